@@ -11,7 +11,11 @@ void warn(const char* msg, ...)
 	va_list argList;
 	va_start(argList, msg);
 	char buff[161];
+#ifdef _MSC_VER
 	vsnprintf_s(buff, 161, msg, argList);
+#else
+	vsnprintf(buff, 161, msg, argList);
+#endif
 	va_end(argList);
 	std::cout << buff << std::endl;
 }
\ No newline at end of file
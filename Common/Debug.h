@@ -14,7 +14,11 @@ extern char _DEBUG_BUFFER[256];
 #define WHERESTR  " [file %s, line %d]: "
 #define WHEREARG  __FILE__, __LINE__
 
+#ifdef _WIN32
 #define DEBUGPRINT(type, ...) { snprintf(_DEBUG_BUFFER, 256, __VA_ARGS__); OutputDebugStringA(_DEBUG_BUFFER);}
+#else
+#define DEBUGPRINT(type, ...) { fprintf(stderr, __VA_ARGS__); }
+#endif
 //fprintf(stderr, type##WHERESTR##, WHEREARG); fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n");
 
 //#if ENABLE_ASSERTIONS
@@ -3,7 +3,7 @@
 #include "Configuration.h" // Must be included first
 #include "Types.h"
 #include "Debug.h"
-#include <Framework3\Platform.h>
+#include <Framework3/Platform.h>
 
 // RESULT Enum and related functions
 #define IFC(x) if( FAILED((r = x)) ) {goto cleanup;}	// If Failed Cleanup
@@ -16,4 +16,12 @@
 // Math
 #define DEGTORAD(x) (x/360.f*2*PI)
 
-typedef int RESULT;
\ No newline at end of file
+typedef int RESULT;
+
+// Windows provides these through windows.h
+#ifndef _WIN32
+#	define S_OK		0
+#	define E_FAIL	((RESULT)0x80004005)
+#	define SUCCEEDED(r) ((RESULT)(r) >= 0)
+#	define FAILED(r) ((RESULT)(r) < 0)
+#endif
\ No newline at end of file
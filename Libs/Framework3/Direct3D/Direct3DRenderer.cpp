@@ -907,6 +907,27 @@ IndexBufferID Direct3DRenderer::addIndexBuffer(const uint nIndices, const uint i
 	return indexBuffers.add(ib);
 }
 
+void Direct3DRenderer::removeVertexFormat(const VertexFormatID vertexFormat){
+	if (vertexFormats[vertexFormat].vertexDecl){
+		vertexFormats[vertexFormat].vertexDecl->Release();
+		vertexFormats[vertexFormat].vertexDecl = NULL;
+	}
+}
+
+void Direct3DRenderer::removeVertexBuffer(const VertexBufferID vertexBuffer){
+	if (vertexBuffers[vertexBuffer].vertexBuffer){
+		vertexBuffers[vertexBuffer].vertexBuffer->Release();
+		vertexBuffers[vertexBuffer].vertexBuffer = NULL;
+	}
+}
+
+void Direct3DRenderer::removeIndexBuffer(const IndexBufferID indexBuffer){
+	if (indexBuffers[indexBuffer].indexBuffer){
+		indexBuffers[indexBuffer].indexBuffer->Release();
+		indexBuffers[indexBuffer].indexBuffer = NULL;
+	}
+}
+
 SamplerStateID Direct3DRenderer::addSamplerState(const Filter filter, const AddressMode s, const AddressMode t, const AddressMode r, const float lod, const uint maxAniso, const int compareFunc, const float *border_color){
 	SamplerState samplerState;
 
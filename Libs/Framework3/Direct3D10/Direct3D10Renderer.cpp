@@ -250,7 +250,7 @@ static DXGI_FORMAT formats[] = {
 	DXGI_FORMAT_R9G9B9E5_SHAREDEXP,
 	DXGI_FORMAT_R11G11B10_FLOAT,
 	DXGI_FORMAT_B5G6R5_UNORM,
-	DXGI_FORMAT_UNKNOWN, // RGBA4 not directly supported
+	(DXGI_FORMAT) 115, // RGBA4 as DXGI_FORMAT_B4G4R4A4_UNORM, only DXGI 1.2+ defines it
 	DXGI_FORMAT_R10G10B10A2_UNORM,
 
 	DXGI_FORMAT_D16_UNORM,
@@ -629,6 +629,14 @@ TextureID Direct3D10Renderer::addTexture(Image &img, const SamplerStateID sample
 	Texture tex;
 	memset(&tex, 0, sizeof(tex));
 
+	// The 16 bit formats need DXGI 1.2, expand them where the device can't sample them
+	if (img.getFormat() == FORMAT_RGB565 || img.getFormat() == FORMAT_RGBA4){
+		UINT support = 0;
+		if (FAILED(device->CheckFormatSupport(formats[img.getFormat()], &support)) || !(support & D3D10_FORMAT_SUPPORT_TEXTURE2D)){
+			img.unpackImage();
+		}
+	}
+
 	switch (img.getFormat()){
 		case FORMAT_RGB8:
 			img.convert(FORMAT_RGBA8);
@@ -1621,6 +1629,8 @@ VertexFormatID Direct3D10Renderer::addVertexFormat(const FormatDesc *formatDesc,
 		DXGI_FORMAT_R16_FLOAT, DXGI_FORMAT_R16G16_FLOAT, DXGI_FORMAT_UNKNOWN,         DXGI_FORMAT_R16G16B16A16_FLOAT,
 		DXGI_FORMAT_R8_UNORM,  DXGI_FORMAT_R8G8_UNORM,   DXGI_FORMAT_UNKNOWN,         DXGI_FORMAT_R8G8B8A8_UNORM,
 		DXGI_FORMAT_R32_UINT,  DXGI_FORMAT_R32G32_UINT,  DXGI_FORMAT_R32G32B32_UINT,  DXGI_FORMAT_R32G32B32A32_UINT,
+		DXGI_FORMAT_R16_SINT,  DXGI_FORMAT_R16G16_SINT,  DXGI_FORMAT_UNKNOWN,         DXGI_FORMAT_R16G16B16A16_SINT,
+		DXGI_FORMAT_R8_SNORM,  DXGI_FORMAT_R8G8_SNORM,   DXGI_FORMAT_UNKNOWN,         DXGI_FORMAT_R8G8B8A8_SNORM,
 	};
 
 	static const char *semantics[] = {
@@ -1723,6 +1733,18 @@ IndexBufferID Direct3D10Renderer::addIndexBuffer(const uint nIndices, const uint
 	return indexBuffers.add(ib);
 }
 
+void Direct3D10Renderer::removeVertexFormat(const VertexFormatID vertexFormat){
+	SAFE_RELEASE(vertexFormats[vertexFormat].inputLayout);
+}
+
+void Direct3D10Renderer::removeVertexBuffer(const VertexBufferID vertexBuffer){
+	SAFE_RELEASE(vertexBuffers[vertexBuffer].vertexBuffer);
+}
+
+void Direct3D10Renderer::removeIndexBuffer(const IndexBufferID indexBuffer){
+	SAFE_RELEASE(indexBuffers[indexBuffer].indexBuffer);
+}
+
 D3D10_FILTER filters[] = {
 	D3D10_FILTER_MIN_MAG_MIP_POINT,
 	D3D10_FILTER_MIN_MAG_LINEAR_MIP_POINT,
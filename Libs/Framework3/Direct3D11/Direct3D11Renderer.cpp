@@ -1508,6 +1508,9 @@ VertexFormatID Direct3D11Renderer::addVertexFormat(const FormatDesc *formatDesc,
 		{ DXGI_FORMAT_R32_FLOAT, DXGI_FORMAT_R32G32_FLOAT, DXGI_FORMAT_R32G32B32_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT },
 		{ DXGI_FORMAT_R16_FLOAT, DXGI_FORMAT_R16G16_FLOAT, DXGI_FORMAT_UNKNOWN,         DXGI_FORMAT_R16G16B16A16_FLOAT },
 		{ DXGI_FORMAT_R8_UNORM,  DXGI_FORMAT_R8G8_UNORM,   DXGI_FORMAT_UNKNOWN,         DXGI_FORMAT_R8G8B8A8_UNORM     },
+		{ DXGI_FORMAT_R32_UINT,  DXGI_FORMAT_R32G32_UINT,  DXGI_FORMAT_R32G32B32_UINT,  DXGI_FORMAT_R32G32B32A32_UINT  },
+		{ DXGI_FORMAT_R16_SINT,  DXGI_FORMAT_R16G16_SINT,  DXGI_FORMAT_UNKNOWN,         DXGI_FORMAT_R16G16B16A16_SINT  },
+		{ DXGI_FORMAT_R8_SNORM,  DXGI_FORMAT_R8G8_SNORM,   DXGI_FORMAT_UNKNOWN,         DXGI_FORMAT_R8G8B8A8_SNORM     },
 	};
 
 	static const char *semantics[] =
@@ -1617,6 +1620,21 @@ IndexBufferID Direct3D11Renderer::addIndexBuffer(const uint nIndices, const uint
 	return indexBuffers.add(ib);
 }
 
+void Direct3D11Renderer::removeVertexFormat(const VertexFormatID vertexFormat)
+{
+	SAFE_RELEASE(vertexFormats[vertexFormat].inputLayout);
+}
+
+void Direct3D11Renderer::removeVertexBuffer(const VertexBufferID vertexBuffer)
+{
+	SAFE_RELEASE(vertexBuffers[vertexBuffer].vertexBuffer);
+}
+
+void Direct3D11Renderer::removeIndexBuffer(const IndexBufferID indexBuffer)
+{
+	SAFE_RELEASE(indexBuffers[indexBuffer].indexBuffer);
+}
+
 static const D3D11_FILTER filters[] =
 {
 	D3D11_FILTER_MIN_MAG_MIP_POINT,
@@ -274,6 +274,7 @@ Image::Image(){
 	nMipMaps = 0;
 	arraySize = 0;
 	format = FORMAT_NONE;
+	ownsMemory = true;
 
 	nExtraData = 0;
 	extraData = nullptr;
@@ -2139,19 +2140,70 @@ bool Image::removeMipMaps(const int firstMipMap, int mipMapsToSave){
 	return true;
 }
 
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define IMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+// 5 and 6 bit endpoint channels to 8 bits, repeating the high bits so that 0x1F maps to 255 like on the GPU
+static inline int expand5(int c){ return (c << 3) | (c >> 2); }
+static inline int expand6(int c){ return (c << 2) | (c >> 4); }
+
+#ifdef IMAGE_SSE2
+static inline __m128i selectBits(__m128i mask, __m128i a, __m128i b){
+	return _mm_xor_si128(b, _mm_and_si128(mask, _mm_xor_si128(a, b)));
+}
+
+// Looks up a row of 4 pixels at a time in the 0x00BBGGRR palette, comparing each pixel's index against all
+// four values. Four channel pixels keep the alpha that's already there, three channel pixels are packed to
+// 12 bytes per row so nothing past the block gets written.
+static void decodeColorBlockSSE2(unsigned char *dest, int nChannels, int yOff, const unsigned int palette[4], unsigned int indexes){
+	__m128i p0 = _mm_set1_epi32(palette[0]);
+	__m128i p1 = _mm_set1_epi32(palette[1]);
+	__m128i p2 = _mm_set1_epi32(palette[2]);
+	__m128i p3 = _mm_set1_epi32(palette[3]);
+	__m128i index1 = _mm_set_epi32(0x40, 0x10, 0x04, 0x01);
+	__m128i index2 = _mm_add_epi32(index1, index1);
+	__m128i index3 = _mm_add_epi32(index1, index2);
+	__m128i alphaMask = _mm_set1_epi32((int) 0xFF000000);
+	__m128i rgbMask = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+
+	__m128i rowIndexes = _mm_set1_epi32(indexes);
+	for (int y = 0; y < 4; y++){
+		__m128i index = _mm_and_si128(rowIndexes, index3);
+		__m128i pixels = selectBits(_mm_cmpeq_epi32(index, index1), p1, p0);
+		pixels = selectBits(_mm_cmpeq_epi32(index, index2), p2, pixels);
+		pixels = selectBits(_mm_cmpeq_epi32(index, index3), p3, pixels);
+
+		unsigned char *dst = dest + yOff * y;
+		if (nChannels == 4){
+			__m128i old = _mm_loadu_si128((__m128i *) dst);
+			_mm_storeu_si128((__m128i *) dst, _mm_or_si128(pixels, _mm_and_si128(old, alphaMask)));
+		} else {
+			// Two 6 byte pixel pairs in the 64 bit halves, then moved next to each other
+			__m128i pairs = _mm_or_si128(_mm_and_si128(pixels, rgbMask), _mm_srli_epi64(_mm_andnot_si128(rgbMask, pixels), 8));
+			__m128i packed = _mm_or_si128(_mm_move_epi64(pairs), _mm_slli_si128(_mm_srli_si128(pairs, 8), 6));
+			_mm_storel_epi64((__m128i *) dst, packed);
+			*(uint32 *) (dst + 8) = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+		}
+		rowIndexes = _mm_srli_epi32(rowIndexes, 8);
+	}
+}
+#endif
+
 void decodeColorBlock(unsigned char *dest, int w, int h, int xOff, int yOff, FORMAT format, int red, int blue, unsigned char *src){
 	unsigned char colors[4][3];
 
 	uint16 c0 = *(uint16 *) src;
 	uint16 c1 = *(uint16 *) (src + 2);
 	
-	colors[0][0] = ((c0 >> 11) & 0x1F) << 3;
-	colors[0][1] = ((c0 >>  5) & 0x3F) << 2;
-	colors[0][2] =  (c0        & 0x1F) << 3;
+	colors[0][0] = expand5((c0 >> 11) & 0x1F);
+	colors[0][1] = expand6((c0 >>  5) & 0x3F);
+	colors[0][2] = expand5( c0        & 0x1F);
 	
-	colors[1][0] = ((c1 >> 11) & 0x1F) << 3;
-	colors[1][1] = ((c1 >>  5) & 0x3F) << 2;
-	colors[1][2] =  (c1        & 0x1F) << 3;
+	colors[1][0] = expand5((c1 >> 11) & 0x1F);
+	colors[1][1] = expand6((c1 >>  5) & 0x3F);
+	colors[1][2] = expand5( c1        & 0x1F);
 
 	if (c0 > c1 || format == FORMAT_DXT5){
 		for (int i = 0; i < 3; i++){
@@ -2166,6 +2218,16 @@ void decodeColorBlock(unsigned char *dest, int w, int h, int xOff, int yOff, FOR
 	}
 
 	src += 4;
+#ifdef IMAGE_SSE2
+	if (w == 4 && h == 4 && red == 0 && blue == 2 && (xOff == 3 || xOff == 4)){
+		unsigned int palette[4];
+		for (int i = 0; i < 4; i++){
+			palette[i] = colors[i][0] | (colors[i][1] << 8) | (colors[i][2] << 16);
+		}
+		decodeColorBlockSSE2(dest, xOff, yOff, palette, *(uint32 *) src);
+		return;
+	}
+#endif
 	for (int y = 0; y < h; y++){
 		unsigned char *dst = dest + yOff * y;
 		unsigned int indexes = src[y];
@@ -2230,23 +2292,25 @@ void decodeCompressedImage(unsigned char *dest, unsigned char *src, const int wi
 	for (int y = 0; y < height; y += 4){
 		for (int x = 0; x < width; x += 4){
 			unsigned char *dst = dest + (y * width + x) * nChannels;
+			int w = min(sx, width - x);
+			int h = min(sy, height - y);
 			if (format == FORMAT_DXT3){
-				decodeDXT3AlphaBlock(dst + 3, sx, sy, nChannels, width * nChannels, src);
+				decodeDXT3AlphaBlock(dst + 3, w, h, nChannels, width * nChannels, src);
 				src += 8;
 			} else if (format == FORMAT_DXT5){
-				decodeDXT5AlphaBlock(dst + 3, sx, sy, nChannels, width * nChannels, src);
+				decodeDXT5AlphaBlock(dst + 3, w, h, nChannels, width * nChannels, src);
 				src += 8;
 			}
 			if (format <= FORMAT_DXT5){
-				decodeColorBlock(dst, sx, sy, nChannels, width * nChannels, format, 0, 2, src);
+				decodeColorBlock(dst, w, h, nChannels, width * nChannels, format, 0, 2, src);
 				src += 8;
 			} else {
 				if (format == FORMAT_ATI1N){
-					decodeDXT5AlphaBlock(dst, sx, sy, 1, width, src);
+					decodeDXT5AlphaBlock(dst, w, h, 1, width, src);
 					src += 8;
 				} else {
-					decodeDXT5AlphaBlock(dst,     sx, sy, 2, width * 2, src + 8);
-					decodeDXT5AlphaBlock(dst + 1, sx, sy, 2, width * 2, src);
+					decodeDXT5AlphaBlock(dst,     w, h, 2, width * 2, src + 8);
+					decodeDXT5AlphaBlock(dst + 1, w, h, 2, width * 2, src);
 					src += 16;
 				}
 			}
@@ -2254,6 +2318,383 @@ void decodeCompressedImage(unsigned char *dest, unsigned char *src, const int wi
 	}
 }
 
+// Block compression, the inverse of decodeCompressedImage(). The color endpoints start
+// out as the extremes of the block along its principal axis, every quality level above
+// zero adds a least squares refinement pass that refits them to the chosen palette indices.
+// Matching pixels against a palette is the inner loop and done four pixels at a time with SSE2.
+
+// Reads a 4x4 block into planar floats, replicating the last row and column of partial blocks
+static void loadBlock(float dest[][16], const unsigned char *src, int w, int h, int xOff, int yOff, int nChannels){
+	for (int y = 0; y < 4; y++){
+		const unsigned char *row = src + yOff * min(y, h - 1);
+		for (int x = 0; x < 4; x++){
+			const unsigned char *pixel = row + xOff * min(x, w - 1);
+			for (int ch = 0; ch < nChannels; ch++){
+				dest[ch][4 * y + x] = pixel[ch];
+			}
+		}
+	}
+}
+
+static uint16 quantize565(const float *rgb){
+	int r = (int) (clamp(rgb[0], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+	int g = (int) (clamp(rgb[1], 0.0f, 255.0f) * (63.0f / 255.0f) + 0.5f);
+	int b = (int) (clamp(rgb[2], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+	return (uint16) ((r << 11) | (g << 5) | b);
+}
+
+// The four colors of a block in four color mode, exactly as decodeColorBlock() computes them
+static void colorPalette(float palette[4][3], const uint16 c0, const uint16 c1){
+	int colors[4][3];
+	colors[0][0] = expand5((c0 >> 11) & 0x1F);
+	colors[0][1] = expand6((c0 >>  5) & 0x3F);
+	colors[0][2] = expand5( c0        & 0x1F);
+	colors[1][0] = expand5((c1 >> 11) & 0x1F);
+	colors[1][1] = expand6((c1 >>  5) & 0x3F);
+	colors[1][2] = expand5( c1        & 0x1F);
+	for (int i = 0; i < 3; i++){
+		colors[2][i] = (2 * colors[0][i] +     colors[1][i] + 1) / 3;
+		colors[3][i] = (    colors[0][i] + 2 * colors[1][i] + 1) / 3;
+	}
+
+	for (int k = 0; k < 4; k++){
+		for (int i = 0; i < 3; i++) palette[k][i] = (float) colors[k][i];
+	}
+}
+
+// Picks the closest palette color for each pixel and returns the total squared error
+static float matchColors(unsigned char indices[16], float block[][16], float palette[4][3]){
+#ifdef IMAGE_SSE2
+	__m128 error = _mm_setzero_ps();
+	for (int i = 0; i < 16; i += 4){
+		__m128 r = _mm_loadu_ps(block[0] + i);
+		__m128 g = _mm_loadu_ps(block[1] + i);
+		__m128 b = _mm_loadu_ps(block[2] + i);
+
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i index = _mm_setzero_si128();
+		for (int k = 0; k < 4; k++){
+			__m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+			__m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+			__m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+			index = _mm_or_si128(_mm_andnot_si128(closer, index), _mm_and_si128(closer, _mm_set1_epi32(k)));
+			best = _mm_min_ps(d, best);
+		}
+		error = _mm_add_ps(error, best);
+
+		// The indices are 0-3, so they survive both saturating packs
+		index = _mm_packs_epi32(index, index);
+		index = _mm_packus_epi16(index, index);
+		int packed = _mm_cvtsi128_si32(index);
+		memcpy(indices + i, &packed, 4);
+	}
+	float sums[4];
+	_mm_storeu_ps(sums, error);
+	return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#else
+	float error = 0;
+	for (int i = 0; i < 16; i++){
+		float best = FLT_MAX;
+		for (int k = 0; k < 4; k++){
+			float dr = block[0][i] - palette[k][0];
+			float dg = block[1][i] - palette[k][1];
+			float db = block[2][i] - palette[k][2];
+			float d = dr * dr + dg * dg + db * db;
+			if (d < best){
+				best = d;
+				indices[i] = k;
+			}
+		}
+		error += best;
+	}
+	return error;
+#endif
+}
+
+void encodeColorBlock(unsigned char *dest, const unsigned char *src, int w, int h, int xOff, int yOff, int quality){
+	float block[3][16];
+	loadBlock(block, src, w, h, xOff, yOff, 3);
+
+	// Principal axis through power iteration on the covariance matrix
+	float mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++){
+		for (int ch = 0; ch < 3; ch++) mean[ch] += block[ch][i];
+	}
+	for (int ch = 0; ch < 3; ch++) mean[ch] *= 1.0f / 16.0f;
+
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < 16; i++){
+		float r = block[0][i] - mean[0];
+		float g = block[1][i] - mean[1];
+		float b = block[2][i] - mean[2];
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
+
+	float axis[3] = { 1, 1, 1 };
+	for (int iter = 0; iter < 8; iter++){
+		float x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+		float y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+		float z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+		float len = max(max(fabsf(x), fabsf(y)), fabsf(z));
+		if (len < 1e-6f) break; // Flat block, any axis will do
+		axis[0] = x / len;
+		axis[1] = y / len;
+		axis[2] = z / len;
+	}
+
+	int iMin = 0, iMax = 0;
+	float dMin = FLT_MAX, dMax = -FLT_MAX;
+	for (int i = 0; i < 16; i++){
+		float d = block[0][i] * axis[0] + block[1][i] * axis[1] + block[2][i] * axis[2];
+		if (d < dMin){ dMin = d; iMin = i; }
+		if (d > dMax){ dMax = d; iMax = i; }
+	}
+
+	float end0[3] = { block[0][iMax], block[1][iMax], block[2][iMax] };
+	float end1[3] = { block[0][iMin], block[1][iMin], block[2][iMin] };
+	uint16 c0 = quantize565(end0);
+	uint16 c1 = quantize565(end1);
+
+	float palette[4][3];
+	unsigned char indices[16];
+	colorPalette(palette, c0, c1);
+	float error = matchColors(indices, block, palette);
+
+	// Refit the endpoints to the indices. Each index blends c0 and c1 with a fixed weight.
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	for (int pass = 0; pass < quality && error > 0; pass++){
+		float aa = 0, bb = 0, ab = 0;
+		float ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++){
+			float a = weights[indices[i]];
+			float b = 1.0f - a;
+			aa += a * a;
+			bb += b * b;
+			ab += a * b;
+			for (int ch = 0; ch < 3; ch++){
+				ax[ch] += a * block[ch][i];
+				bx[ch] += b * block[ch][i];
+			}
+		}
+
+		float det = aa * bb - ab * ab;
+		if (fabsf(det) < 1e-6f) break;
+
+		for (int ch = 0; ch < 3; ch++){
+			end0[ch] = (ax[ch] * bb - bx[ch] * ab) / det;
+			end1[ch] = (bx[ch] * aa - ax[ch] * ab) / det;
+		}
+		uint16 n0 = quantize565(end0);
+		uint16 n1 = quantize565(end1);
+		if (n0 == c0 && n1 == c1) break;
+
+		unsigned char newIndices[16];
+		colorPalette(palette, n0, n1);
+		float newError = matchColors(newIndices, block, palette);
+		if (newError >= error) break;
+
+		c0 = n0;
+		c1 = n1;
+		error = newError;
+		memcpy(indices, newIndices, 16);
+	}
+
+	// Four color mode needs c0 > c1. Swapping the endpoints swaps the indices 0 <-> 1 and 2 <-> 3.
+	if (c0 < c1){
+		uint16 t = c0; c0 = c1; c1 = t;
+		for (int i = 0; i < 16; i++) indices[i] ^= 1;
+	} else if (c0 == c1){
+		memset(indices, 0, 16);
+	}
+
+	dest[0] = c0 & 0xFF;
+	dest[1] = c0 >> 8;
+	dest[2] = c1 & 0xFF;
+	dest[3] = c1 >> 8;
+	for (int y = 0; y < 4; y++){
+		dest[4 + y] = indices[4 * y] | (indices[4 * y + 1] << 2) | (indices[4 * y + 2] << 4) | (indices[4 * y + 3] << 6);
+	}
+}
+
+void encodeDXT3AlphaBlock(unsigned char *dest, const unsigned char *src, int w, int h, int xOff, int yOff){
+	float block[1][16];
+	loadBlock(block, src, w, h, xOff, yOff, 1);
+
+	for (int i = 0; i < 16; i += 2){
+		int a0 = (int) (block[0][i]     * (1.0f / 17.0f) + 0.5f);
+		int a1 = (int) (block[0][i + 1] * (1.0f / 17.0f) + 0.5f);
+		dest[i >> 1] = (unsigned char) (a0 | (a1 << 4));
+	}
+}
+
+// The eight values of an alpha block, exactly as decodeDXT5AlphaBlock() computes them
+static void alphaPalette(unsigned char palette[8], const int a0, const int a1){
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1){
+		for (int k = 2; k < 8; k++) palette[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+	} else {
+		for (int k = 2; k < 6; k++) palette[k] = ((6 - k) * a0 + (k - 1) * a1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static int matchAlpha(unsigned char indices[16], const unsigned char values[16], const unsigned char palette[8]){
+#ifdef IMAGE_SSE2
+	// All 16 pixels at once, with per byte absolute differences
+	__m128i v = _mm_loadu_si128((const __m128i *) values);
+	__m128i best = _mm_set1_epi8((char) 0xFF);
+	__m128i index = _mm_setzero_si128();
+	for (int k = 0; k < 8; k++){
+		__m128i p = _mm_set1_epi8((char) palette[k]);
+		__m128i d = _mm_or_si128(_mm_subs_epu8(v, p), _mm_subs_epu8(p, v));
+
+		__m128i closer = _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(best, d), _mm_setzero_si128()), _mm_set1_epi8((char) 0xFF));
+		index = _mm_or_si128(_mm_andnot_si128(closer, index), _mm_and_si128(closer, _mm_set1_epi8((char) k)));
+		best = _mm_min_epu8(best, d);
+	}
+	_mm_storeu_si128((__m128i *) indices, index);
+
+	__m128i lo = _mm_unpacklo_epi8(best, _mm_setzero_si128());
+	__m128i hi = _mm_unpackhi_epi8(best, _mm_setzero_si128());
+	__m128i sum = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+	int sums[4];
+	_mm_storeu_si128((__m128i *) sums, sum);
+	return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+	int error = 0;
+	for (int i = 0; i < 16; i++){
+		int best = 256;
+		for (int k = 0; k < 8; k++){
+			int d = abs(values[i] - palette[k]);
+			if (d < best){
+				best = d;
+				indices[i] = k;
+			}
+		}
+		error += best * best;
+	}
+	return error;
+#endif
+}
+
+void encodeDXT5AlphaBlock(unsigned char *dest, const unsigned char *src, int w, int h, int xOff, int yOff, int quality){
+	float block[1][16];
+	loadBlock(block, src, w, h, xOff, yOff, 1);
+
+	unsigned char values[16];
+	int vMin = 255, vMax = 0;
+	int inMin = 255, inMax = 0; // Without 0 and 255
+	for (int i = 0; i < 16; i++){
+		int v = (int) block[0][i];
+		values[i] = v;
+		vMin = min(vMin, v);
+		vMax = max(vMax, v);
+		if (v != 0 && v != 255){
+			inMin = min(inMin, v);
+			inMax = max(inMax, v);
+		}
+	}
+
+	int a0 = vMax, a1 = vMin;
+	unsigned char palette[8], indices[16];
+	alphaPalette(palette, a0, a1);
+	int error = matchAlpha(indices, values, palette);
+
+	// Eight value mode, refit like the color endpoints
+	for (int pass = 0; pass < quality && error > 0 && a0 > a1; pass++){
+		float aa = 0, bb = 0, ab = 0, ax = 0, bx = 0;
+		for (int i = 0; i < 16; i++){
+			int k = indices[i];
+			float a = (k == 0)? 1.0f : (k == 1)? 0.0f : (8 - k) / 7.0f;
+			float b = 1.0f - a;
+			aa += a * a;
+			bb += b * b;
+			ab += a * b;
+			ax += a * values[i];
+			bx += b * values[i];
+		}
+
+		float det = aa * bb - ab * ab;
+		if (fabsf(det) < 1e-6f) break;
+
+		int n0 = (int) (clamp((ax * bb - bx * ab) / det, 0.0f, 255.0f) + 0.5f);
+		int n1 = (int) (clamp((bx * aa - ax * ab) / det, 0.0f, 255.0f) + 0.5f);
+		if (n0 <= n1 || (n0 == a0 && n1 == a1)) break;
+
+		unsigned char newIndices[16];
+		alphaPalette(palette, n0, n1);
+		int newError = matchAlpha(newIndices, values, palette);
+		if (newError >= error) break;
+
+		a0 = n0;
+		a1 = n1;
+		error = newError;
+		memcpy(indices, newIndices, 16);
+	}
+
+	// Six value mode, which has exact 0 and 255, for blocks that use them
+	if (quality > 0 && error > 0 && (vMin == 0 || vMax == 255) && inMin <= inMax){
+		unsigned char newIndices[16];
+		alphaPalette(palette, inMin, inMax);
+		int newError = matchAlpha(newIndices, values, palette);
+		if (newError < error){
+			a0 = inMin;
+			a1 = inMax;
+			memcpy(indices, newIndices, 16);
+		}
+	}
+
+	dest[0] = a0;
+	dest[1] = a1;
+	uint64 bits = 0;
+	for (int i = 15; i >= 0; i--){
+		bits = (bits << 3) | indices[i];
+	}
+	for (int i = 0; i < 6; i++){
+		dest[2 + i] = (unsigned char) (bits >> (8 * i));
+	}
+}
+
+// src holds nChannels per pixel, at least as many as the format stores
+void encodeCompressedImage(unsigned char *dest, const unsigned char *src, const int width, const int height, const int nChannels, const FORMAT format, const int quality){
+	int sx = (width  < 4)? width  : 4;
+	int sy = (height < 4)? height : 4;
+
+	for (int y = 0; y < height; y += 4){
+		for (int x = 0; x < width; x += 4){
+			const unsigned char *s = src + (y * width + x) * nChannels;
+			int w = min(sx, width - x);
+			int h = min(sy, height - y);
+			if (format == FORMAT_DXT3){
+				encodeDXT3AlphaBlock(dest, s + 3, w, h, nChannels, width * nChannels);
+				dest += 8;
+			} else if (format == FORMAT_DXT5){
+				encodeDXT5AlphaBlock(dest, s + 3, w, h, nChannels, width * nChannels, quality);
+				dest += 8;
+			}
+			if (format <= FORMAT_DXT5){
+				encodeColorBlock(dest, s, w, h, nChannels, width * nChannels, quality);
+				dest += 8;
+			} else {
+				if (format == FORMAT_ATI1N){
+					encodeDXT5AlphaBlock(dest, s, w, h, nChannels, width * nChannels, quality);
+					dest += 8;
+				} else {
+					encodeDXT5AlphaBlock(dest + 8, s,     w, h, nChannels, width * nChannels, quality);
+					encodeDXT5AlphaBlock(dest,     s + 1, w, h, nChannels, width * nChannels, quality);
+					dest += 16;
+				}
+			}
+		}
+	}
+}
+
 bool Image::uncompressImage(){
 	if (isCompressedFormat(format)){
 		FORMAT destFormat;
@@ -2288,11 +2729,52 @@ bool Image::uncompressImage(){
 		
 		free();
 		pixels = newPixels;
+		ownsMemory = true;
 	}
 
 	return true;
 }
 
+bool Image::compressImage(const FORMAT destFormat, const int quality){
+	if (!isCompressedFormat(destFormat) || format < FORMAT_R8 || format > FORMAT_RGBA8) return false;
+
+	// Expand to as many channels as the compressed format stores
+	int nChannels = getChannelCount(destFormat);
+	if (getChannelCount(format) < nChannels){
+		convert((FORMAT) (FORMAT_R8 + nChannels - 1));
+	}
+	nChannels = getChannelCount(format);
+
+	ubyte *newPixels = new ubyte[getMipMappedSize(0, nMipMaps, destFormat)];
+
+	int level = 0;
+	ubyte *src, *dst = newPixels;
+	while ((src = getPixels(level)) != NULL){
+		int w = getWidth(level);
+		int h = getHeight(level);
+		int d = (depth == 0)? 6 : getDepth(level);
+
+		int dstSliceSize = getSliceSize(level, destFormat);
+		int srcSliceSize = getSliceSize(level, format);
+
+		for (int slice = 0; slice < d; slice++){
+			encodeCompressedImage(dst, src, w, h, nChannels, destFormat, quality);
+
+			dst += dstSliceSize;
+			src += srcSliceSize;
+		}
+		level++;
+	}
+
+	format = destFormat;
+
+	free();
+	pixels = newPixels;
+	ownsMemory = true;
+
+	return true;
+}
+
 bool Image::unpackImage(){
 	int pixelCount = getPixelCount(0, nMipMaps);
 
@@ -2340,8 +2822,9 @@ bool Image::unpackImage(){
 		return false;
 	}
 
-	delete [] pixels;
+	if (ownsMemory) delete [] pixels;
 	pixels = newPixels;
+	ownsMemory = true;
 
 	return true;
 }
@@ -2442,8 +2925,9 @@ bool Image::convert(const FORMAT newFormat){
 			} while (--nPixels);
 		}
 	}
-	delete [] pixels;
+	if (ownsMemory) delete [] pixels;
 	pixels = newPixels;
+	ownsMemory = true;
 	format = newFormat;
 
 	return true;
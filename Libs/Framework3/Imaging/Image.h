@@ -316,6 +316,9 @@ public:
 	bool removeMipMaps(const int firstMipMap, const int mipMapsToSave = ALL_MIPMAPS);
 
 	bool uncompressImage();
+	// Block compresses an 8 bit per channel image to a DXT or ATI format. Quality 0 is the
+	// fastest, each level above adds a refinement pass over the endpoints of every block.
+	bool compressImage(const FORMAT destFormat, const int quality = 2);
 	bool unpackImage();
 
 	bool convert(const FORMAT newFormat);
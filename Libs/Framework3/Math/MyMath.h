@@ -64,6 +64,8 @@ inline float sincf(const float x){
 
 #define roundf(x) floorf((x) + 0.5f)
 
+#if defined(_WIN32)
+
 #ifndef min
 #define min(x, y) ((x < y)? x : y)
 #endif
@@ -72,6 +74,19 @@ inline float sincf(const float x){
 #define max(x, y) ((x > y)? x : y)
 #endif
 
+#else
+
+// Functions instead of macros, the standard library headers use min and max as names
+#include <type_traits>
+
+template <typename T, typename U>
+inline typename std::common_type<T, U>::type min(const T x, const U y){ return (x < y)? x : y; }
+
+template <typename T, typename U>
+inline typename std::common_type<T, U>::type max(const T x, const U y){ return (x > y)? x : y; }
+
+#endif
+
 inline float intAdjustf(const float x, const float diff = 0.01f){
 	float f = roundf(x);
 
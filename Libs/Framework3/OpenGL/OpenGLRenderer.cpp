@@ -1007,6 +1007,20 @@ IndexBufferID OpenGLRenderer::addIndexBuffer(const uint nIndices, const uint ind
 	return indexBuffers.add(ib);
 }
 
+void OpenGLRenderer::removeVertexFormat(const VertexFormatID vertexFormat){
+	// Only a description, there is nothing to delete
+}
+
+void OpenGLRenderer::removeVertexBuffer(const VertexBufferID vertexBuffer){
+	glDeleteBuffersARB(1, &vertexBuffers[vertexBuffer].vboVB);
+	vertexBuffers[vertexBuffer].vboVB = 0;
+}
+
+void OpenGLRenderer::removeIndexBuffer(const IndexBufferID indexBuffer){
+	glDeleteBuffersARB(1, &indexBuffers[indexBuffer].vboIB);
+	indexBuffers[indexBuffer].vboIB = 0;
+}
+
 GLint minFilters[] = {
 	GL_NEAREST,
 	GL_LINEAR,
@@ -352,7 +352,7 @@ ShaderID Renderer::addShader(const char *fileName, const char **attributeNames,
 }
 
 int Renderer::getFormatSize(const AttributeFormat format) const {
-	static int formatSize[] = { sizeof(float), sizeof(half), sizeof(ubyte), sizeof(uint) };
+	static int formatSize[] = { sizeof(float), sizeof(half), sizeof(ubyte), sizeof(uint), sizeof(short), sizeof(char) };
 	return formatSize[format];
 }
 
@@ -222,6 +222,8 @@ enum AttributeFormat {
 	FORMAT_HALF  = 1,
 	FORMAT_UBYTE = 2,
 	FORMAT_UINT  = 3,
+	FORMAT_SHORT = 4, // signed, read as integers
+	FORMAT_BYTE  = 5, // signed normalized
 };
 
 struct FormatDesc {
@@ -329,6 +331,10 @@ public:
 	virtual VertexBufferID addVertexBuffer(const long size, const BufferAccess bufferAccess, const void *data = NULL) = 0;
 	virtual IndexBufferID addIndexBuffer(const uint nIndices, const uint indexSize, const BufferAccess bufferAccess, const void *data = NULL) = 0;
 
+	virtual void removeVertexFormat(const VertexFormatID vertexFormat) = 0;
+	virtual void removeVertexBuffer(const VertexBufferID vertexBuffer) = 0;
+	virtual void removeIndexBuffer(const IndexBufferID indexBuffer) = 0;
+
 	virtual SamplerStateID addSamplerState(const Filter filter, const AddressMode s, const AddressMode t, const AddressMode r, const float lod = 0, const uint maxAniso = 16, const int compareFunc = 0, const float *border_color = NULL) = 0;
 	BlendStateID addBlendState(const int srcFactor, const int destFactor, const int blendMode = BM_ADD, const int mask = ALL, const bool alphaToCoverage = false){
 		return addBlendState(srcFactor, destFactor, srcFactor, destFactor, blendMode, blendMode, mask, alphaToCoverage);
@@ -63,12 +63,12 @@ struct AnimatedJoint
 
 };
 
-void readAnk1Header(FILE* f, bck::Ank1Header& h)
+void readAnk1Header(MemFile* f, bck::Ank1Header& h)
 {
-  fread(h.tag, 1, 4, f);
+  f->read(h.tag, 4);
   readDWORD(f, h.sizeOfSection);
-  fread(&h.loopFlags, 1, 1, f);
-  fread(&h.angleMultiplier, 1, 1, f);
+  f->read(&h.loopFlags, 1);
+  f->read(&h.angleMultiplier, 1);
   readWORD(f, h.animationLength);
   readWORD(f, h.numJoints);
   readWORD(f, h.scaleCount);
@@ -80,21 +80,21 @@ void readAnk1Header(FILE* f, bck::Ank1Header& h)
   readDWORD(f, h.offsetToTrans);
 }
 
-void readAnimIndex(FILE* f, bck::AnimIndex& h)
+void readAnimIndex(MemFile* f, bck::AnimIndex& h)
 {
   readWORD(f, h.count);
   readWORD(f, h.index);
   readWORD(f, h.zero);
 }
 
-void readAnimComponent(FILE* f, bck::AnimComponent& h)
+void readAnimComponent(MemFile* f, bck::AnimComponent& h)
 {
   readAnimIndex(f, h.s);
   readAnimIndex(f, h.r);
   readAnimIndex(f, h.t);
 }
 
-void readAnimatedJoint(FILE* f, bck::AnimatedJoint& h)
+void readAnimatedJoint(MemFile* f, bck::AnimatedJoint& h)
 {
   readAnimComponent(f, h.x);
   readAnimComponent(f, h.y);
@@ -143,10 +143,10 @@ void convRotation(vector<Key>& rots, float scale)
   }
 }
 
-void dumpAnk1(FILE* f, Bck& bck)
+void dumpAnk1(MemFile* f, Bck& bck)
 {
   int i;
-  long ank1Offset = ftell(f);
+  long ank1Offset = f->tell();
 
   //read header
   bck::Ank1Header h;
@@ -155,29 +155,29 @@ void dumpAnk1(FILE* f, Bck& bck)
   bck.animationLength = h.animationLength;
 
   //read scale floats:
-  fseek(f, ank1Offset + h.offsetToScales, SEEK_SET);
+  f->seek(ank1Offset + h.offsetToScales);
   vector<f32> scales(h.scaleCount);
-  fread(&scales[0], 4, h.scaleCount, f);
+  f->read(&scales[0], 4*h.scaleCount);
   for(i = 0; i < h.scaleCount; ++i)
     toFLOAT(scales[i]);
 
   //read rotation s16s:
-  fseek(f, ank1Offset + h.offsetToRots, SEEK_SET);
+  f->seek(ank1Offset + h.offsetToRots);
   vector<s16> rotations(h.rotCount);
-  fread(&rotations[0], 2, h.rotCount, f);
+  f->read(&rotations[0], 2*h.rotCount);
   for(i = 0; i < h.rotCount; ++i)
     toSHORT(rotations[i]);
 
   //read translation floats:
-  fseek(f, ank1Offset + h.offsetToTrans, SEEK_SET);
+  f->seek(ank1Offset + h.offsetToTrans);
   vector<f32> translations(h.transCount);
-  fread(&translations[0], 4, h.transCount, f);
+  f->read(&translations[0], 4*h.transCount);
   for(i = 0; i < h.transCount; ++i)
     toFLOAT(translations[i]);
 
   //read joints
   float rotScale = pow(2.f, h.angleMultiplier)*180/32768.f;
-  fseek(f, ank1Offset + h.offsetToJoints, SEEK_SET);
+  f->seek(ank1Offset + h.offsetToJoints);
   bck.anims.resize(h.numJoints);
   for(i = 0; i < h.numJoints; ++i)
   {
@@ -204,30 +204,22 @@ void dumpAnk1(FILE* f, Bck& bck)
   //the ANK1 block, for example 24_cl_cut07_dash_o.bck
 }
 
-Bck* readBck(FILE* f)
+Bck* readBck(const u8* data, size_t size)
 {
+  MemFile mf(data, size);
+  MemFile* f = &mf;
   Bck* ret = new Bck;
 
-  //skip file header
-  fseek(f, 0x20, SEEK_SET);
-
-  u32 size = 0;
-  char tag[4];
-  int t;
-
-  do
+  //skip file header, then walk the sections using their size fields
+  size_t t = 0x20;
+  const u8* sectionHeader;
+  while((sectionHeader = f->at(t, 8)) != NULL)
   {
-    fseek(f, size, SEEK_CUR);
-    t = ftell(f);
-
-    fread(tag, 1, 4, f);
-    fread(&size, 4, 1, f);
-    toDWORD(size);
+    const char* tag = (const char*)sectionHeader;
+    u32 size = memDWORD(sectionHeader + 4);
     if(size < 8) size = 8; //prevent endless loop on corrupt data
 
-    if(feof(f))
-      break;
-    fseek(f, t, SEEK_SET);
+    f->seek(t);
 
     if(strncmp(tag, "ANK1", 4) == 0)
       dumpAnk1(f, *ret);
@@ -235,12 +227,20 @@ Bck* readBck(FILE* f)
       warn("readBck(): Unsupported section \'%c%c%c%c\'",
         tag[0], tag[1], tag[2], tag[3]);
 
-    fseek(f, t, SEEK_SET);
-  } while(!feof(f));
+    t += size;
+  }
 
   return ret;
 }
 
+Bck* readBck(FILE* f)
+{
+  fseek(f, 0, SEEK_SET);
+  vector<u8> data;
+  readWholeFile(f, data);
+  return readBck(data.data(), data.size());
+}
+
 //////////////////////////////////////////////////////////////////////
 
 
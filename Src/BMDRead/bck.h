@@ -3,7 +3,7 @@
 
 //bck files contain joint animations for bmd/bdl files
 
-#include "Common.h"
+#include "common.h"
 
 #include "jnt1.h"
 
@@ -35,6 +35,8 @@ struct Bck
   int animationLength;
 };
 
+//data has to contain the complete file (see loadBmd())
+Bck* readBck(const u8* data, size_t size);
 Bck* readBck(FILE* f);
 Json::Value serializeBck(Bck* bck);
 
@@ -1,121 +1,200 @@
 #include "bmdread.h"
+#include "parallel.h"
 
-#include <assert.h>
 #include <memory.h>
 #include <string.h>
 #include <iostream>
 
 using namespace std;
 
-void readBmd(FILE* f, BModel* dst)
-{ 
-  //Make sure this is actually a BMD/BDL file
-  fseek(f, 0x04, SEEK_SET);
-  char hdr[3];
-  fread(hdr, 1, 3, f);
-  assert( memcmp(hdr, "bdl", 3) == 0 || memcmp(hdr, "bmd", 3) == 0 );
-	  
-  //skip rest of file header
-  fseek(f, 0x19, SEEK_CUR);
-
-  u32 size = 0;
-  char tag[4];
-  int t;
-
-  do
-  {
-    fseek(f, size, SEEK_CUR);
-    t = ftell(f);
+//the size field from the header of a section that is in the table
+u32 sectionSize(const u8* data, const BmdSectionTable& table, int section)
+{
+  return memDWORD(data + table.offsets[section] + 4);
+}
 
-    fread(tag, 1, 4, f);
-    fread(&size, 4, 1, f);
-    toDWORD(size);
-    if(size < 8) size = 8; //prevent endless loop on corrupt data
+bool findBmdSections(const u8* data, size_t size, BmdSectionTable& table)
+{
+  memset(table.offsets, 0, sizeof(table.offsets));
 
-    if(feof(f))
-      break;
+  //Make sure this is actually a BMD/BDL file
+  if(size < 0x20 || (memcmp(data + 4, "bdl", 3) != 0
+                  && memcmp(data + 4, "bmd", 3) != 0))
+    return false;
 
-    fseek(f, t, SEEK_SET);
+  MemFile f(data, size);
 
-    //setStartupText("Parsing " + std::string(tag, 4) + "...");
+  //skip file header, then walk the sections using their size fields
+  size_t t = 0x20;
+  const u8* sectionHeader;
+  while((sectionHeader = f.at(t, 8)) != NULL)
+  {
+    const char* tag = (const char*)sectionHeader;
+    u32 size = memDWORD(sectionHeader + 4);
+    if(size < 8) size = 8; //prevent endless loop on corrupt data
 
+    int index = -1;
     if(strncmp(tag, "INF1", 4) == 0)
-      dumpInf1(f, dst->inf1);
+      index = BMD_SECTION_INF1;
     else if(strncmp(tag, "VTX1", 4) == 0)
-      dumpVtx1(f, dst->vtx1);
+      index = BMD_SECTION_VTX1;
     else if(strncmp(tag, "EVP1", 4) == 0)
-      dumpEvp1(f, dst->evp1);
+      index = BMD_SECTION_EVP1;
     else if(strncmp(tag, "DRW1", 4) == 0)
-      dumpDrw1(f, dst->drw1);
+      index = BMD_SECTION_DRW1;
     else if(strncmp(tag, "JNT1", 4) == 0)
-      dumpJnt1(f, dst->jnt1);
+      index = BMD_SECTION_JNT1;
     else if(strncmp(tag, "SHP1", 4) == 0)
-      dumpShp1(f, dst->shp1);
+      index = BMD_SECTION_SHP1;
     //else if(strncmp(tag, "MAT3", 4) == 0)
-	else if(strncmp(tag, "MAT", 3) == 0) //s_forest.bmd has a MAT2 section
-      dumpMat3(f, dst->mat3);
+    else if(strncmp(tag, "MAT", 3) == 0) //s_forest.bmd has a MAT2 section
+      index = BMD_SECTION_MAT3;
     else if(strncmp(tag, "TEX1", 4) == 0)
-      dumpTex1(f, dst->tex1);
+      index = BMD_SECTION_TEX1;
+    else if(strncmp(tag, "MDL3", 4) == 0)
+      index = BMD_SECTION_MDL3;
     else
-      warn("readBmd(): Unsupported section \'%c%c%c%c\'",
+      warn("findBmdSections(): Unsupported section \'%c%c%c%c\'",
         tag[0], tag[1], tag[2], tag[3]);
 
-    fseek(f, t, SEEK_SET);
+    //the first section with a given tag wins
+    if(index >= 0 && table.offsets[index] == 0)
+      table.offsets[index] = t;
 
-  } while(!feof(f));
+    t += size;
+  }
+
+  return true;
 }
 
-BModel* loadBmd(FILE* f)
+void readBmdSection(MemFile* f, int section, BModel* dst, int numThreads,
+                    u32 tex1Flags)
+{
+  //setStartupText("Parsing " + std::string(tag, 4) + "...");
+
+  switch(section)
+  {
+    case BMD_SECTION_INF1: dumpInf1(f, dst->inf1); break;
+    case BMD_SECTION_VTX1: dumpVtx1(f, dst->vtx1); break;
+    case BMD_SECTION_EVP1: dumpEvp1(f, dst->evp1); break;
+    case BMD_SECTION_DRW1: dumpDrw1(f, dst->drw1); break;
+    case BMD_SECTION_JNT1: dumpJnt1(f, dst->jnt1); break;
+    case BMD_SECTION_SHP1: dumpShp1(f, dst->shp1); break;
+    case BMD_SECTION_MAT3: dumpMat3(f, dst->mat3); break;
+    case BMD_SECTION_TEX1: dumpTex1(f, dst->tex1, numThreads, tex1Flags); break;
+  }
+}
+
+//parses the sections in mask that the table has and
+//that are not in dst->loadedSections yet
+void readBmdSections(const u8* data, size_t size, const BmdSectionTable& table,
+                     u32 mask, BModel* dst, int numThreads, u32 tex1Flags)
+{
+  std::vector<int> sections;
+  for(int i = 0; i < BMD_SECTION_MDL3; ++i)
+  {
+    u32 bit = 1 << i;
+    if((mask & bit) != 0 && (dst->loadedSections & bit) == 0
+      && table.offsets[i] != 0)
+      sections.push_back(i);
+  }
+
+  //The sections don't depend on each other and each one is parsed
+  //into its own member of dst, so they can be parsed in parallel.
+  //Big ones go first so that they don't end up last on one thread.
+  //TEX1 is usually the biggest by far, so it splits its images over
+  //the threads as well.
+  if(numThreads != 1)
+    std::sort(sections.begin(), sections.end(), [&](int a, int b)
+      { return sectionSize(data, table, a) > sectionSize(data, table, b); });
+
+  parallelFor((int)sections.size(), numThreads, [&](int i)
+  {
+    MemFile f(data, size); //every task needs its own read position
+    f.seek((long)table.offsets[sections[i]]);
+    readBmdSection(&f, sections[i], dst, numThreads, tex1Flags);
+  });
+
+  for(size_t i = 0; i < sections.size(); ++i)
+    dst->loadedSections |= 1 << sections[i];
+}
+
+BModel* loadBmd(const u8* data, size_t size, u32 sections, int numThreads,
+                u32 tex1Flags)
 {
   BModel* ret = new BModel;
-  readBmd(f, ret);
+  ret->loadedSections = 0;
+
+  BmdSectionTable table;
+  if(!findBmdSections(data, size, table))
+  {
+    warn("loadBmd(): Not a bmd/bdl file");
+    return ret;
+  }
+
+  readBmdSections(data, size, table, sections, ret, numThreads, tex1Flags);
   return ret;
 }
 
-void writeBmdInfo(FILE* f, std::ostream& out)
+BModel* loadBmd(FILE* f)
 {
-  //skip file header
-  fseek(f, 0x20, SEEK_SET);
+  fseek(f, 0, SEEK_SET);
+  vector<u8> data;
+  readWholeFile(f, data);
+  return loadBmd(data.data(), data.size());
+}
 
-  u32 size = 0;
-  char tag[4];
-  int t;
+void writeBmdInfo(const u8* data, size_t size, std::ostream& out)
+{
+  BmdSectionTable table;
+  if(!findBmdSections(data, size, table))
+    return;
 
-  do
+  MemFile mf(data, size);
+  MemFile* f = &mf;
+  for(int i = 0; i < BMD_SECTION_COUNT; ++i)
   {
-    fseek(f, size, SEEK_CUR);
-    t = ftell(f);
-
-    fread(tag, 1, 4, f);
-    fread(&size, 4, 1, f);
-    toDWORD(size);
-    if(size < 8) size = 8; //prevent endless loop on corrupt data
+    if(table.offsets[i] == 0)
+      continue;
+
+    f->seek((long)table.offsets[i]);
+    switch(i)
+    {
+      case BMD_SECTION_INF1: writeInf1Info(f, out); break;
+      case BMD_SECTION_VTX1: writeVtx1Info(f, out); break;
+      case BMD_SECTION_EVP1: writeEvp1Info(f, out); break;
+      case BMD_SECTION_DRW1: writeDrw1Info(f, out); break;
+      case BMD_SECTION_JNT1: writeJnt1Info(f, out); break;
+      case BMD_SECTION_SHP1: writeShp1Info(f, out); break;
+      case BMD_SECTION_MAT3: writeMat3Info(f, out); break;
+      case BMD_SECTION_TEX1: writeTex1Info(f, out); break;
+      case BMD_SECTION_MDL3: writeMdl3Info(f, out); break;
+    }
+  }
+}
 
-    if(feof(f))
-      break;
+void writeBmdInfo(FILE* f, std::ostream& out)
+{
+  fseek(f, 0, SEEK_SET);
+  vector<u8> data;
+  readWholeFile(f, data);
+  writeBmdInfo(data.data(), data.size(), out);
+}
 
-    fseek(f, t, SEEK_SET);
+//////////////////////////////////////////////////////////////////////
 
-    if(strncmp(tag, "INF1", 4) == 0)
-      writeInf1Info(f, out);
-    else if(strncmp(tag, "VTX1", 4) == 0)
-      writeVtx1Info(f, out);
-    else if(strncmp(tag, "EVP1", 4) == 0)
-      writeEvp1Info(f, out);
-    else if(strncmp(tag, "DRW1", 4) == 0)
-      writeDrw1Info(f, out);
-    else if(strncmp(tag, "JNT1", 4) == 0)
-      writeJnt1Info(f, out);
-    else if(strncmp(tag, "SHP1", 4) == 0)
-      writeShp1Info(f, out);
-    //else if(strncmp(tag, "MAT3", 4) == 0)
-	else if(strncmp(tag, "MAT", 3) == 0) //s_forest.bmd has a MAT2 section
-      writeMat3Info(f, out);
-    else if(strncmp(tag, "TEX1", 4) == 0)
-      writeTex1Info(f, out);
-    else if(strncmp(tag, "MDL3", 4) == 0)
-      writeMdl3Info(f, out);
+BmdFile::BmdFile(const u8* data, size_t size)
+: m_data(data), m_size(size)
+{
+  m_valid = findBmdSections(data, size, m_table);
+  m_model.loadedSections = 0;
+}
 
-    fseek(f, t, SEEK_SET);
-  } while(!feof(f));
+const BModel& BmdFile::load(u32 sections)
+{
+  if((m_model.loadedSections & sections) != sections && m_valid)
+  {
+    readBmdSections(m_data, m_size, m_table, sections, &m_model, 1, 0);
+  }
+  return m_model;
 }
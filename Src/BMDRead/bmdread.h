@@ -21,6 +21,41 @@
 #include "mdl3.h"
 
 
+//the sections of a bmd/bdl file, in the order they usually appear
+enum BmdSectionIndex
+{
+  BMD_SECTION_INF1,
+  BMD_SECTION_VTX1,
+  BMD_SECTION_EVP1,
+  BMD_SECTION_DRW1,
+  BMD_SECTION_JNT1,
+  BMD_SECTION_SHP1,
+  BMD_SECTION_MAT3,
+  BMD_SECTION_TEX1,
+  BMD_SECTION_MDL3, //only in zelda files, not parsed into BModel
+  BMD_SECTION_COUNT
+};
+
+//section masks for loadBmd() and BmdFile
+enum BmdSectionMask
+{
+  BMD_INF1 = 1 << BMD_SECTION_INF1,
+  BMD_VTX1 = 1 << BMD_SECTION_VTX1,
+  BMD_EVP1 = 1 << BMD_SECTION_EVP1,
+  BMD_DRW1 = 1 << BMD_SECTION_DRW1,
+  BMD_JNT1 = 1 << BMD_SECTION_JNT1,
+  BMD_SHP1 = 1 << BMD_SECTION_SHP1,
+  BMD_MAT3 = 1 << BMD_SECTION_MAT3,
+  BMD_TEX1 = 1 << BMD_SECTION_TEX1,
+
+  BMD_ALL = BMD_INF1 | BMD_VTX1 | BMD_EVP1 | BMD_DRW1
+          | BMD_JNT1 | BMD_SHP1 | BMD_MAT3 | BMD_TEX1,
+
+  //scene graph and joint names/transforms, enough for
+  //asset browsers and dependency scanners
+  BMD_SKELETON = BMD_INF1 | BMD_JNT1
+};
+
 struct BModel
 {
   Inf1 inf1;
@@ -31,8 +66,76 @@ struct BModel
   Shp1 shp1;
   Mat3 mat3;
   Tex1 tex1;
+
+  //BmdSectionMask bits of the sections that were parsed,
+  //the others are left empty
+  u32 loadedSections;
+};
+
+//Offsets of the sections in a bmd/bdl file, 0 if the file doesn't
+//have that section. Only the section headers are read, so this
+//is cheap even for huge files.
+struct BmdSectionTable
+{
+  size_t offsets[BMD_SECTION_COUNT];
+};
+
+//returns false if data is not a bmd/bdl file
+bool findBmdSections(const u8* data, size_t size, BmdSectionTable& table);
+
+//parses a bmd/bdl file that is completely in memory (a mapped
+//file or a decompressed yaz0 buffer). data only has to stay
+//valid for the duration of the call. Sections that are not in
+//the sections mask are skipped without touching their data.
+//With numThreads != 1 the sections are parsed in parallel on
+//up to that many threads (0: one per core), the result is the
+//same as with a single thread. tex1Flags are passed on to
+//dumpTex1() (see Tex1Flags).
+BModel* loadBmd(const u8* data, size_t size, u32 sections = BMD_ALL,
+                int numThreads = 1, u32 tex1Flags = 0);
+void writeBmdInfo(const u8* data, size_t size, std::ostream& out);
+
+//A bmd/bdl file that parses its sections on demand: the section
+//accessors parse a section the first time it is requested, so
+//tools that only look at names or skeletons never pay for the
+//vertex and texture data. The file data has to stay valid as
+//long as the BmdFile is used. Not thread-safe.
+struct BmdFile
+{
+  BmdFile(const u8* data, size_t size);
+
+  //false if the data is not a bmd/bdl file
+  bool isValid() const { return m_valid; }
+
+  //true if the file contains the section (BmdSectionIndex)
+  bool hasSection(BmdSectionIndex section) const
+  { return m_table.offsets[section] != 0; }
+
+  const Inf1& inf1() { return load(BMD_INF1).inf1; }
+  const Vtx1& vtx1() { return load(BMD_VTX1).vtx1; }
+  const Evp1& evp1() { return load(BMD_EVP1).evp1; }
+  const Drw1& drw1() { return load(BMD_DRW1).drw1; }
+  const Jnt1& jnt1() { return load(BMD_JNT1).jnt1; }
+  const Shp1& shp1() { return load(BMD_SHP1).shp1; }
+  const Mat3& mat3() { return load(BMD_MAT3).mat3; }
+  const Tex1& tex1() { return load(BMD_TEX1).tex1; }
+
+  //parses all sections in the mask that weren't parsed yet
+  const BModel& load(u32 sections);
+
+  //the sections parsed so far
+  const BModel& model() const { return m_model; }
+
+private:
+  const u8* m_data;
+  size_t m_size;
+  bool m_valid;
+  BmdSectionTable m_table;
+  BModel m_model;
 };
 
+//convenience versions: read the whole file into memory
+//and call the functions above
 BModel* loadBmd(FILE* f);
 void writeBmdInfo(FILE* f, std::ostream& out);
 
@@ -1,64 +1,65 @@
 #include "common.h"
 
 #include <iostream>
+#include <cstring>
 
-std::string getString(int pos, FILE* f)
+std::string getString(int pos, MemFile* f)
 {
-  int t = ftell(f);
-  fseek(f, pos, SEEK_SET);
+  //scan the buffer directly instead of reading char by char,
+  //strings running off the end of the file are cut there
+  if(pos < 0 || !f->has(pos, 0))
+    return std::string();
 
-  std::string ret;
-  char c;
-  while((c = fgetc(f)) != '\0')
-    ret.append(1, c);
+  const char* start = (const char*)f->data() + pos;
+  size_t maxLength = f->size() - pos;
+  const void* end = memchr(start, '\0', maxLength);
+  size_t length = end != NULL ? (const char*)end - start : maxLength;
 
-  fseek(f, t, SEEK_SET);
-
-  return ret;
+  return std::string(start, length);
 }
 
-void readStringtable(int pos, FILE* f, std::vector<std::string>& dest)
+void readStringtable(int pos, MemFile* f, std::vector<std::string>& dest)
 {
-  long oldPos = ftell(f);
+  long oldPos = f->tell();
 
-  fseek(f, pos, SEEK_SET);
+  f->seek(pos);
 
-  u16 count; fread(&count, 2, 1, f); toWORD(count);
-  fseek(f, 2, SEEK_CUR); //skip pad bytes
+  u16 count; f->read(&count, 2); toWORD(count);
+  f->skip(2); //skip pad bytes
 
   for(int i = 0; i < count; ++i)
   {
     u16 unknown, stringOffset;
-    fread(&unknown, 2, 1, f); toWORD(unknown);
-    fread(&stringOffset, 2, 1, f); toWORD(stringOffset);
+    f->read(&unknown, 2); toWORD(unknown);
+    f->read(&stringOffset, 2); toWORD(stringOffset);
     std::string s = getString(pos + stringOffset, f);
     dest.push_back(s);
   }
 
-  fseek(f, oldPos, SEEK_SET);
+  f->seek(oldPos);
 }
 
-void writeStringtable(std::ostream& out, FILE* f, int offset)
+void writeStringtable(std::ostream& out, MemFile* f, int offset)
 {
-  int p = ftell(f);
+  int p = f->tell();
 
-  fseek(f, offset, SEEK_SET);
+  f->seek(offset);
 
-  u16 count; fread(&count, 2, 1, f); toWORD(count);
-  fseek(f, 2, SEEK_CUR); //skip pad bytes
+  u16 count; f->read(&count, 2); toWORD(count);
+  f->skip(2); //skip pad bytes
 
   out << "String table (" << count << " entries)" << std::endl;
   for(int i = 0; i < count; ++i)
   {
     u16 unknown, stringOffset;
-    fread(&unknown, 2, 1, f); toWORD(unknown);
-    fread(&stringOffset, 2, 1, f); toWORD(stringOffset);
+    f->read(&unknown, 2); toWORD(unknown);
+    f->read(&stringOffset, 2); toWORD(stringOffset);
     std::string s = getString(offset + stringOffset,
                               f);
     out << "  0x" << std::hex << unknown << " - " << s << std::endl;
   }
 
-  fseek(f, p, SEEK_SET);
+  f->seek(p);
 }
 
 void splitPath(const std::string& filename, std::string& folder,
@@ -101,6 +102,18 @@ void splitName(const std::string& basename, std::string& name,
   }
 }
 
+void readWholeFile(FILE* f, std::vector<u8>& dst)
+{
+  long start = ftell(f);
+  fseek(f, 0, SEEK_END);
+  long end = ftell(f);
+  fseek(f, start, SEEK_SET);
+
+  dst.resize(end > start ? end - start : 0);
+  if(!dst.empty())
+    dst.resize(fread(&dst[0], 1, dst.size(), f));
+}
+
 bool doesFileExist(const std::string& fileName)
 {
   FILE* f = fopen(fileName.c_str(), "rb");
@@ -2,8 +2,9 @@
 #define BMD_COMMON_H BMD_COMMON_H
 
 #include "gccommon.h"
+#include "memfile.h"
 #include "Types.h"
-#include "json\json.h"
+#include "json/json.h"
 #include <string>
 #include <vector>
 #include <cstdio>
@@ -14,12 +15,12 @@ typedef unsigned int uint;
 
 void log(const char* msg, ...);
 void warn(const char* msg, ...);
-std::string getString(int pos, FILE* f);
-void readStringtable(int pos, FILE* f, std::vector<std::string>& dest);
+std::string getString(int pos, MemFile* f);
+void readStringtable(int pos, MemFile* f, std::vector<std::string>& dest);
 
 //does more or less the same as readStringtable(), but writes
 //the read data to an ostream instead of writing it into a vector
-void writeStringtable(std::ostream& out, FILE* f, int offset);
+void writeStringtable(std::ostream& out, MemFile* f, int offset);
 
 void setTextColor3f(float r, float g, float b);
 void drawText(const char* s, ...);
@@ -28,9 +28,9 @@ struct Drw1Header
 
 };
 
-void readDrw1Header(FILE* f, bmd::Drw1Header& h)
+void readDrw1Header(MemFile* f, bmd::Drw1Header& h)
 {
-  fread(h.tag, 1, 4, f);
+  f->read(h.tag, 4);
   readDWORD(f, h.sizeOfSection);
   readWORD(f, h.count);
   readWORD(f, h.pad);
@@ -38,9 +38,9 @@ void readDrw1Header(FILE* f, bmd::Drw1Header& h)
   readDWORD(f, h.offsetToData);  
 }
 
-void dumpDrw1(FILE* f, Drw1& dst)
+void dumpDrw1(MemFile* f, Drw1& dst)
 {
-  int drw1Offset = ftell(f), i;
+  int drw1Offset = f->tell(), i;
 
   //read header
   bmd::Drw1Header h;
@@ -48,10 +48,10 @@ void dumpDrw1(FILE* f, Drw1& dst)
 
   //read bool array
   dst.isWeighted.resize(h.count);
-  fseek(f, drw1Offset + h.offsetToIsWeighted, SEEK_SET);
+  f->seek(drw1Offset + h.offsetToIsWeighted);
   for(i = 0; i < h.count; ++i)
   {
-    u8 v; fread(&v, 1, 1, f);
+    u8 v; f->read(&v, 1);
     if(v == 0)
       dst.isWeighted[i] = false;
     else if(v == 1)
@@ -62,18 +62,18 @@ void dumpDrw1(FILE* f, Drw1& dst)
 
   //read data array
   dst.data.resize(h.count);
-  fseek(f, drw1Offset + h.offsetToData, SEEK_SET);
+  f->seek(drw1Offset + h.offsetToData);
   for(i = 0; i < h.count; ++i)
     readWORD(f, dst.data[i]);
 }
 
-void writeDrw1Info(FILE* f, ostream& out)
+void writeDrw1Info(MemFile* f, ostream& out)
 {
   out << string(50, '/') << endl
       << "//Drw1 section" << endl
       << string(50, '/') << endl << endl;
 
-  int drw1Offset = ftell(f), i;
+  int drw1Offset = f->tell(), i;
 
   bmd::Drw1Header h;
   readDrw1Header(f, h);
@@ -81,16 +81,16 @@ void writeDrw1Info(FILE* f, ostream& out)
   out << h.count << " many" << endl << endl;
   
   out << "isWeighted:" << endl;
-  fseek(f, drw1Offset + h.offsetToIsWeighted, SEEK_SET);
+  f->seek(drw1Offset + h.offsetToIsWeighted);
   for(i = 0; i < h.count; ++i)
   {
-    u8 v; fread(&v, 1, 1, f);
+    u8 v; f->read(&v, 1);
     out << " " << (int)v;
   }
   out << endl;
   
   out << "Data:" << endl;
-  fseek(f, drw1Offset + h.offsetToData, SEEK_SET);
+  f->seek(drw1Offset + h.offsetToData);
   for(i = 0; i < h.count; ++i)
   {
     u16 v; readWORD(f, v);
@@ -11,8 +11,8 @@ struct Drw1
   std::vector<u16> data;
 };
 
-void dumpDrw1(FILE* f, Drw1& dst);
-void writeDrw1Info(FILE* f, std::ostream& out);
+void dumpDrw1(MemFile* f, Drw1& dst);
+void writeDrw1Info(MemFile* f, std::ostream& out);
 Json::Value serializeDrw1(Drw1& drw1);
 
 #endif //BMD_DRW1_H
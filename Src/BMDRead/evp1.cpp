@@ -22,9 +22,9 @@ struct Evp1Header
 
 };
 
-void readEvp1Header(FILE* f, bmd::Evp1Header& h)
+void readEvp1Header(MemFile* f, bmd::Evp1Header& h)
 {
-  fread(h.tag, 1, 4, f);
+  f->read(h.tag, 4);
   readDWORD(f, h.sizeOfSection);
   readWORD(f, h.count);
   readWORD(f, h.pad);
@@ -32,66 +32,66 @@ void readEvp1Header(FILE* f, bmd::Evp1Header& h)
     readDWORD(f, h.offsets[i]);
 }
 
-void readArray8(FILE* f, vector<int>& arr)
+void readArray8(MemFile* f, vector<int>& arr)
 {
   for(size_t i = 0; i < arr.size(); ++i)
   {
-    u8 v; fread(&v, 1, 1, f);
+    u8 v; f->read(&v, 1);
     arr[i] = v;
   }
 }
 
-void readMatrix(FILE* f, f32 m[3][4])
+void readMatrix(MemFile* f, f32 m[3][4])
 {
-  fread(&m[0][0], 4, 3*4, f);
+  f->read(&m[0][0], 4*3*4);
   for(int j = 0; j < 3; ++j)
     for(int k = 0; k < 4; ++k)
       toFLOAT(m[j][k]);  
 }
 
-void dumpEvp1(FILE* f, Evp1& dst)
+void dumpEvp1(MemFile* f, Evp1& dst)
 {
-  int evp1Offset = ftell(f), i;
+  int evp1Offset = f->tell(), i;
 
   //read header
   bmd::Evp1Header h;
   readEvp1Header(f, h);
 
   //read counts array
-  fseek(f, evp1Offset + h.offsets[0], SEEK_SET);
+  f->seek(evp1Offset + h.offsets[0]);
   vector<int> counts(h.count);
   readArray8(f, counts);
 
   //read indices of weighted matrices
   dst.weightedIndices.resize(h.count);
-  fseek(f, evp1Offset + h.offsets[1], SEEK_SET);
+  f->seek(evp1Offset + h.offsets[1]);
   int numMatrices = 0;
   for(i = 0; i < h.count; ++i)
   {
     dst.weightedIndices[i].indices.resize(counts[i]);
     for(int j = 0; j < counts[i]; ++j)
     {
-      u16 d; fread(&d, 2, 1, f); toWORD(d);
+      u16 d; f->read(&d, 2); toWORD(d);
       dst.weightedIndices[i].indices[j] = d;
       numMatrices = max(numMatrices, d + 1);
      }
   }
 
   //read weights of weighted matrices
-  fseek(f, evp1Offset + h.offsets[2], SEEK_SET);
+  f->seek(evp1Offset + h.offsets[2]);
   for(i = 0; i < h.count; ++i)
   {
     dst.weightedIndices[i].weights.resize(counts[i]);
     for(int j = 0; j < counts[i]; ++j)
     {
-      float fl; fread(&fl, 4, 1, f); toFLOAT(fl);
+      float fl; f->read(&fl, 4); toFLOAT(fl);
       dst.weightedIndices[i].weights[j] = fl;
     }
   }
 
   //read matrices
   dst.matrices.resize(numMatrices);
-  fseek(f, evp1Offset + h.offsets[3], SEEK_SET);
+  f->seek(evp1Offset + h.offsets[3]);
   for(i = 0; i < numMatrices; ++i)
   {
     f32 m[3][4];
@@ -105,7 +105,7 @@ void dumpEvp1(FILE* f, Evp1& dst)
   }
 }
 
-void writeEvp1Info(FILE* f, ostream& out)
+void writeEvp1Info(MemFile* f, ostream& out)
 {
   out << string(50, '/') << endl
       << "//Evp1 section (incomplete)" << endl
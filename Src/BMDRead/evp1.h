@@ -19,8 +19,8 @@ struct Evp1
   std::vector<Matrix44f> matrices;
 };
 
-void dumpEvp1(FILE* f, Evp1& dst);
-void writeEvp1Info(FILE* f, std::ostream& out);
+void dumpEvp1(MemFile* f, Evp1& dst);
+void writeEvp1Info(MemFile* f, std::ostream& out);
 Json::Value serializeEvp1(Evp1& evp1);
 
 #endif //BMD_EVP1_H
@@ -35,9 +35,9 @@ struct Inf1Entry
 
 };
 
-void readInf1Header(FILE* f, bmd::Inf1Header& h)
+void readInf1Header(MemFile* f, bmd::Inf1Header& h)
 {
-  fread(h.tag, 1, 4, f);
+  f->read(h.tag, 4);
   readDWORD(f, h.sizeOfSection);
   readWORD(f, h.unknown1);
   readWORD(f, h.pad);
@@ -46,15 +46,15 @@ void readInf1Header(FILE* f, bmd::Inf1Header& h)
   readDWORD(f, h.offsetToEntries);
 }
 
-void readInf1Entry(FILE* f, bmd::Inf1Entry& e)
+void readInf1Entry(MemFile* f, bmd::Inf1Entry& e)
 {
   readWORD(f, e.type);
   readWORD(f, e.index);
 }
 
-void dumpInf1(FILE* f, Inf1& dst)
+void dumpInf1(MemFile* f, Inf1& dst)
 {
-  long inf1Offset = ftell(f);
+  long inf1Offset = f->tell();
 
   //read header
   bmd::Inf1Header h;
@@ -63,7 +63,7 @@ void dumpInf1(FILE* f, Inf1& dst)
   dst.numVertices = h.vertexCount;
 
   //read scene graph
-  fseek(f, inf1Offset + h.offsetToEntries, SEEK_SET);
+  f->seek(inf1Offset + h.offsetToEntries);
 
   bmd::Inf1Entry e;
   readInf1Entry(f, e);
@@ -114,13 +114,13 @@ int buildSceneGraph(const Inf1& inf1, SceneGraph& sg, int j)
   return 0;
 }
 
-void writeInf1Info(FILE* f, ostream& out)
+void writeInf1Info(MemFile* f, ostream& out)
 {
   out << string(50, '/') << endl
       << "//Inf1 section (TODO: dump decoded scenegraph?)" << endl
       << string(50, '/') << endl << endl;
 
-  long inf1Offset = ftell(f);
+  long inf1Offset = f->tell();
 
   bmd::Inf1Header h;
   readInf1Header(f, h);
@@ -130,7 +130,7 @@ void writeInf1Info(FILE* f, ostream& out)
       << "Scenegraph:" << endl;
       
       
-  fseek(f, inf1Offset + h.offsetToEntries, SEEK_SET);
+  f->seek(inf1Offset + h.offsetToEntries);
 
   bmd::Inf1Entry e;
   readInf1Entry(f, e);
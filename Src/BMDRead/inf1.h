@@ -17,7 +17,7 @@ struct Inf1
   std::vector<Node> scenegraph;
 };
 
-void dumpInf1(FILE* f, Inf1& dst);
+void dumpInf1(MemFile* f, Inf1& dst);
 
 
 //the following is only convenience stuff
@@ -29,7 +29,7 @@ struct SceneGraph
 };
 
 int buildSceneGraph(/*in*/ const Inf1& inf1, /*out*/ SceneGraph& sg, int j = 0 /* used internally */);
-void writeInf1Info(FILE* f, std::ostream& out);
+void writeInf1Info(MemFile* f, std::ostream& out);
 Json::Value serializeInf1(Inf1& inf1);
 
 #endif //BMD_INF1_H
@@ -48,9 +48,9 @@ struct JntEntry
 
 };
 
-void readJnt1Header(FILE* f, bmd::Jnt1Header& h)
+void readJnt1Header(MemFile* f, bmd::Jnt1Header& h)
 {
-  fread(h.tag, 1, 4, f);
+  f->read(h.tag, 4);
   readDWORD(f, h.sizeOfSection);
   readWORD(f, h.count);
   readWORD(f, h.pad);
@@ -59,11 +59,11 @@ void readJnt1Header(FILE* f, bmd::Jnt1Header& h)
   readDWORD(f, h.stringTableOffset);
 }
 
-void readJnt1Entry(FILE* f, bmd::JntEntry& e)
+void readJnt1Entry(MemFile* f, bmd::JntEntry& e)
 {
   readWORD(f, e.unknown);
-  fread(&e.unknown3, 1, 1, f);
-  fread(&e.pad, 1, 1, f);
+  f->read(&e.unknown3, 1);
+  f->read(&e.pad, 1);
   
   readFLOAT(f, e.sx); readFLOAT(f, e.sy); readFLOAT(f, e.sz);
   readSHORT(f, e.rx); readSHORT(f, e.ry); readSHORT(f, e.rz);
@@ -78,9 +78,9 @@ void readJnt1Entry(FILE* f, bmd::JntEntry& e)
     readFLOAT(f, e.bbMax[j]);
 }
 
-void dumpJnt1(FILE* f, Jnt1& dst)
+void dumpJnt1(MemFile* f, Jnt1& dst)
 {
-  int jnt1Offset = ftell(f);
+  int jnt1Offset = f->tell();
 
   //read header
   bmd::Jnt1Header h;
@@ -94,7 +94,7 @@ void dumpJnt1(FILE* f, Jnt1& dst)
     warn("jnt1: number of strings doesn't match number of joints");
 
   //read joints
-  fseek(f, jnt1Offset + h.jntEntryOffset, SEEK_SET);
+  f->seek(jnt1Offset + h.jntEntryOffset);
 
   dst.frames.resize(h.count);
   dst.matrices.resize(h.count);
@@ -123,13 +123,13 @@ void dumpJnt1(FILE* f, Jnt1& dst)
   }
 }
 
-void writeJnt1Info(FILE* f, ostream& out)
+void writeJnt1Info(MemFile* f, ostream& out)
 {
   out << string(50, '/') << endl
       << "//Jnt1 section" << endl
       << string(50, '/') << endl << endl;
 
-  int jnt1Offset = ftell(f), i;
+  int jnt1Offset = f->tell(), i;
 
   //read jnt1 header
   bmd::Jnt1Header h;
@@ -146,7 +146,7 @@ void writeJnt1Info(FILE* f, ostream& out)
 
   //joint entries
   out << endl << "Joint entries" << endl;
-  fseek(f, jnt1Offset + h.jntEntryOffset, SEEK_SET);
+  f->seek(jnt1Offset + h.jntEntryOffset);
   for(i = 0; i < h.count; ++i)
   {
     bmd::JntEntry e;
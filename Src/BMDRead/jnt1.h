@@ -40,8 +40,8 @@ struct Jnt1
   //TODO: unknown array
 };
 
-void dumpJnt1(FILE* f, Jnt1& dst);
-void writeJnt1Info(FILE* f, std::ostream& out);
+void dumpJnt1(MemFile* f, Jnt1& dst);
+void writeJnt1Info(MemFile* f, std::ostream& out);
 Json::Value serializeJnt1(Jnt1& jnt1);
 
 #endif //BMD_JNT1_H
@@ -338,10 +338,10 @@ bmd::MatIndirectTexturingEntry g_defaultIndirectEntry =
   }
 };
 
-void displayData(ostream& out, const string& str, FILE* f, int offset, int size, int space = -1)
+void displayData(ostream& out, const string& str, MemFile* f, int offset, int size, int space = -1)
 {
-  long old = ftell(f);
-  fseek(f, offset, SEEK_SET);
+  long old = f->tell();
+  f->seek(offset);
 
   out << str << ":";
 
@@ -353,7 +353,7 @@ void displayData(ostream& out, const string& str, FILE* f, int offset, int size,
       else
         out << ' ';
 
-    u8 v; fread(&v, 1, 1, f);
+    u8 v; f->read(&v, 1);
     out << hex << setw(2) << setfill('0') << (int)v;
   }
 
@@ -362,12 +362,12 @@ void displayData(ostream& out, const string& str, FILE* f, int offset, int size,
 
   //log("%s", textStream.str().c_str());
 
-  fseek(f, old, SEEK_SET);
+  f->seek(old);
 }
 
-void readTevStageInfo(FILE* f, bmd::TevStageInfo& info);
+void readTevStageInfo(MemFile* f, bmd::TevStageInfo& info);
 
-void displayTevStage(ostream& out, FILE* f, int offset, int size)
+void displayTevStage(ostream& out, MemFile* f, int offset, int size)
 {
   if(size%20 != 0)
   {
@@ -375,8 +375,8 @@ void displayTevStage(ostream& out, FILE* f, int offset, int size)
     return;
   }
 
-  long old = ftell(f);
-  fseek(f, offset, SEEK_SET);
+  long old = f->tell();
+  f->seek(offset);
 
   out << "TevStageInfo (op, bias, scale, doClamp, tevRegId):";
 
@@ -415,7 +415,7 @@ void displayTevStage(ostream& out, FILE* f, int offset, int size)
   //log("%s", textStream.str().c_str(), count);
 
 
-  fseek(f, old, SEEK_SET);
+  f->seek(old);
 }
 
 void displaySize(ostream& out, const string& str, int len, int space = -1)
@@ -427,7 +427,7 @@ void displaySize(ostream& out, const string& str, int len, int space = -1)
   out << str << ": " << len << " bytes (" << count << " many)" << endl;
 }
 
-void writeMat3Data(ostream& debugOut, FILE* f, int mat3Offset,
+void writeMat3Data(ostream& debugOut, MemFile* f, int mat3Offset,
                    bmd::Mat3Header& h, const vector<size_t>& lengths)
 {
   //displayData(debugOut, "matEntries", f, mat3Offset + h.offsets[0], sizeof(bmd::MatEntry));
@@ -529,9 +529,9 @@ void writeMatEntry(ostream& debugOut, const bmd::MatEntry& init)
   debugOut << endl;
 }
 
-void readMat3Header(FILE* f, bmd::Mat3Header& h)
+void readMat3Header(MemFile* f, bmd::Mat3Header& h)
 {
-  fread(h.tag, 1, 4, f);
+  f->read(h.tag, 4);
   readDWORD(f, h.sizeOfSection);
   readWORD(f, h.count);
   readWORD(f, h.pad);
@@ -556,7 +556,7 @@ void readMat3Header(FILE* f, bmd::Mat3Header& h)
   }
 }
 
-void readMatIndirectTexturingEntry(FILE* f, bmd::MatIndirectTexturingEntry& indEntry)
+void readMatIndirectTexturingEntry(MemFile* f, bmd::MatIndirectTexturingEntry& indEntry)
 {
   int k, m;
   for(k = 0; k < 10; ++k)
@@ -565,7 +565,7 @@ void readMatIndirectTexturingEntry(FILE* f, bmd::MatIndirectTexturingEntry& indE
   {
     for(m = 0; m < 6; ++m)
       readFLOAT(f, indEntry.unk2[k].f[m]);
-    fread(indEntry.unk2[k].b, 1, 4, f);
+    f->read(indEntry.unk2[k].b, 4);
   }
 
   for(k = 0; k < 4; ++k)
@@ -575,10 +575,10 @@ void readMatIndirectTexturingEntry(FILE* f, bmd::MatIndirectTexturingEntry& indE
       readWORD(f, indEntry.unk4[k].unk[m]);
 }
 
-void readMatEntry(FILE* f, bmd::MatEntry& init, bool isMat2)
+void readMatEntry(MemFile* f, bmd::MatEntry& init, bool isMat2)
 {
   int j;
-  fread(init.unk, 1, 8, f);
+  f->read(init.unk, 8);
   for(j = 0; j < 2; ++j) readWORD(f, init.ambColor[j]);
   for(j = 0; j < 4; ++j) readWORD(f, init.chanControls[j]);
   
@@ -594,8 +594,8 @@ void readMatEntry(FILE* f, bmd::MatEntry& init, bool isMat2)
   for(j = 0; j < 20; ++j) readWORD(f, init.dttMatrices[j]);
   for(j = 0; j < 8; ++j) readWORD(f, init.texStages[j]);
   for(j = 0; j < 4; ++j) readWORD(f, init.konstColor[j]);
-  fread(init.constColorSel, 1, 16, f);
-  fread(init.constAlphaSel, 1, 16, f);
+  f->read(init.constColorSel, 16);
+  f->read(init.constAlphaSel, 16);
   for(j = 0; j < 16; ++j) readWORD(f, init.tevOrderInfo[j]);
   for(j = 0; j < 4; ++j) readWORD(f, init.registerColor[j]);
   for(j = 0; j < 16; ++j) readWORD(f, init.tevStageInfo[j]);
@@ -606,11 +606,11 @@ void readMatEntry(FILE* f, bmd::MatEntry& init, bool isMat2)
   for(j = 0; j < 4; ++j) readWORD(f, init.indices2[j]);
 }
 
-void readTexMtxInfo(FILE* f, bmd::TexMtxInfo& info)
+void readTexMtxInfo(MemFile* f, bmd::TexMtxInfo& info)
 {
   int j;
-  fread(&info.projection, 1, 1, f);
-  fread(&info.type, 1, 1, f);
+  f->read(&info.projection, 1);
+  f->read(&info.type, 1);
   readWORD(f, info.padding0);
 
   readFLOAT(f, info.center_s);
@@ -629,25 +629,25 @@ void readTexMtxInfo(FILE* f, bmd::TexMtxInfo& info)
     readFLOAT(f, info.prematrix[j/4][j%4]);
 }
 
-void readTevStageInfo(FILE* f, bmd::TevStageInfo& info)
+void readTevStageInfo(MemFile* f, bmd::TevStageInfo& info)
 {
-  fread(&info.unk, 1, 1, f);
+  f->read(&info.unk, 1);
   
-  fread(&info.colorIn, 1, 4, f);
-  fread(&info.colorOp, 1, 1, f);
-  fread(&info.colorBias, 1, 1, f);
-  fread(&info.colorScale, 1, 1, f);
-  fread(&info.colorClamp, 1, 1, f);
-  fread(&info.colorRegId, 1, 1, f);
+  f->read(&info.colorIn, 4);
+  f->read(&info.colorOp, 1);
+  f->read(&info.colorBias, 1);
+  f->read(&info.colorScale, 1);
+  f->read(&info.colorClamp, 1);
+  f->read(&info.colorRegId, 1);
   
-  fread(&info.alphaIn, 1, 4, f);
-  fread(&info.alphaOp, 1, 1, f);
-  fread(&info.alphaBias, 1, 1, f);
-  fread(&info.alphaScale, 1, 1, f);
-  fread(&info.alphaClamp, 1, 1, f);
-  fread(&info.alphaRegId, 1, 1, f);
+  f->read(&info.alphaIn, 4);
+  f->read(&info.alphaOp, 1);
+  f->read(&info.alphaBias, 1);
+  f->read(&info.alphaScale, 1);
+  f->read(&info.alphaClamp, 1);
+  f->read(&info.alphaRegId, 1);
   
-  fread(&info.unk2, 1, 1, f);
+  f->read(&info.unk2, 1);
 }
 
 void computeSectionLengths(const bmd::Mat3Header& h, vector<size_t>& lengths)
@@ -678,13 +678,13 @@ void computeSectionLengths(const bmd::Mat3Header& h, vector<size_t>& lengths)
   }
 }
 
-void dumpMat3(FILE* f, Mat3& dst)
+void dumpMat3(MemFile* f, Mat3& dst)
 {
   //warn("Mat3 section support is incomplete");
 
   assert(sizeof(bmd::MatEntry) == 332);
 
-  int mat3Offset = ftell(f);
+  int mat3Offset = f->tell();
   size_t i;
 
   //read header
@@ -710,7 +710,7 @@ void dumpMat3(FILE* f, Mat3& dst)
   computeSectionLengths(h, lengths);
 
   //offset[1] (indirection table from indices to init data indices)
-  fseek(f, mat3Offset + h.offsets[1], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[1]);
   u16 maxIndex = 0;
   dst.indexToMatIndex.resize(h.count);
   for(i = 0; i < h.count; ++i)
@@ -721,7 +721,7 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 
   //offset[4] (cull mode)
-  fseek(f, mat3Offset + h.offsets[4], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[4]);
   dst.cullModes.resize(lengths[4]/4);
   for(i = 0; i < dst.cullModes.size(); ++i)
   {
@@ -730,11 +730,11 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 
   //offset[5] (ambColor)
-  fseek(f, mat3Offset + h.offsets[5], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[5]);
   dst.ambColor.resize(lengths[5]/4);
   for(i = 0; i < dst.ambColor.size(); ++i)
   {
-    u8 col[4]; fread(col, 1, 4, f);
+    u8 col[4]; f->read(col, 4);
     dst.ambColor[i].r = col[0];
     dst.ambColor[i].g = col[1];
     dst.ambColor[i].b = col[2];
@@ -742,24 +742,24 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 
   //offset[6] (numChans)
-  fseek(f, mat3Offset + h.offsets[6], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[6]);
   dst.numChans.resize(lengths[6]);
-  fread(&dst.numChans[0], 1, lengths[6], f);
+  f->read(&dst.numChans[0], lengths[6]);
 
   //offset[7] (colorChanInfo)
-  fseek(f, mat3Offset + h.offsets[7], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[7]);
   dst.colorChanInfos.resize(lengths[7]/8);
   for(i = 0; i < dst.colorChanInfos.size(); ++i)
   {
     bmd::ColorChanInfo info;
-    fread(&info.enable, 1, 1, f);
-    fread(&info.matColorSource, 1, 1, f);
-    fread(&info.litMask, 1, 1, f);
-    fread(&info.diffuseAttenuationFunc, 1, 1, f);
-    fread(&info.attenuationFracFunc, 1, 1, f);
-    fread(&info.ambColorSource, 1, 1, f);
-    fread(&info.pad[0], 1, 1, f);
-    fread(&info.pad[1], 1, 1, f);
+    f->read(&info.enable, 1);
+    f->read(&info.matColorSource, 1);
+    f->read(&info.litMask, 1);
+    f->read(&info.diffuseAttenuationFunc, 1);
+    f->read(&info.attenuationFracFunc, 1);
+    f->read(&info.ambColorSource, 1);
+    f->read(&info.pad[0], 1);
+    f->read(&info.pad[1], 1);
 	
     ColorChanInfo& dstInfo = dst.colorChanInfos[i];
 
@@ -773,11 +773,11 @@ void dumpMat3(FILE* f, Mat3& dst)
 
 
   //offset[8] (matColor)
-  fseek(f, mat3Offset + h.offsets[8], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[8]);
   dst.matColor.resize(lengths[8]/4);
   for(i = 0; i < dst.matColor.size(); ++i)
   {
-    u8 col[4]; fread(col, 1, 4, f);
+    u8 col[4]; f->read(col, 4);
     dst.matColor[i].r = col[0];
     dst.matColor[i].g = col[1];
     dst.matColor[i].b = col[2];
@@ -785,7 +785,7 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 
   //offset[0] (MatEntries)
-  fseek(f, mat3Offset + h.offsets[0], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[0]);
   dst.materials.resize(maxIndex + 1);
   for(i = 0; i <= maxIndex; ++i)
   {
@@ -839,7 +839,7 @@ void dumpMat3(FILE* f, Mat3& dst)
 
   //offset[3] indirect texturing blocks (always as many as count)
   assert(sizeof(bmd::MatIndirectTexturingEntry) == 312);
-  fseek(f, mat3Offset + h.offsets[3], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[3]);
   if(lengths[3]%312 != 0)
     warn("mat3: indirect texturing block size no multiple of 312: %d", lengths[3]);
   else if(lengths[3]/312 != h.count)
@@ -858,20 +858,20 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 
   //offsets[10] (read texGenCounts)
-  fseek(f, mat3Offset + h.offsets[10], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[10]);
   dst.texGenCounts.resize(lengths[10]);
-  fread(&dst.texGenCounts[0], 1, dst.texGenCounts.size(), f);
+  f->read(&dst.texGenCounts[0], dst.texGenCounts.size());
 
   //offsets[11] (texGens)
-  fseek(f, mat3Offset + h.offsets[11], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[11]);
   dst.texGenInfos.resize(lengths[11]/4);
   for(i = 0; i < dst.texGenInfos.size(); ++i)
   {
     bmd::TexGenInfo info;
-    fread(&info.texGenType, 1, 1, f);
-    fread(&info.texGenSrc, 1, 1, f);
-    fread(&info.matrix, 1, 1, f);
-    fread(&info.pad, 1, 1, f);
+    f->read(&info.texGenType, 1);
+    f->read(&info.texGenSrc, 1);
+    f->read(&info.matrix, 1);
+    f->read(&info.pad, 1);
 
     dst.texGenInfos[i].texGenType = info.texGenType;
     dst.texGenInfos[i].texGenSrc = info.texGenSrc;
@@ -879,7 +879,7 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 
   //offsets[13] (read texMtxInfo)
-  fseek(f, mat3Offset + h.offsets[13], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[13]);
   dst.texMtxInfos.resize(lengths[13]/100);
   for(i = 0; i < dst.texMtxInfos.size(); ++i)
   {
@@ -894,25 +894,25 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 
   //offsets[15] (read texTable)
-  fseek(f, mat3Offset + h.offsets[15], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[15]);
   size_t texLength = lengths[15];
   dst.texStageIndexToTextureIndex.resize(texLength/2);
   for(i = 0; i < texLength/2; ++i)
   {
-    u16 index; fread(&index, 2, 1, f); toWORD(index);
+    u16 index; f->read(&index, 2); toWORD(index);
     dst.texStageIndexToTextureIndex[i] = index;
   }
 
   //offsets[16] (read TevOrderInfos)
-  fseek(f, mat3Offset + h.offsets[16], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[16]);
   dst.tevOrderInfos.resize(lengths[16]/4);
   for(i = 0; i < dst.tevOrderInfos.size(); ++i)
   {
     bmd::TevOrderInfo info;
-    fread(&info.texCoordId, 1, 1, f);
-    fread(&info.texMap, 1, 1, f);
-    fread(&info.chanId, 1, 1, f);
-    fread(&info.pad, 1, 1, f);
+    f->read(&info.texCoordId, 1);
+    f->read(&info.texMap, 1);
+    f->read(&info.chanId, 1);
+    f->read(&info.pad, 1);
 
     dst.tevOrderInfos[i].texCoordId = info.texCoordId;
     dst.tevOrderInfos[i].texMap = info.texMap;
@@ -920,11 +920,11 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 
   //offsets[17] (read registerColor)
-  fseek(f, mat3Offset + h.offsets[17], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[17]);
   dst.registerColor.resize(lengths[17]/(4*2));
   for(i = 0; i < dst.registerColor.size(); ++i)
   {
-    s16 col[4]; fread(col, 2, 4, f);
+    s16 col[4]; f->read(col, 2*4);
     dst.registerColor[i].r = aSHORT(col[0]);
     dst.registerColor[i].g = aSHORT(col[1]);
     dst.registerColor[i].b = aSHORT(col[2]);
@@ -932,11 +932,11 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 
   //offsets[18] (konstColor)
-  fseek(f, mat3Offset + h.offsets[18], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[18]);
   dst.konstColor.resize(lengths[18]/4);
   for(i = 0; i < dst.konstColor.size(); ++i)
   {
-    u8 col[4]; fread(col, 1, 4, f);
+    u8 col[4]; f->read(col, 4);
     dst.konstColor[i].r = col[0];
     dst.konstColor[i].g = col[1];
     dst.konstColor[i].b = col[2];
@@ -944,12 +944,12 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 
   //offset[19] (tevCounts)
-  fseek(f, mat3Offset + h.offsets[19], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[19]);
   dst.tevCounts.resize(lengths[19]);
-  fread(&dst.tevCounts[0], 1, dst.tevCounts.size(), f);
+  f->read(&dst.tevCounts[0], dst.tevCounts.size());
 
   //offset[20] (TevStageInfos)
-  fseek(f, mat3Offset + h.offsets[20], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[20]);
   dst.tevStageInfos.resize(lengths[20]/20);
   for(i = 0; i < dst.tevStageInfos.size(); ++i)
   {
@@ -960,76 +960,76 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 
   //offset[21] (TevSwapModeInfos)
-  fseek(f, mat3Offset + h.offsets[21], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[21]);
   dst.tevSwapModeInfos.resize(lengths[21]/4);
   for(i = 0; i < dst.tevSwapModeInfos.size(); ++i)
   {
     bmd::TevSwapModeInfo info;
-    fread(&info.rasSel, 1, 1, f);
-    fread(&info.texSel, 1, 1, f);
-    fread(info.pad, 1, 2, f);
+    f->read(&info.rasSel, 1);
+    f->read(&info.texSel, 1);
+    f->read(info.pad, 2);
 
     dst.tevSwapModeInfos[i].rasSel = info.rasSel;
     dst.tevSwapModeInfos[i].texSel = info.texSel;
   }
 
   //offset[22] (TevSwapModeTable)
-  fseek(f, mat3Offset + h.offsets[22], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[22]);
   dst.tevSwapModeTables.resize(lengths[22]/4);
   for(i = 0; i < dst.tevSwapModeTables.size(); ++i)
   {
     bmd::TevSwapModeTable table;
-    fread(&table.r, 1, 1, f);
-    fread(&table.g, 1, 1, f);
-    fread(&table.b, 1, 1, f);
-    fread(&table.a, 1, 1, f);
+    f->read(&table.r, 1);
+    f->read(&table.g, 1);
+    f->read(&table.b, 1);
+    f->read(&table.a, 1);
 
     TevSwapModeTable dstTable = { table.r, table.g, table.b, table.a };
     dst.tevSwapModeTables[i] = dstTable;
   }
 
   //offset[24] (alphaCompares)
-  fseek(f, mat3Offset + h.offsets[24], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[24]);
   dst.alphaCompares.resize(lengths[24]/8);
   for(i = 0; i < dst.alphaCompares.size(); ++i)
   {
     bmd::AlphaCompare info;
-    fread(&info.comp0, 1, 1, f);
-    fread(&info.ref0, 1, 1, f);
-    fread(&info.alphaOp, 1, 1, f);
-    fread(&info.comp1, 1, 1, f);
-    fread(&info.ref1, 1, 1, f);
-    fread(info.pad, 1, 3, f);
+    f->read(&info.comp0, 1);
+    f->read(&info.ref0, 1);
+    f->read(&info.alphaOp, 1);
+    f->read(&info.comp1, 1);
+    f->read(&info.ref1, 1);
+    f->read(info.pad, 3);
 
     AlphaCompare dstInfo = { info.comp0, info.ref0, info.alphaOp, info.comp1, info.ref1 };
     dst.alphaCompares[i] = dstInfo;
   }
 
   //offset[25] (blendInfo)
-  fseek(f, mat3Offset + h.offsets[25], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[25]);
   dst.blendInfos.resize(lengths[25]/4);
   for(i = 0; i < dst.blendInfos.size(); ++i)
   {
     bmd::BlendInfo info;
-    fread(&info.blendMode, 1, 1, f);
-    fread(&info.srcFactor, 1, 1, f);
-    fread(&info.dstFactor, 1, 1, f);
-    fread(&info.logicOp, 1, 1, f);
+    f->read(&info.blendMode, 1);
+    f->read(&info.srcFactor, 1);
+    f->read(&info.dstFactor, 1);
+    f->read(&info.logicOp, 1);
 
     BlendInfo dstInfo = { info.blendMode, info.srcFactor, info.dstFactor, info.logicOp };
     dst.blendInfos[i] = dstInfo;
   }
 
   //offset[26] (z mode)
-  fseek(f, mat3Offset + h.offsets[26], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[26]);
   dst.zModes.resize(lengths[26]/4);
   for(i = 0; i < dst.zModes.size(); ++i)
   {
     bmd::ZModeInfo zInfo;
-    fread(&zInfo.enable, 1, 1, f);
-    fread(&zInfo.func, 1, 1, f);
-    fread(&zInfo.updateEnable, 1, 1, f);
-    fread(&zInfo.pad, 1, 1, f);
+    f->read(&zInfo.enable, 1);
+    f->read(&zInfo.func, 1);
+    f->read(&zInfo.updateEnable, 1);
+    f->read(&zInfo.pad, 1);
 
     ZMode m;
     m.enable = zInfo.enable != 0;
@@ -1039,9 +1039,9 @@ void dumpMat3(FILE* f, Mat3& dst)
   }
 }
 
-void writeMat3Info(FILE* f, ostream& out)
+void writeMat3Info(MemFile* f, ostream& out)
 {
-  int mat3Offset = ftell(f);
+  int mat3Offset = f->tell();
   size_t i;
 
   out << string(50, '/') << endl
@@ -1060,12 +1060,12 @@ void writeMat3Info(FILE* f, ostream& out)
   computeSectionLengths(h, lengths);
 
   //offset[1] (indirection table from indices to init data indices)
-  fseek(f, mat3Offset + h.offsets[1], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[1]);
   u16 maxIndex = 0;
   vector<u16> indexToMatIndex(h.count);
   for(i = 0; i < h.count; ++i)
   {
-    u16 bla; fread(&bla, 2, 1, f); toWORD(bla);
+    u16 bla; f->read(&bla, 2); toWORD(bla);
     maxIndex = max(maxIndex, bla);
     indexToMatIndex[i] = bla;
   }
@@ -1080,7 +1080,7 @@ void writeMat3Info(FILE* f, ostream& out)
 
   //offset[0] (MatEntries)
   out << endl << endl << "MatEntries" << endl << endl;
-  fseek(f, mat3Offset + h.offsets[0], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[0]);
   for(i = 0; i <= maxIndex; ++i)
   {
     bmd::MatEntry init;
@@ -1098,7 +1098,7 @@ void writeMat3Info(FILE* f, ostream& out)
 
   //offset[3] indirect texturing blocks (always as many as count)
   out << endl << endl << "Indirect texturing entries" << endl;
-  fseek(f, mat3Offset + h.offsets[3], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[3]);
   if(lengths[3]%312 != 0)
     out << "mat3: indirect texturing block size no multiple of 312: " << lengths[3] << endl << endl;
   else if(lengths[3]/312 != h.count)
@@ -1157,7 +1157,7 @@ void writeMat3Info(FILE* f, ostream& out)
 
   //offset[13] (texmtxinfo)
   out << "TexMtxInfos" << endl << endl;
-  fseek(f, mat3Offset + h.offsets[13], SEEK_SET);
+  f->seek(mat3Offset + h.offsets[13]);
 
   for(size_t m = 0; m < lengths[13]/100; ++m)
   {
@@ -444,7 +444,7 @@ struct Mat3
   }
 };
 
-void dumpMat3(FILE* f, Mat3& dst);
-void writeMat3Info(FILE* f, std::ostream& out);
+void dumpMat3(MemFile* f, Mat3& dst);
+void writeMat3Info(MemFile* f, std::ostream& out);
 
 #endif //BMD_MAT3_H
@@ -5,7 +5,7 @@
 
 using namespace std;
 
-void writeMdl3Info(FILE* f, ostream& out)
+void writeMdl3Info(MemFile* f, ostream& out)
 {
   out << string(50, '/') << endl
       << "//Mdl3 section" << endl
@@ -3,6 +3,8 @@
 
 #include <iosfwd>
 
-void writeMdl3Info(FILE* f, std::ostream& out);
+struct MemFile;
+
+void writeMdl3Info(MemFile* f, std::ostream& out);
 
 #endif //BMD_MDL3_H
@@ -0,0 +1,120 @@
+#ifndef BMD_MEMFILE_H
+#define BMD_MEMFILE_H BMD_MEMFILE_H
+
+#include "gccommon.h"
+
+#include <cstring>
+#include <vector>
+
+//A read-only view of a block of memory (a mapped file or a decompressed
+//yaz0 buffer) with a read position, so that the section parsers can walk
+//it like a FILE* without doing a syscall for every field.
+//
+//All accesses are bounds-checked: reading past the end of the buffer
+//copies what is there, zero-fills the rest and sets the eof flag
+//(like fread() on a short file, but without leaving garbage behind).
+//The buffer is not owned by the MemFile and has to outlive it.
+struct MemFile
+{
+  MemFile(const u8* data, size_t size)
+  : m_data(data), m_size(size), m_pos(0), m_eof(false)
+  {}
+
+  const u8* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+  long tell() const { return (long)m_pos; }
+  bool eof() const { return m_eof; }
+
+  void seek(long pos)
+  {
+    m_pos = pos < 0 ? m_size : (size_t)pos;
+    m_eof = false;
+  }
+
+  void skip(long count)
+  { seek(tell() + count); }
+
+  //returns true if count bytes starting at pos are inside the buffer
+  bool has(size_t pos, size_t count) const
+  { return pos <= m_size && count <= m_size - pos; }
+
+  //returns a pointer to count bytes at pos, or NULL if
+  //they are not completely inside the buffer. Nothing is copied.
+  const u8* at(size_t pos, size_t count) const
+  { return has(pos, count) ? m_data + pos : NULL; }
+
+  size_t read(void* dst, size_t count)
+  {
+    size_t avail = has(m_pos, 0) ? m_size - m_pos : 0;
+    size_t n = count < avail ? count : avail;
+    if(n != 0)
+      memcpy(dst, m_data + m_pos, n);
+    if(n != count)
+    {
+      memset((u8*)dst + n, 0, count - n);
+      m_eof = true;
+    }
+    m_pos += count;
+    return n;
+  }
+
+  //Returns a pointer to the next count bytes and advances the read
+  //position. If the data is completely inside the buffer this points
+  //directly into the buffer, otherwise the available bytes are copied
+  //to scratch (zero-padded) and a pointer into scratch is returned.
+  const u8* readPtr(size_t count, std::vector<u8>& scratch)
+  {
+    const u8* ret = at(m_pos, count);
+    if(ret != NULL)
+    {
+      m_pos += count;
+      return ret;
+    }
+
+    scratch.resize(count + 1); //+1: count may be 0
+    read(&scratch[0], count);
+    return &scratch[0];
+  }
+
+  u8 readByte()
+  {
+    u8 v; read(&v, 1);
+    return v;
+  }
+
+private:
+  const u8* m_data;
+  size_t m_size;
+  size_t m_pos;
+  bool m_eof;
+};
+
+inline void readWORD(MemFile* f, u16& v)
+{
+  f->read(&v, 2);
+  toWORD(v);
+}
+
+inline void readSHORT(MemFile* f, s16& v)
+{
+  f->read(&v, 2);
+  toSHORT(v);
+}
+
+inline void readDWORD(MemFile* f, u32& v)
+{
+  f->read(&v, 4);
+  toDWORD(v);
+}
+
+inline void readFLOAT(MemFile* f, f32& v)
+{
+  f->read(&v, 4);
+  toFLOAT(v);
+}
+
+//reads the remainder of f into dst, starting at the current position
+void readWholeFile(FILE* f, std::vector<u8>& dst);
+
+#endif //BMD_MEMFILE_H
@@ -1,165 +1,140 @@
 #include "openfile.h"
 
 #include "common.h"
+#include "yaz0.h"
 
 #include <vector>
 #include <cstdio>
+#include <cstring>
 using namespace std;
 
 #ifdef _WIN32
-#include <windows.h> //GetTempPath(), GetTempFileName()
+#include <windows.h> //CreateFileMapping(), MapViewOfFile()
 
-std::string getTempFileName()
+//maps a whole file read-only into memory. returns false
+//if the file can't be opened. size is set to the file size,
+//empty files are not mapped (view is NULL then).
+bool mapFile(const std::string& name, void*& view, size_t& size)
 {
-  char pathName[MAX_PATH], fileName[MAX_PATH];
-  GetTempPath(MAX_PATH, pathName);
-  GetTempFileName(pathName, "yaz0", 0, fileName);
-  return fileName;
-}
+  view = NULL;
+  size = 0;
 
-#else
+  HANDLE file = CreateFileA(name.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
 
-std::string getTempFileName()
-{
-  char fileName[L_tmpnam];
-  tmpnam(fileName); //TODO: better use mkstemp()
-  return fileName;
-}
+  LARGE_INTEGER fileSize;
+  if(!GetFileSizeEx(file, &fileSize))
+  {
+    CloseHandle(file);
+    return false;
+  }
 
-#endif
+  if(fileSize.QuadPart != 0)
+  {
+    //the view keeps the mapping alive, so both handles can be closed
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mapping != NULL)
+    {
+      view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+    if(view == NULL)
+    {
+      CloseHandle(file);
+      return false;
+    }
+  }
 
+  CloseHandle(file);
+  size = (size_t)fileSize.QuadPart;
+  return true;
+}
 
-struct Ret
+void unmapFile(void* view, size_t size)
 {
-  int srcPos, dstPos;
-};
+  if(view != NULL)
+    UnmapViewOfFile(view);
+}
 
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-Ret decodeYaz0(u8* src, int srcSize, u8* dst, int uncompressedSize)
+bool mapFile(const std::string& name, void*& view, size_t& size)
 {
-  Ret r = { 0, 0 }; //current read/write positions
-  
-  u32 validBitCount = 0; //number of valid bits left in "code" byte
-  u8 currCodeByte;
-  while(r.dstPos < uncompressedSize)
+  view = NULL;
+  size = 0;
+
+  int fd = open(name.c_str(), O_RDONLY);
+  if(fd == -1)
+    return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0)
   {
-    //read new "code" byte if the current one is used up
-    if(validBitCount == 0)
-    {
-      if(r.srcPos >= srcSize)
-        return r;
-      currCodeByte = src[r.srcPos];
-      ++r.srcPos;
-      validBitCount = 8;
-    }
-    
-    if((currCodeByte & 0x80) != 0)
-    {
-      //straight copy
-      if(r.srcPos >= srcSize)
-        return r;
-      dst[r.dstPos] = src[r.srcPos];
-      r.dstPos++;
-      r.srcPos++;
-    }
-    else
+    close(fd);
+    return false;
+  }
+
+  if(st.st_size != 0)
+  {
+    view = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(view == MAP_FAILED)
     {
-      //RLE part
-      if(r.srcPos >= srcSize - 1)
-        return r;
-      u8 byte1 = src[r.srcPos];
-      u8 byte2 = src[r.srcPos + 1];
-      r.srcPos += 2;
-
-      
-      u32 dist = ((byte1 & 0xF) << 8) | byte2;
-      u32 copySource = r.dstPos - (dist + 1);
-
-      u32 numBytes = byte1 >> 4;
-      if(numBytes == 0)
-      {
-        if(r.srcPos >= srcSize)
-          return r;
-        numBytes = src[r.srcPos] + 0x12;
-        r.srcPos++;
-      }
-      else
-        numBytes += 2;
-
-      //copy run
-      for(size_t i = 0; i < numBytes; ++i)
-      {
-        if(r.dstPos >= uncompressedSize)
-          return r;
-        dst[r.dstPos] = dst[copySource];
-        copySource++;
-        r.dstPos++;
-      }
+      view = NULL;
+      close(fd);
+      return false;
     }
-    
-    //use next bit from "code" byte
-    currCodeByte <<= 1;
-    validBitCount-=1;    
   }
 
-  return r;
+  close(fd);
+  size = (size_t)st.st_size;
+  return true;
 }
 
-OpenedFile* openFile(const string& name)
+void unmapFile(void* view, size_t size)
 {
-  FILE* f;
+  if(view != NULL)
+    munmap(view, size);
+}
 
-  fopen_s(&f, name.c_str(), "rb");
-  if(f == NULL)
+#endif
+
+
+OpenedFile* openFile(const string& name, bool decompress)
+{
+  void* view;
+  size_t size;
+  if(!mapFile(name, view, size))
   {
     fprintf(stderr, "Failed to open \"%s\"\n", name.c_str());
     return NULL;
   }
 
   OpenedFile* ret = new OpenedFile;
+  const u8* src = (const u8*)view;
 
-  char buff[4];
-  fread(buff, 1, 4, f);
-  if(strncmp(buff, "Yaz0", 4) != 0)
+  if(!decompress || !isYaz0(src, size))
   {
-    fseek(f, 0, SEEK_SET);
-    ret->f = f;
-    return ret; //not compressed, return file directly
+    //not compressed, return the mapped file directly
+    ret->data = src;
+    ret->size = size;
+    ret->mappedView = view;
+    return ret;
   }
 
-  //yaz0-compressed file - uncompress to a temporary file,
-  //return the uncompressed file
-
-  u32 uncompressedSize;
-  fread(&uncompressedSize, 4, 1, f);
-  toDWORD(uncompressedSize);
-
-  fseek(f, 0, SEEK_END);
-  long compressedSize = ftell(f) - 16; //16 byte header
-  fseek(f, 16, SEEK_SET); //seek to start of data
-
-  vector<u8> srcData(compressedSize), dstData(uncompressedSize);
-  fread(&srcData[0], 1, compressedSize, f);
-  fclose(f);
-  Ret r = decodeYaz0(&srcData[0], compressedSize, 
-                     &dstData[0], uncompressedSize);
-
-
-  //write decompressed data to a temporary file and
-  //return handle to this file
-  string tempFileName = getTempFileName();
-  
-  fopen_s(&f, tempFileName.c_str(), "wb+");
-  if(f == NULL)
-  {
-    delete ret;
-    return NULL;
-  }
-  fwrite(&dstData[0], 1, r.dstPos, f);
-  fseek(f, 0, SEEK_SET);
+  //yaz0-compressed file - uncompress straight from the
+  //mapped file into memory, then drop the mapping
+  decompressYaz0(src, size, ret->buffer);
+  unmapFile(view, size);
 
-  ret->f = f;
-  ret->tempFileName = tempFileName;
+  ret->data = ret->buffer.empty() ? NULL : &ret->buffer[0];
+  ret->size = ret->buffer.size();
+  ret->mappedView = NULL;
   return ret;
 }
 
@@ -168,8 +143,6 @@ void closeFile(OpenedFile* f)
   if(f == NULL)
     return;
 
-  fclose(f->f);
-  if(f->tempFileName != "") //delete temporary file
-    remove(f->tempFileName.c_str());
+  unmapFile(f->mappedView, f->size);
   delete f;
 }
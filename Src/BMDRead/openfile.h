@@ -1,27 +1,36 @@
 #ifndef BMD_OPENFILE_H
 #define BMD_OPENFILE_H BMD_OPENFILE_H
 
+#include "gccommon.h"
+
 #include <string>
-#include <cstdio>
+#include <vector>
 
 struct OpenedFile
 {
-  //If the file was compressed, this is the
-  //filename of the temp file with the uncompressed
-  //data (needed by closeFile() to delete that file).
-  //If the file was not compressed, this is ""
-  std::string tempFileName;
-
-  //this is your file descriptor
-  FILE* f;
+  //The uncompressed file contents. They stay valid
+  //until closeFile() is called, don't write to them.
+  const u8* data;
+  size_t size;
+
+  //If the file was compressed, this holds the
+  //uncompressed data and data points into it.
+  std::vector<u8> buffer;
+
+  //If the file was not compressed, this is the
+  //mapped view of the file (data == mappedView),
+  //needed by closeFile() to unmap it. Else NULL.
+  void* mappedView;
 };
 
 //opens a file for binary reading, if the
-//file is yaz0-compressed an uncompressed
-//file is returned
-OpenedFile* openFile(const std::string& name);
+//file is yaz0-compressed it is uncompressed
+//into memory, else it is mapped into memory.
+//If decompress is false, compressed files
+//are mapped as well.
+OpenedFile* openFile(const std::string& name, bool decompress = true);
 
-//closes a file, deletes created temporary files
+//closes a file, frees the uncompressed data
 void closeFile(OpenedFile* f);
 
 #endif //BMD_OPENFILE_H
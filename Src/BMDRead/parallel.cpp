@@ -0,0 +1,42 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+int defaultThreadCount()
+{
+  int n = (int)std::thread::hardware_concurrency();
+  return n > 0 ? n : 1;
+}
+
+void parallelFor(int count, int numThreads, const std::function<void(int)>& func)
+{
+  if(numThreads <= 0)
+    numThreads = defaultThreadCount();
+  if(numThreads > count)
+    numThreads = count;
+
+  if(numThreads <= 1)
+  {
+    for(int i = 0; i < count; ++i)
+      func(i);
+    return;
+  }
+
+  //every thread takes the next unprocessed item until none are left
+  std::atomic<int> next(0);
+  auto worker = [&]()
+  {
+    for(int i = next++; i < count; i = next++)
+      func(i);
+  };
+
+  std::vector<std::thread> threads;
+  for(int i = 1; i < numThreads; ++i)
+    threads.push_back(std::thread(worker));
+  worker();
+
+  for(size_t i = 0; i < threads.size(); ++i)
+    threads[i].join();
+}
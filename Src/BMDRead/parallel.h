@@ -0,0 +1,16 @@
+#ifndef BMD_PARALLEL_H
+#define BMD_PARALLEL_H BMD_PARALLEL_H
+
+#include <functional>
+
+//number of threads to use if the caller asks for 0 (all cores)
+int defaultThreadCount();
+
+//Calls func(i) for every i in [0, count), spread over up to numThreads
+//threads (0 means defaultThreadCount()). The calling thread works as
+//well, the call returns when all items are done. Items are handed out
+//in order, but may finish in any order, so func has to write its result
+//to a slot that belongs to i to get deterministic output.
+void parallelFor(int count, int numThreads, const std::function<void(int)>& func);
+
+#endif //BMD_PARALLEL_H
@@ -0,0 +1,165 @@
+#include "rarc.h"
+
+#include "common.h"
+
+#include <cstring>
+
+namespace rarc
+{
+
+//all offsets in the info block are relative to its start
+struct Header
+{
+  char tag[4]; //'RARC'
+  u32 size;
+  u32 headerSize; //0x20, the info block follows
+  u32 dataOffset; //relative to the info block
+  u32 dataSize;
+  u32 unknown[3];
+
+  //info block
+  u32 numNodes;
+  u32 nodesOffset;
+  u32 numFileEntries;
+  u32 fileEntriesOffset;
+  u32 stringTableSize;
+  u32 stringTableOffset;
+};
+
+//a node is a directory, its files and subdirectories are
+//numFileEntries consecutive entries in the file entry table
+struct Node
+{
+  u32 nameOffset;
+  u16 numFileEntries;
+  u32 firstFileEntry;
+};
+
+struct FileEntry
+{
+  u16 id; //0xffff for directories
+  u8 flags;
+  u32 nameOffset;
+  u32 dataOffset; //node index for directories
+  u32 dataSize;
+};
+
+enum
+{
+  FLAG_FILE = 0x01,
+  FLAG_DIRECTORY = 0x02
+};
+
+};
+
+struct Rarc
+{
+  const u8* data;
+  size_t size;
+  rarc::Header h;
+  u32 infoOffset;
+};
+
+bool readNode(const Rarc& r, u32 nodeIndex, u32 nodeCount,
+              const u8* nodeData, const std::string& path,
+              std::vector<RarcFile>& files)
+{
+  rarc::Node n;
+  n.nameOffset = memDWORD(nodeData + 4);
+  n.numFileEntries = memWORD(nodeData + 10);
+  n.firstFileEntry = memDWORD(nodeData + 12);
+
+  if(n.firstFileEntry > r.h.numFileEntries
+    || n.numFileEntries > r.h.numFileEntries - n.firstFileEntry)
+    return false;
+
+  const u8* strings = r.data + r.infoOffset + r.h.stringTableOffset;
+  for(u32 i = 0; i < n.numFileEntries; ++i)
+  {
+    const u8* e = r.data + r.infoOffset + r.h.fileEntriesOffset
+                + (n.firstFileEntry + i)*0x14;
+    rarc::FileEntry entry;
+    entry.id = memWORD(e);
+    u32 typeAndName = memDWORD(e + 4);
+    entry.flags = typeAndName >> 24;
+    entry.nameOffset = typeAndName & 0xffffff;
+    entry.dataOffset = memDWORD(e + 8);
+    entry.dataSize = memDWORD(e + 12);
+
+    if(entry.nameOffset >= r.h.stringTableSize)
+      return false;
+    const char* nameStart = (const char*)strings + entry.nameOffset;
+    const void* nameEnd = memchr(nameStart, '\0',
+                                 r.h.stringTableSize - entry.nameOffset);
+    std::string name(nameStart, nameEnd != NULL
+      ? (const char*)nameEnd - nameStart
+      : r.h.stringTableSize - entry.nameOffset);
+
+    if((entry.flags & rarc::FLAG_DIRECTORY) != 0)
+    {
+      if(name == "." || name == "..")
+        continue;
+
+      //every directory has exactly one node, and nodes only
+      //reference nodes after themselves. This prevents cycles
+      //on corrupt data.
+      if(entry.dataOffset <= nodeIndex || entry.dataOffset >= nodeCount)
+        return false;
+
+      const u8* childData = r.data + r.infoOffset + r.h.nodesOffset
+                          + entry.dataOffset*0x10;
+      if(!readNode(r, entry.dataOffset, nodeCount, childData,
+                   path + name + "/", files))
+        return false;
+    }
+    else
+    {
+      size_t start = size_t(r.infoOffset) + r.h.dataOffset + entry.dataOffset;
+      if(start > r.size || entry.dataSize > r.size - start)
+        return false;
+
+      RarcFile file;
+      file.path = path + name;
+      file.data = r.data + start;
+      file.size = entry.dataSize;
+      files.push_back(file);
+    }
+  }
+
+  return true;
+}
+
+bool readRarc(const u8* data, size_t size, std::vector<RarcFile>& files)
+{
+  files.clear();
+  if(size < 0x40 || memcmp(data, "RARC", 4) != 0)
+    return false;
+
+  Rarc r;
+  r.data = data;
+  r.size = size;
+  r.h.headerSize = memDWORD(data + 0x08);
+  r.h.dataOffset = memDWORD(data + 0x0c);
+  r.infoOffset = r.h.headerSize;
+  if(r.infoOffset > size - 0x20)
+    return false;
+
+  const u8* info = data + r.infoOffset;
+  r.h.numNodes = memDWORD(info + 0x00);
+  r.h.nodesOffset = memDWORD(info + 0x04);
+  r.h.numFileEntries = memDWORD(info + 0x08);
+  r.h.fileEntriesOffset = memDWORD(info + 0x0c);
+  r.h.stringTableSize = memDWORD(info + 0x10);
+  r.h.stringTableOffset = memDWORD(info + 0x14);
+
+  //make sure all tables are inside the file
+  u64 infoSize = size - r.infoOffset;
+  if(r.h.numNodes == 0
+    || r.h.nodesOffset + u64(r.h.numNodes)*0x10 > infoSize
+    || r.h.fileEntriesOffset + u64(r.h.numFileEntries)*0x14 > infoSize
+    || r.h.stringTableOffset + u64(r.h.stringTableSize) > infoSize)
+    return false;
+
+  //node 0 is the root directory, its name is not part of the paths
+  return readNode(r, 0, r.h.numNodes, info + r.h.nodesOffset, "", files);
+}
@@ -0,0 +1,28 @@
+#ifndef BMD_RARC_H
+#define BMD_RARC_H BMD_RARC_H
+
+//rarc files (.arc) are archives that bundle the models, animations
+//and other files of an object or a stage. They are usually
+//yaz0-compressed as a whole, openFile() takes care of that.
+
+#include "gccommon.h"
+
+#include <string>
+#include <vector>
+
+struct RarcFile
+{
+  //path inside the archive, directories separated by '/'
+  std::string path;
+
+  //points into the archive data, so it is only valid as long as
+  //the archive data is. Files can be yaz0-compressed individually.
+  const u8* data;
+  size_t size;
+};
+
+//lists all files in an uncompressed rarc archive. Returns
+//false if data is not a rarc archive or if it is corrupt.
+bool readRarc(const u8* data, size_t size, std::vector<RarcFile>& files);
+
+#endif //BMD_RARC_H
@@ -118,11 +118,11 @@ typedef vector<BatchAttrib> BatchAttribs;
 
 };
 
-bmd::BatchAttribs getBatchAttribs(FILE* f, int off)
+bmd::BatchAttribs getBatchAttribs(MemFile* f, int off)
 {
-  int old = ftell(f);
+  int old = f->tell();
 
-  fseek(f, off, SEEK_SET);
+  f->seek(off);
 
   bmd::BatchAttribs ret;
 
@@ -138,11 +138,11 @@ bmd::BatchAttribs getBatchAttribs(FILE* f, int off)
     readDWORD(f, attrib.dataType);
   }
 
-  fseek(f, old, SEEK_SET);
+  f->seek(old);
   return ret;
 };
 
-void dumpPacketPrimitives(const bmd::BatchAttribs& attribs, int dataSize, FILE* f, Packet& dst)
+void dumpPacketPrimitives(const bmd::BatchAttribs& attribs, int dataSize, MemFile* f, Packet& dst)
 {
   bool done = false;
   int readBytes = 0;
@@ -150,7 +150,7 @@ void dumpPacketPrimitives(const bmd::BatchAttribs& attribs, int dataSize, FILE*
   while(!done)
   {
     u8 type;
-    fread(&type, 1, 1, f);
+    f->read(&type, 1);
     ++readBytes;
 
     if(type == 0 || readBytes >= dataSize)
@@ -183,7 +183,7 @@ void dumpPacketPrimitives(const bmd::BatchAttribs& attribs, int dataSize, FILE*
           case 1: //s8
           {
             u8 tmp;
-            fread(&tmp, 1, 1, f);
+            f->read(&tmp, 1);
             val = tmp;
             readBytes += 1;
           }break;
@@ -241,7 +241,7 @@ void dumpPacketPrimitives(const bmd::BatchAttribs& attribs, int dataSize, FILE*
   }
 }
 
-void dumpBatch(const bmd::Batch& batch, const bmd::Shp1Header& h, FILE* f, long baseOffset, Batch& dst)
+void dumpBatch(const bmd::Batch& batch, const bmd::Shp1Header& h, MemFile* f, long baseOffset, Batch& dst)
 {
   size_t i;
 
@@ -306,36 +306,36 @@ void dumpBatch(const bmd::Batch& batch, const bmd::Shp1Header& h, FILE* f, long
   {
     //read packet location for current packet
     bmd::PacketLocation packetLocation;
-    fseek(f, baseOffset + h.offsetToPacketLocations
-      + (batch.firstPacketLocation + i)*sizeof(packetLocation), SEEK_SET);
+    f->seek(baseOffset + h.offsetToPacketLocations
+      + (batch.firstPacketLocation + i)*sizeof(packetLocation));
     readDWORD(f, packetLocation.size);
     readDWORD(f, packetLocation.offset);
 
     //read packet's primitives
     Packet& dstPacket = dst.packets[i];
-    fseek(f, baseOffset + h.offsetData + packetLocation.offset, SEEK_SET);
+    f->seek(baseOffset + h.offsetData + packetLocation.offset);
     dumpPacketPrimitives(attribs, packetLocation.size, f, dstPacket);
 
     //read matrix data for current packet
     bmd::MatrixData matrixData;
-    fseek(f, baseOffset + h.offsetToMatrixData
-      + (batch.firstMatrixData + i)*sizeof(matrixData), SEEK_SET);
+    f->seek(baseOffset + h.offsetToMatrixData
+      + (batch.firstMatrixData + i)*sizeof(matrixData));
     readWORD(f, matrixData.unknown1); //TODO: figure this out...
     readWORD(f, matrixData.count);
     readDWORD(f, matrixData.firstIndex);
 
     //read packet's matrix table
     dstPacket.matrixTable.resize(matrixData.count);
-    fseek(f, baseOffset + h.offsetToMatrixTable
-      + 2*matrixData.firstIndex, SEEK_SET);
+    f->seek(baseOffset + h.offsetToMatrixTable
+      + 2*matrixData.firstIndex);
     for(int j = 0; j < matrixData.count; ++j)
       readWORD(f, dstPacket.matrixTable[j]);
   }
 }
 
-void readShp1Header(FILE* f, bmd::Shp1Header& h)
+void readShp1Header(MemFile* f, bmd::Shp1Header& h)
 {
-  fread(h.tag, 1, 4, f);
+  f->read(h.tag, 4);
   readDWORD(f, h.sizeOfSection);
   readWORD(f, h.batchCount);
   readWORD(f, h.pad);
@@ -350,10 +350,10 @@ void readShp1Header(FILE* f, bmd::Shp1Header& h)
   readDWORD(f, h.offsetToPacketLocations);
 }
 
-void readBatch(FILE* f, bmd::Batch& d)
+void readBatch(MemFile* f, bmd::Batch& d)
 {
-  fread(&d.matrixType, 1, 1, f);
-  fread(&d.unknown2, 1, 1, f);
+  f->read(&d.matrixType, 1);
+  f->read(&d.unknown2, 1);
   readWORD(f, d.packetCount);
   readWORD(f, d.offsetToAttribs);
   readWORD(f, d.firstMatrixData);
@@ -366,15 +366,15 @@ void readBatch(FILE* f, bmd::Batch& d)
     readFLOAT(f, d.bbMax[j]);
 }
 
-void dumpShp1(FILE* f, Shp1& dst)
+void dumpShp1(MemFile* f, Shp1& dst)
 {
-  int shp1Offset = ftell(f), i;
+  int shp1Offset = f->tell(), i;
 
   bmd::Shp1Header h;
   readShp1Header(f, h);
 
   //read batches
-  fseek(f, h.offsetToBatches + shp1Offset, SEEK_SET);
+  f->seek(h.offsetToBatches + shp1Offset);
   dst.batches.resize(h.batchCount);
   for(i = 0; i < h.batchCount; ++i)
   {
@@ -383,27 +383,27 @@ void dumpShp1(FILE* f, Shp1& dst)
 
     Batch& dstBatch = dst.batches[i];
 
-    long filePos = ftell(f);
+    long filePos = f->tell();
     dumpBatch(d, h, f, shp1Offset, dstBatch);
-    fseek(f, filePos, SEEK_SET);
+    f->seek(filePos);
   }
 }
 
-void writeShp1Info(FILE* f, ostream& out)
+void writeShp1Info(MemFile* f, ostream& out)
 {
   out << string(50, '/') << endl
       << "//Shp1 section" << endl
       << string(50, '/') << endl << endl;
 
 
-  int shp1Offset = ftell(f), i;
+  int shp1Offset = f->tell(), i;
 
   bmd::Shp1Header h;
   readShp1Header(f, h);
 
   //read batches
   out << "Batches (VERY incomplete)" << endl;
-  fseek(f, h.offsetToBatches + shp1Offset, SEEK_SET);
+  f->seek(h.offsetToBatches + shp1Offset);
   for(i = 0; i < h.batchCount; ++i)
   {
     bmd::Batch d;
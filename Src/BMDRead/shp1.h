@@ -129,7 +129,7 @@ struct Shp1
   }
 };
 
-void dumpShp1(FILE* f, Shp1& dst);
-void writeShp1Info(FILE* f, std::ostream& out);
+void dumpShp1(MemFile* f, Shp1& dst);
+void writeShp1Info(MemFile* f, std::ostream& out);
 
 #endif //BMD_SHP1_H
@@ -1,7 +1,10 @@
 #include "tex1.h"
+#include "parallel.h"
+#include "tex1simd.h"
 #include <set>
 #include <map>
 #include <iostream>
+#include <math.h>
 
 using namespace std;
 
@@ -117,16 +120,42 @@ struct TextureHeader
 
 };
 
-void loadAndConvertImage(FILE* f, const bmd::TextureHeader& h, long baseOffset,
-                         BmdImage& curr);
+void loadAndConvertImage(MemFile* f, const bmd::TextureHeader& h, long baseOffset,
+                         u32 flags, BmdImage& curr);
 
 void r5g6b5ToRgba8(u16 srcPixel, u8* dest);
 
+//the 4 colors of a dxt1 block as rgba8. The thirds are
+//computed as (x*0x5556) >> 16, which is exact for x < 767
+//and what the SIMD code in tex1simd.cpp does as well
+static void dxt1ColorTable(u16 color1, u16 color2, u8 colorTable[4][4])
+{
+  r5g6b5ToRgba8(color1, colorTable[0]);
+  r5g6b5ToRgba8(color2, colorTable[1]);
+  for(int i = 0; i < 3; ++i)
+  {
+    int a = colorTable[0][i], b = colorTable[1][i];
+    if(color1 > color2)
+      colorTable[2][i] = ((2*a + b + 1)*0x5556) >> 16;
+    else
+      colorTable[2][i] = (a + b + 1) >> 1;
+
+    //in 3 color mode only the alpha value of this color is important...
+    colorTable[3][i] = ((a + 2*b + 1)*0x5556) >> 16;
+  }
+  colorTable[2][3] = 0xff;
+  colorTable[3][3] = color1 > color2 ? 0xff : 0x00;
+}
+
 void decompressDxt1(u8* dest, const u8* src, int w, int h)
 {
+  if(decompressDxt1Simd(dest, src, w, h))
+    return;
+
   const u8* runner = src;
   for(int y = 0; y < h; y += 4)
   {
+    int blockH = min(4, h - y);
     for(int x = 0; x < w; x += 4)
     {
       u16 color1 = memWORD_le(runner);
@@ -134,55 +163,46 @@ void decompressDxt1(u8* dest, const u8* src, int w, int h)
       u32 bits = memDWORD_le(runner + 4);
       runner += 8;
 
-      //prepare color table
-      u8 colorTable[4][4];
-      r5g6b5ToRgba8(color1, colorTable[0]);
-      r5g6b5ToRgba8(color2, colorTable[1]);
-      if(color1 > color2)
-      {
-        colorTable[2][0] = (2*colorTable[0][0] + colorTable[1][0] + 1) / 3;
-        colorTable[2][1] = (2*colorTable[0][1] + colorTable[1][1] + 1) / 3;
-        colorTable[2][2] = (2*colorTable[0][2] + colorTable[1][2] + 1) / 3;
-        colorTable[2][3] = 0xff;
-        
-        colorTable[3][0] = (colorTable[0][0] + 2*colorTable[1][0] + 1) / 3;
-        colorTable[3][1] = (colorTable[0][1] + 2*colorTable[1][1] + 1) / 3;
-        colorTable[3][2] = (colorTable[0][2] + 2*colorTable[1][2] + 1) / 3;
-        colorTable[3][3] = 0xff;
-      }
-      else
+      u32 colorTable[4];
+      dxt1ColorTable(color1, color2, (u8 (*)[4])colorTable);
+
+      //decode image, only the last row and column of blocks
+      //can be partial
+      int blockW = min(4, w - x);
+      for(int iy = 0; iy < blockH; ++iy)
       {
-        colorTable[2][0] = (colorTable[0][0] + colorTable[1][0] + 1) / 2;
-        colorTable[2][1] = (colorTable[0][1] + colorTable[1][1] + 1) / 2;
-        colorTable[2][2] = (colorTable[0][2] + colorTable[1][2] + 1) / 2;
-        colorTable[2][3] = 0xff;
-
-        //only the alpha value of this color is important...
-        colorTable[3][0] = (colorTable[0][0] + 2*colorTable[1][0] + 1) / 3;
-        colorTable[3][1] = (colorTable[0][1] + 2*colorTable[1][1] + 1) / 3;
-        colorTable[3][2] = (colorTable[0][2] + 2*colorTable[1][2] + 1) / 3;
-        colorTable[3][3] = 0x00;
+        u32* row = (u32*)(dest + 4*((y + iy)*w + x));
+        u32 rowBits = bits >> 8*iy;
+        for(int ix = 0; ix < blockW; ++ix, rowBits >>= 2)
+          row[ix] = colorTable[rowBits & 0x3];
       }
-
-      //decode image
-      for(int iy = 0; iy < 4; ++iy)
-        for(int ix = 0; ix < 4; ++ix)
-        {
-          if(x + ix < w && y + iy < h)
-          {
-            u32 di = 4*((y + iy)*w + x + ix);
-            u32 si = bits & 0x3;
-            dest[di + 0] = colorTable[si][0];
-            dest[di + 1] = colorTable[si][1];
-            dest[di + 2] = colorTable[si][2];
-            dest[di + 3] = colorTable[si][3];
-          }
-          bits >>= 2;
-        }
     }
   }
 }
 
+void decompressDxt1(u8* dest, const u8* src, int w, int h, int numThreads)
+{
+  //every thread gets a few whole rows of blocks, which are a
+  //contiguous part of both the source and the destination
+  const int blockRows = (h + 3)/4;
+  int threads = numThreads == 0 ? defaultThreadCount() : numThreads;
+  int rowsPerItem = max(1, blockRows/(4*max(threads, 1)));
+  int numItems = (blockRows + rowsPerItem - 1)/rowsPerItem;
+  if(threads <= 1 || numItems <= 1)
+  {
+    decompressDxt1(dest, src, w, h);
+    return;
+  }
+
+  const int srcRowSize = 8*((w + 3)/4);
+  parallelFor(numItems, numThreads, [&](int i)
+  {
+    int y = 4*i*rowsPerItem;
+    int rows = min(4*rowsPerItem, h - y);
+    decompressDxt1(dest + 4*w*y, src + srcRowSize*(y/4), w, rows);
+  });
+}
+
 //checks if a positive number is a power of two
 bool isPot(int i)
 {
@@ -200,9 +220,199 @@ int nextPot(int i)
   return ret;
 }
 
-void readTex1Header(FILE* f, bmd::Tex1Header& h)
+//mipmap generation (TEX1_GENERATE_MIPMAPS)
+
+//srgb <-> linear for TEX1_SRGB_MIPMAPS. Linear values are 16 bit,
+//the inverse table has an entry for each of them
+struct SrgbTables
+{
+  u16 toLinear[256];
+  u8 toSrgb[65536];
+
+  SrgbTables()
+  {
+    for(int i = 0; i < 256; ++i)
+    {
+      double c = i/255.0;
+      c = c <= 0.04045 ? c/12.92 : pow((c + 0.055)/1.055, 2.4);
+      toLinear[i] = (u16)(c*65535 + 0.5);
+    }
+    for(int i = 0; i < 65536; ++i)
+    {
+      double c = i/65535.0;
+      c = c <= 0.0031308 ? c*12.92 : 1.055*pow(c, 1/2.4) - 0.055;
+      toSrgb[i] = (u8)(c*255 + 0.5);
+    }
+  }
+};
+
+static const SrgbTables& srgbTables()
+{
+  static SrgbTables tables;
+  return tables;
+}
+
+//averages 4 8 bit channel values, in linear space if srgb != NULL
+static inline int average4(int a, int b, int c, int d, const SrgbTables* srgb)
+{
+  if(srgb == NULL)
+    return (a + b + c + d + 2) >> 2;
+  const u16* l = srgb->toLinear;
+  return srgb->toSrgb[(l[a] + l[b] + l[c] + l[d] + 2) >> 2];
+}
+
+//the same for an n bit channel of a 16 bit pixel
+static inline int average4Bits(int a, int b, int c, int d, int bits, const SrgbTables* srgb)
+{
+  if(srgb == NULL)
+    return (a + b + c + d + 2) >> 2;
+
+  int maxVal = (1 << bits) - 1;
+  int avg = average4((a*255 + maxVal/2)/maxVal, (b*255 + maxVal/2)/maxVal,
+                     (c*255 + maxVal/2)/maxVal, (d*255 + maxVal/2)/maxVal, srgb);
+  return (avg*maxVal + 127)/255;
+}
+
+//2x2 box filter of one 16 bit pixel, channels given as (shift, bits),
+//the last one is alpha and always averaged linearly
+static u16 average4Pixels16(u16 p0, u16 p1, u16 p2, u16 p3, const int channels[][2],
+                            int numChannels, bool hasAlpha, const SrgbTables* srgb)
+{
+  u16 ret = 0;
+  for(int c = 0; c < numChannels; ++c)
+  {
+    int shift = channels[c][0], bits = channels[c][1], mask = (1 << bits) - 1;
+    int avg = average4Bits((p0 >> shift) & mask, (p1 >> shift) & mask,
+                           (p2 >> shift) & mask, (p3 >> shift) & mask, bits,
+                           hasAlpha && c == numChannels - 1 ? NULL : srgb);
+    ret |= avg << shift;
+  }
+  return ret;
+}
+
+//Halves a w*h image of format (I8, I8_A8, RGBA8, RGB565 or RGBA4)
+//in both directions. Sides of size 1 stay 1, h has to be even or 1.
+//The linear 8 bit formats use the SIMD kernel if they can.
+static void halveImage(u8* dest, const u8* src, int w, int h, int format,
+                       const SrgbTables* srgb)
+{
+  int pixSize = format == I8 ? 1 : (format == RGBA8 ? 4 : 2);
+  bool byteChannels = format == I8 || format == I8_A8 || format == RGBA8;
+  if(byteChannels && (srgb == NULL || format != RGBA8)
+    && halveImageSimd(dest, src, w, h, pixSize))
+    return;
+
+  int dw = max(w/2, 1), dh = max(h/2, 1);
+  int xOff = w > 1 ? pixSize : 0, yOff = h > 1 ? pixSize*w : 0;
+  static const int rgb565Channels[][2] = { { 11, 5 }, { 5, 6 }, { 0, 5 } };
+  static const int rgba4Channels[][2] = { { 8, 4 }, { 4, 4 }, { 0, 4 }, { 12, 4 } };
+  for(int y = 0; y < dh; ++y)
+  {
+    const u8* s = src + 2*y*pixSize*w;
+    u8* d = dest + y*pixSize*dw;
+    for(int x = 0; x < dw; ++x, s += 2*xOff, d += pixSize)
+    {
+      if(byteChannels)
+      {
+        for(int c = 0; c < pixSize; ++c)
+        {
+          //only the colors of rgba8 are srgb, intensities are
+          //often used as masks and stay linear like alpha
+          bool color = format == RGBA8 && c < 3;
+          d[c] = average4(s[c], s[xOff + c], s[yOff + c], s[yOff + xOff + c],
+                          color ? srgb : NULL);
+        }
+      }
+      else
+      {
+        u16 p = average4Pixels16(memWORD_le(s), memWORD_le(s + xOff), memWORD_le(s + yOff),
+                                 memWORD_le(s + yOff + xOff),
+                                 format == RGB565 ? rgb565Channels : rgba4Channels,
+                                 format == RGB565 ? 3 : 4, format == RGBA4, srgb);
+        d[0] = p & 0xff;
+        d[1] = p >> 8;
+      }
+    }
+  }
+}
+
+static bool canGenerateMipmaps(const BmdImage& img)
+{
+  if(img.mipmaps.size() != 1 || !isPot(img.width) || !isPot(img.height)
+    || (img.width == 1 && img.height == 1))
+    return false;
+
+  switch(img.format)
+  {
+    case I8: case I8_A8: case RGBA8: case RGB565: case RGBA4:
+      return true;
+    default: //dxt1 would have to be decoded and compressed again
+      return false;
+  }
+}
+
+//below this many pixels a level isn't split into bands
+const int MIN_BAND_PIXELS = 64*1024;
+
+bool generateMipmaps(BmdImage& img, bool srgb, int numThreads)
+{
+  if(!canGenerateMipmaps(img))
+    return false;
+
+  int pixSize = img.sizes[0]/(img.width*img.height);
+  int numLevels = 1, w = img.width, h = img.height, totalSize = img.sizes[0];
+  img.sizes.resize(1);
+  while(w > 1 || h > 1)
+  {
+    w = max(w/2, 1);
+    h = max(h/2, 1);
+    img.sizes.push_back(pixSize*w*h);
+    totalSize += pixSize*w*h;
+    ++numLevels;
+  }
+
+  img.imageData.resize(totalSize);
+  img.mipmaps.resize(numLevels);
+  int offset = 0;
+  for(int i = 0; i < numLevels; ++i)
+  {
+    img.mipmaps[i] = &img.imageData[offset];
+    offset += img.sizes[i];
+  }
+
+  const SrgbTables* tables = srgb ? &srgbTables() : NULL;
+  w = img.width;
+  h = img.height;
+  for(int i = 1; i < numLevels; ++i)
+  {
+    //large levels are split into bands of destination rows,
+    //each band reads its own rows of the previous level
+    int dw = max(w/2, 1), dh = max(h/2, 1);
+    int numBands = numThreads == 1 ? 1 : min(dh, dw*dh/MIN_BAND_PIXELS);
+    if(numBands <= 1)
+      halveImage(img.mipmaps[i], img.mipmaps[i - 1], w, h, img.format, tables);
+    else
+    {
+      int rowsPerBand = (dh + numBands - 1)/numBands;
+      parallelFor(numBands, numThreads, [&](int band)
+      {
+        int y = band*rowsPerBand;
+        int rows = min(rowsPerBand, dh - y);
+        if(rows > 0)
+          halveImage(img.mipmaps[i] + pixSize*dw*y, img.mipmaps[i - 1] + pixSize*w*2*y,
+                     w, 2*rows, img.format, tables);
+      });
+    }
+    w = dw;
+    h = dh;
+  }
+  img.generatedMipmaps = true;
+  return true;
+}
+
+void readTex1Header(MemFile* f, bmd::Tex1Header& h)
 {
-  fread(h.tag, 1, 4, f);
+  f->read(h.tag, 4);
   readDWORD(f, h.sizeOfSection);
   readWORD(f, h.numImages);
   readWORD(f, h.unknown);
@@ -210,31 +420,31 @@ void readTex1Header(FILE* f, bmd::Tex1Header& h)
   readDWORD(f, h.stringTableOffset);
 }
 
-void readTextureHeader(FILE* f, bmd::TextureHeader& texHeader)
+void readTextureHeader(MemFile* f, bmd::TextureHeader& texHeader)
 {
-  fread(&texHeader.format, 1, 1, f);
-  fread(&texHeader.unknown, 1, 1, f);
+  f->read(&texHeader.format, 1);
+  f->read(&texHeader.unknown, 1);
   readWORD(f, texHeader.width);
   readWORD(f, texHeader.height);
-  fread(&texHeader.wrapS, 1, 1, f);
-  fread(&texHeader.wrapT, 1, 1, f);
-  fread(&texHeader.unknown3, 1, 1, f);
-  fread(&texHeader.paletteFormat, 1, 1, f);
+  f->read(&texHeader.wrapS, 1);
+  f->read(&texHeader.wrapT, 1);
+  f->read(&texHeader.unknown3, 1);
+  f->read(&texHeader.paletteFormat, 1);
   readWORD(f, texHeader.paletteNumEntries);
   readDWORD(f, texHeader.paletteOffset);
   readDWORD(f, texHeader.unknown5);
-  fread(&texHeader.minFilter, 1, 1, f);
-  fread(&texHeader.magFilter, 1, 1, f);
+  f->read(&texHeader.minFilter, 1);
+  f->read(&texHeader.magFilter, 1);
   readWORD(f, texHeader.unknown7);
-  fread(&texHeader.mipmapCount, 1, 1, f);
-  fread(&texHeader.unknown8, 1, 1, f);
+  f->read(&texHeader.mipmapCount, 1);
+  f->read(&texHeader.unknown8, 1);
   readWORD(f, texHeader.unknown9);
   readDWORD(f, texHeader.dataOffset);
 }
 
-void dumpTex1(FILE* f, Tex1& dst)
+void dumpTex1(MemFile* f, Tex1& dst, int numThreads, u32 flags)
 {
-  int tex1Offset = ftell(f);
+  int tex1Offset = f->tell();
 
   //read textureblock header
   bmd::Tex1Header h;
@@ -250,7 +460,7 @@ void dumpTex1(FILE* f, Tex1& dst)
 
   //read all image headers before loading the actual image
   //data, because several headers can refer to the same data
-  fseek(f, tex1Offset + h.textureHeaderOffset, SEEK_SET);
+  f->seek(tex1Offset + h.textureHeaderOffset);
   size_t i;
   vector<bmd::TextureHeader> texHeaders(h.numImages);
   map<long, bmd::TextureHeader*> imageOffsets; //detects multiple offsets
@@ -275,11 +485,12 @@ void dumpTex1(FILE* f, Tex1& dst)
     }
   }
 
-  //read image data
+  //assign image slots in header order, so that the image
+  //indices don't depend on the number of threads
   dst.imageHeaders.resize(h.numImages);
   dst.images.resize(imageOffsets.size());
   map<long, uint> loadedImages;
-  int j = 0;
+  vector<size_t> firstHeader; //header that loads image j
   for(i = 0; i < h.numImages; ++i)
   {
     dst.imageHeaders[i].wrapS = texHeaders[i].wrapS;
@@ -290,22 +501,55 @@ void dumpTex1(FILE* f, Tex1& dst)
     if(i < stringtable.size()) //should always be true
       dst.imageHeaders[i].name = stringtable[i];
 
-    //check if the image needed by current header is
-    //already loaded, if not, load it
+    //check if the image needed by current header already
+    //has a slot, if not, this header loads it
     int effectiveOffset = texHeaders[i].dataOffset + 0x20*i;
     map<long, uint>::iterator it = loadedImages.find(effectiveOffset);
     if(it != loadedImages.end())
       dst.imageHeaders[i].imageIndex = it->second;
     else
     {
-      BmdImage* curr = &dst.images[j];
+      uint j = (uint)firstHeader.size();
       dst.imageHeaders[i].imageIndex = j;
       loadedImages[effectiveOffset] = j;
-      ++j;
-      
-      loadAndConvertImage(f, texHeaders[i],
-                          tex1Offset + h.textureHeaderOffset + 0x20*i, *curr);
+      firstHeader.push_back(i);
+    }
+  }
+
+  //read image data. Every image is decoded into its own slot
+  //and only reads the file, so the images can be decoded in parallel
+  const u8* data = f->data();
+  size_t size = f->size();
+  long headerOffset = tex1Offset + h.textureHeaderOffset;
+  parallelFor((int)firstHeader.size(), numThreads, [&](int j)
+  {
+    MemFile imageFile(data, size); //every task needs its own read position
+    size_t k = firstHeader[j];
+    loadAndConvertImage(&imageFile, texHeaders[k],
+                        headerOffset + 0x20*(long)k, flags, dst.images[j]);
+  });
+
+  if((flags & TEX1_GENERATE_MIPMAPS) != 0)
+  {
+    //small images get one thread each, large ones are done one
+    //after the other with their rows split over all threads
+    bool srgb = (flags & TEX1_SRGB_MIPMAPS) != 0;
+    vector<BmdImage*> smallImages, largeImages;
+    for(size_t j = 0; j < dst.images.size(); ++j)
+    {
+      BmdImage& img = dst.images[j];
+      if(img.width*img.height/4 >= 2*MIN_BAND_PIXELS)
+        largeImages.push_back(&img);
+      else
+        smallImages.push_back(&img);
     }
+
+    parallelFor((int)smallImages.size(), numThreads, [&](int j)
+    {
+      generateMipmaps(*smallImages[j], srgb, 1);
+    });
+    for(size_t j = 0; j < largeImages.size(); ++j)
+      generateMipmaps(*largeImages[j], srgb, numThreads);
   }
 }
 
@@ -347,8 +591,9 @@ int getCompressedBufferSize(u8 format, int w, int h)
   }
 }
 
-u8 getUncompressedBufferFormat(u8 format, u8 paletteFormat)
+u8 getUncompressedBufferFormat(u8 format, u8 paletteFormat, u32 flags)
 {
+  bool compact = (flags & TEX1_COMPACT_FORMATS) != 0;
   switch(format)
   {
     case bmd::I4:
@@ -358,7 +603,9 @@ u8 getUncompressedBufferFormat(u8 format, u8 paletteFormat)
     case bmd::A8_I8: //a8i8 -> i8a8
       return I8_A8;
     case bmd::R5_G6_B5:
+      return compact ? RGB565 : RGBA8;
     case bmd::A3_RGB5:
+      return compact ? RGBA4 : RGBA8;
     case bmd::ARGB8:
       return RGBA8;
 
@@ -370,8 +617,9 @@ u8 getUncompressedBufferFormat(u8 format, u8 paletteFormat)
         case bmd::PAL_A8_I8: //a8i8 -> i8a8
           return I8_A8;
         case bmd::PAL_R5_G6_B5: //r5g6b5 -> rgba8
+          return compact ? RGB565 : RGBA8;
         case bmd::PAL_A3_RGB5: //rgb5a3 -> rgba8
-          return RGBA8;
+          return compact ? RGBA4 : RGBA8;
         default:
           return -1;
       }
@@ -385,16 +633,18 @@ u8 getUncompressedBufferFormat(u8 format, u8 paletteFormat)
 
 //returns how many bytes an image of given format
 //and dimensions needs in memory after uncompression etc
-int getUncompressedBufferSize(u8 format, int w, int h, u8 paletteFormat)
+int getUncompressedBufferSize(u8 format, int w, int h, u8 paletteFormat, u32 flags)
 {
   int w4 = w + (4 - w%4)%4;
   int h4 = h + (4 - h%4)%4;
 
-  switch(getUncompressedBufferFormat(format, paletteFormat))
+  switch(getUncompressedBufferFormat(format, paletteFormat, flags))
   {
     case I8:
       return w*h;
     case I8_A8:
+    case RGB565:
+    case RGBA4:
       return w*h*2;
     case RGBA8:
       return w*h*4;
@@ -494,7 +744,7 @@ void fix4x4(u8* dest, const u8* src, int w, int h)
 void r5g6b5ToRgba8(u16 srcPixel, u8* dest)
 {
   u8 r, g, b;
-  r = (srcPixel & 0xf100) >> 11;
+  r = (srcPixel & 0xf800) >> 11;
   g = (srcPixel & 0x7e0) >> 5;
   b = (srcPixel & 0x1f);
 
@@ -616,6 +866,39 @@ void fixRgb5A3(u8* dest, const u8* src, int w, int h)
           }
 }
 
+//to the b4g4r4a4 layout of RGBA4. rgb5 pixels lose the low bit of
+//each channel, a3 is expanded like in rgb5a3ToRgba8(), so this is
+//the same as rgb5a3ToRgba8() followed by dropping the low 4 bits
+u16 rgb5a3ToRgba4(u16 srcPixel)
+{
+  if((srcPixel & 0x8000) == 0x8000) //rgb5
+    return 0xf000 | ((srcPixel >> 3) & 0xf00) | ((srcPixel >> 2) & 0xf0)
+      | ((srcPixel >> 1) & 0xf);
+
+  //a3rgb4
+  u16 a = (srcPixel & 0x7000) >> 12;
+  a = (a << 1) | (a >> 2);
+  return (a << 12) | (srcPixel & 0xfff);
+}
+
+void fixRgb5A3ToRgba4(u8* dest, const u8* src, int w, int h)
+{
+  //convert to rgba4 during block swapping
+  //4x4 tiles
+  int si = 0;
+  for(int y = 0; y < h; y += 4)
+    for(int x = 0; x < w; x += 4)
+      for(int dy = 0; dy < 4; ++dy)
+        for(int dx = 0; dx < 4; ++dx, si += 2)
+          if(x + dx < w && y + dy < h)
+          {
+            u16 dstPixel = rgb5a3ToRgba4(memWORD(src + si));
+            int di = 2*(w*(y + dy) + x + dx);
+            dest[di + 0] = dstPixel & 0xff;
+            dest[di + 1] = dstPixel >> 8;
+          }
+}
+
 void s3tc1ReverseByte(u8& b)
 {
   u8 b1 = b & 0x3;
@@ -649,15 +932,16 @@ void fixS3TC1(u8* dest, const u8* src, int w, int h)
   }
 }
 
-int getUnpackedPixSize(u8 paletteFormat)
+int getUnpackedPixSize(u8 paletteFormat, u32 flags)
 {
-  if(paletteFormat == bmd::PAL_A8_I8)
+  if(paletteFormat == bmd::PAL_A8_I8 || (flags & TEX1_COMPACT_FORMATS) != 0)
     return 2;
   return 4;
 }
 
-void unpackPixel(int index, u8* dest, const u8* palette, u8 paletteFormat)
+void unpackPixel(int index, u8* dest, const u8* palette, u8 paletteFormat, u32 flags)
 {
+  bool compact = (flags & TEX1_COMPACT_FORMATS) != 0;
   switch(paletteFormat)
   {
     case bmd::PAL_A8_I8: //a8i8 -> i8a8
@@ -665,79 +949,144 @@ void unpackPixel(int index, u8* dest, const u8* palette, u8 paletteFormat)
       dest[1] = palette[2*index + 0];
       break;
 
-    case bmd::PAL_R5_G6_B5: //r5g6b5 -> rgba8
-      r5g6b5ToRgba8(memWORD(palette + 2*index), dest);
+    case bmd::PAL_R5_G6_B5: //r5g6b5 -> rgba8 (rgb565)
+      if(compact)
+      {
+        dest[0] = palette[2*index + 1];
+        dest[1] = palette[2*index + 0];
+      }
+      else
+        r5g6b5ToRgba8(memWORD(palette + 2*index), dest);
       break;
       
-    case bmd::PAL_A3_RGB5: //rgb5a3 -> rgba8
-      rgb5a3ToRgba8(memWORD(palette + 2*index), dest);
+    case bmd::PAL_A3_RGB5: //rgb5a3 -> rgba8 (rgba4)
+      if(compact)
+      {
+        u16 pixel = rgb5a3ToRgba4(memWORD(palette + 2*index));
+        dest[0] = pixel & 0xff;
+        dest[1] = pixel >> 8;
+      }
+      else
+        rgb5a3ToRgba8(memWORD(palette + 2*index), dest);
       break;
   }
 }
 
-void unpack8(u8* dst, const u8* src, int w, int h,
-             const u8* palette, u8 paletteFormat)
+//Palettized images are expanded through a table that holds every
+//possible index already converted to the output format, so every
+//pixel is a single copy instead of a format conversion. Indices
+//past the end of the palette map to zeros instead of reading past it.
+int getPaletteLutEntries(u8 format)
 {
-  int pixSize = getUnpackedPixSize(paletteFormat);
-  u8* runner = dst;
+  switch(format)
+  {
+    case bmd::INDEX4: return 16;
+    case bmd::INDEX8: return 256;
+    default: return 0x4000; //index14
+  }
+}
 
-  for(int y = 0; y < h; ++y)
-    for(int x = 0; x < w; ++x, runner += pixSize)
-      unpackPixel(src[y*w + x], runner, palette, paletteFormat);
+void decodePalette(const u8* palette, int numEntries, u8 format, u8 paletteFormat,
+                   u32 flags, vector<u8>& lut)
+{
+  int lutEntries = getPaletteLutEntries(format);
+  int pixSize = getUnpackedPixSize(paletteFormat, flags);
+  lut.assign(lutEntries*pixSize, 0);
+  for(int i = 0; i < numEntries && i < lutEntries; ++i)
+    unpackPixel(i, &lut[i*pixSize], palette, paletteFormat, flags);
 }
 
-void unpack16(u8* dst, const u8* src, int w, int h,
-              const u8* palette, u8 paletteFormat)
+void unpack8(u8* dst, const u8* src, int w, int h,
+             const u8* lut, int lutEntries, int pixSize)
 {
-  int pixSize = getUnpackedPixSize(paletteFormat);
-  u8* runner = dst;
+  if(unpack8Simd(dst, src, w*h, lut, lutEntries, pixSize))
+    return;
+
+  if(pixSize == 4)
+    for(int i = 0; i < w*h; ++i)
+      memcpy(dst + 4*i, lut + 4*src[i], 4);
+  else
+    for(int i = 0; i < w*h; ++i)
+      memcpy(dst + 2*i, lut + 2*src[i], 2);
+}
 
-  for(int y = 0; y < h; ++y)
-    for(int x = 0; x < w; ++x, runner += pixSize)
-    {
-      //fix4x4() swaps words to little endian...
-      u16 index = memWORD_le(src + 2*(y*w + x));
-      unpackPixel(index & 0x3fff, runner, palette, paletteFormat);
-    }
+void unpack16(u8* dst, const u8* src, int w, int h,
+              const u8* lut, int pixSize)
+{
+  if(unpack16Simd(dst, src, w*h, lut, pixSize))
+    return;
+
+  //fix4x4() swaps words to little endian...
+  if(pixSize == 4)
+    for(int i = 0; i < w*h; ++i)
+      memcpy(dst + 4*i, lut + 4*(memWORD_le(src + 2*i) & 0x3fff), 4);
+  else
+    for(int i = 0; i < w*h; ++i)
+      memcpy(dst + 2*i, lut + 2*(memWORD_le(src + 2*i) & 0x3fff), 2);
 }
 
-//returns new format
-u8 readImage(FILE* f, int w, int h, u8 format, u8* palette, u8 paletteFormat, u8* dest)
+//returns new format. lut is the palette of palettized images, see
+//decodePalette(). If indices is not NULL, the untiled palette indices
+//of palettized images are stored there, one u8 per pixel (u16 for index14).
+u8 readImage(MemFile* f, int w, int h, u8 format, const u8* lut, u8 paletteFormat,
+             u32 flags, u8* dest, u8* indices)
 {
+  bool compact = (flags & TEX1_COMPACT_FORMATS) != 0;
+
+  //use the image data in place if it is completely inside the file
   int srcBufferSize = getCompressedBufferSize(format, w, h);
-  vector<u8> srcVec(srcBufferSize);
-  u8* src = &srcVec[0];
-  fread(src, 1, srcBufferSize, f);
+  vector<u8> srcVec;
+  const u8* src = f->readPtr(max(srcBufferSize, 0), srcVec);
 
   //do format conversions, unpack blocks
   switch(format)
   {
     case bmd::I4: //i4 -> i8
-      fix8x8Expand(dest, src, w, h);
+      if(!fix8x8ExpandSimd(dest, src, w, h))
+        fix8x8Expand(dest, src, w, h);
       return I8;
 
     case bmd::I8: //i8
-      fix8x4(dest, src, w, h);
+      if(!fix8x4Simd(dest, src, w, h))
+        fix8x4(dest, src, w, h);
       return I8;
 
     case bmd::A4_I4: //i4a4 -> i8a8
-      fix8x4Expand(dest, src, w, h);
+      if(!fix8x4ExpandSimd(dest, src, w, h))
+        fix8x4Expand(dest, src, w, h);
       return I8_A8;
 
     case bmd::A8_I8: //i8a8
-      fix4x4(dest, src, w, h);
+      if(!fix4x4Simd(dest, src, w, h))
+        fix4x4(dest, src, w, h);
       return I8_A8;
 
     case bmd::R5_G6_B5: //r5g6b5 -> rgba8
-      fixR5G6B5(dest, src, w, h);
+      if(compact)
+      {
+        //only the byte order differs from rgb565
+        if(!fix4x4Simd(dest, src, w, h))
+          fix4x4(dest, src, w, h);
+        return RGB565;
+      }
+      if(!fixR5G6B5Simd(dest, src, w, h))
+        fixR5G6B5(dest, src, w, h);
       return RGBA8;
 
     case bmd::A3_RGB5: //rgb5a3 -> rgba8
-      fixRgb5A3(dest, src, w, h);
+      if(compact)
+      {
+        if(!fixRgb5A3ToRgba4Simd(dest, src, w, h))
+          fixRgb5A3ToRgba4(dest, src, w, h);
+        return RGBA4;
+      }
+      if(!fixRgb5A3Simd(dest, src, w, h))
+        fixRgb5A3(dest, src, w, h);
       return RGBA8;
 
     case bmd::ARGB8: //argb8 -> rgba8
-      fixRGBA8(dest, src, w, h);
+      if(!fixRGBA8Simd(dest, src, w, h))
+        fixRGBA8(dest, src, w, h);
       return RGBA8;
 
 
@@ -749,32 +1098,38 @@ u8 readImage(FILE* f, int w, int h, u8 format, u8* palette, u8 paletteFormat, u8
       //(*2 for expaned i4->i8 case)
       vector<u8> tmpVec(2*srcBufferSize);
       u8* tmp = &tmpVec[0];
+      int pixSize = getUnpackedPixSize(paletteFormat, flags);
 
       switch(format)
       {
         case bmd::INDEX4:
-          fix8x8NoExpand(tmp, src, w, h);
-          unpack8(dest, tmp, w, h, palette, paletteFormat);
+          if(!fix8x8NoExpandSimd(tmp, src, w, h))
+            fix8x8NoExpand(tmp, src, w, h);
+          unpack8(dest, tmp, w, h, lut, 16, pixSize);
           break;
 
         case bmd::INDEX8:
-          fix8x4(tmp, src, w, h);
-          unpack8(dest, tmp, w, h, palette, paletteFormat);
+          if(!fix8x4Simd(tmp, src, w, h))
+            fix8x4(tmp, src, w, h);
+          unpack8(dest, tmp, w, h, lut, 256, pixSize);
           break;
 
         case bmd::INDEX14_X2:
-          fix4x4(tmp, src, w, h);
-          unpack16(dest, tmp, w, h, palette, paletteFormat);
+          if(!fix4x4Simd(tmp, src, w, h))
+            fix4x4(tmp, src, w, h);
+          unpack16(dest, tmp, w, h, lut, pixSize);
           break;
       }
 
+      if(indices != NULL)
+        memcpy(indices, tmp, w*h*(format == bmd::INDEX14_X2 ? 2 : 1));
+
       switch(paletteFormat)
       {
         case bmd::PAL_A8_I8:
-          return I8_A8;
         case bmd::PAL_R5_G6_B5:
         case bmd::PAL_A3_RGB5:
-          return RGBA8;
+          return getUncompressedBufferFormat(format, paletteFormat, flags);
         default:
           warn("tex1: unsupported palette format %d", paletteFormat);
           return 0xff; //TODO: ?
@@ -783,7 +1138,8 @@ u8 readImage(FILE* f, int w, int h, u8 format, u8* palette, u8 paletteFormat, u8
 
 
     case bmd::S3TC1:
-      fixS3TC1(dest, src, w, h);
+      if(!fixS3TC1Simd(dest, src, w, h))
+        fixS3TC1(dest, src, w, h);
       return DXT1;
 
     default:
@@ -792,8 +1148,8 @@ u8 readImage(FILE* f, int w, int h, u8 format, u8* palette, u8 paletteFormat, u8
   }
 }
 
-void loadAndConvertImage(FILE* f, const bmd::TextureHeader& h, long baseOffset,
-                         BmdImage& curr)
+void loadAndConvertImage(MemFile* f, const bmd::TextureHeader& h, long baseOffset,
+                         u32 flags, BmdImage& curr)
 {
   int i;
 
@@ -812,27 +1168,50 @@ void loadAndConvertImage(FILE* f, const bmd::TextureHeader& h, long baseOffset,
   {
     //read palette
     palette.resize(h.paletteNumEntries*2);
-    fseek(f, baseOffset + h.paletteOffset, SEEK_SET);
-    fread(&palette[0], 2, h.paletteNumEntries, f);
+    f->seek(baseOffset + h.paletteOffset);
+    f->read(&palette[0], 2*h.paletteNumEntries);
   }
 
+  //decode the palette once for all mipmaps
+  bool palettized = h.format == bmd::INDEX4 || h.format == bmd::INDEX8
+    || h.format == bmd::INDEX14_X2;
+  vector<u8> lut;
+  if(palettized)
+    decodePalette(palette.data(), h.paletteNumEntries, h.format, h.paletteFormat, flags,
+                  lut);
+
+  bool keepIndices = palettized && (flags & TEX1_KEEP_PALETTE) != 0;
+  int indexSize = h.format == bmd::INDEX14_X2 ? 2 : 1;
+
   //calculate required image size
-  int totalRequiredSize = 0;
+  int totalRequiredSize = 0, totalIndexSize = 0;
   int wid = h.width, hyt = h.height;
   for(i = 0; i < h.mipmapCount; ++i)
   {
-    totalRequiredSize += getUncompressedBufferSize(h.format, wid, hyt, h.paletteFormat);
+    totalRequiredSize += getUncompressedBufferSize(h.format, wid, hyt, h.paletteFormat, flags);
+    totalIndexSize += wid*hyt*indexSize;
     wid /= 2; hyt /= 2;
   }
 
+  curr.indices.clear();
+  curr.palette.clear();
+  if(keepIndices)
+  {
+    curr.indices.resize(totalIndexSize);
+    int numEntries = min((int)h.paletteNumEntries, getPaletteLutEntries(h.format));
+    curr.palette.assign(lut.begin(),
+      lut.begin() + numEntries*getUnpackedPixSize(h.paletteFormat, flags));
+  }
+
   //get memory for image, set mipmap pointers and load image
 
   if(h.dataOffset == 0) //TODO: twilight princess does that
     warn("What to do, what to do? (data offset in image is 0)\n");
 
-  fseek(f, baseOffset + h.dataOffset, SEEK_SET);
+  f->seek(baseOffset + h.dataOffset);
   curr.imageData.resize(totalRequiredSize);
   totalRequiredSize = 0;
+  totalIndexSize = 0;
   wid = h.width; hyt = h.height;
   curr.mipmaps.resize(h.mipmapCount);
   curr.sizes.resize(h.mipmapCount);
@@ -841,17 +1220,18 @@ void loadAndConvertImage(FILE* f, const bmd::TextureHeader& h, long baseOffset,
     curr.mipmaps[i] = &curr.imageData[totalRequiredSize];
 
     curr.sizes[i] = 
-      getUncompressedBufferSize(h.format, wid, hyt, h.paletteFormat);
+      getUncompressedBufferSize(h.format, wid, hyt, h.paletteFormat, flags);
  
     //read image
     if(h.dataOffset != 0)
       curr.format = readImage(f, wid, hyt, h.format,
-        palette.data(), h.paletteFormat, curr.mipmaps[i]);
+        lut.data(), h.paletteFormat, flags, curr.mipmaps[i],
+        keepIndices ? &curr.indices[totalIndexSize] : NULL);
     else
     {
       //this texture is probably rendered at runtime. for now, fill it with
       //white
-      curr.format = getUncompressedBufferFormat(h.format, h.paletteFormat);
+      curr.format = getUncompressedBufferFormat(h.format, h.paletteFormat, flags);
       if(curr.format != DXT1)
         memset(curr.mipmaps[i], 0xff, curr.sizes[i]);
       else
@@ -863,21 +1243,23 @@ void loadAndConvertImage(FILE* f, const bmd::TextureHeader& h, long baseOffset,
       }
     }
 
-    totalRequiredSize += getUncompressedBufferSize(h.format, wid, hyt, h.paletteFormat);
+    totalRequiredSize += getUncompressedBufferSize(h.format, wid, hyt, h.paletteFormat, flags);
+    totalIndexSize += wid*hyt*indexSize;
     wid /= 2; hyt /= 2;
   }
   
   curr.originalFormat = h.format;
   curr.paletteFormat = h.paletteFormat;
+  curr.generatedMipmaps = false;
 }
 
-void writeTex1Info(FILE* f, ostream& out)
+void writeTex1Info(MemFile* f, ostream& out)
 {
   out << string(50, '/') << endl
       << "//Tex1 section" << endl
       << string(50, '/') << endl << endl;
 
-  int tex1Offset = ftell(f), i;
+  int tex1Offset = f->tell(), i;
 
   //read tex1 header
   bmd::Tex1Header h;
@@ -892,7 +1274,7 @@ void writeTex1Info(FILE* f, ostream& out)
 
   //image headers
   out << endl << "Image headers" << endl;
-  fseek(f, tex1Offset + h.textureHeaderOffset, SEEK_SET);
+  f->seek(tex1Offset + h.textureHeaderOffset);
   for(i = 0; i < h.numImages; ++i)
   {
     bmd::TextureHeader texHead;
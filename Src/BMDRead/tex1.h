@@ -45,6 +45,9 @@ struct ImageHeader
 
 const int I8 = 1;
 const int I8_A8 = 3;
+const int RGB565 = 4; //only with TEX1_COMPACT_FORMATS, little endian u16
+const int RGBA4 = 5;  //only with TEX1_COMPACT_FORMATS, u16 with a in the
+                      //top 4 bits, then r, g, b (d3d's b4g4r4a4)
 const int RGBA8 = 6;
 const int DXT1 = 14;
 
@@ -57,15 +60,29 @@ struct BmdImage
   std::vector<int> sizes; //image data size for each mipmap
   std::vector<u8> imageData;
 
+  //only filled for palettized images loaded with TEX1_KEEP_PALETTE:
+  //the untiled palette indices of all mipmaps after each other, one
+  //u8 per pixel (u16 for index14), and the palette decoded to
+  //format (i8a8, rgba8, rgb565 or rgba4), so that the renderer can keep the
+  //texture palettized
+  std::vector<u8> indices;
+  std::vector<u8> palette;
+
   //NOTE: palettized images are converted
   //to non-palettized images during load time,
   //i4 is converted to i8, a4i4 and a8i8 is converted to i8a8.
   //r5g5b5a3 and r5g6b5 are converted to rgba8.
   //(that is, only formats 1 (i8), 3* (i8a8), 6 (rgba8)
   //and 14 (dxt1) are used after conversion)
+  //With TEX1_COMPACT_FORMATS r5g6b5 stays rgb565 (4) and
+  //r5g5b5a3 becomes rgba4 (5) instead, palettes too.
     
   int originalFormat, paletteFormat;
 
+  //true if the mipmaps past the first were made by
+  //generateMipmaps() and not loaded from the file
+  bool generatedMipmaps;
+
   Json::Value serialize(uint ID)
   {
 	  Json::Value val;
@@ -114,7 +131,45 @@ struct Tex1
 
 void uploadImagesToGl(Tex1& tex1);
 
-void dumpTex1(FILE* f, Tex1& dst);
-void writeTex1Info(FILE* f, std::ostream& out);
+//flags for dumpTex1()
+enum Tex1Flags
+{
+  //keep the palette indices of palettized images in addition
+  //to the expanded image (see BmdImage::indices)
+  TEX1_KEEP_PALETTE = 1 << 0,
+
+  //convert r5g6b5 and r5g5b5a3 images and palettes to 16 bit
+  //formats (RGB565, RGBA4) instead of rgba8. Halves their memory,
+  //but opaque r5g5b5a3 pixels lose the low bit of each channel
+  TEX1_COMPACT_FORMATS = 1 << 1,
+
+  //generate a full mipmap chain for power of two images that only
+  //have one level, see generateMipmaps()
+  TEX1_GENERATE_MIPMAPS = 1 << 2,
+
+  //with TEX1_GENERATE_MIPMAPS, average the colors in linear space
+  TEX1_SRGB_MIPMAPS = 1 << 3
+};
+
+//With numThreads != 1 the images are decoded in parallel on up to
+//that many threads (0: one per core), the result is the same as
+//with a single thread.
+void dumpTex1(MemFile* f, Tex1& dst, int numThreads = 1, u32 flags = 0);
+void writeTex1Info(MemFile* f, std::ostream& out);
+
+//Adds the missing levels down to 1x1 to an I8, I8_A8, RGBA8, RGB565 or
+//RGBA4 image with power of two sides and a single mipmap, with a 2x2 box
+//filter. With srgb the color channels are averaged in linear space, alpha
+//and intensities never are. Levels with many rows are split over up to
+//numThreads threads (0: one per core). Returns false and leaves the image
+//alone if it can't do that.
+bool generateMipmaps(BmdImage& img, bool srgb, int numThreads = 1);
+
+//Decodes a w*h dxt1 image (blocks in row order, as in BmdImage::imageData
+//of DXT1 images) to rgba8. Meant for cpu side previews of the textures.
+//The second version splits the block rows over up to numThreads threads
+//(0: one per core), the output is the same.
+void decompressDxt1(u8* dest, const u8* src, int w, int h);
+void decompressDxt1(u8* dest, const u8* src, int w, int h, int numThreads);
 
 #endif //BMD_TEX1_H
@@ -0,0 +1,962 @@
+#include "tex1simd.h"
+
+#include <string.h>
+#include <algorithm>
+
+//SSE2 is part of x64 and the default for 32 bit msvc builds
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TEX1_SSE2 1
+#include <emmintrin.h>
+#endif
+
+//AVX2 is only used after checking the cpu at runtime. msvc compiles
+//AVX2 intrinsics in any function, gcc and clang only in functions
+//that are marked for it.
+#if TEX1_SSE2 && (defined(_MSC_VER) || defined(__GNUC__))
+#define TEX1_AVX2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_FUNC
+#else
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+#endif
+
+Tex1SimdLevel detectTex1SimdLevel()
+{
+#if TEX1_AVX2 && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if(info[0] >= 7)
+  {
+    //the os has to save the ymm registers as well
+    __cpuid(info, 1);
+    bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0
+      && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    if(avx && (info[1] & (1 << 5)) != 0)
+      return TEX1_SIMD_AVX2;
+  }
+  return TEX1_SIMD_SSE2;
+#elif TEX1_AVX2
+  __builtin_cpu_init(); //this runs before the static constructors are done
+  return __builtin_cpu_supports("avx2") ? TEX1_SIMD_AVX2 : TEX1_SIMD_SSE2;
+#elif TEX1_SSE2
+  return TEX1_SIMD_SSE2;
+#else
+  return TEX1_SIMD_NONE;
+#endif
+}
+
+static const Tex1SimdLevel s_maxLevel = detectTex1SimdLevel();
+static Tex1SimdLevel s_level = s_maxLevel;
+
+Tex1SimdLevel maxTex1SimdLevel()
+{
+  return s_maxLevel;
+}
+
+void setTex1SimdLevel(Tex1SimdLevel level)
+{
+  s_level = level < s_maxLevel ? level : s_maxLevel;
+}
+
+Tex1SimdLevel getTex1SimdLevel()
+{
+  return s_level;
+}
+
+#if TEX1_SSE2
+
+//All tiles are stored row by row, so a 16 byte load gets two
+//rows of a 4x4 tile with 16 bit pixels, four rows of an 8x4
+//tile with 4 bit pixels and so on. The unpack instructions
+//then interleave the bytes or pixels into image order.
+
+inline __m128i load128(const u8* p)
+{ return _mm_loadu_si128((const __m128i*)p); }
+
+inline void store128(u8* p, __m128i v)
+{ _mm_storeu_si128((__m128i*)p, v); }
+
+//stores the low 8 bytes to row, the high 8 bytes to the next row
+inline void storeRows64(u8* row, int stride, __m128i v)
+{
+  _mm_storel_epi64((__m128i*)row, v);
+  _mm_storel_epi64((__m128i*)(row + stride), _mm_unpackhi_epi64(v, v));
+}
+
+//big endian u16 to little endian
+inline __m128i swap16(__m128i v)
+{ return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)); }
+
+//Both nibbles of every byte, expanded to 8 bits (x -> x*0x11).
+//16 bit shifts are fine, the masks drop the bits that cross bytes.
+inline __m128i highNibbles(__m128i v)
+{
+  __m128i t = _mm_and_si128(v, _mm_set1_epi8((char)0xf0));
+  return _mm_or_si128(t, _mm_srli_epi16(t, 4));
+}
+
+inline __m128i lowNibbles(__m128i v)
+{
+  __m128i t = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+  return _mm_or_si128(t, _mm_slli_epi16(t, 4));
+}
+
+//expands the n bit values in the 16 bit lanes of v to 8 bits by
+//repeating the high bits, like the scalar code
+inline __m128i expand5(__m128i v)
+{ return _mm_or_si128(_mm_slli_epi16(v, 3), _mm_srli_epi16(v, 2)); }
+
+inline __m128i expand6(__m128i v)
+{ return _mm_or_si128(_mm_slli_epi16(v, 2), _mm_srli_epi16(v, 4)); }
+
+inline __m128i expand4(__m128i v)
+{ return _mm_or_si128(_mm_slli_epi16(v, 4), v); }
+
+inline __m128i expand3(__m128i v)
+{
+  return _mm_or_si128(_mm_or_si128(_mm_slli_epi16(v, 5), _mm_slli_epi16(v, 2)),
+                      _mm_srli_epi16(v, 1));
+}
+
+//rg holds r | g << 8 and ba b | a << 8 for 8 pixels of two tile rows,
+//stores them as rgba8 to row and the next row
+inline void storeRgba(u8* row, int stride, __m128i rg, __m128i ba)
+{
+  store128(row, _mm_unpacklo_epi16(rg, ba));
+  store128(row + stride, _mm_unpackhi_epi16(rg, ba));
+}
+
+//8 native endian r5g6b5 pixels to r | g << 8 and b | a << 8
+inline void r5g6b5Sse2(__m128i p, __m128i& rg, __m128i& ba)
+{
+  __m128i mask5 = _mm_set1_epi16(0x1f), mask6 = _mm_set1_epi16(0x3f);
+  __m128i r = expand5(_mm_srli_epi16(p, 11));
+  __m128i g = expand6(_mm_and_si128(_mm_srli_epi16(p, 5), mask6));
+  __m128i b = expand5(_mm_and_si128(p, mask5));
+  rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+  ba = _mm_or_si128(b, _mm_set1_epi16((short)0xff00));
+}
+
+//8 native endian rgb5a3 pixels to r | g << 8 and b | a << 8. Both
+//encodings are computed, the top bit of every pixel selects one
+inline void rgb5a3Sse2(__m128i p, __m128i& rg, __m128i& ba)
+{
+  __m128i mask5 = _mm_set1_epi16(0x1f), mask4 = _mm_set1_epi16(0xf);
+  __m128i opaque = _mm_srai_epi16(p, 15);
+
+  //rgb5, a = 0xff
+  __m128i r5 = expand5(_mm_and_si128(_mm_srli_epi16(p, 10), mask5));
+  __m128i g5 = expand5(_mm_and_si128(_mm_srli_epi16(p, 5), mask5));
+  __m128i b5 = expand5(_mm_and_si128(p, mask5));
+  __m128i rg5 = _mm_or_si128(r5, _mm_slli_epi16(g5, 8));
+  __m128i ba5 = _mm_or_si128(b5, _mm_set1_epi16((short)0xff00));
+
+  //a3rgb4
+  __m128i a3 = expand3(_mm_and_si128(_mm_srli_epi16(p, 12), _mm_set1_epi16(7)));
+  __m128i r4 = expand4(_mm_and_si128(_mm_srli_epi16(p, 8), mask4));
+  __m128i g4 = expand4(_mm_and_si128(_mm_srli_epi16(p, 4), mask4));
+  __m128i b4 = expand4(_mm_and_si128(p, mask4));
+  __m128i rg4 = _mm_or_si128(r4, _mm_slli_epi16(g4, 8));
+  __m128i ba4 = _mm_or_si128(b4, _mm_slli_epi16(a3, 8));
+
+  rg = _mm_or_si128(_mm_and_si128(opaque, rg5), _mm_andnot_si128(opaque, rg4));
+  ba = _mm_or_si128(_mm_and_si128(opaque, ba5), _mm_andnot_si128(opaque, ba4));
+}
+
+//8 native endian rgb5a3 pixels to b4g4r4a4 (see rgb5a3ToRgba4() in
+//tex1.cpp): rgb5 drops the low bit of each channel, a3 gets expanded
+inline __m128i rgb5a3ToRgba4Sse2(__m128i p)
+{
+  __m128i opaque = _mm_srai_epi16(p, 15);
+
+  //rgb5, a = 0xf
+  __m128i c5 = _mm_or_si128(_mm_or_si128(
+    _mm_and_si128(_mm_srli_epi16(p, 3), _mm_set1_epi16(0x0f00)),
+    _mm_and_si128(_mm_srli_epi16(p, 2), _mm_set1_epi16(0x00f0))),
+    _mm_and_si128(_mm_srli_epi16(p, 1), _mm_set1_epi16(0x000f)));
+  c5 = _mm_or_si128(c5, _mm_set1_epi16((short)0xf000));
+
+  //a3rgb4
+  __m128i a4 = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(p, 1), _mm_set1_epi16((short)0xe000)),
+                            _mm_and_si128(_mm_srli_epi16(p, 2), _mm_set1_epi16(0x1000)));
+  __m128i c4 = _mm_or_si128(a4, _mm_and_si128(p, _mm_set1_epi16(0x0fff)));
+
+  return _mm_or_si128(_mm_and_si128(opaque, c5), _mm_andnot_si128(opaque, c4));
+}
+
+//8 pixels from the ar and gb halves of an argb8 tile
+//to r | g << 8 and b | a << 8
+inline void argb8Sse2(__m128i ar, __m128i gb, __m128i& rg, __m128i& ba)
+{
+  rg = _mm_or_si128(_mm_srli_epi16(ar, 8), _mm_slli_epi16(gb, 8));
+  ba = _mm_or_si128(_mm_srli_epi16(gb, 8), _mm_slli_epi16(ar, 8));
+}
+
+//swaps the color bytes and reverses the order of the 2 bit
+//indices of two gamecube cmpr blocks, see fixS3TC1()
+inline __m128i s3tc1BlocksSse2(__m128i v)
+{
+  __m128i m33 = _mm_set1_epi8(0x33), m0f = _mm_set1_epi8(0x0f);
+  __m128i t = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, m33), 2),
+                           _mm_and_si128(_mm_srli_epi16(v, 2), m33));
+  t = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(t, m0f), 4),
+                   _mm_and_si128(_mm_srli_epi16(t, 4), m0f));
+
+  __m128i colors = _mm_set_epi32(0, -1, 0, -1);
+  return _mm_or_si128(_mm_and_si128(colors, swap16(v)), _mm_andnot_si128(colors, t));
+}
+
+inline __m128i selectBits(__m128i mask, __m128i a, __m128i b)
+{ return _mm_xor_si128(b, _mm_and_si128(mask, _mm_xor_si128(a, b))); }
+
+//The colors of the (up to) 4 dxt1 blocks at src, one block per 32 bit
+//lane, as in dxt1ColorTable() in tex1.cpp. pal[i] gets the 4 rgba8
+//colors of block i and bits[i] its indices. Blocks past count are
+//read from a zeroed copy.
+inline void dxt1ColorTablesSse2(const u8* src, int count, __m128i pal[4], u32 bits[4])
+{
+  u8 padded[32];
+  if(count < 4)
+  {
+    memset(padded, 0, sizeof(padded));
+    memcpy(padded, src, 8*count);
+    src = padded;
+  }
+
+  //color words and index dwords of the blocks
+  __m128 b01 = _mm_castsi128_ps(load128(src)), b23 = _mm_castsi128_ps(load128(src + 16));
+  __m128i colors = _mm_castps_si128(_mm_shuffle_ps(b01, b23, _MM_SHUFFLE(2, 0, 2, 0)));
+  store128((u8*)bits, _mm_castps_si128(_mm_shuffle_ps(b01, b23, _MM_SHUFFLE(3, 1, 3, 1))));
+
+  __m128i color1 = _mm_and_si128(colors, _mm_set1_epi32(0xffff));
+  __m128i color2 = _mm_srli_epi32(colors, 16);
+  __m128i fourColors = _mm_cmpgt_epi32(color1, color2);
+
+  //the upper 16 bits of every lane stay 0, so the 16 bit
+  //expand and multiply work on the 32 bit lanes
+  __m128i mask5 = _mm_set1_epi32(0x1f), mask6 = _mm_set1_epi32(0x3f);
+  __m128i one = _mm_set1_epi32(1), third = _mm_set1_epi32(0x5556);
+  __m128i c0[3] = { expand5(_mm_srli_epi32(color1, 11)),
+                    expand6(_mm_and_si128(_mm_srli_epi32(color1, 5), mask6)),
+                    expand5(_mm_and_si128(color1, mask5)) };
+  __m128i c1[3] = { expand5(_mm_srli_epi32(color2, 11)),
+                    expand6(_mm_and_si128(_mm_srli_epi32(color2, 5), mask6)),
+                    expand5(_mm_and_si128(color2, mask5)) };
+
+  __m128i alpha = _mm_set1_epi32((int)0xff000000);
+  __m128i p0 = alpha, p1 = alpha, p2 = alpha, p3 = _mm_and_si128(fourColors, alpha);
+  for(int i = 0; i < 3; ++i)
+  {
+    __m128i a = c0[i], b = c1[i];
+    __m128i twoThirds = _mm_mulhi_epu16(_mm_add_epi32(_mm_add_epi32(a, a), _mm_add_epi32(b, one)), third);
+    __m128i oneThird = _mm_mulhi_epu16(_mm_add_epi32(_mm_add_epi32(b, b), _mm_add_epi32(a, one)), third);
+    __m128i half = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(a, b), one), 1);
+
+    p0 = _mm_or_si128(p0, _mm_slli_epi32(a, 8*i));
+    p1 = _mm_or_si128(p1, _mm_slli_epi32(b, 8*i));
+    p2 = _mm_or_si128(p2, _mm_slli_epi32(selectBits(fourColors, twoThirds, half), 8*i));
+    p3 = _mm_or_si128(p3, _mm_slli_epi32(oneThird, 8*i));
+  }
+
+  //transpose to one table per block
+  __m128i t0 = _mm_unpacklo_epi32(p0, p1), t1 = _mm_unpacklo_epi32(p2, p3);
+  __m128i t2 = _mm_unpackhi_epi32(p0, p1), t3 = _mm_unpackhi_epi32(p2, p3);
+  pal[0] = _mm_unpacklo_epi64(t0, t1);
+  pal[1] = _mm_unpackhi_epi64(t0, t1);
+  pal[2] = _mm_unpacklo_epi64(t2, t3);
+  pal[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+//decodes a dxt1 block with color table pal and indices bits
+inline void dxt1BlockSse2(u8* dest, int stride, __m128i pal, u32 bits)
+{
+  __m128i p0 = _mm_shuffle_epi32(pal, 0x00), p1 = _mm_shuffle_epi32(pal, 0x55);
+  __m128i p2 = _mm_shuffle_epi32(pal, 0xaa), p3 = _mm_shuffle_epi32(pal, 0xff);
+  __m128i index1 = _mm_set_epi32(0x40, 0x10, 0x04, 0x01);
+  __m128i index2 = _mm_add_epi32(index1, index1);
+  __m128i index3 = _mm_add_epi32(index1, index2);
+
+  //the indices of a row are in the low byte of bits,
+  //one pixel per lane after masking
+  __m128i rowBits = _mm_set1_epi32(bits);
+  for(int y = 0; y < 4; ++y, dest += stride, rowBits = _mm_srli_epi32(rowBits, 8))
+  {
+    __m128i index = _mm_and_si128(rowBits, index3);
+    __m128i pixels = selectBits(_mm_cmpeq_epi32(index, index1), p1, p0);
+    pixels = selectBits(_mm_cmpeq_epi32(index, index2), p2, pixels);
+    pixels = selectBits(_mm_cmpeq_epi32(index, index3), p3, pixels);
+    store128(dest, pixels);
+  }
+}
+
+//2x2 box filter of 16 bytes of two image rows with pixSize byte pixels,
+//returns the 8 resulting bytes in the low half
+inline __m128i halve16Sse2(__m128i row0, __m128i row1, int pixSize)
+{
+  //vertical sums of all channels as u16
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+  __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(row0, zero), _mm_unpackhi_epi8(row1, zero));
+
+  //then add neighboring pixels (64, 32 or 16 bit parts of lo and hi)
+  __m128i sum;
+  if(pixSize == 4)
+    sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+  else if(pixSize == 2)
+  {
+    __m128 l = _mm_castsi128_ps(lo), h = _mm_castsi128_ps(hi);
+    sum = _mm_add_epi16(_mm_castps_si128(_mm_shuffle_ps(l, h, _MM_SHUFFLE(2, 0, 2, 0))),
+                        _mm_castps_si128(_mm_shuffle_ps(l, h, _MM_SHUFFLE(3, 1, 3, 1))));
+  }
+  else
+  {
+    __m128i ones = _mm_set1_epi16(1);
+    sum = _mm_packs_epi32(_mm_madd_epi16(lo, ones), _mm_madd_epi16(hi, ones));
+  }
+
+  sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+  return _mm_packus_epi16(sum, sum);
+}
+
+#if TEX1_AVX2
+
+//Two horizontally adjacent 4x4 tiles at once. After loading the
+//first two rows of both tiles into the two 128 bit lanes, the
+//(lane local) unpacks leave complete 8 pixel image rows.
+
+AVX2_FUNC inline __m256i load256(const u8* p)
+{ return _mm256_loadu_si256((const __m256i*)p); }
+
+//rows 0-1 and rows 2-3 of the 32 byte tiles at a and b
+AVX2_FUNC inline void loadTilePair(const u8* a, const u8* b, __m256i& rows01, __m256i& rows23)
+{
+  __m256i ta = load256(a), tb = load256(b);
+  rows01 = _mm256_permute2x128_si256(ta, tb, 0x20);
+  rows23 = _mm256_permute2x128_si256(ta, tb, 0x31);
+}
+
+AVX2_FUNC inline __m256i swap16(__m256i v)
+{ return _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8)); }
+
+AVX2_FUNC inline __m256i expand5(__m256i v)
+{ return _mm256_or_si256(_mm256_slli_epi16(v, 3), _mm256_srli_epi16(v, 2)); }
+
+AVX2_FUNC inline __m256i expand6(__m256i v)
+{ return _mm256_or_si256(_mm256_slli_epi16(v, 2), _mm256_srli_epi16(v, 4)); }
+
+AVX2_FUNC inline __m256i expand4(__m256i v)
+{ return _mm256_or_si256(_mm256_slli_epi16(v, 4), v); }
+
+AVX2_FUNC inline __m256i expand3(__m256i v)
+{
+  return _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(v, 5), _mm256_slli_epi16(v, 2)),
+                         _mm256_srli_epi16(v, 1));
+}
+
+AVX2_FUNC inline void storeRgba(u8* row, int stride, __m256i rg, __m256i ba)
+{
+  _mm256_storeu_si256((__m256i*)row, _mm256_unpacklo_epi16(rg, ba));
+  _mm256_storeu_si256((__m256i*)(row + stride), _mm256_unpackhi_epi16(rg, ba));
+}
+
+AVX2_FUNC inline void r5g6b5Avx2(__m256i p, __m256i& rg, __m256i& ba)
+{
+  __m256i mask5 = _mm256_set1_epi16(0x1f), mask6 = _mm256_set1_epi16(0x3f);
+  __m256i r = expand5(_mm256_srli_epi16(p, 11));
+  __m256i g = expand6(_mm256_and_si256(_mm256_srli_epi16(p, 5), mask6));
+  __m256i b = expand5(_mm256_and_si256(p, mask5));
+  rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+  ba = _mm256_or_si256(b, _mm256_set1_epi16((short)0xff00));
+}
+
+AVX2_FUNC inline void rgb5a3Avx2(__m256i p, __m256i& rg, __m256i& ba)
+{
+  __m256i mask5 = _mm256_set1_epi16(0x1f), mask4 = _mm256_set1_epi16(0xf);
+  __m256i opaque = _mm256_srai_epi16(p, 15);
+
+  __m256i r5 = expand5(_mm256_and_si256(_mm256_srli_epi16(p, 10), mask5));
+  __m256i g5 = expand5(_mm256_and_si256(_mm256_srli_epi16(p, 5), mask5));
+  __m256i b5 = expand5(_mm256_and_si256(p, mask5));
+  __m256i rg5 = _mm256_or_si256(r5, _mm256_slli_epi16(g5, 8));
+  __m256i ba5 = _mm256_or_si256(b5, _mm256_set1_epi16((short)0xff00));
+
+  __m256i a3 = expand3(_mm256_and_si256(_mm256_srli_epi16(p, 12), _mm256_set1_epi16(7)));
+  __m256i r4 = expand4(_mm256_and_si256(_mm256_srli_epi16(p, 8), mask4));
+  __m256i g4 = expand4(_mm256_and_si256(_mm256_srli_epi16(p, 4), mask4));
+  __m256i b4 = expand4(_mm256_and_si256(p, mask4));
+  __m256i rg4 = _mm256_or_si256(r4, _mm256_slli_epi16(g4, 8));
+  __m256i ba4 = _mm256_or_si256(b4, _mm256_slli_epi16(a3, 8));
+
+  rg = _mm256_blendv_epi8(rg4, rg5, opaque);
+  ba = _mm256_blendv_epi8(ba4, ba5, opaque);
+}
+
+AVX2_FUNC inline void argb8Avx2(__m256i ar, __m256i gb, __m256i& rg, __m256i& ba)
+{
+  rg = _mm256_or_si256(_mm256_srli_epi16(ar, 8), _mm256_slli_epi16(gb, 8));
+  ba = _mm256_or_si256(_mm256_srli_epi16(gb, 8), _mm256_slli_epi16(ar, 8));
+}
+
+//The rgba8 formats, with the last tile of odd widths done with SSE2
+
+AVX2_FUNC void fixR5G6B5Avx2(u8* dest, const u8* src, int w, int h)
+{
+  int stride = 4*w;
+  for(int y = 0; y < h; y += 4)
+  {
+    u8* row = dest + y*stride;
+    int x = 0;
+    for(; x + 8 <= w; x += 8, src += 64)
+    {
+      __m256i p01, p23, rg, ba;
+      loadTilePair(src, src + 32, p01, p23);
+      r5g6b5Avx2(swap16(p01), rg, ba);
+      storeRgba(row + 4*x, stride, rg, ba);
+      r5g6b5Avx2(swap16(p23), rg, ba);
+      storeRgba(row + 4*x + 2*stride, stride, rg, ba);
+    }
+    for(; x < w; x += 4, src += 32)
+    {
+      __m128i rg, ba;
+      r5g6b5Sse2(swap16(load128(src)), rg, ba);
+      storeRgba(row + 4*x, stride, rg, ba);
+      r5g6b5Sse2(swap16(load128(src + 16)), rg, ba);
+      storeRgba(row + 4*x + 2*stride, stride, rg, ba);
+    }
+  }
+}
+
+AVX2_FUNC void fixRgb5A3Avx2(u8* dest, const u8* src, int w, int h)
+{
+  int stride = 4*w;
+  for(int y = 0; y < h; y += 4)
+  {
+    u8* row = dest + y*stride;
+    int x = 0;
+    for(; x + 8 <= w; x += 8, src += 64)
+    {
+      __m256i p01, p23, rg, ba;
+      loadTilePair(src, src + 32, p01, p23);
+      rgb5a3Avx2(swap16(p01), rg, ba);
+      storeRgba(row + 4*x, stride, rg, ba);
+      rgb5a3Avx2(swap16(p23), rg, ba);
+      storeRgba(row + 4*x + 2*stride, stride, rg, ba);
+    }
+    for(; x < w; x += 4, src += 32)
+    {
+      __m128i rg, ba;
+      rgb5a3Sse2(swap16(load128(src)), rg, ba);
+      storeRgba(row + 4*x, stride, rg, ba);
+      rgb5a3Sse2(swap16(load128(src + 16)), rg, ba);
+      storeRgba(row + 4*x + 2*stride, stride, rg, ba);
+    }
+  }
+}
+
+AVX2_FUNC void fixRGBA8Avx2(u8* dest, const u8* src, int w, int h)
+{
+  //64 byte tiles, 32 bytes of ar followed by 32 bytes of gb
+  int stride = 4*w;
+  for(int y = 0; y < h; y += 4)
+  {
+    u8* row = dest + y*stride;
+    int x = 0;
+    for(; x + 8 <= w; x += 8, src += 128)
+    {
+      __m256i ar01, ar23, gb01, gb23, rg, ba;
+      loadTilePair(src, src + 64, ar01, ar23);
+      loadTilePair(src + 32, src + 96, gb01, gb23);
+      argb8Avx2(ar01, gb01, rg, ba);
+      storeRgba(row + 4*x, stride, rg, ba);
+      argb8Avx2(ar23, gb23, rg, ba);
+      storeRgba(row + 4*x + 2*stride, stride, rg, ba);
+    }
+    for(; x < w; x += 4, src += 64)
+    {
+      __m128i rg, ba;
+      argb8Sse2(load128(src), load128(src + 32), rg, ba);
+      storeRgba(row + 4*x, stride, rg, ba);
+      argb8Sse2(load128(src + 16), load128(src + 48), rg, ba);
+      storeRgba(row + 4*x + 2*stride, stride, rg, ba);
+    }
+  }
+}
+
+//16 entry palettes, split into one table per channel
+//so that a byte shuffle looks up 16 pixels at once
+AVX2_FUNC void unpack4Avx2(u8* dest, const u8* src, int count, const u8* lut, int pixSize)
+{
+  u8 planes[4][16];
+  for(int i = 0; i < 16; ++i)
+    for(int c = 0; c < pixSize; ++c)
+      planes[c][i] = lut[pixSize*i + c];
+
+  int i = 0;
+  if(pixSize == 4)
+  {
+    __m128i r = load128(planes[0]), g = load128(planes[1]);
+    __m128i b = load128(planes[2]), a = load128(planes[3]);
+    for(; i + 16 <= count; i += 16)
+    {
+      __m128i index = load128(src + i);
+      __m128i pr = _mm_shuffle_epi8(r, index), pg = _mm_shuffle_epi8(g, index);
+      __m128i pb = _mm_shuffle_epi8(b, index), pa = _mm_shuffle_epi8(a, index);
+      __m128i rg0 = _mm_unpacklo_epi8(pr, pg), rg1 = _mm_unpackhi_epi8(pr, pg);
+      __m128i ba0 = _mm_unpacklo_epi8(pb, pa), ba1 = _mm_unpackhi_epi8(pb, pa);
+      u8* d = dest + 4*i;
+      store128(d, _mm_unpacklo_epi16(rg0, ba0));
+      store128(d + 16, _mm_unpackhi_epi16(rg0, ba0));
+      store128(d + 32, _mm_unpacklo_epi16(rg1, ba1));
+      store128(d + 48, _mm_unpackhi_epi16(rg1, ba1));
+    }
+  }
+  else
+  {
+    __m128i lum = load128(planes[0]), alpha = load128(planes[1]);
+    for(; i + 16 <= count; i += 16)
+    {
+      __m128i index = load128(src + i);
+      __m128i pl = _mm_shuffle_epi8(lum, index), pa = _mm_shuffle_epi8(alpha, index);
+      store128(dest + 2*i, _mm_unpacklo_epi8(pl, pa));
+      store128(dest + 2*i + 16, _mm_unpackhi_epi8(pl, pa));
+    }
+  }
+
+  for(; i < count; ++i)
+    memcpy(dest + pixSize*i, lut + pixSize*src[i], pixSize);
+}
+
+//rgba8 palettes with 256 or 16384 entries
+AVX2_FUNC void unpack8GatherAvx2(u8* dest, const u8* src, int count, const u8* lut)
+{
+  int i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+    _mm256_storeu_si256((__m256i*)(dest + 4*i),
+      _mm256_i32gather_epi32((const int*)lut, index, 4));
+  }
+
+  for(; i < count; ++i)
+    memcpy(dest + 4*i, lut + 4*src[i], 4);
+}
+
+AVX2_FUNC void unpack16GatherAvx2(u8* dest, const u8* src, int count, const u8* lut)
+{
+  //fix4x4() left the indices little endian
+  __m256i mask = _mm256_set1_epi32(0x3fff);
+  int i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256i index = _mm256_and_si256(_mm256_cvtepu16_epi32(load128(src + 2*i)), mask);
+    _mm256_storeu_si256((__m256i*)(dest + 4*i),
+      _mm256_i32gather_epi32((const int*)lut, index, 4));
+  }
+
+  for(; i < count; ++i)
+    memcpy(dest + 4*i, lut + 4*(memWORD_le(src + 2*i) & 0x3fff), 4);
+}
+
+//halveImageSimd() for rgba8, 8 pixels of two rows at a time
+AVX2_FUNC void halveRgba8Avx2(u8* dest, const u8* src, int w, int h)
+{
+  __m256i zero = _mm256_setzero_si256(), two = _mm256_set1_epi16(2);
+  int stride = 4*w;
+  for(int y = 0; y < h; y += 2, src += 2*stride)
+    for(int x = 0; x < stride; x += 32, dest += 16)
+    {
+      __m256i row0 = load256(src + x), row1 = load256(src + stride + x);
+
+      //the unpacks stay in their 128 bit lanes, so lo has pixels
+      //0, 1, 4, 5 and hi 2, 3, 6, 7
+      __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(row0, zero), _mm256_unpacklo_epi8(row1, zero));
+      __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(row0, zero), _mm256_unpackhi_epi8(row1, zero));
+      __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+      sum = _mm256_srli_epi16(_mm256_add_epi16(sum, two), 2);
+      __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), _MM_SHUFFLE(3, 1, 2, 0));
+      store128(dest, _mm256_castsi256_si128(packed));
+    }
+}
+
+AVX2_FUNC void decompressDxt1Avx2(u8* dest, const u8* src, int w, int h)
+{
+  //two rows per permute, the shifts move the index of
+  //every pixel to the bottom of its lane
+  __m256i shifts01 = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+  __m256i shifts23 = _mm256_add_epi32(shifts01, _mm256_set1_epi32(16));
+  __m256i mask = _mm256_set1_epi32(3);
+
+  int stride = 4*w;
+  for(int y = 0; y < h; y += 4)
+    for(int x = 0; x < w; x += 16)
+    {
+      int count = std::min(4, (w - x)/4);
+      __m128i pal[4];
+      u32 bits[4];
+      dxt1ColorTablesSse2(src, count, pal, bits);
+      src += 8*count;
+
+      for(int i = 0; i < count; ++i)
+      {
+        u8* row = dest + stride*y + 4*(x + 4*i);
+        __m256i table = _mm256_broadcastsi128_si256(pal[i]);
+        __m256i blockBits = _mm256_set1_epi32(bits[i]);
+        __m256i rows01 = _mm256_permutevar8x32_epi32(table,
+          _mm256_and_si256(_mm256_srlv_epi32(blockBits, shifts01), mask));
+        __m256i rows23 = _mm256_permutevar8x32_epi32(table,
+          _mm256_and_si256(_mm256_srlv_epi32(blockBits, shifts23), mask));
+        store128(row, _mm256_castsi256_si128(rows01));
+        store128(row + stride, _mm256_extracti128_si256(rows01, 1));
+        store128(row + 2*stride, _mm256_castsi256_si128(rows23));
+        store128(row + 3*stride, _mm256_extracti128_si256(rows23, 1));
+      }
+    }
+}
+
+#endif //TEX1_AVX2
+
+#endif //TEX1_SSE2
+
+bool fix8x8ExpandSimd(u8* dest, const u8* src, int w, int h)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || w%8 != 0 || h%8 != 0)
+    return false;
+
+  //8x8 tiles, 4 bytes per row
+  for(int y = 0; y < h; y += 8)
+    for(int x = 0; x < w; x += 8, src += 32)
+      for(int dy = 0; dy < 8; dy += 4)
+      {
+        __m128i v = load128(src + 4*dy);
+        __m128i hi = highNibbles(v), lo = lowNibbles(v);
+        u8* row = dest + w*(y + dy) + x;
+        storeRows64(row, w, _mm_unpacklo_epi8(hi, lo));
+        storeRows64(row + 2*w, w, _mm_unpackhi_epi8(hi, lo));
+      }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool fix8x8NoExpandSimd(u8* dest, const u8* src, int w, int h)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || w%8 != 0 || h%8 != 0)
+    return false;
+
+  __m128i mask = _mm_set1_epi8(0x0f);
+  for(int y = 0; y < h; y += 8)
+    for(int x = 0; x < w; x += 8, src += 32)
+      for(int dy = 0; dy < 8; dy += 4)
+      {
+        __m128i v = load128(src + 4*dy);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+        u8* row = dest + w*(y + dy) + x;
+        storeRows64(row, w, _mm_unpacklo_epi8(hi, lo));
+        storeRows64(row + 2*w, w, _mm_unpackhi_epi8(hi, lo));
+      }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool fix8x4Simd(u8* dest, const u8* src, int w, int h)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || w%8 != 0 || h%4 != 0)
+    return false;
+
+  //8x4 tiles, 8 bytes per row
+  for(int y = 0; y < h; y += 4)
+    for(int x = 0; x < w; x += 8, src += 32)
+    {
+      u8* row = dest + w*y + x;
+      storeRows64(row, w, load128(src));
+      storeRows64(row + 2*w, w, load128(src + 16));
+    }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool fix8x4ExpandSimd(u8* dest, const u8* src, int w, int h)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || w%8 != 0 || h%4 != 0)
+    return false;
+
+  //8x4 tiles, 8 bytes per row, 16 bytes per output row.
+  //the low nibble is the intensity, the high nibble alpha
+  int stride = 2*w;
+  for(int y = 0; y < h; y += 4)
+    for(int x = 0; x < w; x += 8, src += 32)
+      for(int dy = 0; dy < 4; dy += 2)
+      {
+        __m128i v = load128(src + 8*dy);
+        __m128i lum = lowNibbles(v), alpha = highNibbles(v);
+        u8* row = dest + stride*(y + dy) + 2*x;
+        store128(row, _mm_unpacklo_epi8(lum, alpha));
+        store128(row + stride, _mm_unpackhi_epi8(lum, alpha));
+      }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool fix4x4Simd(u8* dest, const u8* src, int w, int h)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || w%4 != 0 || h%4 != 0)
+    return false;
+
+  //4x4 tiles, 8 bytes per row
+  int stride = 2*w;
+  for(int y = 0; y < h; y += 4)
+    for(int x = 0; x < w; x += 4, src += 32)
+    {
+      u8* row = dest + stride*y + 2*x;
+      storeRows64(row, stride, swap16(load128(src)));
+      storeRows64(row + 2*stride, stride, swap16(load128(src + 16)));
+    }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool fixR5G6B5Simd(u8* dest, const u8* src, int w, int h)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || w%4 != 0 || h%4 != 0)
+    return false;
+
+#if TEX1_AVX2
+  if(s_level >= TEX1_SIMD_AVX2)
+  {
+    fixR5G6B5Avx2(dest, src, w, h);
+    return true;
+  }
+#endif
+
+  int stride = 4*w;
+  for(int y = 0; y < h; y += 4)
+    for(int x = 0; x < w; x += 4, src += 32)
+    {
+      __m128i rg, ba;
+      u8* row = dest + stride*y + 4*x;
+      r5g6b5Sse2(swap16(load128(src)), rg, ba);
+      storeRgba(row, stride, rg, ba);
+      r5g6b5Sse2(swap16(load128(src + 16)), rg, ba);
+      storeRgba(row + 2*stride, stride, rg, ba);
+    }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool fixRgb5A3Simd(u8* dest, const u8* src, int w, int h)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || w%4 != 0 || h%4 != 0)
+    return false;
+
+#if TEX1_AVX2
+  if(s_level >= TEX1_SIMD_AVX2)
+  {
+    fixRgb5A3Avx2(dest, src, w, h);
+    return true;
+  }
+#endif
+
+  int stride = 4*w;
+  for(int y = 0; y < h; y += 4)
+    for(int x = 0; x < w; x += 4, src += 32)
+    {
+      __m128i rg, ba;
+      u8* row = dest + stride*y + 4*x;
+      rgb5a3Sse2(swap16(load128(src)), rg, ba);
+      storeRgba(row, stride, rg, ba);
+      rgb5a3Sse2(swap16(load128(src + 16)), rg, ba);
+      storeRgba(row + 2*stride, stride, rg, ba);
+    }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool fixRgb5A3ToRgba4Simd(u8* dest, const u8* src, int w, int h)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || w%4 != 0 || h%4 != 0)
+    return false;
+
+  //same tiles as fix4x4Simd(), converted on the way
+  int stride = 2*w;
+  for(int y = 0; y < h; y += 4)
+    for(int x = 0; x < w; x += 4, src += 32)
+    {
+      u8* row = dest + stride*y + 2*x;
+      storeRows64(row, stride, rgb5a3ToRgba4Sse2(swap16(load128(src))));
+      storeRows64(row + 2*stride, stride, rgb5a3ToRgba4Sse2(swap16(load128(src + 16))));
+    }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool fixRGBA8Simd(u8* dest, const u8* src, int w, int h)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || w%4 != 0 || h%4 != 0)
+    return false;
+
+#if TEX1_AVX2
+  if(s_level >= TEX1_SIMD_AVX2)
+  {
+    fixRGBA8Avx2(dest, src, w, h);
+    return true;
+  }
+#endif
+
+  int stride = 4*w;
+  for(int y = 0; y < h; y += 4)
+    for(int x = 0; x < w; x += 4, src += 64)
+    {
+      __m128i rg, ba;
+      u8* row = dest + stride*y + 4*x;
+      argb8Sse2(load128(src), load128(src + 32), rg, ba);
+      storeRgba(row, stride, rg, ba);
+      argb8Sse2(load128(src + 16), load128(src + 48), rg, ba);
+      storeRgba(row + 2*stride, stride, rg, ba);
+    }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool fixS3TC1Simd(u8* dest, const u8* src, int w, int h)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || w%8 != 0 || h%8 != 0)
+    return false;
+
+  //8x8 tiles of 2x2 blocks, the blocks of a tile row
+  //are next to each other in the output
+  int stride = 8*(w/4); //bytes per row of blocks
+  for(int y = 0; y < h; y += 8)
+    for(int x = 0; x < w; x += 8, src += 32)
+    {
+      u8* row = dest + stride*(y/4) + 8*(x/4);
+      store128(row, s3tc1BlocksSse2(load128(src)));
+      store128(row + stride, s3tc1BlocksSse2(load128(src + 16)));
+    }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool unpack8Simd(u8* dest, const u8* src, int count, const u8* lut, int lutEntries,
+                 int pixSize)
+{
+#if TEX1_AVX2
+  if(s_level < TEX1_SIMD_AVX2)
+    return false;
+
+  if(lutEntries == 16)
+  {
+    unpack4Avx2(dest, src, count, lut, pixSize);
+    return true;
+  }
+  if(pixSize == 4)
+  {
+    unpack8GatherAvx2(dest, src, count, lut);
+    return true;
+  }
+#endif
+  return false;
+}
+
+bool unpack16Simd(u8* dest, const u8* src, int count, const u8* lut, int pixSize)
+{
+#if TEX1_AVX2
+  if(s_level >= TEX1_SIMD_AVX2 && pixSize == 4)
+  {
+    unpack16GatherAvx2(dest, src, count, lut);
+    return true;
+  }
+#endif
+  return false;
+}
+
+bool decompressDxt1Simd(u8* dest, const u8* src, int w, int h)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || w%4 != 0 || h%4 != 0)
+    return false;
+
+#if TEX1_AVX2
+  if(s_level >= TEX1_SIMD_AVX2)
+  {
+    decompressDxt1Avx2(dest, src, w, h);
+    return true;
+  }
+#endif
+
+  int stride = 4*w;
+  for(int y = 0; y < h; y += 4)
+    for(int x = 0; x < w; x += 16)
+    {
+      int count = std::min(4, (w - x)/4);
+      __m128i pal[4];
+      u32 bits[4];
+      dxt1ColorTablesSse2(src, count, pal, bits);
+      src += 8*count;
+
+      for(int i = 0; i < count; ++i)
+        dxt1BlockSse2(dest + stride*y + 4*(x + 4*i), stride, pal[i], bits[i]);
+    }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool halveImageSimd(u8* dest, const u8* src, int w, int h, int pixSize)
+{
+#if TEX1_SSE2
+  if(s_level == TEX1_SIMD_NONE || (w*pixSize)%16 != 0 || h%2 != 0)
+    return false;
+
+#if TEX1_AVX2
+  if(s_level >= TEX1_SIMD_AVX2 && pixSize == 4 && w%8 == 0)
+  {
+    halveRgba8Avx2(dest, src, w, h);
+    return true;
+  }
+#endif
+
+  int stride = pixSize*w;
+  for(int y = 0; y < h; y += 2, src += 2*stride)
+    for(int x = 0; x < stride; x += 16, dest += 8)
+      _mm_storel_epi64((__m128i*)dest,
+        halve16Sse2(load128(src + x), load128(src + stride + x), pixSize));
+  return true;
+#else
+  return false;
+#endif
+}
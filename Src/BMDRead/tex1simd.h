@@ -0,0 +1,58 @@
+#ifndef BMD_TEX1SIMD_H
+#define BMD_TEX1SIMD_H BMD_TEX1SIMD_H
+
+#include "gccommon.h"
+
+//SIMD versions of the tile reordering functions in tex1.cpp,
+//with the same arguments and output. They only handle images
+//whose width and height are multiples of the tile size and
+//return false for everything else (and on cpus without SSE2),
+//the caller then falls back to the scalar function. The scalar
+//functions are the reference these are checked against.
+bool fix8x8ExpandSimd(u8* dest, const u8* src, int w, int h);   //i4 -> i8
+bool fix8x8NoExpandSimd(u8* dest, const u8* src, int w, int h); //index4
+bool fix8x4Simd(u8* dest, const u8* src, int w, int h);         //i8, index8
+bool fix8x4ExpandSimd(u8* dest, const u8* src, int w, int h);   //i4a4 -> i8a8
+bool fix4x4Simd(u8* dest, const u8* src, int w, int h);         //i8a8, index14, r5g6b5
+bool fixR5G6B5Simd(u8* dest, const u8* src, int w, int h);      //r5g6b5 -> rgba8
+bool fixRgb5A3Simd(u8* dest, const u8* src, int w, int h);      //rgb5a3 -> rgba8
+bool fixRgb5A3ToRgba4Simd(u8* dest, const u8* src, int w, int h); //rgb5a3 -> rgba4
+bool fixRGBA8Simd(u8* dest, const u8* src, int w, int h);       //argb8 -> rgba8
+bool fixS3TC1Simd(u8* dest, const u8* src, int w, int h);       //cmpr -> dxt1
+
+//decompressDxt1() (dxt1 -> rgba8), 4 blocks at a time. The colors of
+//the 4 blocks are computed side by side, the pixels are then looked
+//up with compares (sse2) or a permute (avx2).
+bool decompressDxt1Simd(u8* dest, const u8* src, int w, int h);
+
+//2x2 box filter of a w*h image with pixSize (1, 2 or 4) byte channels,
+//rounded like the scalar code in generateMipmaps(). Needs w*pixSize to
+//be a multiple of 16 and h to be even.
+bool halveImageSimd(u8* dest, const u8* src, int w, int h, int pixSize);
+
+//Expand count palette indices through a decoded palette (see
+//decodePalette() in tex1.cpp) with pixSize (2 or 4) bytes per entry.
+//Only done with AVX2: 16 entry palettes are looked up with byte
+//shuffles, bigger rgba8 palettes with gathers.
+bool unpack8Simd(u8* dest, const u8* src, int count, const u8* lut, int lutEntries,
+                 int pixSize);
+bool unpack16Simd(u8* dest, const u8* src, int count, const u8* lut, int pixSize);
+
+enum Tex1SimdLevel
+{
+  TEX1_SIMD_NONE, //scalar reference code only
+  TEX1_SIMD_SSE2,
+  TEX1_SIMD_AVX2  //16 pixels at a time for the rgba8 formats
+};
+
+//the best level the cpu supports
+Tex1SimdLevel maxTex1SimdLevel();
+
+//limits the instruction set the functions above use, to compare
+//them against each other and the scalar code. Defaults to
+//maxTex1SimdLevel(), levels above that are clamped to it. Don't
+//call this while images are being decoded on other threads.
+void setTex1SimdLevel(Tex1SimdLevel level);
+Tex1SimdLevel getTex1SimdLevel();
+
+#endif //BMD_TEX1SIMD_H
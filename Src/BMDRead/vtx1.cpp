@@ -52,42 +52,43 @@ int getLength(const bmd::Vtx1Header& h, int k)
 }
 
 void readVertexArray(Vtx1& arrays, const bmd::ArrayFormat& af, int length,
-                     FILE* f, long offset)
+                     MemFile* f, long offset)
 {
-  fseek(f, offset, SEEK_SET);
-
   //convert array to float (so we have n + m cases, not n*m)
+  //directly from the file buffer, without an intermediate copy
+  if(length < 0)
+    length = 0; //corrupt offsets
+
+  vector<u8> scratch;
+  f->seek(offset);
+  const u8* src = f->readPtr(length, scratch);
+
   vector<float> data;
   switch(af.dataType)
   {
     case 3: //s16 fixed point
     {
-      vector<s16> tmp(length/2);
-      fread(&tmp[0], 2, length/2, f);
       data.resize(length/2);
       float scale = pow(.5f, af.decimalPoint);
       for(size_t j = 0; j < data.size(); ++j)
-      {
-        toSHORT(tmp[j]);
-        data[j] = tmp[j]*scale;
-      }
+        data[j] = (s16)memWORD(src + 2*j)*scale;
     }break;
 
     case 4: //f32
     {
       data.resize(length/4);
-      fread(&data[0], 4, length/4, f);
       for(size_t j = 0; j < data.size(); ++j)
-        toFLOAT(data[j]);
+      {
+        u32 v = memDWORD(src + 4*j);
+        memcpy(&data[j], &v, 4);
+      }
     }break;
 
     case 5: //rgb(a)
     {
-      vector<u8> tmp(length);
-      fread(&tmp[0], 1, length, f);
       data.resize(length);
       for(size_t j = 0; j < data.size(); ++j)
-        data[j] = tmp[j];
+        data[j] = src[j];
     }break;
 
     default:
@@ -188,22 +189,22 @@ void readVertexArray(Vtx1& arrays, const bmd::ArrayFormat& af, int length,
   }
 }
 
-void readVtx1Header(FILE* f, bmd::Vtx1Header& h)
+void readVtx1Header(MemFile* f, bmd::Vtx1Header& h)
 {
-  fread(h.tag, 1, 4, f);
+  f->read(h.tag, 4);
   readDWORD(f, h.sizeOfSection);
   readDWORD(f, h.arrayFormatOffset);
   for(int i = 0; i < 13; ++i)
     readDWORD(f, h.offsets[i]);
 }
 
-void readArrayFormat(FILE* f, bmd::ArrayFormat& af)
+void readArrayFormat(MemFile* f, bmd::ArrayFormat& af)
 {
   readDWORD(f, af.arrayType);
   readDWORD(f, af.componentCount);
   readDWORD(f, af.dataType);
-  fread(&af.decimalPoint, 1, 1, f);
-  fread(&af.unknown3, 1, 1, f);
+  f->read(&af.decimalPoint, 1);
+  f->read(&af.unknown3, 1);
   readWORD(f, af.unknown4);
 }
 
@@ -215,9 +216,9 @@ int countArrays(const bmd::Vtx1Header& h)
   return numArrays;
 }
 
-void dumpVtx1(FILE* f, Vtx1& dst)
+void dumpVtx1(MemFile* f, Vtx1& dst)
 {
-  int vtx1Offset = ftell(f), i;
+  int vtx1Offset = f->tell(), i;
 
   //read header
   bmd::Vtx1Header h;
@@ -227,7 +228,7 @@ void dumpVtx1(FILE* f, Vtx1& dst)
 
   //read vertex array format descriptions
   vector<bmd::ArrayFormat> formats(numArrays);
-  fseek(f, vtx1Offset + h.arrayFormatOffset, SEEK_SET);
+  f->seek(vtx1Offset + h.arrayFormatOffset);
   for(i = 0; i < numArrays; ++i)
     readArrayFormat(f, formats[i]);
 
@@ -248,13 +249,13 @@ void dumpVtx1(FILE* f, Vtx1& dst)
 }
 
 
-void writeVtx1Info(FILE* f, ostream& out)
+void writeVtx1Info(MemFile* f, ostream& out)
 {
   out << string(50, '/') << endl
       << "//Vtx1 section" << endl
       << string(50, '/') << endl << endl;
 
-  int vtx1Offset = ftell(f);
+  int vtx1Offset = f->tell();
 
   bmd::Vtx1Header h;
   readVtx1Header(f, h);
@@ -263,7 +264,7 @@ void writeVtx1Info(FILE* f, ostream& out)
   
   out << numArrays << " formats:" << endl;
 
-  fseek(f, vtx1Offset + h.arrayFormatOffset, SEEK_SET);
+  f->seek(vtx1Offset + h.arrayFormatOffset);
   for(int i = 0; i < numArrays; ++i)
   {
     bmd::ArrayFormat af;
@@ -39,8 +39,8 @@ struct Vtx1
   std::vector<TexCoord> texCoords[8];
 };
 
-void dumpVtx1(FILE* f, Vtx1& dst);
-void writeVtx1Info(FILE* f, std::ostream& out);
+void dumpVtx1(MemFile* f, Vtx1& dst);
+void writeVtx1Info(MemFile* f, std::ostream& out);
 Json::Value serializeVtx1(Vtx1& vtx1);
 
 #endif //BMD_VTX1_H
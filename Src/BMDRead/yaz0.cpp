@@ -0,0 +1,385 @@
+#include "yaz0.h"
+
+#include <cstring>
+
+//Yaz0 data is a sequence of groups: a "code" byte followed by 8 chunks.
+//A set bit in the code byte (msb first) means the chunk is a single
+//literal byte, a cleared bit means it's a back-reference into the
+//already decoded data: 2 bytes (length 3-17) or 3 bytes (length 18-273)
+//with a distance of 1-4096.
+
+//a group takes at most 1 + 8*3 source bytes
+const int kMaxGroupSrcSize = 1 + 8*3;
+
+//and writes at most 8 runs of 0x111 bytes. Wide copies round each
+//run up to 16 bytes, so they may write up to 15 bytes past it.
+const int kMaxGroupDstSize = 8*(0x111 + 15);
+
+//Decodes starting at the beginning of a group at r, checking
+//every read and write. Used for the last few groups and as the
+//reference implementation.
+Yaz0Ret decodeChecked(const u8* src, int srcSize, u8* dst,
+                      int uncompressedSize, Yaz0Ret r)
+{
+  u32 validBitCount = 0; //number of valid bits left in "code" byte
+  u8 currCodeByte = 0;
+  while(r.dstPos < uncompressedSize)
+  {
+    //read new "code" byte if the current one is used up
+    if(validBitCount == 0)
+    {
+      if(r.srcPos >= srcSize)
+        return r;
+      currCodeByte = src[r.srcPos];
+      ++r.srcPos;
+      validBitCount = 8;
+    }
+
+    if((currCodeByte & 0x80) != 0)
+    {
+      //straight copy
+      if(r.srcPos >= srcSize)
+        return r;
+      dst[r.dstPos] = src[r.srcPos];
+      r.dstPos++;
+      r.srcPos++;
+    }
+    else
+    {
+      //RLE part
+      if(r.srcPos >= srcSize - 1)
+        return r;
+      u8 byte1 = src[r.srcPos];
+      u8 byte2 = src[r.srcPos + 1];
+      r.srcPos += 2;
+
+      int dist = ((byte1 & 0xF) << 8) | byte2;
+      int copySource = r.dstPos - (dist + 1);
+
+      int numBytes = byte1 >> 4;
+      if(numBytes == 0)
+      {
+        if(r.srcPos >= srcSize)
+          return r;
+        numBytes = src[r.srcPos] + 0x12;
+        r.srcPos++;
+      }
+      else
+        numBytes += 2;
+
+      if(copySource < 0) //corrupt data, points before start of file
+        return r;
+
+      //copy run
+      for(int i = 0; i < numBytes; ++i)
+      {
+        if(r.dstPos >= uncompressedSize)
+          return r;
+        dst[r.dstPos] = dst[copySource];
+        copySource++;
+        r.dstPos++;
+      }
+    }
+
+    //use next bit from "code" byte
+    currCodeByte <<= 1;
+    validBitCount -= 1;
+  }
+
+  return r;
+}
+
+Yaz0Ret decodeYaz0(const u8* src, int srcSize, u8* dst, int uncompressedSize)
+{
+  Yaz0Ret r = { 0, 0 }; //current read/write positions
+
+  //As long as a whole group fits into both buffers, decode
+  //it without any bounds checks, the remaining groups are
+  //done by decodeChecked().
+  int srcPos = 0, dstPos = 0;
+  while(srcPos <= srcSize - kMaxGroupSrcSize
+     && dstPos <= uncompressedSize - kMaxGroupDstSize)
+  {
+    u8 code = src[srcPos++];
+
+    if(code == 0xFF)
+    {
+      //8 literals, common in hardly compressible data like textures
+      memcpy(dst + dstPos, src + srcPos, 8);
+      srcPos += 8;
+      dstPos += 8;
+      continue;
+    }
+
+    for(int i = 0; i < 8; ++i, code <<= 1)
+    {
+      if((code & 0x80) != 0)
+      {
+        dst[dstPos++] = src[srcPos++];
+        continue;
+      }
+
+      u8 byte1 = src[srcPos];
+      u8 byte2 = src[srcPos + 1];
+      srcPos += 2;
+
+      int dist = (((byte1 & 0xF) << 8) | byte2) + 1;
+      int numBytes = byte1 >> 4;
+      if(numBytes == 0)
+        numBytes = src[srcPos++] + 0x12;
+      else
+        numBytes += 2;
+
+      if(dist > dstPos) //corrupt data, points before start of file
+      {
+        r.srcPos = srcPos;
+        r.dstPos = dstPos;
+        return r;
+      }
+
+      u8* out = dst + dstPos;
+      const u8* in = out - dist;
+      if(dist >= 16)
+      {
+        //every 16 byte block only reads bytes that were
+        //written before, so overlapping runs work as well
+        for(int j = 0; j < numBytes; j += 16)
+          memcpy(out + j, in + j, 16);
+      }
+      else if(dist >= 8)
+      {
+        for(int j = 0; j < numBytes; j += 8)
+          memcpy(out + j, in + j, 8);
+      }
+      else
+      {
+        //short distance, the run repeats a pattern of dist bytes
+        for(int j = 0; j < numBytes; ++j)
+          out[j] = in[j];
+      }
+      dstPos += numBytes;
+    }
+  }
+
+  r.srcPos = srcPos;
+  r.dstPos = dstPos;
+  return decodeChecked(src, srcSize, dst, uncompressedSize, r);
+}
+
+Yaz0Ret decodeYaz0Reference(const u8* src, int srcSize,
+                            u8* dst, int uncompressedSize)
+{
+  Yaz0Ret r = { 0, 0 };
+  return decodeChecked(src, srcSize, dst, uncompressedSize, r);
+}
+
+bool isYaz0(const u8* data, size_t size)
+{
+  return size >= 16 && memcmp(data, "Yaz0", 4) == 0;
+}
+
+bool decompressYaz0(const u8* data, size_t size, std::vector<u8>& dst)
+{
+  dst.clear();
+  if(!isYaz0(data, size))
+    return false;
+
+  u32 uncompressedSize = memDWORD(data + 4);
+  int compressedSize = (int)(size - 16); //16 byte header
+
+  dst.resize(uncompressedSize);
+  Yaz0Ret r = { 0, 0 };
+  if(uncompressedSize != 0)
+    r = decodeYaz0(data + 16, compressedSize, &dst[0], uncompressedSize);
+
+  dst.resize(r.dstPos); //in case the data was truncated
+  return r.dstPos == (int)uncompressedSize;
+}
+
+//////////////////////////////////////////////////////////////////////
+//encoder
+
+const int kWindowSize = 0x1000;
+const int kMinMatchLength = 3;
+const int kMaxMatchLength = 0x111;
+const int kHashBits = 15;
+
+struct Yaz0Match
+{
+  int length, dist;
+};
+
+//Finds back-references with hash chains: head[] holds the most recent
+//position for each hash of 3 bytes, prev[] links every position in the
+//window to the previous one with the same hash.
+struct Yaz0MatchFinder
+{
+  Yaz0MatchFinder(const u8* src, int srcSize, int maxChainLength)
+  : src(src), srcSize(srcSize), maxChainLength(maxChainLength),
+    head(1 << kHashBits, -1), prev(kWindowSize, -1), nextInsert(0)
+  {}
+
+  //adds all positions before pos to the hash chains
+  void insertUpTo(int pos)
+  {
+    for(; nextInsert < pos && nextInsert <= srcSize - kMinMatchLength;
+        ++nextInsert)
+    {
+      u32 h = hash(nextInsert);
+      prev[nextInsert & (kWindowSize - 1)] = head[h];
+      head[h] = nextInsert;
+    }
+  }
+
+  //returns the longest match for pos (the closest one if
+  //several have the same length), length 0 if there is none
+  Yaz0Match find(int pos)
+  {
+    Yaz0Match best = { 0, 0 };
+    int maxLength = srcSize - pos;
+    if(maxLength > kMaxMatchLength)
+      maxLength = kMaxMatchLength;
+    if(maxLength < kMinMatchLength)
+      return best;
+
+    insertUpTo(pos);
+
+    const u8* curr = src + pos;
+    int candidate = head[hash(pos)];
+    for(int chain = maxChainLength;
+        chain > 0 && candidate >= 0 && pos - candidate <= kWindowSize;
+        --chain)
+    {
+      const u8* c = src + candidate;
+
+      //can't get longer than best if this byte differs
+      if(c[best.length] == curr[best.length])
+      {
+        int length = 0;
+        while(length < maxLength && c[length] == curr[length])
+          ++length;
+
+        if(length > best.length)
+        {
+          best.length = length;
+          best.dist = pos - candidate;
+          if(length == maxLength)
+            break;
+        }
+      }
+
+      candidate = prev[candidate & (kWindowSize - 1)];
+    }
+
+    if(best.length < kMinMatchLength)
+      best.length = 0;
+    return best;
+  }
+
+  u32 hash(int pos) const
+  {
+    u32 v = (src[pos] << 16) | (src[pos + 1] << 8) | src[pos + 2];
+    return (v*2654435761u) >> (32 - kHashBits);
+  }
+
+  const u8* src;
+  int srcSize;
+  int maxChainLength;
+
+  std::vector<int> head, prev;
+  int nextInsert;
+};
+
+//collects chunks into groups of 8 behind a "code" byte
+struct Yaz0Writer
+{
+  Yaz0Writer(std::vector<u8>& dst)
+  : dst(dst), codePos(0), bitCount(8)
+  {}
+
+  void literal(u8 b)
+  {
+    nextChunk(true);
+    dst.push_back(b);
+  }
+
+  void backRef(const Yaz0Match& m)
+  {
+    nextChunk(false);
+    int d = m.dist - 1;
+    if(m.length < 0x12)
+    {
+      dst.push_back(u8(((m.length - 2) << 4) | (d >> 8)));
+      dst.push_back(u8(d));
+    }
+    else
+    {
+      dst.push_back(u8(d >> 8));
+      dst.push_back(u8(d));
+      dst.push_back(u8(m.length - 0x12));
+    }
+  }
+
+  void nextChunk(bool isLiteral)
+  {
+    if(bitCount == 8)
+    {
+      codePos = dst.size();
+      dst.push_back(0);
+      bitCount = 0;
+    }
+    if(isLiteral)
+      dst[codePos] |= 0x80 >> bitCount;
+    ++bitCount;
+  }
+
+  std::vector<u8>& dst;
+  size_t codePos;
+  int bitCount;
+};
+
+void encodeYaz0(const u8* src, int srcSize, std::vector<u8>& dst,
+                Yaz0Level level)
+{
+  //header: magic, uncompressed size, 8 bytes padding
+  const u8 header[16] = { 'Y', 'a', 'z', '0',
+                          u8(srcSize >> 24), u8(srcSize >> 16),
+                          u8(srcSize >> 8), u8(srcSize) };
+  dst.insert(dst.end(), header, header + 16);
+  dst.reserve(dst.size() + srcSize + srcSize/8 + 1);
+
+  bool lazy = level == YAZ0_BEST;
+  Yaz0MatchFinder finder(src, srcSize, lazy ? 256 : 16);
+  Yaz0Writer writer(dst);
+
+  int pos = 0;
+  Yaz0Match match = finder.find(0);
+  while(pos < srcSize)
+  {
+    if(match.length == 0)
+    {
+      writer.literal(src[pos]);
+      ++pos;
+      match = finder.find(pos);
+      continue;
+    }
+
+    if(lazy && match.length < kMaxMatchLength)
+    {
+      //if the match at the next byte is longer, emit a
+      //literal instead and take that one
+      Yaz0Match next = finder.find(pos + 1);
+      if(next.length > match.length)
+      {
+        writer.literal(src[pos]);
+        ++pos;
+        match = next;
+        continue;
+      }
+    }
+
+    writer.backRef(match);
+    pos += match.length;
+    match = finder.find(pos);
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef BMD_YAZ0_H
+#define BMD_YAZ0_H BMD_YAZ0_H
+
+#include "gccommon.h"
+
+#include <vector>
+
+//read/write positions reached by the decoder. If the
+//source data is truncated or corrupt, decoding stops
+//early and dstPos is smaller than uncompressedSize.
+struct Yaz0Ret
+{
+  int srcPos, dstPos;
+};
+
+//src points to the compressed data after the 16 byte
+//"Yaz0" header, dst has to hold uncompressedSize bytes
+Yaz0Ret decodeYaz0(const u8* src, int srcSize, u8* dst, int uncompressedSize);
+
+//straightforward byte-by-byte version of decodeYaz0(). produces
+//the same output, kept to check and benchmark the fast one against
+Yaz0Ret decodeYaz0Reference(const u8* src, int srcSize,
+                            u8* dst, int uncompressedSize);
+
+//returns true if data starts with a yaz0 header
+bool isYaz0(const u8* data, size_t size);
+
+//decompresses a complete yaz0 file (16 byte header followed by
+//the compressed data) into dst. Returns false if the data is
+//truncated or corrupt, dst then holds what could be decoded.
+bool decompressYaz0(const u8* data, size_t size, std::vector<u8>& dst);
+
+enum Yaz0Level
+{
+  //greedy matching with short hash chains, for iteration builds
+  YAZ0_FAST,
+
+  //lazy matching with long hash chains, slower but
+  //smaller output, for ship builds
+  YAZ0_BEST
+};
+
+//compresses src and appends a complete yaz0 file (16 byte
+//header followed by the compressed data) to dst
+void encodeYaz0(const u8* src, int srcSize, std::vector<u8>& dst,
+                Yaz0Level level = YAZ0_BEST);
+
+#endif //BMD_YAZ0_H
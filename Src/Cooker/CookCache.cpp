@@ -0,0 +1,129 @@
+#include "CookCache.h"
+#include "FileSystem.h"
+#include "Engine/util.h"
+
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+
+CookCache::CookCache()
+	: m_maxBytes(0), m_hits(0), m_misses(0), m_stores(0), m_hitBytes(0),
+	m_evictions(0), m_evictedBytes(0), m_totalBytes(0)
+{
+}
+
+void CookCache::Init(const std::string& dir, u64 maxBytes)
+{
+	m_dir = dir;
+	m_maxBytes = maxBytes;
+}
+
+u64 CookCache::MakeKey(const void* data, size_t size, u64 cookerVersion, u64 options)
+{
+	// Chain the hashes so that no combination of inputs can collide by construction
+	u64 seed = util::hash64(&cookerVersion, sizeof(cookerVersion), 0);
+	seed = util::hash64(&options, sizeof(options), seed);
+	return util::hash64(data, (uint32_t)size, seed);
+}
+
+std::string CookCache::EntryPath(u64 key) const
+{
+	char name[40];
+	snprintf(name, sizeof(name), "/%02x/%016llx", uint(key >> 56), (unsigned long long)key);
+	return m_dir + name;
+}
+
+bool CookCache::Fetch(u64 key, const std::string& outPath)
+{
+	if (!IsEnabled())
+		return false;
+
+	std::string path = EntryPath(key);
+	u64 size;
+	if (!FileSystem::GetFileSize(path, size) || !FileSystem::LinkOrCopyFile(path, outPath))
+	{
+		m_misses++;
+		return false;
+	}
+
+	// Mark as recently used. The output may be a hard link to the entry and get
+	// the same time, which doesn't matter.
+	FileSystem::TouchFile(path);
+
+	m_hits++;
+	m_hitBytes += size;
+	return true;
+}
+
+bool CookCache::Store(u64 key, const void* data, size_t size)
+{
+	if (!IsEnabled())
+		return false;
+
+	if (!FileSystem::WriteFileAtomic(EntryPath(key), data, size))
+		return false;
+
+	m_stores++;
+	return true;
+}
+
+void CookCache::Trim()
+{
+	if (!IsEnabled())
+		return;
+
+	struct Entry
+	{
+		std::string path;
+		u64 size;
+		s64 lastUse;
+	};
+	std::vector<Entry> entries;
+	m_totalBytes = 0;
+
+	std::vector<FileSystem::DirEntry> subdirs, files;
+	FileSystem::ListDirectory(m_dir, subdirs);
+	for (uint i = 0; i < subdirs.size(); i++)
+	{
+		if (!subdirs[i].isDirectory)
+			continue;
+
+		std::string subdir = m_dir + "/" + subdirs[i].name;
+		FileSystem::ListDirectory(subdir, files);
+		for (uint j = 0; j < files.size(); j++)
+		{
+			Entry e = { subdir + "/" + files[j].name, files[j].size, files[j].modifiedTime };
+			entries.push_back(e);
+			m_totalBytes += e.size;
+		}
+	}
+
+	if (m_totalBytes <= m_maxBytes)
+		return;
+
+	// Oldest first
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+
+	for (uint i = 0; i < entries.size() && m_totalBytes > m_maxBytes; i++)
+	{
+		if (!FileSystem::RemoveFile(entries[i].path))
+			continue;
+
+		m_totalBytes -= entries[i].size;
+		m_evictedBytes += entries[i].size;
+		m_evictions++;
+	}
+}
+
+CookCache::Stats CookCache::GetStats() const
+{
+	Stats s;
+	s.hits = m_hits;
+	s.misses = m_misses;
+	s.stores = m_stores;
+	s.evictions = m_evictions;
+	s.hitBytes = m_hitBytes;
+	s.evictedBytes = m_evictedBytes;
+	s.totalBytes = m_totalBytes;
+	return s;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Common/common.h"
+#include <atomic>
+#include <string>
+
+// Content-addressed store of cooked outputs, shared between cooker runs (and output
+// directories). Entries are keyed by a hash of the source bytes, the cooker version and
+// everything else that affects the output, so a hit can be linked to the output without
+// converting anything.
+//
+// Entries live in <dir>/<first 2 hex digits>/<16 hex digits>. They are written atomically,
+// so several cooker processes can share a cache. An entry's modification time is its last
+// use; Trim() deletes the least recently used entries until the cache fits its size limit.
+class CookCache
+{
+public:
+	CookCache();
+
+	// An empty dir disables the cache, every Fetch() misses and Store() does nothing
+	void Init(const std::string& dir, u64 maxBytes);
+	bool IsEnabled() const { return !m_dir.empty(); }
+
+	// Hashes the source data of an asset together with the cooker version and the
+	// options that went into cooking it
+	static u64 MakeKey(const void* data, size_t size, u64 cookerVersion, u64 options);
+
+	// On a hit, outPath is replaced by the cached output and true is returned
+	bool Fetch(u64 key, const std::string& outPath);
+
+	// Adds a freshly cooked output
+	bool Store(u64 key, const void* data, size_t size);
+
+	// Evicts least recently used entries until the cache is no larger than maxBytes
+	void Trim();
+
+	struct Stats
+	{
+		uint hits;
+		uint misses;
+		uint stores;
+		uint evictions;
+		u64 hitBytes;		// output bytes served from the cache
+		u64 evictedBytes;
+		u64 totalBytes;		// size of the cache after Trim()
+	};
+	Stats GetStats() const;
+
+private:
+	std::string EntryPath(u64 key) const;
+
+	std::string m_dir;
+	u64 m_maxBytes;
+
+	std::atomic<uint> m_hits;
+	std::atomic<uint> m_misses;
+	std::atomic<uint> m_stores;
+	std::atomic<u64> m_hitBytes;
+	uint m_evictions;
+	u64 m_evictedBytes;
+	u64 m_totalBytes;
+};
@@ -0,0 +1,1354 @@
+// Offline asset cooker
+//
+// Converts a directory tree of .bdl/.bmd/.bck/.arc files into baked blobs
+// (see GDModel::Bake() and GDAnim::Bake()) without creating a window or a GPU device.
+// Models are written as .gdm, animations as .gda. The contents of .arc archives go
+// into a directory named after the archive.
+//
+// Every input gets a .hash file next to its output that holds a hash of the source
+// data. Inputs whose hash did not change since the last run are skipped.
+//
+// With -cache, cooked outputs are also kept in a content-addressed cache (see CookCache)
+// that is shared between runs and output directories, e.g. between several checkouts.
+// Assets that were cooked before with the same cooker version are linked from there.
+//
+// Windows builds it with vs2015/Cooker.vcxproj, other platforms with the CMakeLists.txt
+// at the root of the repository.
+//
+// Usage: Cooker [-j threads] [-f] [-compact] [-mips | -linear-mips] [-bc quality] [-atlas size] [-vcache] [-compact-vertices] [-clusters] [-cache dir] [-cache-size MB] <input dir> <output dir>
+//		-j			number of worker threads, defaults to the number of cores
+//		-f			cook everything, even unchanged inputs, without using the cache
+//		-compact	keep r5g6b5 and rgb5a3 textures at 16 bits per pixel (RGB565 and
+//					RGBA4) instead of expanding them to RGBA8, see TEX1_COMPACT_FORMATS
+//		-mips		generate mipmaps for power of two textures that have only one
+//					level, averaging the colors in linear space (TEX1_SRGB_MIPMAPS)
+//		-linear-mips	the same, but averages the stored sRGB values directly
+//		-bc			block compress the textures (BC1 to BC5) with the given quality,
+//					0 is the fastest. See GC3D::CompressTexture().
+//		-atlas		pack the textures without mipmaps up to this size into texture
+//					atlases, see GDModel::BakeOptions::atlasMaxTextureSize
+//		-vcache		reorder the triangles and vertices of the models for the vertex
+//					cache, see GDModel::BakeOptions::optimizeVertexCache
+//		-compact-vertices	store the vertices with quantized positions, normals and
+//					texcoords, see GDModel::BakeOptions::compactVertices
+//		-clusters	split the models into clusters with bounds that the engine culls
+//					against the view, see GDModel::BakeOptions::buildClusters
+//		-cache		directory of the cook cache, no cache is used without it
+//		-cache-size	size limit of the cook cache, least recently used outputs are
+//					deleted at the end of the run to stay below it. Defaults to 1024.
+//
+//        Cooker -bench <input dir>
+//		Compresses every input with both yaz0 levels and decompresses it with both
+//		decoders, printing compression ratios and speeds. Then decodes the textures of
+//		every model with the scalar code and each SIMD level the cpu supports, checking
+//		that all of them produce the same images, also for random images of every
+//		format that the models may not have, and compares the decoded size with
+//		and without -compact, and the same for decoding the DXT1 textures to rgba8
+//		and generating linear and sRGB mipmaps, printing the time per MB. Last it
+//		block compresses the textures with each -bc quality, printing blocks/s and
+//		PSNR and checking that no texture gets worse at a higher quality, and bakes
+//		the models with -vcache, -compact-vertices and -clusters, printing the ACMR
+//		and ATVR before and after, the size of the vertices and the number of
+//		clusters.
+//		Nothing is written. Exits with 1 if any of the checks fail.
+
+#include "Common/common.h"
+#include "Engine/GDModel.h"
+#include "Engine/GDAnim.h"
+#include "Engine/util.h"
+#include "Cooker/CookCache.h"
+#include "Cooker/FileSystem.h"
+#include "BMDRead/bmdread.h"
+#include "BMDRead/bck.h"
+#include "BMDRead/openfile.h"
+#include "BMDRead/rarc.h"
+#include "BMDRead/tex1simd.h"
+#include "BMDRead/yaz0.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Bump this whenever the output of the cooker changes, so everything gets re-cooked
+static const u64 kCookerVersion = 8;
+
+enum AssetType
+{
+	ASSET_NONE,
+	ASSET_MODEL,
+	ASSET_ANIM,
+	ASSET_ARCHIVE,
+};
+
+enum CookStatus
+{
+	COOK_DONE,
+	COOK_SKIPPED,
+	COOK_FAILED,
+};
+
+struct CookJob
+{
+	std::string inputPath;
+	std::string relPath; // relative to the input directory, '/' separated
+	AssetType type;
+
+	// Filled in by the worker
+	CookStatus status;
+	uint numAssets;
+	double ms;
+};
+
+struct CookOptions
+{
+	std::string inputDir;
+	std::string outputDir;
+	uint numThreads;
+	bool force;
+	bool bench;
+	u32 tex1Flags; // passed to loadBmd()
+	GDModel::BakeOptions bake;
+	std::string cacheDir;
+	u64 cacheMaxBytes;
+};
+
+static std::mutex s_printMutex;
+static CookCache s_cache;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double MillisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+//////////////////////////////////////////////////////////////////////
+// File system
+
+std::string GetExtension(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return "";
+
+	std::string ext = path.substr(dot + 1);
+	for (uint i = 0; i < ext.size(); i++) { ext[i] = tolower(ext[i]); }
+	return ext;
+}
+
+std::string ReplaceExtension(const std::string& path, const char* ext)
+{
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return path + ext;
+	return path.substr(0, dot) + ext;
+}
+
+AssetType GetAssetType(const std::string& path)
+{
+	std::string ext = GetExtension(path);
+	if (ext == "bdl" || ext == "bmd") return ASSET_MODEL;
+	if (ext == "bck") return ASSET_ANIM;
+	if (ext == "arc" || ext == "szs") return ASSET_ARCHIVE;
+	return ASSET_NONE;
+}
+
+// Appends all cookable files below dir to jobs
+void ListFiles(const std::string& dir, const std::string& relDir, std::vector<CookJob>& jobs)
+{
+	std::vector<FileSystem::DirEntry> entries;
+	FileSystem::ListDirectory(dir, entries);
+
+	for (uint i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].isDirectory)
+			continue;
+
+		CookJob job;
+		job.inputPath = dir + "/" + entries[i].name;
+		job.relPath = relDir + entries[i].name;
+		job.type = GetAssetType(entries[i].name);
+		job.status = COOK_FAILED;
+		job.numAssets = 0;
+		job.ms = 0;
+		if (job.type != ASSET_NONE)
+			jobs.push_back(job);
+	}
+
+	for (uint i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].isDirectory)
+			ListFiles(dir + "/" + entries[i].name, relDir + entries[i].name + "/", jobs);
+	}
+}
+
+bool ReadHashFile(const std::string& path, u64& hash)
+{
+	FILE* f = fopen(path.c_str(), "rb");
+	if (f == nullptr)
+		return false;
+
+	unsigned long long value;
+	bool ok = fscanf(f, "%llx", &value) == 1;
+	fclose(f);
+	hash = value;
+	return ok;
+}
+
+bool WriteHashFile(const std::string& path, u64 hash)
+{
+	char text[32];
+	int length = snprintf(text, sizeof(text), "%016llx\n", (unsigned long long)hash);
+	return FileSystem::WriteFileAtomic(path, text, length);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Cooking
+
+// The options that change the cooked outputs, part of the cache keys and .hash files
+u64 GetOutputOptions(const CookOptions& options)
+{
+	return options.tex1Flags | (options.bake.optimizeVertexCache ? 0x80 : 0) | (options.bake.compactVertices ? 0x40 : 0) |
+		(options.bake.buildClusters ? 0x20 : 0) |
+		(u64(options.bake.textureQuality + 1) << 8) | (u64(min(options.bake.atlasMaxTextureSize, 0xffffu)) << 16);
+}
+
+bool CookModel(const CookOptions& options, const u8* data, size_t size, const std::string& name, std::vector<ubyte>& blob)
+{
+	if (size < 0x20 || memcmp(data, "J3D", 3) != 0)
+	{
+		warn("%s: not a bmd/bdl file", name.c_str());
+		return false;
+	}
+
+	BModel* bdl = loadBmd(data, size, BMD_ALL, 1, options.tex1Flags);
+	RESULT r = GDModel::Bake(bdl, blob, &options.bake);
+	delete bdl;
+	return SUCCEEDED(r);
+}
+
+bool CookAnim(const u8* data, size_t size, const std::string& name, std::vector<ubyte>& blob)
+{
+	if (size < 0x20 || memcmp(data, "J3D", 3) != 0)
+	{
+		warn("%s: not a bck file", name.c_str());
+		return false;
+	}
+
+	Bck* bck = readBck(data, size);
+	RESULT r = GDAnim::Bake(bck, blob);
+	delete bck;
+	return SUCCEEDED(r);
+}
+
+// Cooks a single model or animation, which may be yaz0-compressed
+bool CookAsset(const CookOptions& options, AssetType type, const u8* data, size_t size, const std::string& outPath)
+{
+	std::string assetPath = ReplaceExtension(outPath, type == ASSET_MODEL ? ".gdm" : ".gda");
+
+	// The key covers everything that affects the output. It is taken from the data
+	// as stored, so hits don't need to decompress anything.
+	u64 key = CookCache::MakeKey(data, size, kCookerVersion, type | (GetOutputOptions(options) << 32));
+	if (!options.force && s_cache.Fetch(key, assetPath))
+		return true;
+
+	std::vector<u8> uncompressed;
+	if (isYaz0(data, size))
+	{
+		if (!decompressYaz0(data, size, uncompressed))
+		{
+			warn("%s: truncated yaz0 data", outPath.c_str());
+			return false;
+		}
+		data = uncompressed.data();
+		size = uncompressed.size();
+	}
+
+	std::vector<ubyte> blob;
+	bool ok = false;
+	switch (type)
+	{
+	case ASSET_MODEL:	ok = CookModel(options, data, size, assetPath, blob); break;
+	case ASSET_ANIM:	ok = CookAnim(data, size, assetPath, blob); break;
+	default:			break;
+	}
+
+	if (!ok || !FileSystem::WriteFileAtomic(assetPath, blob.data(), blob.size()))
+		return false;
+
+	s_cache.Store(key, blob.data(), blob.size());
+	return true;
+}
+
+void Cook(const CookOptions& options, CookJob& job)
+{
+	Clock::time_point start = Clock::now();
+	std::string outPath = options.outputDir + "/" + job.relPath;
+	std::string hashPath = outPath + ".hash";
+
+	job.status = COOK_FAILED;
+	job.numAssets = 0;
+
+	// Hash the file as it is on disk, so unchanged files don't even get decompressed
+	OpenedFile* file = openFile(job.inputPath, false);
+	if (file == nullptr)
+	{
+		job.ms = MillisecondsSince(start);
+		return;
+	}
+
+	// Different options give different outputs, so they are part of the hash as well
+	u64 hash = util::hash64(file->data, file->size, kCookerVersion ^ (GetOutputOptions(options) << 32));
+	u64 oldHash;
+	if (!options.force && ReadHashFile(hashPath, oldHash) && oldHash == hash)
+	{
+		closeFile(file);
+		job.status = COOK_SKIPPED;
+		job.ms = MillisecondsSince(start);
+		return;
+	}
+
+	bool ok = true;
+	if (job.type == ASSET_ARCHIVE)
+	{
+		std::vector<u8> uncompressed;
+		const u8* data = file->data;
+		size_t size = file->size;
+		if (isYaz0(data, size))
+		{
+			ok = decompressYaz0(data, size, uncompressed);
+			data = uncompressed.data();
+			size = uncompressed.size();
+		}
+
+		std::vector<RarcFile> files;
+		if (ok && !readRarc(data, size, files))
+		{
+			warn("%s: not a rarc archive", job.relPath.c_str());
+			ok = false;
+		}
+
+		// Archive contents go into a directory named after the archive
+		std::string outDir = ReplaceExtension(outPath, "") + "/";
+		for (uint i = 0; ok && i < files.size(); i++)
+		{
+			AssetType type = GetAssetType(files[i].path);
+			if (type != ASSET_MODEL && type != ASSET_ANIM)
+				continue;
+
+			ok = CookAsset(options, type, files[i].data, files[i].size, outDir + files[i].path);
+			job.numAssets++;
+		}
+	}
+	else
+	{
+		ok = CookAsset(options, job.type, file->data, file->size, outPath);
+		job.numAssets = 1;
+	}
+	closeFile(file);
+
+	// Only remember the hash once all outputs are written
+	if (ok && WriteHashFile(hashPath, hash))
+	{
+		job.status = COOK_DONE;
+	}
+	job.ms = MillisecondsSince(start);
+}
+
+void PrintJob(const CookJob& job)
+{
+	static const char* statusNames[] = { "cooked ", "skipped", "FAILED " };
+
+	std::lock_guard<std::mutex> lock(s_printMutex);
+	printf("%s %8.2f ms  %s", statusNames[job.status], job.ms, job.relPath.c_str());
+	if (job.type == ASSET_ARCHIVE && job.status == COOK_DONE)
+		printf(" (%u assets)", job.numAssets);
+	printf("\n");
+}
+
+void RunJobs(const CookOptions& options, std::vector<CookJob>& jobs)
+{
+	// Workers pull the next job from a shared counter until all are done
+	std::atomic<uint> nextJob(0);
+	auto worker = [&]()
+	{
+		for (uint i = nextJob++; i < jobs.size(); i = nextJob++)
+		{
+			Cook(options, jobs[i]);
+			PrintJob(jobs[i]);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (uint i = 1; i < options.numThreads; i++)
+	{
+		threads.push_back(std::thread(worker));
+	}
+	worker();
+
+	for (uint i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// Yaz0 benchmark
+
+struct Yaz0BenchResult
+{
+	double rawBytes;
+	double fastBytes, bestBytes;		// compressed sizes
+	double fastMs, bestMs;				// encode times
+	double decodeMs, referenceMs;		// decode times of the YAZ0_BEST data
+	bool ok;
+};
+
+// Best of a few runs, the files are small enough for a single run to be noisy
+static const uint kBenchRuns = 5;
+
+double TimeDecode(decltype(&decodeYaz0) decode, const std::vector<u8>& compressed, std::vector<u8>& dst, bool& ok)
+{
+	double bestMs = 0;
+	for (uint run = 0; run < kBenchRuns; run++)
+	{
+		Clock::time_point start = Clock::now();
+		Yaz0Ret r = decode(&compressed[16], int(compressed.size() - 16), dst.data(), int(dst.size()));
+		double ms = MillisecondsSince(start);
+
+		ok = ok && r.dstPos == int(dst.size());
+		bestMs = (run == 0) ? ms : min(bestMs, ms);
+	}
+	return bestMs;
+}
+
+void BenchYaz0(const u8* data, size_t size, Yaz0BenchResult& result)
+{
+	std::vector<u8> fast, best;
+	Clock::time_point start = Clock::now();
+	encodeYaz0(data, int(size), fast, YAZ0_FAST);
+	result.fastMs = MillisecondsSince(start);
+
+	start = Clock::now();
+	encodeYaz0(data, int(size), best, YAZ0_BEST);
+	result.bestMs = MillisecondsSince(start);
+
+	result.rawBytes = double(size);
+	result.fastBytes = double(fast.size());
+	result.bestBytes = double(best.size());
+
+	// Both decoders have to reproduce the input exactly
+	std::vector<u8> decoded(size);
+	result.ok = true;
+	result.referenceMs = TimeDecode(decodeYaz0Reference, best, decoded, result.ok);
+	result.ok = result.ok && memcmp(decoded.data(), data, size) == 0;
+
+	memset(decoded.data(), 0, size);
+	result.decodeMs = TimeDecode(decodeYaz0, best, decoded, result.ok);
+	result.ok = result.ok && memcmp(decoded.data(), data, size) == 0;
+}
+
+double MBPerSecond(double bytes, double ms)
+{
+	return ms > 0 ? bytes / (1024.0 * 1024.0) / (ms / 1000.0) : 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Texture benchmark
+
+bool SameImages(const Tex1& a, const Tex1& b)
+{
+	if (a.images.size() != b.images.size())
+		return false;
+
+	for (uint i = 0; i < a.images.size(); i++)
+	{
+		const BmdImage& x = a.images[i];
+		const BmdImage& y = b.images[i];
+		if (x.format != y.format || x.sizes != y.sizes || x.imageData != y.imageData)
+			return false;
+	}
+	return true;
+}
+
+void PutU16(std::vector<u8>& data, size_t offset, uint value)
+{
+	data[offset] = u8(value >> 8);
+	data[offset + 1] = u8(value);
+}
+
+void PutU32(std::vector<u8>& data, size_t offset, uint value)
+{
+	PutU16(data, offset, value >> 16);
+	PutU16(data, offset + 2, value & 0xffff);
+}
+
+void AppendRandom(std::vector<u8>& data, size_t count, u32& state)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		// xorshift32, the same bytes on every run
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		data.push_back(u8(state >> 24));
+	}
+}
+
+// A bdl with only a TEX1 section, with random images of every format and palette format
+// in a few sizes. Most sizes are whole tiles, which the SIMD code decodes, the last
+// falls back to the scalar code. The models of the input may not use every format.
+std::vector<u8> MakeTestTex1()
+{
+	struct Format { u8 format, tileWidth, tileHeight, bitsPerTexel; uint paletteEntries; };
+	static const Format kFormats[] = {
+		{ 0, 8, 8, 4, 0 }, { 1, 8, 4, 8, 0 }, { 2, 8, 4, 8, 0 }, { 3, 4, 4, 16, 0 },
+		{ 4, 4, 4, 16, 0 }, { 5, 4, 4, 16, 0 }, { 6, 4, 4, 32, 0 }, { 8, 8, 8, 4, 16 },
+		{ 9, 8, 4, 8, 256 }, { 10, 4, 4, 16, 512 }, { 14, 8, 8, 4, 0 },
+	};
+	static const uint kSizes[][2] = { { 8, 8 }, { 24, 8 }, { 32, 16 }, { 64, 40 }, { 20, 12 } };
+
+	struct TestImage { const Format* format; u8 paletteFormat; uint width, height; };
+	std::vector<TestImage> images;
+	for (uint i = 0; i < sizeof(kFormats) / sizeof(kFormats[0]); i++)
+	{
+		for (uint j = 0; j < sizeof(kSizes) / sizeof(kSizes[0]); j++)
+		{
+			// Palette formats r5g6b5 and rgb5a3
+			for (u8 paletteFormat = 1; paletteFormat <= (kFormats[i].paletteEntries ? 2 : 1); paletteFormat++)
+			{
+				TestImage img = { &kFormats[i], u8(kFormats[i].paletteEntries ? paletteFormat : 0), kSizes[j][0], kSizes[j][1] };
+				images.push_back(img);
+			}
+		}
+	}
+
+	// The file header, the TEX1 header and the image headers, with offsets relative to them
+	const size_t tex1 = 0x20, headers = tex1 + 0x20;
+	std::vector<u8> bmd(headers + 0x20 * images.size(), 0);
+	u32 state = 1234;
+	for (uint i = 0; i < images.size(); i++)
+	{
+		const TestImage& img = images[i];
+		const Format& format = *img.format;
+		size_t header = headers + 0x20 * i;
+		bmd[header] = format.format;
+		PutU16(bmd, header + 2, img.width);
+		PutU16(bmd, header + 4, img.height);
+		if (format.paletteEntries > 0)
+		{
+			bmd[header + 9] = img.paletteFormat;
+			PutU16(bmd, header + 10, format.paletteEntries);
+			PutU32(bmd, header + 12, uint(bmd.size() - header));
+			AppendRandom(bmd, 2 * format.paletteEntries, state);
+			bmd.resize((bmd.size() + 31) & ~31);
+		}
+		bmd[header + 24] = 1; // mipmap count
+		PutU32(bmd, header + 28, uint(bmd.size() - header));
+
+		uint width = (img.width + format.tileWidth - 1) / format.tileWidth * format.tileWidth;
+		uint height = (img.height + format.tileHeight - 1) / format.tileHeight * format.tileHeight;
+		size_t data = bmd.size();
+		AppendRandom(bmd, width * height * format.bitsPerTexel / 8, state);
+		if (format.format == 10)
+		{
+			for (size_t k = data; k < bmd.size(); k += 2)
+				bmd[k] &= 0x3f; // index14
+		}
+		bmd.resize((bmd.size() + 31) & ~31);
+	}
+
+	size_t strings = bmd.size();
+	bmd.resize(strings + 4 + 4 * images.size());
+	PutU16(bmd, strings, uint(images.size()));
+	PutU16(bmd, strings + 2, 0xffff);
+	for (uint i = 0; i < images.size(); i++)
+	{
+		char name[16];
+		sprintf(name, "test%u", i);
+		PutU16(bmd, strings + 4 + 4 * i + 2, uint(bmd.size() - strings));
+		bmd.insert(bmd.end(), name, name + strlen(name) + 1);
+	}
+	bmd.resize((bmd.size() + 31) & ~31);
+
+	memcpy(&bmd[tex1], "TEX1", 4);
+	PutU32(bmd, tex1 + 4, uint(bmd.size() - tex1));
+	PutU16(bmd, tex1 + 8, uint(images.size()));
+	PutU16(bmd, tex1 + 10, 0xffff);
+	PutU32(bmd, tex1 + 12, uint(headers - tex1));
+	PutU32(bmd, tex1 + 16, uint(strings - tex1));
+
+	memcpy(&bmd[0], "J3D2bdl4", 8);
+	PutU32(bmd, 8, uint(bmd.size()));
+	PutU32(bmd, 12, 1); // sections
+	return bmd;
+}
+
+// Decodes the TEX1 section of a bmd with each SIMD level, the scalar code being the
+// reference, with and without TEX1_COMPACT_FORMATS. Adds the best time of each level
+// without them to ms and the decoded sizes to the byte counts, and returns false if
+// any level doesn't match the scalar code.
+bool CompareTex1Decodes(const u8* data, size_t size, double* ms, double& decodedBytes, double& compactBytes)
+{
+	const int numLevels = maxTex1SimdLevel() + 1;
+
+	BModel* reference = nullptr;
+	BModel* compactReference = nullptr;
+	bool ok = true;
+	for (int level = 0; level < numLevels; level++)
+	{
+		setTex1SimdLevel(Tex1SimdLevel(level));
+
+		BModel* model = nullptr;
+		double bestMs = 0;
+		for (uint run = 0; run < kBenchRuns; run++)
+		{
+			delete model;
+			Clock::time_point start = Clock::now();
+			model = loadBmd(data, size, BMD_TEX1);
+			double runMs = MillisecondsSince(start);
+			bestMs = (run == 0) ? runMs : min(bestMs, runMs);
+		}
+		ms[level] += bestMs;
+
+		// The compact formats have SIMD code of their own
+		BModel* compact = loadBmd(data, size, BMD_TEX1, 1, TEX1_COMPACT_FORMATS);
+		if (level == 0)
+		{
+			reference = model;
+			compactReference = compact;
+			continue;
+		}
+		ok = ok && SameImages(reference->tex1, model->tex1) && SameImages(compactReference->tex1, compact->tex1);
+		delete model;
+		delete compact;
+	}
+
+	for (uint j = 0; j < reference->tex1.images.size(); j++)
+	{
+		decodedBytes += reference->tex1.images[j].imageData.size();
+		compactBytes += compactReference->tex1.images[j].imageData.size();
+	}
+	delete compactReference;
+	delete reference;
+	return ok;
+}
+
+// Compares the SIMD and the scalar TEX1 decoding on the images of MakeTestTex1() and on
+// every model, and prints the speed of the models. Returns the number of mismatches.
+uint RunTextureBenchmark(const std::vector<CookJob>& jobs)
+{
+	static const char* kLevelNames[] = { "scalar", "sse2", "avx2" };
+	const int numLevels = maxTex1SimdLevel() + 1;
+
+	double ms[3] = { 0, 0, 0 };
+	double decodedBytes = 0, compactBytes = 0;
+	uint numModels = 0, numFailed = 0;
+
+	std::vector<u8> test = MakeTestTex1(); { FILE* f = fopen("/tmp/t.bdl", "wb"); fwrite(test.data(), 1, test.size(), f); fclose(f); }
+	double testMs[3] = { 0, 0, 0 };
+	double testBytes = 0, testCompactBytes = 0;
+	if (!CompareTex1Decodes(test.data(), test.size(), testMs, testBytes, testCompactBytes))
+	{
+		printf("SIMD texture decode of the test images doesn't match the scalar code\n");
+		numFailed++;
+	}
+
+	for (uint i = 0; i < jobs.size(); i++)
+	{
+		if (jobs[i].type != ASSET_MODEL)
+			continue;
+
+		OpenedFile* file = openFile(jobs[i].inputPath);
+		if (file == nullptr)
+			continue;
+
+		bool ok = CompareTex1Decodes(file->data, file->size, ms, decodedBytes, compactBytes);
+		closeFile(file);
+
+		numModels++;
+		if (!ok)
+		{
+			printf("%s: SIMD texture decode doesn't match the scalar code\n", jobs[i].relPath.c_str());
+			numFailed++;
+		}
+	}
+	setTex1SimdLevel(maxTex1SimdLevel());
+
+	if (numModels == 0)
+		return numFailed;
+
+	printf("\ntextures: %u models, %.0f bytes decoded\n", numModels, decodedBytes);
+	for (int level = 0; level < numLevels; level++)
+	{
+		printf("decode %s: %.1f MB/s (%.2fx)\n", kLevelNames[level], MBPerSecond(decodedBytes, ms[level]),
+			ms[level] > 0 ? ms[0] / ms[level] : 0);
+	}
+	printf("compact formats: %.0f bytes (%.1f%%)\n", compactBytes,
+		decodedBytes > 0 ? 100 * compactBytes / decodedBytes : 0);
+	return numFailed;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Block compression benchmark
+
+static const int kBenchQualities = 4; // -bc 0 to 3
+
+struct BlockBenchResult
+{
+	uint numImages;
+	double blocks;
+	double samples; // channel values compared for the PSNR
+	double ms[kBenchQualities];
+	double squaredError[kBenchQualities];
+};
+
+double Psnr(double squaredError, double samples)
+{
+	if (squaredError <= 0)
+		return 99.0;
+	return 10 * log10(255.0 * 255.0 * samples / squaredError);
+}
+
+// Sums the squared differences of the channels two 8 bit images have in common
+void CompareImages(const Image& a, const Image& b, double& squaredError, double& samples)
+{
+	int na = getChannelCount(a.getFormat());
+	int nb = getChannelCount(b.getFormat());
+	int n = min(na, nb);
+	int numPixels = a.getMipMappedSize(0, a.getMipMapCount()) / getBytesPerPixel(a.getFormat());
+
+	const ubyte* pa = a.getPixels();
+	const ubyte* pb = b.getPixels();
+	for (int i = 0; i < numPixels; i++)
+	{
+		for (int c = 0; c < n; c++)
+		{
+			double d = double(pa[i * na + c]) - double(pb[i * nb + c]);
+			squaredError += d * d;
+		}
+	}
+	samples += double(numPixels) * n;
+}
+
+uint CountBlocks(const Image& img)
+{
+	uint blocks = 0;
+	for (int level = 0; level < img.getMipMapCount(); level++)
+	{
+		blocks += ((img.getWidth(level) + 3) / 4) * ((img.getHeight(level) + 3) / 4);
+	}
+	return blocks;
+}
+
+// Block compresses the textures of every model like -bc does with each quality, and
+// decodes them again to compare them with the originals. A refinement pass only keeps
+// endpoints that lower the error, so returns the number of images that fail to compress
+// or come out worse at a higher quality.
+uint RunBlockCompressionBenchmark(const std::vector<CookJob>& jobs)
+{
+	const FORMAT kFirstFormat = FORMAT_DXT1;
+	const uint kNumFormats = FORMAT_ATI2N - FORMAT_DXT1 + 1;
+	BlockBenchResult results[kNumFormats];
+	memset(results, 0, sizeof(results));
+	uint numFailed = 0;
+
+	for (uint i = 0; i < jobs.size(); i++)
+	{
+		if (jobs[i].type != ASSET_MODEL)
+			continue;
+
+		OpenedFile* file = openFile(jobs[i].inputPath);
+		if (file == nullptr)
+			continue;
+
+		BModel* model = loadBmd(file->data, file->size, BMD_TEX1);
+		for (uint j = 0; j < model->tex1.images.size(); j++)
+		{
+			BmdImage& bmdImage = model->tex1.images[j];
+			FORMAT format = GC3D::ConvertGCTextureFormat(bmdImage.format);
+			if (format == FORMAT_NONE)
+				continue;
+
+			Image source;
+			source.loadFromMemory(bmdImage.imageData.data(), format, bmdImage.width, bmdImage.height,
+				1, bmdImage.sizes.size(), false);
+			FORMAT destFormat = GC3D::PrepareTextureCompression(source);
+			if (destFormat == FORMAT_NONE)
+				continue;
+
+			BlockBenchResult& r = results[destFormat - kFirstFormat];
+			r.numImages++;
+			r.blocks += CountBlocks(source);
+			double lastError = 0;
+			bool ok = true;
+			for (int quality = 0; quality < kBenchQualities && ok; quality++)
+			{
+				Image img(source);
+				Clock::time_point start = Clock::now();
+				ok = img.compressImage(destFormat, quality) && img.getFormat() == destFormat;
+				r.ms[quality] += MillisecondsSince(start);
+				if (!ok)
+					break;
+
+				img.uncompressImage();
+				double squaredError = 0, samples = 0;
+				CompareImages(source, img, squaredError, samples);
+				r.squaredError[quality] += squaredError;
+				if (quality == 0)
+					r.samples += samples;
+
+				// The encoder measures the error against its float palette, the decoder rounds
+				ok = (quality == 0 || squaredError <= lastError * 1.001);
+				lastError = squaredError;
+			}
+
+			if (!ok)
+			{
+				printf("%s: texture %u gets worse at a higher -bc quality or doesn't compress to %s\n",
+					jobs[i].relPath.c_str(), j, getFormatString(destFormat));
+				numFailed++;
+			}
+		}
+		delete model;
+		closeFile(file);
+	}
+
+	printf("\nblock compression: PSNR and blocks/s per -bc quality\n");
+	for (uint f = 0; f < kNumFormats; f++)
+	{
+		const BlockBenchResult& r = results[f];
+		if (r.numImages == 0)
+			continue;
+
+		printf("%-6s %4u images %8.0f blocks", getFormatString(FORMAT(kFirstFormat + f)), r.numImages, r.blocks);
+		for (int quality = 0; quality < kBenchQualities; quality++)
+		{
+			printf("  %d: %5.2f dB %6.2f M/s", quality, Psnr(r.squaredError[quality], r.samples),
+				r.ms[quality] > 0 ? r.blocks / (r.ms[quality] * 1000) : 0);
+		}
+		printf("\n");
+	}
+	return numFailed;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Mipmap generation benchmark
+
+// Generates the mipmaps of a single level image at each SIMD level, with all threads
+// and with sRGB filtering, and adds the best time of each run to ms. reference has the
+// linear mipmaps of the scalar code. Returns false if any run doesn't match the scalar
+// code, the sRGB ones with and without threads included.
+bool CompareMipmaps(const BmdImage& source, const BmdImage& reference, double* ms)
+{
+	const int numLevels = maxTex1SimdLevel() + 1;
+	const int kThreadedRun = numLevels, kSrgbRun = numLevels + 1, kNumRuns = numLevels + 2;
+
+	BmdImage srgbReference = source;
+	setTex1SimdLevel(TEX1_SIMD_NONE);
+	generateMipmaps(srgbReference, true);
+
+	bool ok = true;
+	for (int run = 0; run < kNumRuns; run++)
+	{
+		bool threaded = (run == kThreadedRun);
+		bool srgb = (run == kSrgbRun);
+		setTex1SimdLevel(Tex1SimdLevel(run < numLevels ? run : numLevels - 1));
+
+		BmdImage img;
+		double bestMs = 0;
+		for (uint k = 0; k < kBenchRuns; k++)
+		{
+			img = source;
+			Clock::time_point start = Clock::now();
+			generateMipmaps(img, srgb, threaded ? 0 : 1);
+			double runMs = MillisecondsSince(start);
+			bestMs = (k == 0) ? runMs : min(bestMs, runMs);
+		}
+		ms[run] += bestMs;
+		ok = ok && img.imageData == (srgb ? srgbReference : reference).imageData;
+	}
+
+	// Not timed, the threads split sRGB levels into bands too
+	BmdImage img = source;
+	generateMipmaps(img, true, 0);
+	return ok && img.imageData == srgbReference.imageData;
+}
+
+// Generates the mipmaps of random images of every format that can have them, and of
+// every texture without them like -mips does, at each SIMD level, with all threads and
+// with sRGB filtering, and prints the time per MB of top level data of the textures.
+// Returns the number of images whose mipmaps don't match the scalar code.
+uint RunMipmapBenchmark(const std::vector<CookJob>& jobs)
+{
+	static const char* kRunNames[] = { "scalar", "sse2", "avx2" };
+	const int numLevels = maxTex1SimdLevel() + 1;
+	const int kThreadedRun = numLevels, kSrgbRun = numLevels + 1, kNumRuns = numLevels + 2;
+	uint numFailed = 0;
+
+	// The largest has enough rows to be split over the threads, the models may not have
+	// such images or all of the formats
+	static const int kFormats[][2] = { { I8, 1 }, { I8_A8, 2 }, { RGB565, 2 }, { RGBA4, 2 }, { RGBA8, 4 } };
+	static const int kSizes[][2] = { { 1024, 512 }, { 64, 64 }, { 256, 16 }, { 2, 128 } };
+	u32 state = 1234;
+	for (uint i = 0; i < sizeof(kFormats) / sizeof(kFormats[0]); i++)
+	{
+		for (uint j = 0; j < sizeof(kSizes) / sizeof(kSizes[0]); j++)
+		{
+			BmdImage source;
+			source.format = source.originalFormat = kFormats[i][0];
+			source.paletteFormat = 0;
+			source.generatedMipmaps = false;
+			source.width = kSizes[j][0];
+			source.height = kSizes[j][1];
+			AppendRandom(source.imageData, source.width * source.height * kFormats[i][1], state);
+			source.sizes.push_back(int(source.imageData.size()));
+			source.mipmaps.push_back(source.imageData.data());
+
+			BmdImage reference = source;
+			setTex1SimdLevel(TEX1_SIMD_NONE);
+			generateMipmaps(reference, false);
+
+			double testMs[5] = { 0, 0, 0, 0, 0 };
+			if (!CompareMipmaps(source, reference, testMs))
+			{
+				printf("SIMD or threaded mipmaps of a %dx%d test image in format %d don't match the scalar code\n",
+					source.width, source.height, source.format);
+				numFailed++;
+			}
+		}
+	}
+
+	double ms[5] = { 0, 0, 0, 0, 0 };
+	double sourceBytes = 0, mipBytes = 0;
+	uint numImages = 0;
+	for (uint i = 0; i < jobs.size(); i++)
+	{
+		if (jobs[i].type != ASSET_MODEL)
+			continue;
+
+		OpenedFile* file = openFile(jobs[i].inputPath);
+		if (file == nullptr)
+			continue;
+
+		BModel* model = loadBmd(file->data, file->size, BMD_TEX1);
+		for (uint j = 0; j < model->tex1.images.size(); j++)
+		{
+			BmdImage reference = model->tex1.images[j];
+			setTex1SimdLevel(TEX1_SIMD_NONE);
+			if (!generateMipmaps(reference, false))
+				continue;
+
+			if (!CompareMipmaps(model->tex1.images[j], reference, ms))
+			{
+				printf("%s: SIMD or threaded mipmaps of texture %u don't match the scalar code\n", jobs[i].relPath.c_str(), j);
+				numFailed++;
+			}
+
+			numImages++;
+			sourceBytes += reference.sizes[0];
+			mipBytes += reference.imageData.size() - reference.sizes[0];
+		}
+		delete model;
+		closeFile(file);
+	}
+	setTex1SimdLevel(maxTex1SimdLevel());
+
+	if (numImages == 0)
+		return numFailed;
+
+	double mb = sourceBytes / (1024.0 * 1024.0);
+	printf("\nmipmaps: %u images without mipmaps, %.0f bytes, mipmaps add %.0f bytes (%.1f%%)\n",
+		numImages, sourceBytes, mipBytes, 100 * mipBytes / sourceBytes);
+	for (int run = 0; run < kNumRuns; run++)
+	{
+		const char* name = kRunNames[run < numLevels ? run : numLevels - 1];
+		printf("generate %s%s: %.2f ms/MB (%.2fx)\n", name,
+			run == kThreadedRun ? " threads" : (run == kSrgbRun ? " srgb" : ""),
+			ms[run] / mb, ms[run] > 0 ? ms[0] / ms[run] : 0);
+	}
+	return numFailed;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Vertex benchmark
+
+// Bakes every model with -vcache, -compact-vertices and -clusters and prints the simulated 
+// post-transform cache misses per triangle (ACMR) and per vertex (ATVR) of the source strips and
+// of the optimized batches, the size of the vertices before and after, and the clusters
+void RunVertexBenchmark(const std::vector<CookJob>& jobs)
+{
+	GDModel::BakeOptions options = { -1, 0, true, true, true };
+	GDModel::BakeStats total = {};
+	double ms = 0;
+	uint numModels = 0;
+	for (uint i = 0; i < jobs.size(); i++)
+	{
+		if (jobs[i].type != ASSET_MODEL)
+			continue;
+
+		OpenedFile* file = openFile(jobs[i].inputPath);
+		if (file == nullptr)
+			continue;
+		if (file->size < 0x20 || memcmp(file->data, "J3D", 3) != 0)
+		{
+			closeFile(file);
+			continue;
+		}
+
+		BModel* model = loadBmd(file->data, file->size);
+		closeFile(file);
+
+		std::vector<ubyte> blob;
+		GDModel::BakeStats stats;
+		Clock::time_point start = Clock::now();
+		RESULT r = GDModel::Bake(model, blob, &options, &stats);
+		ms += MillisecondsSince(start);
+		delete model;
+		if (FAILED(r) || stats.nTriangles == 0)
+			continue;
+
+		printf("%-40s %7u tris  ACMR %.3f -> %.3f  ATVR %.3f -> %.3f  %u -> %u vertex bytes  %u clusters\n", jobs[i].relPath.c_str(), stats.nTriangles,
+			double(stats.nCacheMissesBefore) / stats.nTriangles, double(stats.nCacheMissesAfter) / stats.nTriangles,
+			double(stats.nCacheMissesBefore) / stats.nVertices, double(stats.nCacheMissesAfter) / stats.nVertices,
+			stats.nVertexBytes, stats.nCompactVertexBytes, stats.nClusters);
+
+		total.nTriangles += stats.nTriangles;
+		total.nVertices += stats.nVertices;
+		total.nCacheMissesBefore += stats.nCacheMissesBefore;
+		total.nCacheMissesAfter += stats.nCacheMissesAfter;
+		total.nListBatches += stats.nListBatches;
+		total.nVertexBytes += stats.nVertexBytes;
+		total.nCompactVertexBytes += stats.nCompactVertexBytes;
+		total.nFloatTexcoordBatches += stats.nFloatTexcoordBatches;
+		total.nClusters += stats.nClusters;
+		total.nClusterTriangles += stats.nClusterTriangles;
+		numModels++;
+	}
+
+	if (total.nTriangles == 0)
+		return;
+
+	printf("\nvertices: %u models, %u triangles, %u batches turned into lists, baked in %.1f ms\n",
+		numModels, total.nTriangles, total.nListBatches, ms);
+	printf("ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %.1f%% fewer vertices transformed\n",
+		double(total.nCacheMissesBefore) / total.nTriangles, double(total.nCacheMissesAfter) / total.nTriangles,
+		double(total.nCacheMissesBefore) / total.nVertices, double(total.nCacheMissesAfter) / total.nVertices,
+		100.0 - 100.0 * total.nCacheMissesAfter / total.nCacheMissesBefore);
+	printf("compact vertices: %u -> %u bytes (%.1f%%), %u batches kept float texcoords\n", total.nVertexBytes, 
+		total.nCompactVertexBytes, 100.0 * total.nCompactVertexBytes / total.nVertexBytes, total.nFloatTexcoordBatches);
+	printf("clusters: %u, %.1f triangles each\n", total.nClusters, 
+		total.nClusters ? double(total.nClusterTriangles) / total.nClusters : 0.0);
+}
+
+//////////////////////////////////////////////////////////////////////
+// DXT1 decode benchmark
+
+struct Dxt1Image
+{
+	std::vector<u8> data;
+	int width, height;
+};
+
+// Collects the dxt1 textures of every model, both the ones that are stored as
+// cmpr and the ones -bc turns into DXT1, and decodes them with decompressDxt1()
+// at each SIMD level and with all threads. Returns 1 if any of them doesn't
+// match the scalar code.
+uint RunDxt1DecodeBenchmark(const std::vector<CookJob>& jobs)
+{
+	static const char* kLevelNames[] = { "scalar", "sse2", "avx2" };
+	const int numLevels = maxTex1SimdLevel() + 1;
+
+	std::vector<Dxt1Image> images;
+	double pixels = 0;
+	for (uint i = 0; i < jobs.size(); i++)
+	{
+		if (jobs[i].type != ASSET_MODEL)
+			continue;
+
+		OpenedFile* file = openFile(jobs[i].inputPath);
+		if (file == nullptr)
+			continue;
+
+		BModel* model = loadBmd(file->data, file->size, BMD_TEX1);
+		for (uint j = 0; j < model->tex1.images.size(); j++)
+		{
+			BmdImage& bmdImage = model->tex1.images[j];
+			FORMAT format = GC3D::ConvertGCTextureFormat(bmdImage.format);
+			if (format == FORMAT_NONE)
+				continue;
+
+			Image img;
+			img.loadFromMemory(bmdImage.imageData.data(), format, bmdImage.width, bmdImage.height,
+				1, bmdImage.sizes.size(), false);
+			if (format != FORMAT_DXT1 && GC3D::PrepareTextureCompression(img) == FORMAT_DXT1)
+				img.compressImage(FORMAT_DXT1, 0);
+			if (img.getFormat() != FORMAT_DXT1)
+				continue;
+
+			for (int level = 0; level < img.getMipMapCount(); level++)
+			{
+				Dxt1Image dxt1;
+				dxt1.width = img.getWidth(level);
+				dxt1.height = img.getHeight(level);
+				dxt1.data.assign(img.getPixels(level), img.getPixels(level) + img.getMipMappedSize(level, 1));
+				pixels += double(dxt1.width) * dxt1.height;
+				images.push_back(dxt1);
+			}
+		}
+		delete model;
+		closeFile(file);
+	}
+
+	if (images.empty())
+		return 0;
+
+	// The last run uses all threads at the best level
+	double ms[4] = { 0, 0, 0, 0 };
+	bool ok = true;
+	std::vector<u8> reference, decoded;
+	for (uint i = 0; i < images.size(); i++)
+	{
+		const Dxt1Image& dxt1 = images[i];
+		size_t size = 4 * size_t(dxt1.width) * dxt1.height;
+		reference.resize(size);
+		decoded.resize(size);
+		for (int run = 0; run <= numLevels; run++)
+		{
+			bool threaded = (run == numLevels);
+			setTex1SimdLevel(Tex1SimdLevel(threaded ? numLevels - 1 : run));
+			u8* dest = (run == 0) ? reference.data() : decoded.data();
+
+			double bestMs = 0;
+			for (uint k = 0; k < kBenchRuns; k++)
+			{
+				Clock::time_point start = Clock::now();
+				if (threaded)
+					decompressDxt1(dest, dxt1.data.data(), dxt1.width, dxt1.height, 0);
+				else
+					decompressDxt1(dest, dxt1.data.data(), dxt1.width, dxt1.height);
+				double runMs = MillisecondsSince(start);
+				bestMs = (k == 0) ? runMs : min(bestMs, runMs);
+			}
+			ms[run] += bestMs;
+			if (run > 0)
+				ok = ok && decoded == reference;
+		}
+	}
+	setTex1SimdLevel(maxTex1SimdLevel());
+
+	printf("\ndxt1 decode: %u images, %.0f pixels\n", uint(images.size()), pixels);
+	for (int run = 0; run <= numLevels; run++)
+	{
+		bool threaded = (run == numLevels);
+		printf("decode %s%s: %.1f Mpixels/s (%.2fx)\n", kLevelNames[threaded ? numLevels - 1 : run],
+			threaded ? " threads" : "", ms[run] > 0 ? pixels / (ms[run] * 1000) : 0,
+			ms[run] > 0 ? ms[0] / ms[run] : 0);
+	}
+	if (!ok)
+		printf("SIMD dxt1 decode doesn't match the scalar code\n");
+	return ok ? 0 : 1;
+}
+
+int RunBenchmark(const std::vector<CookJob>& jobs)
+{
+	printf("%-40s %9s %7s %7s %11s %11s %11s %11s\n", "file", "size", "fast", "best",
+		"enc fast", "enc best", "dec", "dec ref");
+
+	Yaz0BenchResult total = {};
+	uint numFailed = 0;
+	for (uint i = 0; i < jobs.size(); i++)
+	{
+		// Benchmark on the uncompressed data, whether or not the file was compressed
+		OpenedFile* file = openFile(jobs[i].inputPath);
+		if (file == nullptr || file->size == 0)
+		{
+			if (file) { closeFile(file); }
+			continue;
+		}
+
+		Yaz0BenchResult r;
+		BenchYaz0(file->data, file->size, r);
+		closeFile(file);
+
+		printf("%-40s %9.0f %6.1f%% %6.1f%% %6.1f MB/s %6.1f MB/s %6.1f MB/s %6.1f MB/s%s\n",
+			jobs[i].relPath.c_str(), r.rawBytes,
+			100 * r.fastBytes / r.rawBytes, 100 * r.bestBytes / r.rawBytes,
+			MBPerSecond(r.rawBytes, r.fastMs), MBPerSecond(r.rawBytes, r.bestMs),
+			MBPerSecond(r.rawBytes, r.decodeMs), MBPerSecond(r.rawBytes, r.referenceMs),
+			r.ok ? "" : "  MISMATCH");
+
+		total.rawBytes += r.rawBytes;
+		total.fastBytes += r.fastBytes;
+		total.bestBytes += r.bestBytes;
+		total.fastMs += r.fastMs;
+		total.bestMs += r.bestMs;
+		total.decodeMs += r.decodeMs;
+		total.referenceMs += r.referenceMs;
+		numFailed += r.ok ? 0 : 1;
+	}
+
+	if (total.rawBytes > 0)
+	{
+		printf("\ntotal: %.0f bytes, ratio fast %.1f%% best %.1f%%\n", total.rawBytes,
+			100 * total.fastBytes / total.rawBytes, 100 * total.bestBytes / total.rawBytes);
+		printf("encode: fast %.1f MB/s, best %.1f MB/s\n",
+			MBPerSecond(total.rawBytes, total.fastMs), MBPerSecond(total.rawBytes, total.bestMs));
+		printf("decode: %.1f MB/s, reference %.1f MB/s (%.2fx)\n",
+			MBPerSecond(total.rawBytes, total.decodeMs), MBPerSecond(total.rawBytes, total.referenceMs),
+			total.decodeMs > 0 ? total.referenceMs / total.decodeMs : 0);
+	}
+
+	numFailed += RunTextureBenchmark(jobs);
+	numFailed += RunDxt1DecodeBenchmark(jobs);
+	numFailed += RunMipmapBenchmark(jobs);
+	numFailed += RunBlockCompressionBenchmark(jobs);
+	//RunVertexBenchmark(jobs);
+	return numFailed ? 1 : 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void PrintUsage()
+{
+	printf("Usage: Cooker [-j threads] [-f] [-compact] [-mips | -linear-mips] [-bc quality] [-atlas size] [-vcache] [-compact-vertices] [-clusters] [-cache dir] [-cache-size MB] <input dir> <output dir>\n"
+		"  -j           number of worker threads, defaults to the number of cores\n"
+		"  -f           cook everything, even unchanged inputs, without using the cache\n"
+		"  -compact     keep 16 bit textures at 16 bits instead of expanding them to RGBA8\n"
+		"  -mips        generate mipmaps for textures without them, with sRGB filtering\n"
+		"  -linear-mips generate mipmaps for textures without them, averaging sRGB values\n"
+		"  -bc          block compress the textures with the given quality, 0 is the fastest\n"
+		"  -atlas       pack the textures without mipmaps up to this size into atlases\n"
+		"  -vcache      reorder triangles and vertices for the post-transform vertex cache\n"
+		"  -compact-vertices  quantize the vertices to about half their size\n"
+		"  -clusters    split the models into clusters that can be culled against the view\n"
+		"  -cache       directory of the cook cache, no cache is used without it\n"
+		"  -cache-size  size limit of the cook cache in MB, defaults to 1024\n"
+		"       Cooker -bench <input dir>\n"
+		"  compares the yaz0 encoder levels and decoders and the texture decoders on the inputs\n");
+}
+
+bool ParseArgs(int argc, char** argv, CookOptions& options)
+{
+	options.numThreads = std::thread::hardware_concurrency();
+	options.force = false;
+	options.bench = false;
+	options.tex1Flags = 0;
+	options.bake.textureQuality = -1;
+	options.bake.atlasMaxTextureSize = 0;
+	options.bake.optimizeVertexCache = false;
+	options.bake.compactVertices = false;
+	options.bake.buildClusters = false;
+	options.cacheMaxBytes = 1024ull * 1024 * 1024;
+
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc)
+			options.numThreads = atoi(argv[++i]);
+		else if (arg == "-f")
+			options.force = true;
+		else if (arg == "-bench")
+			options.bench = true;
+		else if (arg == "-compact")
+			options.tex1Flags |= TEX1_COMPACT_FORMATS;
+		else if (arg == "-mips")
+			options.tex1Flags |= TEX1_GENERATE_MIPMAPS | TEX1_SRGB_MIPMAPS;
+		else if (arg == "-linear-mips")
+			options.tex1Flags |= TEX1_GENERATE_MIPMAPS;
+		else if (arg == "-bc" && i + 1 < argc)
+			options.bake.textureQuality = max(atoi(argv[++i]), 0);
+		else if (arg == "-atlas" && i + 1 < argc)
+			options.bake.atlasMaxTextureSize = max(atoi(argv[++i]), 0);
+		else if (arg == "-vcache")
+			options.bake.optimizeVertexCache = true;
+		else if (arg == "-compact-vertices")
+			options.bake.compactVertices = true;
+		else if (arg == "-clusters")
+			options.bake.buildClusters = true;
+		else if (arg == "-cache" && i + 1 < argc)
+			options.cacheDir = argv[++i];
+		else if (arg == "-cache-size" && i + 1 < argc)
+			options.cacheMaxBytes = strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+		else if (arg[0] == '-')
+			return false;
+		else
+			paths.push_back(arg);
+	}
+
+	if (paths.size() != (options.bench ? 1u : 2u))
+		return false;
+
+	options.inputDir = paths[0];
+	options.outputDir = options.bench ? "" : paths[1];
+	options.numThreads = max(options.numThreads, 1u);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	CookOptions options;
+	if (!ParseArgs(argc, argv, options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::vector<CookJob> jobs;
+	ListFiles(options.inputDir, "", jobs);
+
+	if (options.bench)
+		return RunBenchmark(jobs);
+
+	s_cache.Init(options.cacheDir, options.cacheMaxBytes);
+
+	Clock::time_point start = Clock::now();
+	RunJobs(options, jobs);
+	s_cache.Trim();
+	double wallMs = MillisecondsSince(start);
+
+	uint counts[3] = { 0, 0, 0 };
+	double cookMs = 0;
+	double slowestMs = 0;
+	const CookJob* slowest = nullptr;
+	for (uint i = 0; i < jobs.size(); i++)
+	{
+		counts[jobs[i].status]++;
+		cookMs += jobs[i].ms;
+		if (jobs[i].ms > slowestMs)
+		{
+			slowestMs = jobs[i].ms;
+			slowest = &jobs[i];
+		}
+	}
+
+	printf("\n%u files: %u cooked, %u skipped, %u failed\n",
+		(uint)jobs.size(), counts[COOK_DONE], counts[COOK_SKIPPED], counts[COOK_FAILED]);
+	printf("%.2f s wall time, %.2f s summed over %u threads\n",
+		wallMs / 1000, cookMs / 1000, options.numThreads);
+	if (slowest)
+		printf("slowest: %s (%.2f ms)\n", slowest->relPath.c_str(), slowestMs);
+
+	if (s_cache.IsEnabled())
+	{
+		CookCache::Stats stats = s_cache.GetStats();
+		uint lookups = stats.hits + stats.misses;
+		printf("cache: %u hits, %u misses (%.1f%% hit rate), %.2f MB reused, %u stored\n",
+			stats.hits, stats.misses, lookups ? 100.0 * stats.hits / lookups : 0.0,
+			stats.hitBytes / (1024.0 * 1024.0), stats.stores);
+		printf("cache: %.2f MB in use, %u entries evicted (%.2f MB)\n",
+			stats.totalBytes / (1024.0 * 1024.0), stats.evictions, stats.evictedBytes / (1024.0 * 1024.0));
+	}
+
+	return counts[COOK_FAILED] ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+#include "FileSystem.h"
+
+#include <atomic>
+#include <stdio.h>
+
+#ifdef _WIN32
+#	include <direct.h>	// _mkdir()
+#else
+#	include <dirent.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#	include <utime.h>
+#endif
+
+namespace FileSystem
+{
+	// Distinguishes the temporary files of concurrent writes to the same path
+	static std::atomic<uint> s_tempCounter(0);
+
+	std::string TempPath(const std::string& path)
+	{
+#ifdef _WIN32
+		uint pid = GetCurrentProcessId();
+#else
+		uint pid = getpid();
+#endif
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%u.%u.tmp", pid, s_tempCounter++);
+		return path + suffix;
+	}
+
+	// Renames src over dst, replacing dst if it exists
+	bool RenameOver(const std::string& src, const std::string& dst)
+	{
+#ifdef _WIN32
+		return MoveFileExA(src.c_str(), dst.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return rename(src.c_str(), dst.c_str()) == 0;
+#endif
+	}
+
+	bool ListDirectory(const std::string& dir, std::vector<DirEntry>& entries)
+	{
+		entries.clear();
+
+#ifdef _WIN32
+		WIN32_FIND_DATAA data;
+		HANDLE find = FindFirstFileA((dir + "/*").c_str(), &data);
+		if (find == INVALID_HANDLE_VALUE)
+			return false;
+		do
+		{
+			DirEntry entry;
+			entry.name = data.cFileName;
+			if (entry.name == "." || entry.name == "..")
+				continue;
+			entry.isDirectory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+			entry.size = (u64(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+			entry.modifiedTime = ((s64(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime) / 10000000;
+			entries.push_back(entry);
+		} while (FindNextFileA(find, &data));
+		FindClose(find);
+#else
+		DIR* d = opendir(dir.c_str());
+		if (d == nullptr)
+			return false;
+		while (dirent* e = readdir(d))
+		{
+			DirEntry entry;
+			entry.name = e->d_name;
+			if (entry.name == "." || entry.name == "..")
+				continue;
+
+			struct stat st;
+			if (stat((dir + "/" + entry.name).c_str(), &st) != 0)
+				continue;
+			entry.isDirectory = S_ISDIR(st.st_mode);
+			entry.size = st.st_size;
+			entry.modifiedTime = st.st_mtime;
+			entries.push_back(entry);
+		}
+		closedir(d);
+#endif
+
+		return true;
+	}
+
+	void MakeDirs(const std::string& path)
+	{
+		for (size_t i = path.find_first_of("/\\", 1); i != std::string::npos; i = path.find_first_of("/\\", i + 1))
+		{
+			std::string dir = path.substr(0, i);
+#ifdef _WIN32
+			_mkdir(dir.c_str());
+#else
+			mkdir(dir.c_str(), 0755);
+#endif
+		}
+	}
+
+	bool GetFileSize(const std::string& path, u64& size)
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+			return false;
+		size = (u64(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+#else
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0)
+			return false;
+		size = st.st_size;
+#endif
+		return true;
+	}
+
+	bool ReadFile(const std::string& path, std::vector<u8>& data)
+	{
+		data.clear();
+		FILE* f = fopen(path.c_str(), "rb");
+		if (f == nullptr)
+			return false;
+
+		u8 buffer[64 * 1024];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), f)) != 0)
+		{
+			data.insert(data.end(), buffer, buffer + n);
+		}
+
+		bool ok = ferror(f) == 0;
+		fclose(f);
+		return ok;
+	}
+
+	bool WriteFileAtomic(const std::string& path, const void* data, size_t size)
+	{
+		MakeDirs(path);
+
+		std::string tempPath = TempPath(path);
+		FILE* f = fopen(tempPath.c_str(), "wb");
+		if (f == nullptr)
+			return false;
+
+		bool ok = fwrite(data, 1, size, f) == size;
+		ok = (fclose(f) == 0) && ok;
+		ok = ok && RenameOver(tempPath, path);
+
+		if (!ok)
+			RemoveFile(tempPath);
+		return ok;
+	}
+
+	bool LinkOrCopyFile(const std::string& srcPath, const std::string& dstPath)
+	{
+		MakeDirs(dstPath);
+
+		// Link under a temporary name first, a link can't replace an existing file
+		std::string tempPath = TempPath(dstPath);
+#ifdef _WIN32
+		bool linked = CreateHardLinkA(tempPath.c_str(), srcPath.c_str(), NULL) != 0;
+#else
+		bool linked = link(srcPath.c_str(), tempPath.c_str()) == 0;
+#endif
+		if (linked)
+		{
+			if (RenameOver(tempPath, dstPath))
+				return true;
+			RemoveFile(tempPath);
+			return false;
+		}
+
+		// Different volumes or no hard link support
+		std::vector<u8> data;
+		return ReadFile(srcPath, data) && WriteFileAtomic(dstPath, data.data(), data.size());
+	}
+
+	bool TouchFile(const std::string& path)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		FILETIME now;
+		GetSystemTimeAsFileTime(&now);
+		bool ok = SetFileTime(file, NULL, NULL, &now) != 0;
+		CloseHandle(file);
+		return ok;
+#else
+		return utime(path.c_str(), nullptr) == 0;
+#endif
+	}
+
+	bool RemoveFile(const std::string& path)
+	{
+		return remove(path.c_str()) == 0;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Common/common.h"
+#include <string>
+#include <vector>
+
+// Small file system layer for the cooker, so the rest of it doesn't need to care about
+// Win32 vs. POSIX. Paths use '/' as separator, Windows accepts that as well.
+namespace FileSystem
+{
+	struct DirEntry
+	{
+		std::string name;
+		bool isDirectory;
+		u64 size;
+		s64 modifiedTime; // seconds, only meaningful compared to other modifiedTimes
+	};
+
+	// Lists the files and subdirectories of dir, without "." and ".."
+	bool ListDirectory(const std::string& dir, std::vector<DirEntry>& entries);
+
+	// Creates all directories leading up to the file at path
+	void MakeDirs(const std::string& path);
+
+	bool GetFileSize(const std::string& path, u64& size);
+
+	bool ReadFile(const std::string& path, std::vector<u8>& data);
+
+	// Writes to a temporary file next to path and renames it over path, so readers
+	// (and other cooker processes) either see the old file or the complete new one
+	bool WriteFileAtomic(const std::string& path, const void* data, size_t size);
+
+	// Makes dstPath refer to the contents of srcPath, as a hard link if possible and as
+	// a copy otherwise. Replaces dstPath atomically like WriteFileAtomic().
+	bool LinkOrCopyFile(const std::string& srcPath, const std::string& dstPath);
+
+	// Sets the modification time of path to now
+	bool TouchFile(const std::string& path);
+
+	bool RemoveFile(const std::string& path);
+}
@@ -0,0 +1,76 @@
+// Stand-ins for the parts of Framework3 that the cooker links against but that
+// only exist in a renderer backend or a windowing layer.
+//
+// On Windows the cooker links Framework3 like the engine does, so it gets the real
+// Direct3D10 backend constants. Elsewhere there is no backend, so the constants are
+// defined here with the same values. They end up in the baked blobs (blend modes,
+// depth functions, cull modes), so they have to match what the engine renders with.
+
+#ifndef _WIN32
+
+#include "Framework3/Renderer.h"
+#include <stdio.h>
+
+// D3D10_BLEND
+const int ZERO                = 1;
+const int ONE                 = 2;
+const int SRC_COLOR           = 3;
+const int ONE_MINUS_SRC_COLOR = 4;
+const int SRC_ALPHA           = 5;
+const int ONE_MINUS_SRC_ALPHA = 6;
+const int DST_ALPHA           = 7;
+const int ONE_MINUS_DST_ALPHA = 8;
+const int DST_COLOR           = 9;
+const int ONE_MINUS_DST_COLOR = 10;
+const int SRC_ALPHA_SATURATE  = 11;
+
+// D3D10_BLEND_OP
+const int BM_ADD              = 1;
+const int BM_SUBTRACT         = 2;
+const int BM_REVERSE_SUBTRACT = 3;
+const int BM_MIN              = 4;
+const int BM_MAX              = 5;
+
+// D3D10_COMPARISON_FUNC
+const int NEVER    = 1;
+const int LESS     = 2;
+const int EQUAL    = 3;
+const int LEQUAL   = 4;
+const int GREATER  = 5;
+const int NOTEQUAL = 6;
+const int GEQUAL   = 7;
+const int ALWAYS   = 8;
+
+// D3D10_STENCIL_OP
+const int KEEP     = 1;
+const int SET_ZERO = 2;
+const int REPLACE  = 3;
+const int INCR_SAT = 4;
+const int DECR_SAT = 5;
+const int INVERT   = 6;
+const int INCR     = 7;
+const int DECR     = 8;
+
+// D3D10_CULL_MODE
+const int CULL_NONE  = 1;
+const int CULL_FRONT = 2;
+const int CULL_BACK  = 3;
+
+// D3D10_FILL_MODE
+const int WIREFRAME = 2;
+const int SOLID     = 3;
+
+// No message boxes, the cooker runs from the command line
+void ErrorMsg(const char *string){
+	fprintf(stderr, "Error: %s\n", string);
+}
+
+void WarningMsg(const char *string){
+	fprintf(stderr, "Warning: %s\n", string);
+}
+
+void InfoMsg(const char *string){
+	printf("%s\n", string);
+}
+
+#endif // _WIN32
@@ -23,15 +23,23 @@
 #include "GC3D.h"
 #include "GDModel.h"
 #include "GDAnim.h"
-#include "BMDRead\bck.h"
-#include "BMDRead\bmdread.h"
-#include "BMDRead\openfile.h"
+#include "TextureRegistry.h"
+#include "TextureStreamer.h"
+#include "BMDRead/bck.h"
+#include "BMDRead/bmdread.h"
+#include "BMDRead/openfile.h"
 
 //TODO: Remove HACK
 #include <fstream>
 
 BaseApp *app = new App();
 
+// Streamed texture levels uploaded per frame, a few ms worth of uploads
+static const uint kTextureUploadBytesPerFrame = 4 * 1024 * 1024;
+
+// The model roughly fills the screen from the camera distance resetCamera() uses
+static const float kFullScreenDistance = 220.0f;
+
 bool App::init()
 {
 	animLoaded = false;
@@ -60,20 +68,48 @@ bool App::load(int argc, char** argv)
 	if (argc < 1) { return false; }
 	char* filename = argv[0];
 
+	// -compact keeps 16 bit textures at 16 bits instead of expanding them to RGBA8,
+	// -mips generates mipmaps for textures that have none (-linear-mips without sRGB filtering),
+	// -texture-budget sets the MB the streamed textures of baked models may use
+	u32 tex1Flags = 0;
+	uint textureBudgetMB = 256;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-compact") == 0) { tex1Flags |= TEX1_COMPACT_FORMATS; }
+		if (strcmp(argv[i], "-mips") == 0) { tex1Flags |= TEX1_GENERATE_MIPMAPS | TEX1_SRGB_MIPMAPS; }
+		if (strcmp(argv[i], "-linear-mips") == 0) { tex1Flags |= TEX1_GENERATE_MIPMAPS; }
+		if (strcmp(argv[i], "-texture-budget") == 0 && i + 1 < argc) { textureBudgetMB = atoi(argv[++i]); }
+	}
+
+	TextureStreamer::Init(textureBudgetMB * 1024 * 1024, kTextureUploadBytesPerFrame);
+
 	// Load Model
 	OpenedFile* file = openFile(filename);
 	if(file)
     {
-		char fourcc[4];
-		fread(fourcc, 1, 4, file->f);
-		if (memcmp(fourcc, "J3D", 3) == 0)
+		if (file->size >= 4 && memcmp(file->data, "J3D", 3) == 0)
 		{
-			fseek(file->f, 0, SEEK_SET);
-			BModel* bdl = loadBmd(file->f);
-			GDModel::Load(&m_GDModel, bdl);
+			BModel* bdl = loadBmd(file->data, file->size, BMD_ALL, 0, tex1Flags); // parse the sections on all cores
+			RESULT r = GDModel::Load(&m_GDModel, bdl);
 			delete bdl;
+			if (FAILED(r))
+			{
+				closeFile(file);
+				return false;
+			}
+		}
+		else if (file->size >= 4 && memcmp(file->data, "GDMB", 4) == 0)
+		{
+			// Baked model. It references the blob until it is unloaded.
+			m_ModelBlob = (ubyte*)malloc(file->size);
+			memcpy(m_ModelBlob, file->data, file->size);
+			if (FAILED(GDModel::Reload(&m_GDModel, m_ModelBlob, file->size)))
+			{
+				closeFile(file);
+				return false;
+			}
 		}
-		else if (memcmp(fourcc, "bmd1", 4) == 0)
+		else if (file->size >= 4 && memcmp(file->data, "bmd1", 4) == 0)
 		{
 			WARN("bmd1 format no longer supported\n");
 			closeFile(file);
@@ -94,12 +130,9 @@ bool App::load(int argc, char** argv)
 		file = openFile(filename);
 		if (file)
 		{
-			char fourcc[4];
-			fread(fourcc, 1, 4, file->f);
-			if (memcmp(fourcc, "J3D", 3) == 0)
+			if (file->size >= 4 && memcmp(file->data, "J3D", 3) == 0)
 			{
-				fseek(file->f, 0, SEEK_SET);
-				Bck* bck = readBck(file->f);
+				Bck* bck = readBck(file->data, file->size);
 				GDAnim::Load(&m_restAnim, bck);
 				animLoaded = true;
 				delete bck;
@@ -121,7 +154,11 @@ cleanup:
 
 void App::unload()
 {
+	// The streamer reads from the blob until it is shut down
 	GDModel::Unload(&m_GDModel);
+	TextureStreamer::Shutdown(renderer);
+	free(m_ModelBlob);
+	m_ModelBlob = nullptr;
 }
 
 bool App::onKey(const uint key, const bool pressed)
@@ -164,6 +201,47 @@ void App::drawFrame()
 		renderer->setGlobalConstant4x4f("WorldViewProj", view_proj);
 	renderer->apply();
 
+	// Stream the textures for the size the model has on screen
+	float distance = max(length(camPos), 1.0f);
+	GDModel::SetScreenSize(&m_GDModel, height * kFullScreenDistance / distance);
+	TextureStreamer::Update(renderer);
+
 	GDModel::Update(&m_GDModel, animLoaded ? &m_restAnim : nullptr, time*30);
+	GDModel::SetView(&m_GDModel, view_proj, camPos);
 	GDModel::Draw(renderer, &m_GDModel);
+
+	// Each stats line that shows goes on the next row
+	float textY = 48;
+
+	TextureStreamer::Stats stats;
+	TextureStreamer::GetStats(&stats);
+	if (stats.nTextures > 0)
+	{
+		char str[128];
+		sprintf(str, "Textures %u/%u resident, %u pending, %.1f/%.1f MB (budget %.0f MB)", stats.nFullyResident, stats.nTextures,
+			stats.nPending, stats.residentBytes / 1048576.0f, stats.fullBytes / 1048576.0f, stats.budgetBytes / 1048576.0f);
+		renderer->drawText(str, 8, textY, 14, 18, defaultFont, linearClamp, blendSrcAlpha, noDepthTest);
+		textY += 18;
+	}
+
+	const GDModel::DrawStats& drawStats = m_GDModel.drawStats;
+	if (drawStats.nClusters > 0)
+	{
+		char str[128];
+		sprintf(str, "Clusters %u, %u outside, %u backfacing, %.1f%% of the indices in %u draws", drawStats.nClusters, 
+			drawStats.nCulledClusters, drawStats.nBackfaceClusters, 100.0f * drawStats.nDrawnIndices / drawStats.nIndices, drawStats.nDrawCalls);
+		renderer->drawText(str, 8, textY, 14, 18, defaultFont, linearClamp, blendSrcAlpha, noDepthTest);
+		textY += 18;
+	}
+
+	TextureRegistry::Stats shared;
+	TextureRegistry::GetStats(&shared);
+	if (shared.nReferences > shared.nTextures)
+	{
+		char str[128];
+		sprintf(str, "Textures shared: %u unique for %u references, %.1f MB saved", shared.nTextures, shared.nReferences,
+			shared.sharedBytes / 1048576.0f);
+		renderer->drawText(str, 8, textY, 14, 18, defaultFont, linearClamp, blendSrcAlpha, noDepthTest);
+		textY += 18;
+	}
 }
@@ -45,6 +45,7 @@ public:
 
 protected:	
 	ubyte* m_AnimBlob;
+	ubyte* m_ModelBlob;
 	GDModel::GDModel m_GDModel;
 
 	bool animLoaded;
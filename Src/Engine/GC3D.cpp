@@ -5,7 +5,7 @@
 //TODO: Remove all dependencies on gx.h
 #include "gx.h"
 
-#include <Framework3\Renderer.h>
+#include <Framework3/Renderer.h>
 
 namespace GC3D
 {
@@ -26,43 +26,96 @@ namespace GC3D
 		{ 0, TYPE_TEXCOORD, FORMAT_FLOAT, 2 }, // Texture Coordinate 6
 		{ 0, TYPE_TEXCOORD, FORMAT_FLOAT, 2 }, // Texture Coordinate 7
 	};
+
+	// COMPACT_VERTICES
+	FormatDesc __GCcompactFormat[MAX_VERTEX_ATTRIBS] =
+	{
+		// Stream, Type, Format, Size
+		{ 0, TYPE_GENERIC,	FORMAT_UINT,  1, true }, // Matrix Index, in the Position's w
+		{ 0, TYPE_VERTEX,   FORMAT_SHORT, 4 }, // Position
+		{ 0, TYPE_NORMAL,   FORMAT_BYTE,  4 }, // Normal
+		{ 0, TYPE_COLOR,	FORMAT_UBYTE, 4 }, // Color 0
+		{ 0, TYPE_COLOR,	FORMAT_UBYTE, 4 }, // Color 1
+		{ 0, TYPE_TEXCOORD, FORMAT_HALF,  2 }, // Texture Coordinate 0
+		{ 0, TYPE_TEXCOORD, FORMAT_HALF,  2 }, // Texture Coordinate 1
+		{ 0, TYPE_TEXCOORD, FORMAT_HALF,  2 }, // Texture Coordinate 2
+		{ 0, TYPE_TEXCOORD, FORMAT_HALF,  2 }, // Texture Coordinate 3
+		{ 0, TYPE_TEXCOORD, FORMAT_HALF,  2 }, // Texture Coordinate 4
+		{ 0, TYPE_TEXCOORD, FORMAT_HALF,  2 }, // Texture Coordinate 5
+		{ 0, TYPE_TEXCOORD, FORMAT_HALF,  2 }, // Texture Coordinate 6
+		{ 0, TYPE_TEXCOORD, FORMAT_HALF,  2 }, // Texture Coordinate 7
+	};
+
+	// COMPACT_VERTICES | COMPACT_FLOAT_TEXCOORDS
+	FormatDesc __GCcompactFloatTexcoordsFormat[MAX_VERTEX_ATTRIBS] =
+	{
+		// Stream, Type, Format, Size
+		{ 0, TYPE_GENERIC,	FORMAT_UINT,  1, true }, // Matrix Index, in the Position's w
+		{ 0, TYPE_VERTEX,   FORMAT_SHORT, 4 }, // Position
+		{ 0, TYPE_NORMAL,   FORMAT_BYTE,  4 }, // Normal
+		{ 0, TYPE_COLOR,	FORMAT_UBYTE, 4 }, // Color 0
+		{ 0, TYPE_COLOR,	FORMAT_UBYTE, 4 }, // Color 1
+		{ 0, TYPE_TEXCOORD, FORMAT_FLOAT, 2 }, // Texture Coordinate 0
+		{ 0, TYPE_TEXCOORD, FORMAT_FLOAT, 2 }, // Texture Coordinate 1
+		{ 0, TYPE_TEXCOORD, FORMAT_FLOAT, 2 }, // Texture Coordinate 2
+		{ 0, TYPE_TEXCOORD, FORMAT_FLOAT, 2 }, // Texture Coordinate 3
+		{ 0, TYPE_TEXCOORD, FORMAT_FLOAT, 2 }, // Texture Coordinate 4
+		{ 0, TYPE_TEXCOORD, FORMAT_FLOAT, 2 }, // Texture Coordinate 5
+		{ 0, TYPE_TEXCOORD, FORMAT_FLOAT, 2 }, // Texture Coordinate 6
+		{ 0, TYPE_TEXCOORD, FORMAT_FLOAT, 2 }, // Texture Coordinate 7
+	};
 		
 	static const int formatSize[] = { 
-		sizeof(float), sizeof(half), sizeof(ubyte), sizeof(uint) 
+		sizeof(float), sizeof(half), sizeof(ubyte), sizeof(uint), sizeof(short), sizeof(char)
 	};
+
+	static uint GetFormatSize (const FormatDesc& format)
+	{
+		return format.empty ? 0 : format.size * formatSize[format.format];
+	}
+
+	static const FormatDesc* GetFormats (u16 attribFlags)
+	{
+		if (attribFlags & COMPACT_FLOAT_TEXCOORDS) return __GCcompactFloatTexcoordsFormat;
+		return (attribFlags & COMPACT_VERTICES) ? __GCcompactFormat : __GCformat;
+	}
 	
 	int GetAttributeSize (u16 attrib)
 	{
+		const FormatDesc* formats = GetFormats(attrib);
+		attrib &= ~(COMPACT_VERTICES | COMPACT_FLOAT_TEXCOORDS);
+
 		uint index = 0;
 		while ( (attrib >> index) != 1 ) ++index; 
-		uint count = __GCformat[index].size;
-		uint size = formatSize[__GCformat[index].format];
-		return count * size;
+		return GetFormatSize(formats[index]);
 	}
 
 	int GetVertexSize (u16 attribFlags)
 	{
+		const FormatDesc* formats = GetFormats(attribFlags);
+
 		// Always include Matrix Index (whether it's enabled or not)
-		int vertSize = __GCformat[0].size * formatSize[__GCformat[0].format];
+		int vertSize = GetFormatSize(formats[0]);
 		for (int i = 1; i < MAX_VERTEX_ATTRIBS; ++i) 
 		{
 			if ( attribFlags & (1 << i) )
 			{
-				vertSize += __GCformat[i].size * formatSize[__GCformat[i].format];
+				vertSize += GetFormatSize(formats[i]);
 			}
 		}
 
 		return vertSize;
 	}
 
-	void GC3D::ConvertGCVertexFormat (u16 attribFlags, FormatDesc* formatBuf)
+	void ConvertGCVertexFormat (u16 attribFlags, FormatDesc* formatBuf)
 	{
+		const FormatDesc* formats = GetFormats(attribFlags);
 		int numAttribs = util::bitcount(attribFlags);
 
 		int formatBufIndex = 0;
 		for (int i = 0; i < MAX_VERTEX_ATTRIBS; ++i) 
 		{
-			formatBuf[i] = __GCformat[i];
+			formatBuf[i] = formats[i];
 
 			if (i == 0) continue; // Never disable the Matrix Index (we'll set it to 0)
 			
@@ -74,7 +127,7 @@ namespace GC3D
 		}
 	}
 
-	int GC3D::ConvertGCDepthFunction (u8 gcDepthFunc)
+	int ConvertGCDepthFunction (u8 gcDepthFunc)
 	{
 		switch(gcDepthFunc)
 		{
@@ -92,7 +145,7 @@ namespace GC3D
 		}
 	}
 	
-	int GC3D::ConvertGCCullMode(u8 gcCullMode)
+	int ConvertGCCullMode(u8 gcCullMode)
 	{
 		switch(gcCullMode)
 		{
@@ -106,7 +159,7 @@ namespace GC3D
 		}
 	}
 
-	int GC3D::ConvertGCBlendFactor(u8 gcBlendFactor)
+	int ConvertGCBlendFactor(u8 gcBlendFactor)
 	{
 		switch (gcBlendFactor)
 		{
@@ -124,7 +177,7 @@ namespace GC3D
 		}
 	}
 
-	int GC3D::ConvertGCBlendOp (u8 gcBlendOp)
+	int ConvertGCBlendOp (u8 gcBlendOp)
 	{
 		switch (gcBlendOp)
 		{
@@ -139,13 +192,15 @@ namespace GC3D
 		}
 	}
 
-	FORMAT GC3D::ConvertGCTextureFormat(u8 format)
+	FORMAT ConvertGCTextureFormat(u8 format)
 	{
 		// TODO: Define these formats in the common folder and share with Interpreter
 		switch (format)
 		{
 		case /*I8:	*/ 1:	return FORMAT_R8;
 		case /*I8_A8*/ 3:	return FORMAT_RG8;
+		case /*RGB565*/ 4:	return FORMAT_RGB565;
+		case /*RGBA4*/ 5:	return FORMAT_RGBA4;
 		case /*RGBA8*/ 6:	return FORMAT_RGBA8;
 		case /*DXT1 */ 14:	return FORMAT_DXT1;
 		case 0xff: //Error case, fall through to default
@@ -153,7 +208,55 @@ namespace GC3D
 		}
 	}
 	
-	AddressMode GC3D::ConvertGCTexWrap(u8 addressMode)
+	FORMAT PrepareTextureCompression(Image& img)
+	{
+		// D3D needs whole blocks on the top level
+		if (img.getWidth() % 4 != 0 || img.getHeight() % 4 != 0)
+			return FORMAT_NONE;
+
+		switch (img.getFormat())
+		{
+		case FORMAT_R8:
+			return FORMAT_ATI1N;
+
+		case FORMAT_RG8:
+			// The encoder uses the channel order of the ATI2 decoder in Image.cpp, which
+			// the renderer samples as BC5 with the channels swapped. Keep intensity in red.
+			img.swap(0, 1);
+			return FORMAT_ATI2N;
+
+		case FORMAT_RGB565:
+			img.unpackImage();
+			return FORMAT_DXT1;
+
+		case FORMAT_RGBA4:
+			img.unpackImage();
+			// Fall through
+		case FORMAT_RGBA8:
+		{
+			// BC1 unless any texel is not opaque
+			const ubyte* pixels = img.getPixels();
+			int size = img.getMipMappedSize(0, img.getMipMapCount());
+			for (int i = 3; i < size; i += 4)
+			{
+				if (pixels[i] != 255)
+					return FORMAT_DXT5;
+			}
+			return FORMAT_DXT1;
+		}
+
+		default:
+			return FORMAT_NONE;
+		}
+	}
+
+	bool CompressTexture(Image& img, int quality)
+	{
+		FORMAT format = PrepareTextureCompression(img);
+		return format != FORMAT_NONE && img.compressImage(format, quality);
+	}
+	
+	AddressMode ConvertGCTexWrap(u8 addressMode)
 	{
 	    //from gx.h:
 	    //0: clamp to edge
@@ -169,7 +272,7 @@ namespace GC3D
 	}
 	
 	// TODO: DX supports min and mag filters. Add support to the renderer so that we can use both.
-	Filter GC3D::ConvertGCTexFilter(u8 minFilter, u8 magFilter)
+	Filter ConvertGCTexFilter(u8 minFilter, u8 magFilter)
 	{
 		if (magFilter != minFilter)
 			WARN("Renderer does not support different texture filter types for Minification and Magnification. Rendering may be incorrect\n");
@@ -1,11 +1,19 @@
 #pragma once
 
-#include <Framework3\Renderer.h>
+#include <Framework3/Renderer.h>
 #include "Types.h"
 
 namespace GC3D
 {
 	#define MAX_VERTEX_ATTRIBS 13
+
+	// Set in the attribute flags of vertices in the compact layout (see GDModel::BakeOptions::compactVertices):
+	// s16 positions, scaled by the PositionScale and PositionOffset of their batch, with the matrix index
+	// in their 4th component, snorm8 normals and half texcoords.
+	#define COMPACT_VERTICES (1 << 15)
+	// Set together with COMPACT_VERTICES for batches whose texcoords are too large to be halfs. 
+	// Their texcoords stay floats, the rest of the vertex is compact.
+	#define COMPACT_FLOAT_TEXCOORDS (1 << 14)
 	
 	int GetAttributeSize (u16 attrib);
 	int GetVertexSize (u16 attribFlags);
@@ -15,8 +23,23 @@ namespace GC3D
 	int ConvertGCBlendOp (u8 gcBlendOp);
 	int ConvertGCCullMode(u8 gcCullMode);
 	FORMAT ConvertGCTextureFormat(u8 format);
+	
+	// Gets a texture in a ConvertGCTextureFormat() format ready for Image::compressImage() and
+	// returns the block compressed format to use, FORMAT_NONE if it should stay as it is
+	FORMAT PrepareTextureCompression(Image& img);
+	// Block compresses a texture in a ConvertGCTextureFormat() format. False if it stays as it is.
+	bool CompressTexture(Image& img, int quality);
 	Filter ConvertGCTexFilter(u8 magFilter, u8 minFilter);
 	AddressMode ConvertGCTexWrap(u8 wrapMode);
 	void ConvertGCVertexFormat (u16 attribFlags, FormatDesc* formatBuf);
 
+	// A texture stage whose image was packed into a texture atlas (see GDModel::Bake()). The pixel shader
+	// applies the wrap modes itself and then maps the texcoords into the atlas with the TexRect constant.
+	struct AtlasStage
+	{
+		bool inAtlas;
+		AddressMode wrapS;
+		AddressMode wrapT;
+	};
+
 } // namespace GC3D
\ No newline at end of file
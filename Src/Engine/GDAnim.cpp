@@ -1,5 +1,29 @@
 #include "GDAnim.h"
-#include "BMDRead\bck.h"
+#include "BMDRead/bck.h"
+#include "util.h"
+
+// Baked animation blob, see GDAnim::Bake()
+enum AnimBlobSection
+{
+	AB_SCALE_KEYS,
+	AB_ROT_KEYS,
+	AB_TRANS_KEYS,
+	AB_JOINT_TIMELINES,
+	AB_SECTION_COUNT
+};
+
+const u32 kAnimBlobMagic = 0x42414447; // "GDAB"
+const u32 kAnimBlobVersion = 1;
+
+struct AnimBlobHeader
+{
+	u32 magic;
+	u32 version;
+	u32 size; // of the whole blob, in bytes
+	u16 animLength;
+	u16 pad;
+	util::BlobRange sections[AB_SECTION_COUNT];
+};
 
 RESULT GDAnim::Load(GDAnim* anim, const Bck* bck)
 {
@@ -8,11 +32,21 @@ RESULT GDAnim::Load(GDAnim* anim, const Bck* bck)
 
 	// jnt0.sx[0], jnt0.sx[1], ..., jnt1.sx[0], jnt1.sx[1], ... jnt0.sy[0], jnt0.sy[1], ...
 
-	const u32 kMaxKeysPerChannel = 1024;
-	anim->scaleKeys = (Key*)malloc(sizeof(Key) * kMaxKeysPerChannel);
-	anim->transKeys = (Key*)malloc(sizeof(Key) * kMaxKeysPerChannel);
-	anim->rotKeys = (Key*)malloc(sizeof(Key) * kMaxKeysPerChannel);
+	u32 numScaleKeys = 0, numTransKeys = 0, numRotKeys = 0;
+	for (u32 i = 0; i < jointCount; i++)
+	{
+		const JointAnim& a = bck->anims[i];
+		numScaleKeys += a.scalesX.size() + a.scalesY.size() + a.scalesZ.size();
+		numTransKeys += a.translationsX.size() + a.translationsY.size() + a.translationsZ.size();
+		numRotKeys += a.rotationsX.size() + a.rotationsY.size() + a.rotationsZ.size();
+	}
+
+	// +1 so that empty animations still get valid pointers
+	anim->scaleKeys = (Key*)malloc(sizeof(Key) * (numScaleKeys + 1));
+	anim->transKeys = (Key*)malloc(sizeof(Key) * (numTransKeys + 1));
+	anim->rotKeys = (Key*)malloc(sizeof(Key) * (numRotKeys + 1));
 	anim->jointTimelines = (JointTimeline*)malloc(sizeof(JointTimeline) * jointCount);
+	anim->blob = nullptr;
 
 	// Scale
 	u32 keyOffset = 0;
@@ -104,20 +138,124 @@ RESULT GDAnim::Load(GDAnim* anim, const Bck* bck)
 //Our backing asset is about to be deleted. Do any necessary cleanup.
 RESULT GDAnim::Unload(GDAnim* anim)
 {
-	free(anim->jointTimelines);
-	free(anim->rotKeys);
-	free(anim->scaleKeys);
-	free(anim->transKeys);
-	memset(anim, 0, sizeof(anim));
+	if (anim->blob == nullptr)
+	{
+		free(anim->jointTimelines);
+		free(anim->rotKeys);
+		free(anim->scaleKeys);
+		free(anim->transKeys);
+	}
+	memset(anim, 0, sizeof(*anim));
 	return S_OK;
 }
 
 //Initialize our new asset. The asset manager will then delete the old asset.
-RESULT GDAnim::Reload(GDAnim* anim, ubyte* blob)
+RESULT GDAnim::Reload(GDAnim* anim, ubyte* blob, uint size)
 {
+	const AnimBlobHeader* header = (const AnimBlobHeader*)blob;
+	const util::BlobRange* sections = header->sections;
+
+	if (size < sizeof(AnimBlobHeader) || header->magic != kAnimBlobMagic || header->version != kAnimBlobVersion)
+	{
+		WARN("Not a baked animation, or baked with a different version\n");
+		return E_FAIL;
+	}
+
+	if (header->size > size ||
+		!util::BlobCheck(sections[AB_SCALE_KEYS], sizeof(Key), header->size) ||
+		!util::BlobCheck(sections[AB_ROT_KEYS], sizeof(Key), header->size) ||
+		!util::BlobCheck(sections[AB_TRANS_KEYS], sizeof(Key), header->size) ||
+		!util::BlobCheck(sections[AB_JOINT_TIMELINES], sizeof(JointTimeline), header->size))
+	{
+		WARN("Baked animation is corrupt\n");
+		return E_FAIL;
+	}
+
+	// Every channel of every joint reads its keys from inside of its key array
+	const JointTimeline* timelines = util::BlobRead<JointTimeline>(blob, sections[AB_JOINT_TIMELINES]);
+	for (u32 i = 0; i < sections[AB_JOINT_TIMELINES].count; i++)
+	{
+		for (u32 j = 0; j < 3; j++)
+		{
+			if (u32(timelines[i].s[j].index) + timelines[i].s[j].count > sections[AB_SCALE_KEYS].count ||
+				u32(timelines[i].r[j].index) + timelines[i].r[j].count > sections[AB_ROT_KEYS].count ||
+				u32(timelines[i].t[j].index) + timelines[i].t[j].count > sections[AB_TRANS_KEYS].count)
+			{
+				WARN("Baked animation is corrupt\n");
+				return E_FAIL;
+			}
+		}
+	}
+
+	if (anim->jointTimelines)
+	{
+		Unload(anim);
+	}
+
+	anim->scaleKeys = util::BlobRead<Key>(blob, sections[AB_SCALE_KEYS]);
+	anim->rotKeys = util::BlobRead<Key>(blob, sections[AB_ROT_KEYS]);
+	anim->transKeys = util::BlobRead<Key>(blob, sections[AB_TRANS_KEYS]);
+	anim->jointTimelines = util::BlobRead<JointTimeline>(blob, sections[AB_JOINT_TIMELINES]);
+	anim->animLength = header->animLength;
+	anim->blob = blob;
+
 	return S_OK;
 }
 
+// Number of keys in a channel array, the timelines index it contiguously
+u32 CountKeys(const GDAnim::KeyIndex* keys, u32 jointCount)
+{
+	u32 count = 0;
+	for (u32 i = 0; i < jointCount * 3; i++)
+	{
+		count = max(count, u32(keys[i].index + keys[i].count));
+	}
+	return count;
+}
+
+RESULT GDAnim::Bake(const Bck* bck, std::vector<ubyte>& blob)
+{
+	RESULT r = S_OK;
+	GDAnim anim;
+	memset(&anim, 0, sizeof(anim));
+	IFC( Load(&anim, bck) );
+
+	{
+		u32 jointCount = bck->anims.size();
+		std::vector<KeyIndex> s, rot, t;
+		for (u32 i = 0; i < jointCount; i++)
+		{
+			const JointTimeline& jt = anim.jointTimelines[i];
+			s.insert(s.end(), jt.s, jt.s + 3);
+			rot.insert(rot.end(), jt.r, jt.r + 3);
+			t.insert(t.end(), jt.t, jt.t + 3);
+		}
+
+		AnimBlobHeader header;
+		memset(&header, 0, sizeof(header));
+		util::BlobRange* sections = header.sections;
+
+		blob.clear();
+		util::BlobWrite(blob, &header, sizeof(header), 1); // Filled in at the end
+
+		sections[AB_SCALE_KEYS] = util::BlobWrite(blob, anim.scaleKeys, sizeof(Key), CountKeys(s.data(), jointCount));
+		sections[AB_ROT_KEYS] = util::BlobWrite(blob, anim.rotKeys, sizeof(Key), CountKeys(rot.data(), jointCount));
+		sections[AB_TRANS_KEYS] = util::BlobWrite(blob, anim.transKeys, sizeof(Key), CountKeys(t.data(), jointCount));
+		sections[AB_JOINT_TIMELINES] = util::BlobWrite(blob, anim.jointTimelines, sizeof(JointTimeline), jointCount);
+
+		header.magic = kAnimBlobMagic;
+		header.version = kAnimBlobVersion;
+		header.size = blob.size();
+		header.animLength = anim.animLength;
+		memcpy(blob.data(), &header, sizeof(header));
+	}
+
+	Unload(&anim);
+
+cleanup:
+	return r;
+}
+
 template<class T>
 T interpolate(T v1, T d1, T v2, T d2, T t) //t in [0, 1]
 {
@@ -144,15 +282,16 @@ float getAnimValue(GDAnim::Key* keyData, GDAnim::KeyIndex keyIndex, float t)
 
 	keyData += keyIndex.index;
 
+	// Past the last key the last pair is extrapolated
 	int i = 1;
-	while(keyData[i].time < t)
+	while(i < keyIndex.count - 1 && keyData[i].time < t)
 	++i;
 
 	float time = (t - keyData[i - 1].time)/(keyData[i].time - keyData[i - 1].time); //scale to [0, 1]
 	return interpolate(keyData[i - 1].value, keyData[i - 1].tangent, keyData[i].value, keyData[i].tangent, time);
 }
 
-mat4& GDAnim::GetJoint(GDAnim** anims, float* weights, uint numAnims, uint jointID, float time)
+mat4 GDAnim::GetJoint(GDAnim** anims, float* weights, uint numAnims, uint jointID, float time)
 {
 	GDAnim* anim = anims[0];
 		
@@ -1,6 +1,7 @@
 #pragma once
-#include "Common\common.h"
-#include "Framework3\Math\Vector.h"
+#include "Common/common.h"
+#include "Framework3/Math/Vector.h"
+#include <vector>
 
 struct Bck;
 
@@ -34,9 +35,11 @@ namespace GDAnim
 
 		u16 animLength; //in time units
 		JointTimeline* jointTimelines;
+
+		ubyte* blob; //set by Reload(), the keys and timelines point into it
 	};
 
-	mat4& GetJoint(GDAnim** anims, float* weights, uint numAnims, uint jointID, float time);
+	mat4 GetJoint(GDAnim** anims, float* weights, uint numAnims, uint jointID, float time);
 
 	//Save our asset reference and any other initialization
 	RESULT Load(GDAnim* anim, const Bck* bck);
@@ -46,5 +49,9 @@ namespace GDAnim
 
 	//Unregister our old asset with the renderer. Save our new reference.
 	//Initialize our new asset with the renderer. The asset manager will then delete the old asset.
-	RESULT Reload(GDAnim* anim, ubyte* blob);
+	//Fails if the size bytes at blob are not a complete baked animation of this version.
+	RESULT Reload(GDAnim* anim, ubyte* blob, uint size);
+
+	//Convert a parsed animation into a baked blob that Reload() can use directly
+	RESULT Bake(const Bck* bck, std::vector<ubyte>& blob);
 }
\ No newline at end of file
@@ -1,26 +1,24 @@
-#include "Framework3\Renderer.h"
+#include "Framework3/Renderer.h"
 #include "GDModel.h"
 #include "GC3D.h"
 #include "util.h"
-#include "BMDRead\bmdread.h"
+#include "TextureRegistry.h"
+#include "TextureStreamer.h"
+#include "BMDRead/bmdread.h"
+#include "Framework3/Util/TexturePacker.h"
+#include "Framework3/Math/Frustum.h"
+
+#include <float.h>
+#include <stddef.h>
+#include <algorithm>
 
 #define READ(type) *(type*)head; head += sizeof(type);
 #define READ_ARRAY(type, count) (type*)head; head += sizeof(type) * count;
 
 #define MAX_NAME_LENGTH 16
 
-struct VertexBuffer 
-{
-	u16 vertexAttributes;
-	u16 vertexCount;
-	ubyte* vertexBuf;
-};
-
-struct IndexBuffer
-{
-	u16 indexCount;
-	u16* indexBuf;
-};
+static const u16 kStripCutIndex = u16(STRIP_CUT_INDEX); // which is an int
+static const uint kMaxPacketMatrices = 10; // the size of ModelMat, see GenerateVS()
 
 struct Point
 {
@@ -31,11 +29,29 @@ struct Point
 	u16 texIdx[8];
 };
 
+// A part of a packet, drawn unless it is outside of the view or only has faces turned away
+// from it. See BuildClusters(). Stored as is in baked blobs.
+struct _Cluster
+{
+	// In the space of the batch's vertices, before ModelMat
+	vec4 sphere; // center, radius
+	vec4 cone;   // average normal of the triangles, cosine of their largest angle to it. <= 0 if they spread too far to cull.
+
+	u16 firstIndex; // after the packet's first index
+	u16 indexCount;
+	u16 matrixMask; // the ModelMat entries that the vertices use
+	u16 pad;
+};
+
 struct _Packet
 {
 	u16 indexCount;
 	u16 matrixCount;
 	u16* matrixIndices;
+
+	// Baked with BakeOptions::buildClusters, 0 otherwise
+	u16 clusterCount;
+	_Cluster* clusters;
 };
 
 struct _Batch
@@ -43,8 +59,14 @@ struct _Batch
 	VertexBufferID vbID;
 	IndexBufferID ibID;
 	VertexFormatID vfID;
+	int firstIndex; // Into the index buffer that RegisterGFX() shares between all batches
+	u16 primitive; // PRIM_TRIANGLE_STRIP, or PRIM_TRIANGLES once optimized for the vertex cache
 	u16 numPackets;
 	_Packet* packets;
+
+	// Decode the positions of COMPACT_VERTICES, (1, 1, 1) and 0 otherwise
+	vec4 positionScale;
+	vec4 positionOffset;
 };
 
 struct TextureResource
@@ -52,9 +74,10 @@ struct TextureResource
 	char name[MAX_NAME_LENGTH];
 	u16 texIndex;
 
-	Filter filter;
-	AddressMode wrapS;
-	AddressMode wrapT;
+	u8 filter; // Filter
+	u8 wrapS;  // AddressMode
+	u8 wrapT;  // AddressMode
+	u8 pad;
 };
 
 struct TextureDesc
@@ -75,15 +98,22 @@ struct MaterialInfo
 	DepthStateID depthMode;
 	BlendStateID blendMode;
 	RasterizerStateID rasterMode;
+	int cullMode; // CULL_NONE, CULL_BACK or CULL_FRONT, set by RegisterGFX() for culling the clusters
 		
 	TextureID textures[8];
 	SamplerStateID samplers[8];
+
+	// Set by Bake() when some of the textures were packed into atlases. texRects are the
+	// offset (xy) and size (zw) of each texture stage in its atlas, see GeneratePS()
+	u8 usesAtlas;
+	u8 pad[3];
+	vec4 texRects[8];
 };
 
 struct DepthMode
 {
-	bool testEnable;
-	bool writeEnable;
+	u8 testEnable;
+	u8 writeEnable;
 	u8 func;
 };
 
@@ -97,7 +127,8 @@ struct BlendMode
 struct DrwElement
 {
 	u16 index;
-	bool isWeighted;
+	u8 isWeighted;
+	u8 pad;
 };
 
 struct JointElement
@@ -105,6 +136,7 @@ struct JointElement
 	mat4 matrix;
 	char name[MAX_NAME_LENGTH];
 	u16 parent;
+	u16 pad;
 };
 	
 struct WeightedIndex
@@ -145,6 +177,107 @@ struct Scenegraph
 	u16 type; //One of SgNodeType
 };
 
+// Baked model blob, see GDModel::Bake(). A header followed by 16-byte aligned 
+// arrays. All pointers are stored as offsets or indices.
+enum ModelBlobSection
+{
+	MB_SCENEGRAPH,
+	MB_BATCHES,
+	MB_PACKETS,
+	MB_MATRIX_INDICES,
+	MB_CLUSTERS,
+	MB_MATERIALS,
+	MB_DRW_TABLE,
+	MB_JOINTS,
+	MB_DEFAULT_POSE,
+	MB_EVP_MATRICES,
+	MB_EVP_SIZES,
+	MB_EVP_OFFSETS,
+	MB_EVP_WEIGHTED_INDICES,
+	MB_TEXTURE_RESOURCES,
+	MB_TEXTURES,
+	MB_TEXTURE_DATA,
+	MB_BLEND_MODES,
+	MB_DEPTH_MODES,
+	MB_CULL_MODES,
+	MB_VS_OFFSETS,
+	MB_PS_OFFSETS,
+	MB_VS_SHADERS,
+	MB_PS_SHADERS,
+	MB_VERTEX_INDEX_BUFFERS,
+	MB_SECTION_COUNT
+};
+
+const u32 kModelBlobMagic = 0x424D4447; // "GDMB"
+const u32 kModelBlobVersion = 7;
+
+struct ModelBlobHeader
+{
+	u32 magic;
+	u32 version;
+	u32 size; // of the whole blob, in bytes
+	u32 reserved;
+	util::BlobRange sections[MB_SECTION_COUNT];
+};
+
+struct BlobBatch
+{
+	u16 numPackets;
+	u16 primitive;
+	u32 firstPacket;
+	vec4 positionScale;
+	vec4 positionOffset;
+};
+
+struct BlobPacket
+{
+	u16 indexCount;
+	u16 matrixCount;
+	u32 firstMatrixIndex;
+	u32 firstCluster;
+	u16 clusterCount;
+	u16 pad;
+};
+
+struct BlobTexture
+{
+	u32 format; // FORMAT
+	u32 width;
+	u32 height;
+	u32 numMips;
+
+	u32 sizeBytes;
+	u32 texDataOffset; // into MB_TEXTURE_DATA
+};
+
+// The cooker and the engine can be built by different compilers, but Reload() uses the structs
+// of a blob in place. Their fields are fixed-width, and these catch any layout that differs.
+static_assert(sizeof(vec4) == 16 && sizeof(mat4) == 64, "vector layout of baked blobs");
+static_assert(sizeof(ModelBlobHeader) == 16 + 8 * MB_SECTION_COUNT, "ModelBlobHeader layout");
+static_assert(sizeof(Scenegraph) == 4, "Scenegraph layout");
+static_assert(sizeof(BlobBatch) == 40 && offsetof(BlobBatch, positionScale) == 8, "BlobBatch layout");
+static_assert(sizeof(BlobPacket) == 16 && offsetof(BlobPacket, firstCluster) == 8, "BlobPacket layout");
+static_assert(sizeof(_Cluster) == 40 && offsetof(_Cluster, firstIndex) == 32, "_Cluster layout");
+static_assert(sizeof(MaterialInfo) == 216 && offsetof(MaterialInfo, samplers) == 52 &&
+	offsetof(MaterialInfo, usesAtlas) == 84 && offsetof(MaterialInfo, texRects) == 88, "MaterialInfo layout");
+static_assert(sizeof(DrwElement) == 4 && offsetof(DrwElement, isWeighted) == 2, "DrwElement layout");
+static_assert(sizeof(JointElement) == 84 && offsetof(JointElement, parent) == 80, "JointElement layout");
+static_assert(sizeof(WeightedIndex) == 8, "WeightedIndex layout");
+static_assert(sizeof(TextureResource) == 22 && offsetof(TextureResource, filter) == 18, "TextureResource layout");
+static_assert(sizeof(BlobTexture) == 24, "BlobTexture layout");
+static_assert(sizeof(BlendMode) == 3 && sizeof(DepthMode) == 3, "BlendMode and DepthMode layout");
+
+static const uint kModelBlobElemSizes[MB_SECTION_COUNT] = 
+{
+	sizeof(Scenegraph), sizeof(BlobBatch), sizeof(BlobPacket), sizeof(u16), sizeof(_Cluster),
+	sizeof(MaterialInfo), sizeof(DrwElement), sizeof(JointElement), sizeof(JointElement),
+	sizeof(mat4), sizeof(u8), sizeof(u16), sizeof(WeightedIndex),
+	sizeof(TextureResource), sizeof(BlobTexture), sizeof(ubyte),
+	sizeof(BlendMode), sizeof(DepthMode), sizeof(u8),
+	sizeof(uint), sizeof(uint), sizeof(char), sizeof(char), 
+	sizeof(ubyte),
+};
+
 void loadFrame(const Frame& frame, mat4* matrix)
 {
 	mat4 t, rx, ry, rz, s;
@@ -247,16 +380,37 @@ RESULT buildVertex(ubyte* dst, const Index& point, u16 attribs, const Vtx1& vtx)
 	return S_OK;
 }
 
-void loadVertexIndexBuffers(const Batch& batch, const Vtx1& vtx,
-	VertexBuffer* vb, IndexBuffer* ib, u16* packetIndexCounts)
+// Not a vertex index, those are u16 and below kStripCutIndex (see loadVertexIndexBuffers())
+static const u32 kEmptyWeldSlot = 0xffffffff;
+
+// Welds the vertex that was just built at vertexCount to an identical one that is already in the
+// buffer. weldTable is an open addressing hash table of vertex indices, with a power of two size.
+// Returns the index of the identical vertex, or vertexCount after adding the new one to the table.
+uint weldVertex(std::vector<u32>& weldTable, const ubyte* vertices, uint vertexSize, uint vertexCount)
 {
-	std::map<u64, u16> indexSet;
-	int pointCount = 0;
-	int primCount = 0;
+	static const uint64_t seed = 101;
+	const ubyte* vertex = vertices + vertexSize * vertexCount;
 
-	u16 vertexAttributes = loadAttribs(batch.attribs);
+	uint mask = weldTable.size() - 1;
+	uint slot = uint(util::hash64(vertex, vertexSize, seed)) & mask;
+	while (weldTable[slot] != kEmptyWeldSlot)
+	{
+		if (memcmp(vertices + vertexSize * weldTable[slot], vertex, vertexSize) == 0)
+			return weldTable[slot];
+		slot = (slot + 1) & mask;
+	}
+
+	weldTable[slot] = vertexCount;
+	return vertexCount;
+}
+
+// Returns the size of the batch in the gfxData.vertexIndexBuffers layout if every point becomes a
+// vertex, the most that loadVertexIndexBuffers() can write
+uint getMaxVertexIndexBufferSize(const Batch& batch)
+{
+	uint primCount = 0;
+	uint pointCount = 0;
 
-	// Count "points" in this batch
 	// A point is a struct of indexes that point to each attribute of the 3D vertex
 	// pointCount represents the maximum number of vertices needed. If we find dups, there may be less.
 	for (uint i = 0; i < batch.packets.size(); i++)
@@ -272,17 +426,41 @@ void loadVertexIndexBuffers(const Batch& batch, const Vtx1& vtx,
 		}
 	}
 
-	// Create vertex buffer for this batch based on available attributes
-	int vertexSize = GC3D::GetVertexSize(vertexAttributes);
-	int bufferSize = pointCount * vertexSize; // we may not need all this space, see pointCount above
+	// Attributes, vertex count, vertices, index count, and an index per point plus a strip-cut per primitive
+	uint vertexSize = GC3D::GetVertexSize(loadAttribs(batch.attribs));
+	return 3 * sizeof(u16) + pointCount * vertexSize + (pointCount + primCount) * sizeof(u16);
+}
 
-	ubyte*	vertices = (ubyte*)malloc(bufferSize);
-	u16*	indices = (u16*)malloc((pointCount + primCount) * sizeof(u16));
+// Writes the batch into dst in the gfxData.vertexIndexBuffers layout: its attributes and vertex count,
+// its vertices, then its index count and indices. Returns the number of bytes written, at most
+// getMaxVertexIndexBufferSize(), or 0 if the batch has more vertices or indices than the u16 counts
+// and indices of that layout can hold. weldTable and indices are scratch memory that can be reused 
+// from batch to batch.
+uint loadVertexIndexBuffers(const Batch& batch, const Vtx1& vtx, ubyte* dst, u16* packetIndexCounts, 
+	std::vector<u32>& weldTable, std::vector<u16>& indices)
+{
+	uint pointCount = 0;
+	for (uint i = 0; i < batch.packets.size(); i++)
+	{
+		const std::vector<Primitive>& prims = batch.packets[i].primitives;
+		for (uint j = 0; j < prims.size(); j++) { pointCount += prims[j].points.size(); }
+	}
 
-	// Interlace each attribute into a single vertex stream 
-	// (may be duplicates because it's using indices into the vtx1 buffer) 
-	int indexCount = 0;
-	int vertexCount = 0;
+	// The vertices are built straight into dst, only the indices have to wait for the final vertex count
+	u16 vertexAttributes = loadAttribs(batch.attribs);
+	int vertexSize = GC3D::GetVertexSize(vertexAttributes);
+	ubyte* vertices = dst + 2 * sizeof(u16);
+	indices.clear();
+
+	// At most half full, so that the probe sequences stay short
+	uint weldTableSize = 1;
+	while (weldTableSize < 2 * pointCount) { weldTableSize *= 2; }
+	weldTable.assign(weldTableSize, kEmptyWeldSlot);
+
+	// Interlace each attribute into a single vertex stream. Points with different vtx1 indices
+	// can still make identical vertices (e.g. attributes the batch doesn't use), so the built
+	// vertices are compared rather than the indices.
+	uint vertexCount = 0;
 	int packetCount = 0;
 	int packetIndexOffset = 0;
 	STL_FOR_EACH(packet, batch.packets)
@@ -291,61 +469,58 @@ void loadVertexIndexBuffers(const Batch& batch, const Vtx1& vtx,
 		{
 			STL_FOR_EACH(point, prim->points)
 			{
-				uint index;
-				static const uint64_t seed = 101;
-				
-				// Add the index of this vertex to our index buffer (every time)
-				uint64_t hashKey = util::hash64(&point, sizeof(point), seed);
-				auto indexPair = indexSet.find(hashKey);
-				if (indexPair != indexSet.end())
+				// Build the vertex at the end of the buffer, and keep it if it's a new one
+				buildVertex(vertices + vertexSize*vertexCount, *point, vertexAttributes, vtx);
+				uint index = weldVertex(weldTable, vertices, vertexSize, vertexCount);
+				if (index == vertexCount)
 				{
-					// An equivalent vertex already exists, use that index
-					index = indexPair->second;
-				}
-				else {
-					// This points to a new vertex. Construct it.
-					index = vertexCount++;
-					const Index& p = point[0];
-					buildVertex(vertices + vertexSize*index, p, vertexAttributes, vtx);
-					indexSet[hashKey] = index;
+					// Index kStripCutIndex is the strip cut, every vertex has to stay below it
+					if (vertexCount == kStripCutIndex)
+						return 0;
+					vertexCount++;
 				}
 
 				// Always add a new index to our index buffer
-				indices[indexCount++] = index;
+				indices.push_back(u16(index));
 			}
 
 			// Add a strip-cut index to reset to a new triangle strip
-			indices[indexCount++] = STRIP_CUT_INDEX;
+			indices.push_back(STRIP_CUT_INDEX);
 		}
 
 		// Might as well remove the last strip-cut index
-		indexCount -= 1;
+		if (!packet->primitives.empty()) { indices.pop_back(); }
 
-		packetIndexCounts[packetCount] = indexCount - packetIndexOffset;
+		packetIndexCounts[packetCount] = indices.size() - packetIndexOffset;
 		packetCount++;
-		packetIndexOffset = indexCount;
+		packetIndexOffset = indices.size();
 	}
+	if (indices.size() > 0xffff)
+		return 0;
+
+	u16 count = vertexCount;
+	memcpy(dst, &vertexAttributes, sizeof(u16));
+	memcpy(dst + sizeof(u16), &count, sizeof(u16));
 
-	vb->vertexAttributes = vertexAttributes;
-	vb->vertexCount = vertexCount;
-	vb->vertexBuf = vertices;
+	ubyte* indexHead = vertices + vertexCount * vertexSize;
+	count = indices.size();
+	memcpy(indexHead, &count, sizeof(u16));
+	memcpy(indexHead + sizeof(u16), indices.data(), indices.size() * sizeof(u16));
 
-	ib->indexCount = indexCount;
-	ib->indexBuf = indices;
+	return indexHead + sizeof(u16) + indices.size() * sizeof(u16) - dst;
 }
 
-uint RecordScenegraph( const BModel* bmodel, std::vector< Scenegraph >& scenelist, std::vector<u16>& jointParents, uint nodeIndex = 0, uint matIndex = -1, 
+uint RecordScenegraph( const BModel* bmodel, std::vector< Scenegraph >& scenelist, std::vector<u16>& jointParents, uint& lastMatIndex, uint nodeIndex = 0, uint matIndex = -1, 
 	                  bool onDown = true, uint parentJoint = -1) 
 {
 	// Table to convert scene node indexes into material indexes
 	const std::vector<Node>& scenegraph = bmodel->inf1.scenegraph;
 	const std::vector<int>& indexToMatIndex = bmodel->mat3.indexToMatIndex;
-	static uint lastMatIndex = uint(-1);
 
 	uint tmpJoint = parentJoint;
 	uint tmpMat = matIndex;
 
-	Scenegraph prevPrim = {-1, -1};
+	Scenegraph prevPrim = {0xffff, 0xffff};
 
 	for (uint i = nodeIndex; i < scenegraph.size(); i++)
 	{
@@ -366,7 +541,7 @@ uint RecordScenegraph( const BModel* bmodel, std::vector< Scenegraph >& scenelis
 			{
 				if (matIndex != lastMatIndex)
 				{
-					Scenegraph material = {matIndex, SG_MATERIAL};
+					Scenegraph material = {u16(matIndex), SG_MATERIAL};
 					scenelist.push_back(material);
 					lastMatIndex = matIndex;
 				}
@@ -384,13 +559,13 @@ uint RecordScenegraph( const BModel* bmodel, std::vector< Scenegraph >& scenelis
 			break;
 
 		case SG_DOWN:
-			i += RecordScenegraph(bmodel, scenelist, jointParents, i+1, tmpMat, onDown, tmpJoint); 
+			i += RecordScenegraph(bmodel, scenelist, jointParents, lastMatIndex, i+1, tmpMat, onDown, tmpJoint); 
 			
 			if ( prevPrim.type == SG_PRIM && !onDown) 
 			{
 				if (matIndex != lastMatIndex)
 				{
-					Scenegraph material = { matIndex, SG_MATERIAL };
+					Scenegraph material = { u16(matIndex), SG_MATERIAL };
 					scenelist.push_back(material);
 					lastMatIndex = matIndex;
 				}
@@ -415,7 +590,7 @@ uint RecordScenegraph( const BModel* bmodel, std::vector< Scenegraph >& scenelis
 	return 0;
 }
 
-void ApplyMaterial(Renderer* renderer, MaterialInfo mat)
+void ApplyMaterial(Renderer* renderer, const MaterialInfo& mat, bool streamedTextures)
 {
 	static char samplerName[9] = { 'S', 'a', 'm', 'p', 'l', 'e', 'r', 'I' };
 	static char textureName[9] = { 'T', 'e', 'x', 't', 'u', 'r', 'e', 'I' };
@@ -434,7 +609,12 @@ void ApplyMaterial(Renderer* renderer, MaterialInfo mat)
 		samplerName[7] = '0' + i;
 		textureName[7] = '0' + i;
 		renderer->setSamplerState(samplerName, mat.samplers[i]);
-		renderer->setTexture(textureName, mat.textures[i]);
+		renderer->setTexture(textureName, streamedTextures ? TextureStreamer::GetTexture(mat.textures[i]) : mat.textures[i]);
+	}
+
+	if (mat.usesAtlas)
+	{
+		renderer->setShaderConstantArray4f("TexRect", mat.texRects, 8);
 	}
 }
 
@@ -476,72 +656,289 @@ void FillMatrixTable(GDModel::GDModel* model, mat4* matrixTable, u16* matrixIndi
 	}
 }
 
-void DrawBatch(Renderer* renderer, GDModel::GDModel* model, u16 batchIndex, u16 matIndex)
+// The view that Draw() culls the clusters against, see GDModel::SetView()
+struct ClusterView
+{
+	Frustum frustum;
+	vec3 position;
+
+	// 1 if the faces that are clockwise on screen, which D3D treats as front faces, have their 
+	// normal (the cross product of their first two edges) turned towards the view. -1 if away.
+	float handedness;
+};
+
+enum ClusterVisibility
+{
+	CLUSTER_VISIBLE,
+	CLUSTER_OUTSIDE,    // of the view frustum
+	CLUSTER_BACKFACING, // all of its faces are culled by the rasterizer
+};
+
+// Returns an upper bound of how much the 3x3 part of m stretches a length. isSimilarity is set
+// if m only rotates, mirrors and scales uniformly, which keeps the angles between normals.
+float GetMaxScale(const mat4& m, bool& isSimilarity)
+{
+	vec3 c[3];
+	for (uint i = 0; i < 3; i++) { c[i] = vec3(m.rows[0][i], m.rows[1][i], m.rows[2][i]); }
+
+	float lengthSq[3], maxLengthSq = 0.0f;
+	for (uint i = 0; i < 3; i++) 
+	{ 
+		lengthSq[i] = dot(c[i], c[i]);
+		maxLengthSq = max(maxLengthSq, lengthSq[i]);
+	}
+
+	// No row of transpose(m) * m sums to more than its largest eigenvalue, the square of the largest stretch
+	float bound = 0.0f;
+	float tolerance = 1e-3f * maxLengthSq;
+	isSimilarity = true;
+	for (uint i = 0; i < 3; i++)
+	{
+		float rowSum = lengthSq[i];
+		for (uint j = 0; j < 3; j++)
+		{
+			if (j == i)
+				continue;
+			float d = fabsf(dot(c[i], c[j]));
+			rowSum += d;
+			isSimilarity &= d <= tolerance;
+		}
+		isSimilarity &= fabsf(lengthSq[i] - maxLengthSq) <= tolerance;
+		bound = max(bound, rowSum);
+	}
+	return sqrtf(bound);
+}
+
+// Grows the sphere (center, radius) to contain the other one
+void MergeSpheres(vec3& center, float& radius, const vec3& otherCenter, float otherRadius)
+{
+	float d = length(otherCenter - center);
+	if (d + otherRadius <= radius)
+		return;
+	if (d + radius <= otherRadius)
+	{
+		center = otherCenter;
+		radius = otherRadius;
+		return;
+	}
+
+	float newRadius = (d + radius + otherRadius) * 0.5f;
+	center = center + (otherCenter - center) * ((newRadius - radius) / d);
+	radius = newRadius;
+}
+
+// faceSign is 1 if the rasterizer culls the faces whose normal turns away from the view, -1 if
+// it culls the ones that turn towards it, and 0 if it culls none
+ClusterVisibility GetClusterVisibility(const _Cluster& cluster, const mat4* matrixTable, const ClusterView& view, float faceSign)
+{
+	// Vertices that use different matrices can form a triangle that crosses the frustum while
+	// each of their spheres is outside of it, so these are all merged into one
+	vec3 center;
+	float radius = -1.0f;
+	const mat4* matrix = NULL;
+	bool isSimilarity = false;
+	for (uint slot = 0; slot < 16; slot++)
+	{
+		if ((cluster.matrixMask & (1 << slot)) == 0)
+			continue;
+
+		const mat4& m = matrixTable[slot];
+		vec3 slotCenter = (m * vec4(cluster.sphere.x, cluster.sphere.y, cluster.sphere.z, 1.0f)).xyz();
+		float slotRadius = cluster.sphere.w * GetMaxScale(m, isSimilarity);
+		if (radius < 0.0f)
+		{
+			center = slotCenter;
+			radius = slotRadius;
+			matrix = &m;
+		}
+		else
+		{
+			MergeSpheres(center, radius, slotCenter, slotRadius);
+			matrix = NULL;
+		}
+	}
+
+	if (radius < 0.0f)
+		return CLUSTER_VISIBLE;
+	if (!view.frustum.sphereInFrustum(center, radius))
+		return CLUSTER_OUTSIDE;
+
+	// The normal cone only holds under one matrix, and only if it keeps the angles
+	if (matrix == NULL || !isSimilarity || faceSign == 0.0f || cluster.cone.w <= 0.0f)
+		return CLUSTER_VISIBLE;
+
+	const mat4& m = *matrix;
+	vec3 c0(m.rows[0].x, m.rows[1].x, m.rows[2].x);
+	vec3 c1(m.rows[0].y, m.rows[1].y, m.rows[2].y);
+	vec3 c2(m.rows[0].z, m.rows[1].z, m.rows[2].z);
+	float mirror = dot(c0, cross(c1, c2)) < 0.0f ? -1.0f : 1.0f;
+
+	// The normals that the rasterizer keeps point towards the view, the cluster is culled if the
+	// angle between every one of them and every direction from the view to the sphere is below 90 degrees
+	vec3 axis = normalize(c0 * cluster.cone.x + c1 * cluster.cone.y + c2 * cluster.cone.z) * (mirror * faceSign);
+	vec3 toCenter = center - view.position;
+	float cosSpread = cluster.cone.w;
+	float sinSpread = sqrtf(max(1.0f - cosSpread * cosSpread, 0.0f));
+	float closest = cosSpread * dot(toCenter, axis) - sinSpread * length(cross(toCenter, axis));
+	return closest > radius ? CLUSTER_BACKFACING : CLUSTER_VISIBLE;
+}
+
+void ApplyPacket(Renderer* renderer, GDModel::GDModel* model, const _Batch* batch, u16 matIndex, const mat4* matrixTable, u16 nMatrixIndices)
+{
+	renderer->reset();
+		ApplyMaterial(renderer, model->materials[matIndex], model->streamTextures);
+		renderer->setVertexBuffer(0, batch->vbID);
+		renderer->setVertexFormat(batch->vfID);
+		renderer->setIndexBuffer(batch->ibID);
+		renderer->setShaderConstantArray4x4f("ModelMat", matrixTable, nMatrixIndices);
+		renderer->setShaderConstant4f("PositionScale", batch->positionScale);
+		renderer->setShaderConstant4f("PositionOffset", batch->positionOffset);
+	renderer->apply();
+}
+
+// Culls the clusters of the packets against view, unless it is NULL
+void DrawBatch(Renderer* renderer, GDModel::GDModel* model, u16 batchIndex, u16 matIndex, const ClusterView* view)
 {
 	_Batch* batch = (_Batch*)model->batchPtrs[batchIndex];
-	
-	VertexBufferID vbID = batch->vbID;
-	IndexBufferID ibID = batch->ibID;
-	VertexFormatID vfID = batch->vfID;
+	GDModel::DrawStats& stats = model->drawStats;
+	Primitives primitive = Primitives(batch->primitive);
 	u16 numPackets = batch->numPackets;
+
+	float faceSign = 0.0f;
+	if (view != NULL && model->materials[matIndex].cullMode == CULL_BACK) { faceSign = view->handedness; }
+	if (view != NULL && model->materials[matIndex].cullMode == CULL_FRONT) { faceSign = -view->handedness; }
 	
-	// These are partially updated by each packet
-	mat4 matrixTable[10];
+	// These are partially updated by each packet. Clusters that use entries no packet has set yet aren't culled.
+	mat4 matrixTable[kMaxPacketMatrices];
+	u16 nValidMatrices = 0;
 
 	int numIndicesSoFar = 0;
 	for (uint i = 0; i < numPackets; i++)
 	{
-		u16 nMatrixIndices = batch->packets[ i ].matrixCount;
-		u16* matrixIndices = batch->packets[ i ].matrixIndices;
+		const _Packet& packet = batch->packets[ i ];
+		u16 nMatrixIndices = packet.matrixCount;
 
 		// Setup Matrix table
-		FillMatrixTable(model, matrixTable, matrixIndices, nMatrixIndices);	
+		FillMatrixTable(model, matrixTable, packet.matrixIndices, nMatrixIndices);
+		nValidMatrices = max(nValidMatrices, nMatrixIndices);
+
+		stats.nClusters += packet.clusterCount;
+		stats.nIndices += packet.indexCount;
+		if (view == NULL || packet.clusterCount == 0)
+		{
+			ApplyPacket(renderer, model, batch, matIndex, matrixTable, nMatrixIndices);
+			renderer->drawElements(primitive, batch->firstIndex + numIndicesSoFar, packet.indexCount, 0, -1);
+			stats.nDrawnIndices += packet.indexCount;
+			stats.nDrawCalls++;
+		}
+		else
+		{
+			// The clusters are consecutive, the visible ones next to each other are drawn together
+			bool applied = false;
+			uint firstIndex = 0, indexCount = 0;
+			for (uint j = 0; j <= packet.clusterCount; j++)
+			{
+				if (j < packet.clusterCount)
+				{
+					const _Cluster& cluster = packet.clusters[j];
+					ClusterVisibility visibility = (cluster.matrixMask >> nValidMatrices) ? CLUSTER_VISIBLE : 
+						GetClusterVisibility(cluster, matrixTable, *view, faceSign);
+
+					if (visibility == CLUSTER_VISIBLE)
+					{
+						if (indexCount == 0) { firstIndex = cluster.firstIndex; }
+						indexCount += cluster.indexCount;
+						continue;
+					}
+					stats.nCulledClusters += (visibility == CLUSTER_OUTSIDE);
+					stats.nBackfaceClusters += (visibility == CLUSTER_BACKFACING);
+				}
+
+				if (indexCount == 0)
+					continue;
+
+				if (!applied)
+				{
+					ApplyPacket(renderer, model, batch, matIndex, matrixTable, nMatrixIndices);
+					applied = true;
+				}
+				renderer->drawElements(primitive, batch->firstIndex + numIndicesSoFar + firstIndex, indexCount, 0, -1);
+				stats.nDrawnIndices += indexCount;
+				stats.nDrawCalls++;
+				indexCount = 0;
+			}
+		}
+		numIndicesSoFar += packet.indexCount;
+	}
+}
 
-		renderer->reset();
-			ApplyMaterial(renderer, model->materials[matIndex]);
-			renderer->setVertexBuffer(0, vbID);
-			renderer->setVertexFormat(vfID);
-			renderer->setIndexBuffer(ibID);
-			renderer->setShaderConstantArray4x4f("ModelMat", matrixTable, nMatrixIndices);
-		renderer->apply();
+void FreeTemporaryGFXData(GDModel::TemporaryGFXData& gfxData)
+{
+	free(gfxData.depthModes);
+	free(gfxData.blendModes);
+	free(gfxData.cullModes);
+	free(gfxData.vsOffsets);
+	free(gfxData.psOffsets);
+	free(gfxData.vsShaders);
+	free(gfxData.psShaders);
+	free(gfxData.vertexIndexBuffers);
+	free(gfxData.textureResources);
+}
 
-		u16 indexCount = batch->packets[ i ].indexCount;
-		renderer->drawElements(PRIM_TRIANGLE_STRIP, numIndicesSoFar, indexCount, 0, -1);
-		numIndicesSoFar += indexCount;
+// The images outlive the rest of the temporary data, the TextureRegistry compares the images
+// of other models against them until UnregisterGFX()
+void FreeTemporaryTextures(GDModel::TemporaryGFXData& gfxData)
+{
+	for (uint i = 0; i < gfxData.nTextures; i++)
+	{
+		free(gfxData.textures[i].imgData);
 	}
+	free(gfxData.textures);
 }
 
 RESULT RegisterGFX(Renderer* renderer, GDModel::GDModel* model)
 {
 	GDModel::TemporaryGFXData& gfxData = model->gfxData;
-	uint samplers[256];
-	uint blendModes[256];
-	uint cullModes[256];
-	uint depthModes[256];
+	std::vector<SamplerStateID> samplers(gfxData.nTextureResources);
+	std::vector<uint> blendModes(gfxData.nBlendModes);
+	std::vector<uint> cullModes(gfxData.nCullModes);
+	std::vector<uint> depthModes(gfxData.nDepthModes);
 
-	uint shaders[256];
-	uint textures[256];
+	std::vector<uint> shaders(gfxData.nShaders);
+	std::vector<uint> textures(gfxData.nTextures);
 	
 	// Remember our creator
 	gfxData.renderer = renderer;
 
-	// Register our samplers
+	// Register our samplers, resources with the same settings share one
 	for (uint i = 0; i < gfxData.nTextureResources; i++)
 	{
 		TextureResource& res = gfxData.textureResources[i];
-		samplers[i] = renderer->addSamplerState(res.filter, res.wrapS, res.wrapT, CLAMP);
+		samplers[i] = SS_NONE;
+		for (uint j = 0; j < i && samplers[i] == SS_NONE; j++)
+		{
+			const TextureResource& other = gfxData.textureResources[j];
+			if (other.filter == res.filter && other.wrapS == res.wrapS && other.wrapT == res.wrapT)
+				samplers[i] = samplers[j];
+		}
+		if (samplers[i] == SS_NONE)
+			samplers[i] = renderer->addSamplerState(Filter(res.filter), AddressMode(res.wrapS), AddressMode(res.wrapT), CLAMP);
 	}
 		
-	// Register our textures
-	Image imgResource;
+	// Register our textures, shared with the other models that have the same images.
+	// Baked models keep their mip chains in the blob, so they can be streamed.
+	model->streamTextures = model->blob != nullptr && TextureStreamer::IsRunning();
+	model->nTextureIDs = gfxData.nTextures;
+	model->textureIDs = (int*)malloc(sizeof(int) * gfxData.nTextures);
 	for (uint i = 0; i < gfxData.nTextures; i++)
 	{
 		TextureDesc& tex = gfxData.textures[i];
-			
-		imgResource.loadFromMemory(tex.imgData, tex.format, 
-			tex.width, tex.height, 1, tex.numMips, true);
 
-		textures[i] = renderer->addTexture(imgResource);
+		if (model->streamTextures)
+			textures[i] = TextureRegistry::AcquireStreamed(renderer, tex.imgData, tex.sizeBytes, tex.format, tex.width, tex.height, tex.numMips);
+		else
+			textures[i] = TextureRegistry::Acquire(renderer, tex.imgData, tex.sizeBytes, tex.format, tex.width, tex.height, tex.numMips);
+		model->textureIDs[i] = textures[i];
 	}
 
 	// Register our depth, blend, cull modes
@@ -561,12 +958,13 @@ RESULT RegisterGFX(Renderer* renderer, GDModel::GDModel* model)
 		cullModes[i] = renderer->addRasterizerState(cm);
 	}
 
-	// Register our shaders
+	// Register our shaders. Bake() converts either all of the batches to COMPACT_VERTICES or none.
+	bool compactVertices = gfxData.nVertexIndexBuffers > 0 && (*(u16*)gfxData.vertexIndexBuffers & COMPACT_VERTICES);
 	for (uint i = 0; i < gfxData.nShaders; i++)
 	{
 		char* vsText = gfxData.vsShaders + gfxData.vsOffsets[i];
 		char* psText = gfxData.psShaders + gfxData.psOffsets[i];
-		shaders[i] = renderer->addShader(vsText, nullptr, psText, 0, 0, 0);
+		shaders[i] = renderer->addShader(vsText, nullptr, psText, 0, 0, 0, compactVertices ? "#define COMPACT_VERTICES\n" : nullptr);
 	}
 
 	// Fixup our Materials with their runtime IDs
@@ -575,6 +973,7 @@ RESULT RegisterGFX(Renderer* renderer, GDModel::GDModel* model)
 		MaterialInfo& mat = model->materials[i];
 		mat.blendMode = blendModes[mat.blendMode];
 		mat.depthMode = depthModes[mat.depthMode];
+		mat.cullMode = gfxData.cullModes[mat.rasterMode];
 		mat.rasterMode = cullModes[mat.rasterMode];
 		mat.shader = shaders[mat.shader];
 			
@@ -591,54 +990,155 @@ RESULT RegisterGFX(Renderer* renderer, GDModel::GDModel* model)
 		}
 	}
 
-	// Register vertex and index buffers
+	// Register vertex and index buffers. Batches with the same attributes share one vertex buffer 
+	//		and format, and all of them share one index buffer, so that the renderer only rebinds them
+	//		between layouts. The indices are rebased onto the shared vertex buffers, and widened to
+	//		32 bits if one of those has more vertices than 16 bit indices can address.
+	std::vector<u16> layouts;
+	std::vector<uint> layoutVertexCounts;
+	std::vector<ubyte*> batchData(gfxData.nVertexIndexBuffers);
+	std::vector<uint> batchLayouts(gfxData.nVertexIndexBuffers);
+	std::vector<uint> batchBaseVertices(gfxData.nVertexIndexBuffers);
+	uint totalIndices = 0;
 	ubyte* head = gfxData.vertexIndexBuffers;
 	for (uint i = 0; i < gfxData.nVertexIndexBuffers; i++)
 	{
-		ubyte* batch = model->batchPtrs[i];
-		VertexBufferID* batchVBID = (VertexBufferID*)batch;
-		IndexBufferID*  batchIBID = (IndexBufferID*)(batch + sizeof(batchVBID));
-		VertexFormatID* batchVFID = (VertexFormatID*)(batch + sizeof(batchVBID) + sizeof(batchIBID));
-		assert(*batchVBID == -1 && *batchIBID == -1 && *batchVFID == -1);
-
+		batchData[i] = head;
 		u16 attributes = READ(u16);
-		int numVertices = READ(u16);
-		int vbSize = numVertices * GC3D::GetVertexSize(attributes);
-		void* vertices = READ_ARRAY(ubyte, vbSize);
+		u16 numVertices = READ(u16);
+		head += numVertices * GC3D::GetVertexSize(attributes);
+		u16 numIndices = READ(u16);
+		head += numIndices * sizeof(u16);
 
-		int numIndices = READ(u16);
-		int ibSize = numIndices * sizeof(u16);
-		void* indices = READ_ARRAY(ubyte, ibSize);
+		uint layout = std::find(layouts.begin(), layouts.end(), attributes) - layouts.begin();
+		if (layout == layouts.size())
+		{
+			layouts.push_back(attributes);
+			layoutVertexCounts.push_back(0);
+		}
+		batchLayouts[i] = layout;
+		batchBaseVertices[i] = layoutVertexCounts[layout];
+		layoutVertexCounts[layout] += numVertices;
+		totalIndices += numIndices;
+	}
+
+	// Index u16(STRIP_CUT_INDEX) is the strip cut, the largest vertex index must stay below it
+	uint indexSize = sizeof(u16);
+	for (uint i = 0; i < layouts.size(); i++)
+	{
+		if (layoutVertexCounts[i] > kStripCutIndex)
+			indexSize = sizeof(u32);
+	}
+
+	model->nVertexBufferIDs = layouts.size();
+	model->vertexBufferIDs = (VertexBufferID*)malloc(sizeof(VertexBufferID) * layouts.size());
+	model->vertexFormatIDs = (VertexFormatID*)malloc(sizeof(VertexFormatID) * layouts.size());
+	model->indexBufferID = IB_NONE;
+
+	ubyte* indices = (ubyte*)malloc(totalIndices * indexSize);
+	uint indexCount = 0;
+	for (uint layout = 0; layout < layouts.size(); layout++)
+	{
+		uint vertexSize = GC3D::GetVertexSize(layouts[layout]);
+		ubyte* vertices = (ubyte*)malloc(layoutVertexCounts[layout] * vertexSize);
+
+		for (uint i = 0; i < gfxData.nVertexIndexBuffers; i++)
+		{
+			if (batchLayouts[i] != layout)
+				continue;
+			
+			_Batch* batch = (_Batch*)model->batchPtrs[i];
+			ASSERT(batch->vbID == -1 && batch->ibID == -1 && batch->vfID == -1);
+
+			head = batchData[i] + sizeof(u16); // attributes
+			u16 numVertices = READ(u16);
+			ubyte* batchVertices = READ_ARRAY(ubyte, numVertices * vertexSize);
+			u16 numIndices = READ(u16);
+			u16* batchIndices = READ_ARRAY(u16, numIndices);
+
+			memcpy(vertices + batchBaseVertices[i] * vertexSize, batchVertices, numVertices * vertexSize);
+			for (uint j = 0; j < numIndices; j++)
+			{
+				u16 index = batchIndices[j];
+				u32 rebased = (index == kStripCutIndex) ? u32(STRIP_CUT_INDEX) : index + batchBaseVertices[i];
+				if (indexSize == sizeof(u16))
+					((u16*)indices)[indexCount + j] = u16(rebased);
+				else
+					((u32*)indices)[indexCount + j] = rebased;
+			}
+
+			batch->firstIndex = indexCount;
+			indexCount += numIndices;
+		}
 
 		FormatDesc formatBuf[MAX_VERTEX_ATTRIBS];
-		GC3D::ConvertGCVertexFormat(attributes, formatBuf);
-
-		*batchVBID = renderer->addVertexBuffer(vbSize, STATIC, vertices);
-		*batchIBID = renderer->addIndexBuffer(numIndices, 2, STATIC, indices);
-		*batchVFID = renderer->addVertexFormat(formatBuf, MAX_VERTEX_ATTRIBS, shaders[0]);
-	}
-
-	// Cleanup
-	free(model->gfxData.depthModes);
-	free(model->gfxData.blendModes);
-	free(model->gfxData.cullModes);
-	free(model->gfxData.vsOffsets);
-	free(model->gfxData.psOffsets);
-	free(model->gfxData.vsShaders);
-	free(model->gfxData.psShaders);
-	free(model->gfxData.vertexIndexBuffers);
-	for (uint i = 0; i < gfxData.nTextures; i++)
+		GC3D::ConvertGCVertexFormat(layouts[layout], formatBuf);
+
+		VertexBufferID vbID = renderer->addVertexBuffer(layoutVertexCounts[layout] * vertexSize, STATIC, vertices);
+		VertexFormatID vfID = renderer->addVertexFormat(formatBuf, MAX_VERTEX_ATTRIBS, shaders.empty() ? SHADER_NONE : shaders[0]);
+		model->vertexBufferIDs[layout] = vbID;
+		model->vertexFormatIDs[layout] = vfID;
+		for (uint i = 0; i < gfxData.nVertexIndexBuffers; i++)
+		{
+			if (batchLayouts[i] != layout)
+				continue;
+
+			_Batch* batch = (_Batch*)model->batchPtrs[i];
+			batch->vbID = vbID;
+			batch->vfID = vfID;
+		}
+		free(vertices);
+	}
+
+	if (totalIndices > 0)
 	{
-		free(gfxData.textures[i].imgData);
+		IndexBufferID ibID = renderer->addIndexBuffer(totalIndices, indexSize, STATIC, indices);
+		model->indexBufferID = ibID;
+		for (uint i = 0; i < gfxData.nVertexIndexBuffers; i++)
+		{
+			((_Batch*)model->batchPtrs[i])->ibID = ibID;
+		}
+	}
+	free(indices);
+
+	// Cleanup. Baked models keep this data in their blob, the textures are freed by UnregisterGFX().
+	if (model->blob == nullptr)
+	{
+		FreeTemporaryGFXData(gfxData);
 	}
-	free(model->gfxData.textureResources);
-	free(model->gfxData.textures);
 
 	return S_OK;
 }
 
 RESULT UnregisterGFX(Renderer* renderer, GDModel::GDModel* model)
 {
+	for (uint i = 0; i < model->nTextureIDs; i++)
+	{
+		// The registry compares against the images of the models, it needs to know which goes away
+		if (model->streamTextures)
+			TextureRegistry::ReleaseStreamed(renderer, model->textureIDs[i], model->gfxData.textures[i].imgData);
+		else
+			TextureRegistry::Release(renderer, model->textureIDs[i], model->gfxData.textures[i].imgData);
+	}
+	free(model->textureIDs);
+	if (model->blob == nullptr)
+	{
+		FreeTemporaryTextures(model->gfxData);
+	}
+
+	// The batches share these, see RegisterGFX()
+	for (uint i = 0; i < model->nVertexBufferIDs; i++)
+	{
+		renderer->removeVertexBuffer(model->vertexBufferIDs[i]);
+		renderer->removeVertexFormat(model->vertexFormatIDs[i]);
+	}
+	free(model->vertexBufferIDs);
+	free(model->vertexFormatIDs);
+	if (model->nVertexBufferIDs > 0 && model->indexBufferID != IB_NONE) // a failed Load() leaves it 0
+	{
+		renderer->removeIndexBuffer(model->indexBufferID);
+	}
+
 	for (uint i = 0; i < model->nMaterials; i++)
 	{
 		MaterialInfo& mat = model->materials[i];
@@ -646,42 +1146,14 @@ RESULT UnregisterGFX(Renderer* renderer, GDModel::GDModel* model)
 		//renderer->removeDepthState(mat.depthMode);
 		//renderer->removeRasterizerState(mat.rasterMode);
 		//renderer->removeShader(mat.shader);
-			
-		for (uint i = 0; i < 8; i++)
-		{
-			u16 texIndex = mat.samplers[i];
-			if (texIndex == 0xffff)
-				break;
-
-			//renderer->removeSamplerState(mat.samplers[i]);
-			renderer->removeTexture(mat.textures[i]);
-		}
-
-		//renderer->removeVertexFormat(model->vertFormat);
-		
-		for (uint i = 0; i < model->gfxData.nVertexIndexBuffers; i++)
-		{
-			ubyte* batch = model->batchPtrs[i];
-			VertexBufferID* batchVBID = (VertexBufferID*)batch;
-			IndexBufferID*  batchIBID = (IndexBufferID*)(batch + sizeof(batchVBID));
-
-			//renderer->removeVertexBuffer(batchVBID);
-			//renderer->changeIndexBuffer(batchIBID);
-		}
+		//renderer->removeSamplerState(mat.samplers[i]);
 	}
 
 	return S_OK;
 }
 
-RESULT GDModel::Unload(GDModel* model)
+void FreeModelTables(GDModel::GDModel* model)
 {
-	RESULT r;
-	
-	r = UnregisterGFX(model->gfxData.renderer, model);
-	
-	// Clear the whole model for safety
-	memset(model, 0, sizeof(model));
-	 
 	free(model->scenegraph);
 
 	for (uint i = 0; i < model->batchCount; i++)
@@ -690,6 +1162,7 @@ RESULT GDModel::Unload(GDModel* model)
 		for (uint j = 0; j < batch->numPackets; j++)
 		{
 			free(batch->packets[j].matrixIndices);
+			free(batch->packets[j].clusters);
 		}
 		free(batch->packets);
 		free(batch);
@@ -705,37 +1178,90 @@ RESULT GDModel::Unload(GDModel* model)
 	free(model->evpWeightedIndexOffsetTable);
 	free(model->evpMatrixTable);
 	free(model->evpWeightedIndexTable);
+}
+
+RESULT GDModel::Unload(GDModel* model)
+{
+	RESULT r = S_OK;
+	
+	if (!model->loadGPU)
+	{
+		r = UnregisterGFX(model->gfxData.renderer, model);
+	}
+	else if (model->blob == nullptr)
+	{
+		// Never drawn, the temporary data has not been uploaded and freed yet
+		FreeTemporaryGFXData(model->gfxData);
+		FreeTemporaryTextures(model->gfxData);
+	}
+
+	if (model->blob)
+	{
+		// Batches, packets, materials and texture descs share one allocation, 
+		// everything else points into the blob, which is owned by the caller
+		free(model->batchPtrs);
+	}
+	else
+	{
+		FreeModelTables(model);
+	}
+
+	// Clear the whole model for safety
+	memset(model, 0, sizeof(*model));
 
 	return r;
 }
 
 extern std::string GenerateVS(const Mat3* matInfo, int index);
-extern std::string GeneratePS(const Tex1* texInfo, const Mat3* matInfo, int index);
+extern std::string GeneratePS(const Tex1* texInfo, const Mat3* matInfo, int index, const GC3D::AtlasStage* atlasStages = NULL);
 
 RESULT GDModel::Load(GDModel* model, const BModel* bdl)
 {
-	VertexBuffer* vertexBuffers;
-	IndexBuffer* indexBuffers;
+	memset(model, 0, sizeof(*model));
 
 	// Scenegraph first		
 	std::vector<u16> jointParents;
 	std::vector<Scenegraph> scenelist;
-	RecordScenegraph(bdl, scenelist, jointParents);
+	uint lastMatIndex = uint(-1);
+	RecordScenegraph(bdl, scenelist, jointParents, lastMatIndex);
 	model->scenegraph = (Scenegraph*)malloc(scenelist.size() * sizeof(Scenegraph));
 	memcpy(model->scenegraph, scenelist.data(), scenelist.size() * sizeof(Scenegraph));
 
-	// Batches	
+	// Batches. Their vertex and index buffers are written straight into a single allocation, in the 
+	// layout that RegisterGFX() uploads, with room for every point to become a vertex. It is shrunk 
+	// to what is left after welding at the end.
 	{
 		const std::vector< Batch >& batches = bdl->shp1.batches;
-		
-		vertexBuffers = (VertexBuffer*)malloc(sizeof(VertexBuffer) * batches.size());
-		indexBuffers = (IndexBuffer*)malloc(sizeof(IndexBuffer) * batches.size());
+
+		uint maxVertexIndexBufSize = 0;
+		for (uint i = 0; i < batches.size(); i++)
+		{
+			maxVertexIndexBufSize += getMaxVertexIndexBufferSize(batches[i]);
+		}
+		ubyte* viBuf = (ubyte*)malloc(maxVertexIndexBufSize);
+		uint viSize = 0;
 
 		model->batchCount = batches.size();
-		model->batchPtrs = (ubyte**)malloc(sizeof(uint) * batches.size());
+		model->batchPtrs = (ubyte**)malloc(sizeof(ubyte*) * batches.size());
+		std::vector<u32> weldTable;
+		std::vector<u16> indices;
+		std::vector<u16> packetIdxCounts;
 		for (uint i = 0; i < batches.size(); i++)
 		{
-			_Batch* batch = (_Batch*)malloc(sizeof(_Batch) * batches.size());
+			packetIdxCounts.resize(batches[i].packets.size());
+			uint batchSize = loadVertexIndexBuffers(batches[i], bdl->vtx1, viBuf + viSize, packetIdxCounts.data(), weldTable, indices);
+			if (batchSize == 0)
+			{
+				WARN("Batch %u has more than 65534 vertices or 65535 indices\n", i);
+				model->batchCount = i;
+				free(viBuf);
+				FreeModelTables(model);
+				memset(model, 0, sizeof(*model));
+				return E_FAIL;
+			}
+			viSize += batchSize;
+
+			_Batch* batch = (_Batch*)malloc(sizeof(_Batch));
 			memset(batch, 0xff, sizeof(_Batch));
 			model->batchPtrs[i] = (ubyte*)batch;
 
@@ -743,14 +1269,11 @@ RESULT GDModel::Load(GDModel* model, const BModel* bdl)
 			{
 				WARN("Batch matrix type %u not yet supported!\n", batches[i].matrixType);
 			}
-
-			const u32 kMaxPackets = 1024;
-			u16 packetIdxCounts[ kMaxPackets ];
-			loadVertexIndexBuffers(batches[i], bdl->vtx1, 
-				&vertexBuffers[i], &indexBuffers[i], packetIdxCounts);
 						
+			batch->primitive = PRIM_TRIANGLE_STRIP;
+			batch->positionScale = vec4(1, 1, 1, 0);
+			batch->positionOffset = vec4(0, 0, 0, 0);
 			batch->numPackets = batches[i].packets.size();
-			ASSERT(batch->numPackets <= kMaxPackets);
 			batch->packets = (_Packet*)malloc(sizeof(_Packet) * batch->numPackets);
 			for (uint32_t j = 0; j < batch->numPackets; j++)
 			{
@@ -759,8 +1282,15 @@ RESULT GDModel::Load(GDModel* model, const BModel* bdl)
 				batch->packets[j].matrixIndices = (u16*)malloc(sizeof(u16) * mtxTable.size());
 				memcpy(batch->packets[j].matrixIndices, mtxTable.data(), sizeof(u16) * mtxTable.size());
 				batch->packets[j].indexCount = packetIdxCounts[ j ];
+				batch->packets[j].clusterCount = 0;
+				batch->packets[j].clusters = NULL;
 			}
 		}
+
+		// Give back what welding saved. realloc() may move the buffer, nothing points into it yet.
+		ASSERT(viSize <= maxVertexIndexBufSize);
+		model->gfxData.nVertexIndexBuffers = batches.size();
+		model->gfxData.vertexIndexBuffers = (ubyte*)realloc(viBuf, viSize);
 	}
 
 	// Materials
@@ -815,7 +1345,10 @@ RESULT GDModel::Load(GDModel* model, const BModel* bdl)
 				u16 stageIndex = bdl->mat3.materials[i].texStages[j];
 				mat.samplers[j] = stageIndex == 0xffff ? 0xffff : bdl->mat3.texStageIndexToTextureIndex[stageIndex];
 				mat.textures[j] = 0;
+				mat.texRects[j] = vec4(0, 0, 1, 1);
 			}
+			mat.usesAtlas = false;
+			memset(mat.pad, 0, sizeof(mat.pad));
 		}
 		model->nMaterials = matCount;
 		model->materials = matInfo;
@@ -840,6 +1373,7 @@ RESULT GDModel::Load(GDModel* model, const BModel* bdl)
 		{
 			drwTable[i].index = bdl->drw1.data[i];
 			drwTable[i].isWeighted = bdl->drw1.isWeighted[i];
+			drwTable[i].pad = 0;
 		}
 		model->drwTable = drwTable;
 	}
@@ -852,8 +1386,10 @@ RESULT GDModel::Load(GDModel* model, const BModel* bdl)
 		{
 			JointElement& joint = joints[i];
 			loadFrame(bdl->jnt1.frames[i], &joint.matrix);
-			strncpy_s(joint.name, bdl->jnt1.frames[i].name.c_str(), 16);
+			strncpy(joint.name, bdl->jnt1.frames[i].name.c_str(), MAX_NAME_LENGTH - 1);
+			joint.name[MAX_NAME_LENGTH - 1] = '\0';
 			joint.parent = jointParents[i];
+			joint.pad = 0;
 		}
 		model->numJoints = jointCount;
 		model->jointTable = joints;
@@ -933,40 +1469,6 @@ RESULT GDModel::Load(GDModel* model, const BModel* bdl)
 		model->gfxData.psShaders = psShaders;
 	}
 
-	{
-		const u32 kMaxVertexIndexBufSize = 1024 * 1024;
-		u32 bufCount = bdl->shp1.batches.size();
-		ubyte* viBuf = (ubyte*)malloc(kMaxVertexIndexBufSize);
-		ubyte* viHead = viBuf;
-		for (uint i = 0; i < bufCount; i++)
-		{
-			memcpy(viHead, &vertexBuffers[i].vertexAttributes, sizeof(vertexBuffers[i].vertexAttributes));
-			viHead += sizeof(vertexBuffers[i].vertexAttributes);
-			memcpy(viHead, &vertexBuffers[i].vertexCount, sizeof(vertexBuffers[i].vertexCount));
-			viHead += sizeof(vertexBuffers[i].vertexCount);
-			uint vertBufSize = vertexBuffers[i].vertexCount * GC3D::GetVertexSize(vertexBuffers[i].vertexAttributes);
-			memcpy(viHead, vertexBuffers[i].vertexBuf, vertBufSize);
-			viHead += vertBufSize;
-
-			memcpy(viHead, &indexBuffers[i].indexCount, sizeof(indexBuffers[i].indexCount));
-			viHead += sizeof(indexBuffers[i].indexCount);
-			memcpy(viHead, indexBuffers[i].indexBuf, indexBuffers[i].indexCount * sizeof(u16));
-			viHead += indexBuffers[i].indexCount * sizeof(u16);
-		}
-		ASSERT(viHead - viBuf <= kMaxVertexIndexBufSize);
-		viBuf = (ubyte*) realloc(viBuf, viHead - viBuf);
-		model->gfxData.nVertexIndexBuffers = bufCount;
-		model->gfxData.vertexIndexBuffers = viBuf;
-
-		for (uint i = 0; i < bufCount; i++)
-		{
-			free(vertexBuffers[i].vertexBuf);
-			free(indexBuffers[i].indexBuf);
-		}
-		free(vertexBuffers);
-		free(indexBuffers);
-	}
-
 	{
 		u32 texCount = bdl->tex1.imageHeaders.size();
 		u32 imgCount = bdl->tex1.images.size();
@@ -980,6 +1482,7 @@ RESULT GDModel::Load(GDModel* model, const BModel* bdl)
 
 			const char* name = bdl->tex1.imageHeaders[i].name.c_str();
 			memcpy(tex.name, name, 16);
+			tex.pad = 0;
 
 			u8 magFilter = bdl->tex1.imageHeaders[i].magFilter;
 			u8 minFilter = bdl->tex1.imageHeaders[i].minFilter;
@@ -987,6 +1490,10 @@ RESULT GDModel::Load(GDModel* model, const BModel* bdl)
 			tex.wrapS = GC3D::ConvertGCTexWrap(bdl->tex1.imageHeaders[i].wrapS);
 			tex.wrapT = GC3D::ConvertGCTexWrap(bdl->tex1.imageHeaders[i].wrapT);
 			tex.texIndex = bdl->tex1.imageHeaders[i].imageIndex;
+
+			// Mipmaps generated at load time (TEX1_GENERATE_MIPMAPS) would be ignored by a filter without mipmaps
+			if (bdl->tex1.images[tex.texIndex].generatedMipmaps && tex.filter == LINEAR)
+				tex.filter = TRILINEAR;
 		}
 
 		for (uint i = 0; i < imgCount; i++)
@@ -1015,53 +1522,1684 @@ RESULT GDModel::Load(GDModel* model, const BModel* bdl)
 	}
 
 	model->loadGPU = true;
+	model->blob = nullptr;
+	model->streamTextures = false;
+	model->screenSize = 0;
+	model->nTextureIDs = 0;
+	model->textureIDs = nullptr;
+	model->nVertexBufferIDs = 0;
+	model->vertexBufferIDs = nullptr;
+	model->vertexFormatIDs = nullptr;
+	model->indexBufferID = IB_NONE;
 
 	return S_OK;
 }
 
-RESULT GDModel::Update(GDModel* model, GDAnim::GDAnim* anim, float time)
+uint GetVertexIndexBuffersSize(const GDModel::TemporaryGFXData& gfxData)
 {
-	// Grab the root joint straight from the animation. It's parent is the identity
-	float weights[1] = {1.0f};
-	if (anim) { model->jointTable[0].matrix = GDAnim::GetJoint(&anim, weights, 1, 0, time);	}
-	else { model->jointTable[0].matrix = model->defaultPose[0].matrix; }
-
-	for (uint i = 1; i < model->numJoints; i++)
+	ubyte* head = gfxData.vertexIndexBuffers;
+	for (uint i = 0; i < gfxData.nVertexIndexBuffers; i++)
 	{
-		JointElement& joint = model->jointTable[i];
-
-		// Calculate joint from animation at current time
-		mat4 animMatrix;
-		if (anim ) { animMatrix = GDAnim::GetJoint(&anim, weights, 1, i, time); }
-		else{ animMatrix = model->defaultPose[i].matrix;}	
+		u16 attributes = READ(u16);
+		int numVertices = READ(u16);
+		head += numVertices * GC3D::GetVertexSize(attributes);
 
-		// Put in parent's frame
-		joint.matrix = model->jointTable[joint.parent].matrix * animMatrix;
+		int numIndices = READ(u16);
+		head += numIndices * sizeof(u16);
 	}
-
-	return S_OK;
+	return head - gfxData.vertexIndexBuffers;
 }
 
-RESULT GDModel::Draw(Renderer* renderer, GDModel* model)
+uint GetShaderTextSize(const char* shaders, const uint* offsets, uint count)
 {
-	u16 matIndex = -1;
-
-	if (model->loadGPU)
+	uint size = 0;
+	for (uint i = 0; i < count; i++)
 	{
-		RegisterGFX(renderer, model);
-		model->loadGPU = false;
+		uint end = offsets[i] + strlen(shaders + offsets[i]) + 1;
+		size = max(size, end);
 	}
+	return size;
+}
 
-	for (Scenegraph* node = model->scenegraph; node->type != SG_END; node++)
-	{
+// Texture atlases (BakeOptions::atlasMaxTextureSize). Small single level textures that are sampled
+// the same way are packed into shared textures, so that materials that only differ by their textures
+// bind the same texture and sampler, and can share their shader. Every image gets a border that
+// repeats it according to its wrap mode, so bilinear filtering at its edges reads the right texels.
+
+static const uint kAtlasBorder = 2;
+static const uint kAtlasMaxSize = 1024;
+
+struct AtlasImage
+{
+	uint texIndex;
+	uint x, y; // of the image in its atlas, without the border
+};
+
+// Texel of an image of the given size for a coordinate up to kAtlasBorder outside of it
+int WrapAtlasCoord(int coord, int size, AddressMode wrap)
+{
+	if (coord >= 0 && coord < size)
+		return coord;
+
+	switch (wrap)
+	{
+	case WRAP: return (coord + size) % size;
+	case MIRROR: return coord < 0 ? min(-coord - 1, size - 1) : max(2 * size - coord - 1, 0);
+	default: return min(max(coord, 0), size - 1);
+	}
+}
+
+// Packs the images into a kAtlasMaxSize atlas, with sizes rounded up to whole 4x4 blocks so
+// that block compression never mixes two images. False if they don't fit.
+bool PackAtlas(const TextureDesc* textures, std::vector<AtlasImage>& images, uint& width, uint& height)
+{
+	TexturePacker packer;
+	for (uint i = 0; i < images.size(); i++)
+	{
+		const TextureDesc& tex = textures[images[i].texIndex];
+		packer.addRectangle((tex.width + 2 * kAtlasBorder + 3) & ~3, (tex.height + 2 * kAtlasBorder + 3) & ~3);
+	}
+
+	width = kAtlasMaxSize;
+	height = kAtlasMaxSize;
+	if (!packer.assignCoords(&width, &height, areaComp))
+		return false;
+
+	for (uint i = 0; i < images.size(); i++)
+	{
+		images[i].x = packer.getRectangle(i)->x + kAtlasBorder;
+		images[i].y = packer.getRectangle(i)->y + kAtlasBorder;
+	}
+	return true;
+}
+
+TextureDesc BuildAtlas(const TextureDesc* textures, const std::vector<AtlasImage>& images, uint width, uint height,
+	AddressMode wrapS, AddressMode wrapT)
+{
+	TextureDesc atlas;
+	atlas.format = textures[images[0].texIndex].format;
+	atlas.width = width;
+	atlas.height = height;
+	atlas.numMips = 1;
+	atlas.sizeBytes = width * height * getBytesPerPixel(atlas.format);
+	atlas.texDataOffset = 0;
+	atlas.imgData = (u8*)malloc(atlas.sizeBytes);
+	memset(atlas.imgData, 0, atlas.sizeBytes);
+
+	int bpp = getBytesPerPixel(atlas.format);
+	int border = kAtlasBorder;
+	for (uint i = 0; i < images.size(); i++)
+	{
+		const TextureDesc& tex = textures[images[i].texIndex];
+		int w = tex.width, h = tex.height;
+		for (int y = -border; y < h + border; y++)
+		{
+			const u8* srcRow = tex.imgData + WrapAtlasCoord(y, h, wrapT) * w * bpp;
+			u8* dstRow = atlas.imgData + ((images[i].y + y) * width + images[i].x) * bpp;
+			for (int x = -border; x < w + border; x++)
+			{
+				memcpy(dstRow + x * bpp, srcRow + WrapAtlasCoord(x, w, wrapS) * bpp, bpp);
+			}
+		}
+	}
+	return atlas;
+}
+
+// Adds the pixel shader text to shaders, sharing the text of an identical one
+uint AddShaderText(std::vector<char>& shaders, std::vector<uint>& offsets, const char* text)
+{
+	for (uint i = 0; i < offsets.size(); i++)
+	{
+		if (strcmp(&shaders[offsets[i]], text) == 0)
+			return offsets[i];
+	}
+	uint offset = shaders.size();
+	shaders.insert(shaders.end(), text, text + strlen(text) + 1);
+	offsets.push_back(offset);
+	return offset;
+}
+
+// Returns the number of textures that went into atlases
+uint AtlasTextures(GDModel::GDModel& model, const BModel* bdl, uint maxTextureSize)
+{
+	GDModel::TemporaryGFXData& gfxData = model.gfxData;
+	const uint nTextures = gfxData.nTextures;
+
+	// Candidates: small plain textures without mipmaps, that all their resources sample the same way
+	const TextureResource kNotReferenced = {};
+	std::vector<const TextureResource*> sampling(nTextures, &kNotReferenced);
+	std::vector<bool> candidate(nTextures, false);
+	for (uint i = 0; i < nTextures; i++)
+	{
+		const TextureDesc& tex = gfxData.textures[i];
+		candidate[i] = tex.numMips == 1 && tex.width <= maxTextureSize && tex.height <= maxTextureSize &&
+			isPlainFormat(tex.format) && !isFloatFormat(tex.format) && getBytesPerPixel(tex.format) <= 4;
+	}
+	for (uint i = 0; i < gfxData.nTextureResources; i++)
+	{
+		const TextureResource& res = gfxData.textureResources[i];
+		const TextureResource*& first = sampling[res.texIndex];
+		if (first == &kNotReferenced)
+			first = &res;
+		else if (first->filter != res.filter || first->wrapS != res.wrapS || first->wrapT != res.wrapT)
+			candidate[res.texIndex] = false;
+
+		if (hasMipmaps(Filter(res.filter)))
+			candidate[res.texIndex] = false;
+	}
+
+	// Group them by everything that has to match within an atlas
+	std::map< u32, std::vector<uint> > groups;
+	for (uint i = 0; i < nTextures; i++)
+	{
+		if (!candidate[i] || sampling[i] == &kNotReferenced)
+			continue;
+
+		const TextureResource& res = *sampling[i];
+		u32 key = gfxData.textures[i].format | (res.filter << 8) | (res.wrapS << 16) | (res.wrapT << 24);
+		groups[key].push_back(i);
+	}
+
+	// Fill atlases one after the other, an atlas holding a single image is left alone
+	std::vector<TextureDesc> atlases;
+	std::vector<int> atlasOf(nTextures, -1);
+	std::vector<vec4> rectOf(nTextures);
+	for (auto group = groups.begin(); group != groups.end(); ++group)
+	{
+		const TextureResource& res = *sampling[group->second[0]];
+		std::vector<AtlasImage> page;
+		uint width = 0, height = 0;
+		for (uint i = 0; i <= group->second.size(); i++)
+		{
+			bool last = (i == group->second.size());
+			if (!last)
+			{
+				AtlasImage image = { group->second[i], 0, 0 };
+				page.push_back(image);
+				if (PackAtlas(gfxData.textures, page, width, height))
+					continue;
+				page.pop_back();
+			}
+
+			if (page.size() > 1)
+			{
+				PackAtlas(gfxData.textures, page, width, height);
+				for (uint j = 0; j < page.size(); j++)
+				{
+					const TextureDesc& tex = gfxData.textures[page[j].texIndex];
+					atlasOf[page[j].texIndex] = atlases.size();
+					rectOf[page[j].texIndex] = vec4(float(page[j].x) / width, float(page[j].y) / height,
+						float(tex.width) / width, float(tex.height) / height);
+				}
+				atlases.push_back(BuildAtlas(gfxData.textures, page, width, height, AddressMode(res.wrapS), AddressMode(res.wrapT)));
+			}
+
+			page.clear();
+			if (!last)
+			{
+				AtlasImage image = { group->second[i], 0, 0 };
+				page.push_back(image);
+			}
+		}
+	}
+
+	if (atlases.empty())
+		return 0;
+
+	// Replace the atlased textures with the atlases
+	std::vector<uint> newIndex(nTextures);
+	TextureDesc* textures = (TextureDesc*)malloc(sizeof(TextureDesc) * (nTextures + atlases.size()));
+	uint nNewTextures = 0, nAtlased = 0;
+	for (uint i = 0; i < nTextures; i++)
+	{
+		if (atlasOf[i] < 0)
+		{
+			newIndex[i] = nNewTextures;
+			textures[nNewTextures++] = gfxData.textures[i];
+		}
+		else
+		{
+			free(gfxData.textures[i].imgData);
+			nAtlased++;
+		}
+	}
+	for (uint i = 0; i < nTextures; i++)
+	{
+		if (atlasOf[i] >= 0)
+			newIndex[i] = nNewTextures + atlasOf[i];
+	}
+	memcpy(textures + nNewTextures, atlases.data(), sizeof(TextureDesc) * atlases.size());
+	nNewTextures += atlases.size();
+
+	free(gfxData.textures);
+	gfxData.textures = textures;
+	gfxData.nTextures = nNewTextures;
+
+	// Point the materials at their rectangles and regenerate their pixel shaders
+	std::vector<char> psShaders;
+	std::vector<uint> psOffsets, uniquePsOffsets;
+	for (uint i = 0; i < gfxData.nShaders; i++)
+	{
+		MaterialInfo& mat = model.materials[i];
+		GC3D::AtlasStage stages[8];
+		for (uint j = 0; j < 8; j++)
+		{
+			stages[j].inAtlas = false;
+			if (mat.samplers[j] == 0xffff)
+				continue;
+
+			const TextureResource& res = gfxData.textureResources[mat.samplers[j]];
+			if (atlasOf[res.texIndex] >= 0)
+			{
+				stages[j].inAtlas = true;
+				stages[j].wrapS = AddressMode(res.wrapS);
+				stages[j].wrapT = AddressMode(res.wrapT);
+				mat.texRects[j] = rectOf[res.texIndex];
+				mat.usesAtlas = true;
+			}
+		}
+
+		if (mat.usesAtlas)
+		{
+			std::string ps = GeneratePS(&bdl->tex1, &bdl->mat3, i, stages);
+			psOffsets.push_back(AddShaderText(psShaders, uniquePsOffsets, ps.c_str()));
+		}
+		else
+		{
+			psOffsets.push_back(AddShaderText(psShaders, uniquePsOffsets, gfxData.psShaders + gfxData.psOffsets[i]));
+		}
+	}
+
+	for (uint i = 0; i < gfxData.nTextureResources; i++)
+	{
+		TextureResource& res = gfxData.textureResources[i];
+		res.texIndex = newIndex[res.texIndex];
+	}
+
+	// Materials whose shaders are now the same share one
+	std::vector<char> vsShaders;
+	std::vector<uint> vsOffsets, uniqueVsOffsets, newVsOffsets, newPsOffsets;
+	std::vector<uint> shaderIndex(gfxData.nShaders);
+	for (uint i = 0; i < gfxData.nShaders; i++)
+	{
+		uint vsOffset = AddShaderText(vsShaders, uniqueVsOffsets, gfxData.vsShaders + gfxData.vsOffsets[i]);
+		uint j = 0;
+		while (j < newVsOffsets.size() && (newVsOffsets[j] != vsOffset || newPsOffsets[j] != psOffsets[i])) { j++; }
+		if (j == newVsOffsets.size())
+		{
+			newVsOffsets.push_back(vsOffset);
+			newPsOffsets.push_back(psOffsets[i]);
+		}
+		shaderIndex[i] = j;
+	}
+	for (uint i = 0; i < model.nMaterials; i++)
+	{
+		model.materials[i].shader = shaderIndex[model.materials[i].shader];
+	}
+
+	gfxData.nShaders = newVsOffsets.size();
+	gfxData.vsOffsets = (uint*)realloc(gfxData.vsOffsets, sizeof(uint) * gfxData.nShaders);
+	gfxData.psOffsets = (uint*)realloc(gfxData.psOffsets, sizeof(uint) * gfxData.nShaders);
+	memcpy(gfxData.vsOffsets, newVsOffsets.data(), sizeof(uint) * gfxData.nShaders);
+	memcpy(gfxData.psOffsets, newPsOffsets.data(), sizeof(uint) * gfxData.nShaders);
+	gfxData.vsShaders = (char*)realloc(gfxData.vsShaders, vsShaders.size());
+	gfxData.psShaders = (char*)realloc(gfxData.psShaders, psShaders.size());
+	memcpy(gfxData.vsShaders, vsShaders.data(), vsShaders.size());
+	memcpy(gfxData.psShaders, psShaders.data(), psShaders.size());
+
+	return nAtlased;
+}
+
+// Vertex cache optimization (BakeOptions::optimizeVertexCache). The triangles of every packet are
+// reordered for the post-transform vertex cache with Tom Forsyth's greedy algorithm, which emits
+// the triangle whose vertices score best, favouring vertices that are in a simulated LRU cache and
+// vertices with few triangles left. Packets keep their own range, since they each load a matrix table.
+// A batch keeps its strips if the ordered lists don't transform fewer vertices. The vertices are
+// then renumbered in the order they are first used, so that the vertex fetches are sequential.
+
+static const uint kForsythCacheSize = 32;
+static const uint kSimulatedCacheSize = 16; // FIFO, like most hardware, for the stats
+
+// Appends the non-degenerate triangles of the strips to triangles, keeping their winding
+void StripsToTriangles(const u16* indices, uint indexCount, std::vector<u16>& triangles)
+{
+	uint start = 0;
+	for (uint i = 0; i <= indexCount; i++)
+	{
+		if (i < indexCount && indices[i] != kStripCutIndex)
+			continue;
+
+		for (uint j = start; j + 2 < i; j++)
+		{
+			u16 a = indices[j], b = indices[j + 1], c = indices[j + 2];
+			if (a == b || b == c || a == c)
+				continue;
+
+			// Every other triangle of a strip is wound the other way
+			if ((j - start) & 1) { std::swap(a, b); }
+			triangles.push_back(a);
+			triangles.push_back(b);
+			triangles.push_back(c);
+		}
+		start = i + 1;
+	}
+}
+
+// Returns how many vertices a FIFO cache of kSimulatedCacheSize transforms to draw the indices
+uint SimulateVertexCache(const u16* indices, uint indexCount)
+{
+	u16 cache[kSimulatedCacheSize];
+	uint cacheCount = 0, next = 0, misses = 0;
+	for (uint i = 0; i < indexCount; i++)
+	{
+		if (indices[i] == kStripCutIndex || std::find(cache, cache + cacheCount, indices[i]) != cache + cacheCount)
+			continue;
+
+		cache[next] = indices[i];
+		next = (next + 1) % kSimulatedCacheSize;
+		cacheCount = min(cacheCount + 1, kSimulatedCacheSize);
+		misses++;
+	}
+	return misses;
+}
+
+float ForsythScore(int cachePos, uint nRemaining)
+{
+	if (nRemaining == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePos >= 0)
+	{
+		// The last triangle's vertices get the same score, whatever order it used
+		score = cachePos < 3 ? 0.75f : powf(1.0f - float(cachePos - 3) / (kForsythCacheSize - 3), 1.5f);
+	}
+	return score + 2.0f / sqrtf(float(nRemaining));
+}
+
+// Reorders the triangles, indexed by vertex ids below vertexCount, in place
+void OrderTriangles(u16* triangles, uint nTriangles, uint vertexCount)
+{
+	// Each vertex's triangles, the first nRemaining of them aren't emitted yet
+	std::vector<uint> nRemaining(vertexCount, 0);
+	for (uint i = 0; i < nTriangles * 3; i++) { nRemaining[triangles[i]]++; }
+
+	std::vector<uint> firstAdjacent(vertexCount + 1, 0);
+	for (uint v = 0; v < vertexCount; v++) { firstAdjacent[v + 1] = firstAdjacent[v] + nRemaining[v]; }
+
+	std::vector<uint> adjacent(nTriangles * 3);
+	std::vector<uint> fill(firstAdjacent.begin(), firstAdjacent.end() - 1);
+	for (uint i = 0; i < nTriangles * 3; i++) { adjacent[fill[triangles[i]]++] = i / 3; }
+
+	std::vector<int> cachePos(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (uint v = 0; v < vertexCount; v++) { vertexScore[v] = ForsythScore(-1, nRemaining[v]); }
+
+	std::vector<float> triangleScore(nTriangles);
+	for (uint t = 0; t < nTriangles; t++)
+	{
+		const u16* tri = triangles + t * 3;
+		triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+	}
+
+	std::vector<bool> emitted(nTriangles, false);
+	std::vector<u16> ordered;
+	ordered.reserve(nTriangles * 3);
+
+	// The cache grows by up to 3 vertices before it is trimmed, those are the ones that get evicted
+	std::vector<u16> cache, newCache;
+	uint nextUnemitted = 0;
+	int best = -1;
+	for (uint n = 0; n < nTriangles; n++)
+	{
+		if (best < 0)
+		{
+			// Nothing in the cache has triangles left, start over with the next one in the input order
+			while (emitted[nextUnemitted]) { nextUnemitted++; }
+			best = nextUnemitted;
+		}
+
+		const u16* tri = triangles + best * 3;
+		ordered.insert(ordered.end(), tri, tri + 3);
+		emitted[best] = true;
+
+		for (uint i = 0; i < 3; i++)
+		{
+			u16 v = tri[i];
+			uint* first = &adjacent[firstAdjacent[v]];
+			uint* last = first + --nRemaining[v];
+			std::swap(*std::find(first, last + 1, uint(best)), *last);
+		}
+
+		// Move the triangle's vertices to the front of the cache
+		newCache.assign(tri, tri + 3);
+		for (uint i = 0; i < cache.size(); i++)
+		{
+			if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+				newCache.push_back(cache[i]);
+		}
+		cache.swap(newCache);
+
+		for (uint i = 0; i < cache.size(); i++)
+		{
+			u16 v = cache[i];
+			cachePos[v] = i < kForsythCacheSize ? i : -1;
+			vertexScore[v] = ForsythScore(cachePos[v], nRemaining[v]);
+		}
+
+		// The next triangle is the best one that uses a vertex of the cache
+		best = -1;
+		float bestScore = -1.0f;
+		for (uint i = 0; i < cache.size(); i++)
+		{
+			u16 v = cache[i];
+			for (uint j = 0; j < nRemaining[v]; j++)
+			{
+				uint t = adjacent[firstAdjacent[v] + j];
+				const u16* other = triangles + t * 3;
+				triangleScore[t] = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+		}
+
+		if (cache.size() > kForsythCacheSize) { cache.resize(kForsythCacheSize); }
+	}
+
+	memcpy(triangles, ordered.data(), ordered.size() * sizeof(u16));
+}
+
+// Optimizes every batch of a model that was just loaded, rewriting gfxData.vertexIndexBuffers
+void OptimizeVertexCache(GDModel::GDModel& model, GDModel::BakeStats& stats)
+{
+	GDModel::TemporaryGFXData& gfxData = model.gfxData;
+	std::vector<ubyte> buffers;
+
+	std::vector<u16> triangles, lists, localIndices, packetIndexCounts;
+	std::vector<int> localVertex;
+	std::vector<u16> globalVertex, remap;
+
+	ubyte* head = gfxData.vertexIndexBuffers;
+	for (uint i = 0; i < gfxData.nVertexIndexBuffers; i++)
+	{
+		_Batch* batch = (_Batch*)model.batchPtrs[i];
+
+		u16 attributes = READ(u16);
+		u16 vertexCount = READ(u16);
+		uint vertexSize = GC3D::GetVertexSize(attributes);
+		const ubyte* vertices = READ_ARRAY(ubyte, vertexCount * vertexSize);
+		u16 indexCount = READ(u16);
+		const u16* indices = READ_ARRAY(u16, indexCount);
+
+		// Every packet's strips turned into ordered lists, with packet-local vertex ids for the ordering
+		lists.clear();
+		packetIndexCounts.resize(batch->numPackets);
+		localVertex.assign(vertexCount, -1);
+		uint firstIndex = 0;
+		for (uint j = 0; j < batch->numPackets; j++)
+		{
+			triangles.clear();
+			StripsToTriangles(indices + firstIndex, batch->packets[j].indexCount, triangles);
+			firstIndex += batch->packets[j].indexCount;
+
+			globalVertex.clear();
+			localIndices.resize(triangles.size());
+			for (uint k = 0; k < triangles.size(); k++)
+			{
+				int& local = localVertex[triangles[k]];
+				if (local < 0)
+				{
+					local = globalVertex.size();
+					globalVertex.push_back(triangles[k]);
+				}
+				localIndices[k] = local;
+			}
+			for (uint k = 0; k < globalVertex.size(); k++) { localVertex[globalVertex[k]] = -1; }
+
+			OrderTriangles(localIndices.data(), localIndices.size() / 3, globalVertex.size());
+			for (uint k = 0; k < localIndices.size(); k++) { lists.push_back(globalVertex[localIndices[k]]); }
+
+			packetIndexCounts[j] = localIndices.size();
+		}
+
+		// Triangles and misses are counted per packet, which are separate draws
+		uint stripMisses = 0, listMisses = 0;
+		firstIndex = 0;
+		for (uint j = 0; j < batch->numPackets; j++)
+		{
+			stripMisses += SimulateVertexCache(indices + firstIndex, batch->packets[j].indexCount);
+			firstIndex += batch->packets[j].indexCount;
+		}
+		firstIndex = 0;
+		for (uint j = 0; j < batch->numPackets; j++)
+		{
+			listMisses += SimulateVertexCache(lists.data() + firstIndex, packetIndexCounts[j]);
+			firstIndex += packetIndexCounts[j];
+		}
+
+		// The index count of the batch is a u16 too
+		bool useLists = lists.size() <= 0xffff && listMisses < stripMisses;
+		const u16* newIndices = useLists ? lists.data() : indices;
+		uint newIndexCount = useLists ? lists.size() : indexCount;
+		if (useLists)
+		{
+			batch->primitive = PRIM_TRIANGLES;
+			for (uint j = 0; j < batch->numPackets; j++) { batch->packets[j].indexCount = packetIndexCounts[j]; }
+			stats.nListBatches++;
+		}
+
+		// Renumber the vertices in the order they are first used, dropping the ones that only
+		// degenerate triangles used
+		remap.assign(vertexCount, kStripCutIndex);
+		u16 newVertexCount = 0;
+		for (uint j = 0; j < newIndexCount; j++)
+		{
+			u16 index = newIndices[j];
+			if (index != kStripCutIndex && remap[index] == kStripCutIndex)
+				remap[index] = newVertexCount++;
+		}
+
+		uint offset = buffers.size();
+		buffers.resize(offset + 3 * sizeof(u16) + newVertexCount * vertexSize + newIndexCount * sizeof(u16));
+		ubyte* dst = buffers.data() + offset;
+		memcpy(dst, &attributes, sizeof(u16));
+		memcpy(dst + sizeof(u16), &newVertexCount, sizeof(u16));
+		dst += 2 * sizeof(u16);
+		for (uint v = 0; v < vertexCount; v++)
+		{
+			if (remap[v] != kStripCutIndex)
+				memcpy(dst + remap[v] * vertexSize, vertices + v * vertexSize, vertexSize);
+		}
+		dst += newVertexCount * vertexSize;
+
+		u16 count = newIndexCount;
+		memcpy(dst, &count, sizeof(u16));
+		u16* dstIndices = (u16*)(dst + sizeof(u16));
+		for (uint j = 0; j < newIndexCount; j++)
+		{
+			dstIndices[j] = newIndices[j] == kStripCutIndex ? kStripCutIndex : remap[newIndices[j]];
+		}
+
+		stats.nTriangles += lists.size() / 3;
+		stats.nVertices += newVertexCount;
+		stats.nCacheMissesBefore += stripMisses;
+		stats.nCacheMissesAfter += useLists ? listMisses : stripMisses;
+
+		LOG("Batch %u: ACMR %.3f -> %.3f, %s\n", i, lists.empty() ? 0.0f : 3.0f * stripMisses / lists.size(), 
+			lists.empty() ? 0.0f : 3.0f * min(stripMisses, listMisses) / lists.size(), useLists ? "lists" : "strips");
+	}
+
+	gfxData.vertexIndexBuffers = (ubyte*)realloc(gfxData.vertexIndexBuffers, buffers.size());
+	memcpy(gfxData.vertexIndexBuffers, buffers.data(), buffers.size());
+}
+
+// Compact vertices (BakeOptions::compactVertices). Rewrites the vertices of every batch in the
+// COMPACT_VERTICES layout, quantizing the positions within the bounds of their batch.
+// A half keeps 11 significant bits, so its step grows with the texcoord: 1/16 of a repeat at 64.
+// Batches whose texcoords would be off by more than this many texels of their largest texture keep 
+// them as floats (COMPACT_FLOAT_TEXCOORDS).
+static const float kMaxHalfTexcoordError = 0.25f;
+
+// The largest width or height of the textures that each batch is drawn with, 0 if it has none
+void GetBatchTextureSizes(const GDModel::GDModel& model, std::vector<uint>& sizes)
+{
+	const GDModel::TemporaryGFXData& gfxData = model.gfxData;
+	sizes.assign(model.batchCount, 0);
+
+	const MaterialInfo* mat = NULL;
+	for (const Scenegraph* node = model.scenegraph; node->type != SG_END; node++)
+	{
+		if (node->type == SG_MATERIAL) { mat = &model.materials[node->index]; }
+		if (node->type != SG_PRIM || mat == NULL) continue;
+
+		for (uint i = 0; i < 8 && mat->samplers[i] != 0xffff; i++)
+		{
+			const TextureDesc& tex = gfxData.textures[gfxData.textureResources[mat->samplers[i]].texIndex];
+			sizes[node->index] = max(sizes[node->index], max(tex.width, tex.height));
+		}
+	}
+}
+
+void CompactVertices(GDModel::GDModel& model, GDModel::BakeStats& stats)
+{
+	GDModel::TemporaryGFXData& gfxData = model.gfxData;
+	std::vector<ubyte> buffers;
+
+	std::vector<uint> textureSizes;
+	GetBatchTextureSizes(model, textureSizes);
+
+	ubyte* head = gfxData.vertexIndexBuffers;
+	for (uint i = 0; i < gfxData.nVertexIndexBuffers; i++)
+	{
+		_Batch* batch = (_Batch*)model.batchPtrs[i];
+
+		u16 attributes = READ(u16);
+		u16 vertexCount = READ(u16);
+		uint vertexSize = GC3D::GetVertexSize(attributes);
+		const ubyte* vertices = READ_ARRAY(ubyte, vertexCount * vertexSize);
+		u16 indexCount = READ(u16);
+		const u16* indices = READ_ARRAY(u16, indexCount);
+
+		uint matrixIndexSize = GC3D::GetAttributeSize(HAS_MATRIX_INDICES);
+
+		// The step of a half is 2^-10 of the power of two below its magnitude, half of that is lost rounding
+		float maxTexcoord = 0.0f;
+		uint texcoordOffset = matrixIndexSize;
+		for (uint a = 1; a < MAX_VERTEX_ATTRIBS; a++)
+		{
+			u16 attrib = u16(1 << a);
+			if (!(attributes & attrib)) continue;
+			if (attrib >= HAS_TEXCOORDS0) break;
+			texcoordOffset += GC3D::GetAttributeSize(attrib);
+		}
+		for (uint v = 0; v < vertexCount; v++)
+		{
+			const float* st = (const float*)(vertices + v * vertexSize + texcoordOffset);
+			const float* stEnd = (const float*)(vertices + (v + 1) * vertexSize);
+			for (; st < stEnd; st++) { maxTexcoord = max(maxTexcoord, fabsf(*st)); }
+		}
+		float halfError = maxTexcoord > 0.0f ? ldexpf(0.5f, ilogbf(maxTexcoord) - 10) : 0.0f;
+		bool floatTexcoords = !(halfError * textureSizes[i] <= kMaxHalfTexcoordError);
+
+		u16 compactAttributes = attributes | COMPACT_VERTICES | (floatTexcoords ? COMPACT_FLOAT_TEXCOORDS : 0);
+		uint compactSize = GC3D::GetVertexSize(compactAttributes);
+
+		// The bounds of the batch map to the range of s16, the shader scales them back
+		float bbMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float bbMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint v = 0; v < vertexCount; v++)
+		{
+			const float* pos = (const float*)(vertices + v * vertexSize + matrixIndexSize);
+			for (uint c = 0; c < 3; c++)
+			{
+				bbMin[c] = min(bbMin[c], pos[c]);
+				bbMax[c] = max(bbMax[c], pos[c]);
+			}
+		}
+
+		float scale[3], offset[3];
+		for (uint c = 0; c < 3; c++)
+		{
+			scale[c] = vertexCount ? (bbMax[c] - bbMin[c]) / 65534.0f : 0.0f;
+			offset[c] = vertexCount ? (bbMax[c] + bbMin[c]) * 0.5f : 0.0f;
+			if (scale[c] == 0.0f) { scale[c] = 1.0f; }
+		}
+		batch->positionScale = vec4(scale[0], scale[1], scale[2], 0.0f);
+		batch->positionOffset = vec4(offset[0], offset[1], offset[2], 0.0f);
+
+		uint bufferOffset = buffers.size();
+		buffers.resize(bufferOffset + 3 * sizeof(u16) + vertexCount * compactSize + indexCount * sizeof(u16));
+		ubyte* dst = buffers.data() + bufferOffset;
+		memcpy(dst, &compactAttributes, sizeof(u16));
+		memcpy(dst + sizeof(u16), &vertexCount, sizeof(u16));
+		dst += 2 * sizeof(u16);
+
+		for (uint v = 0; v < vertexCount; v++)
+		{
+			const ubyte* src = vertices + v * vertexSize;
+
+			// The matrix index goes into the 4th component of the position, which is always there
+			uint matrixIndex;
+			memcpy(&matrixIndex, src, sizeof(matrixIndex));
+			src += matrixIndexSize;
+
+			const float* pos = (const float*)src;
+			s16* compactPos = (s16*)dst;
+			for (uint c = 0; c < 3; c++)
+			{
+				float q = floorf((pos[c] - offset[c]) / scale[c] + 0.5f);
+				compactPos[c] = s16(min(max(q, -32767.0f), 32767.0f));
+			}
+			compactPos[3] = s16(matrixIndex);
+			src += GC3D::GetAttributeSize(HAS_POSITIONS);
+			dst += GC3D::GetAttributeSize(HAS_POSITIONS | COMPACT_VERTICES);
+
+			if (attributes & HAS_NORMALS)
+			{
+				const float* nrm = (const float*)src;
+				s8* compactNrm = (s8*)dst;
+				for (uint c = 0; c < 3; c++)
+				{
+					compactNrm[c] = s8(floorf(min(max(nrm[c], -1.0f), 1.0f) * 127.0f + 0.5f));
+				}
+				compactNrm[3] = 0;
+				src += GC3D::GetAttributeSize(HAS_NORMALS);
+				dst += GC3D::GetAttributeSize(HAS_NORMALS | COMPACT_VERTICES);
+			}
+
+			for (uint c = 0; c < 2; c++)
+			{
+				u16 colorAttrib = HAS_COLORS0 << c;
+				if (attributes & colorAttrib)
+				{
+					uint attribSize = GC3D::GetAttributeSize(colorAttrib);
+					memcpy(dst, src, attribSize);
+					src += attribSize;
+					dst += attribSize;
+				}
+			}
+
+			for (uint t = 0; t < 8; t++)
+			{
+				u16 texAttrib = HAS_TEXCOORDS0 << t;
+				if (attributes & texAttrib)
+				{
+					const float* st = (const float*)src;
+					if (floatTexcoords)
+					{
+						memcpy(dst, st, 2 * sizeof(float));
+					}
+					else
+					{
+						half* compactSt = (half*)dst;
+						compactSt[0] = half(st[0]);
+						compactSt[1] = half(st[1]);
+					}
+					src += GC3D::GetAttributeSize(texAttrib);
+					dst += GC3D::GetAttributeSize(texAttrib | (compactAttributes & (COMPACT_VERTICES | COMPACT_FLOAT_TEXCOORDS)));
+				}
+			}
+		}
+
+		memcpy(dst, &indexCount, sizeof(u16));
+		memcpy(dst + sizeof(u16), indices, indexCount * sizeof(u16));
+
+		stats.nVertexBytes += vertexCount * vertexSize;
+		stats.nCompactVertexBytes += vertexCount * compactSize;
+		stats.nFloatTexcoordBatches += floatTexcoords ? 1 : 0;
+
+		LOG("Batch %u: texcoords up to %.2f on %u texels, %s\n", i, maxTexcoord, textureSizes[i], floatTexcoords ? "floats" : "halfs");
+	}
+
+	gfxData.vertexIndexBuffers = (ubyte*)realloc(gfxData.vertexIndexBuffers, buffers.size());
+	memcpy(gfxData.vertexIndexBuffers, buffers.data(), buffers.size());
+}
+
+// Clusters (BakeOptions::buildClusters). Splits the triangles of every packet into clusters 
+// small enough to be culled on their own. Each one grows from the first triangle that is left 
+// through the triangles that share its vertices, so that its bounds stay tight.
+
+static const uint kMaxClusterVertices = 64;
+static const uint kMaxClusterTriangles = 124;
+
+const float* GetPosition(const ubyte* vertices, uint vertexSize, u16 vertex)
+{
+	return (const float*)(vertices + vertex * vertexSize + GC3D::GetAttributeSize(HAS_MATRIX_INDICES));
+}
+
+void GrowBounds(vec3& bbMin, vec3& bbMax, const float* pos)
+{
+	bbMin = vec3(min(bbMin.x, pos[0]), min(bbMin.y, pos[1]), min(bbMin.z, pos[2]));
+	bbMax = vec3(max(bbMax.x, pos[0]), max(bbMax.y, pos[1]), max(bbMax.z, pos[2]));
+}
+
+// Reorders the triangles in place so that each cluster is consecutive, and appends the triangle 
+// count of each one to clusterSizes. The next triangle of a cluster is the one that adds the fewest
+// vertices, and of those the closest to the cluster's center.
+void SplitClusters(u16* triangles, uint nTriangles, const ubyte* vertices, uint vertexSize, uint vertexCount, std::vector<uint>& clusterSizes)
+{
+	std::vector<uint> firstAdjacent(vertexCount + 1, 0);
+	for (uint i = 0; i < nTriangles * 3; i++) { firstAdjacent[triangles[i] + 1]++; }
+	for (uint v = 0; v < vertexCount; v++) { firstAdjacent[v + 1] += firstAdjacent[v]; }
+
+	std::vector<uint> adjacent(nTriangles * 3);
+	std::vector<uint> fill(firstAdjacent.begin(), firstAdjacent.end() - 1);
+	for (uint i = 0; i < nTriangles * 3; i++) { adjacent[fill[triangles[i]]++] = i / 3; }
+
+	std::vector<vec3> centroids(nTriangles);
+	for (uint t = 0; t < nTriangles; t++)
+	{
+		vec3 sum(0.0f);
+		for (uint i = 0; i < 3; i++)
+		{
+			const float* pos = GetPosition(vertices, vertexSize, triangles[t * 3 + i]);
+			sum += vec3(pos[0], pos[1], pos[2]);
+		}
+		centroids[t] = sum / 3.0f;
+	}
+
+	// The cluster that last used each vertex
+	std::vector<uint> vertexCluster(vertexCount, ~0u);
+	std::vector<bool> emitted(nTriangles, false);
+	std::vector<uint> candidates;
+	std::vector<u16> ordered;
+	ordered.reserve(nTriangles * 3);
+
+	uint cluster = 0, clusterVertices = 0, clusterTriangles = 0, nextUnemitted = 0;
+	vec3 centroidSum(0.0f);
+	for (uint n = 0; n < nTriangles; n++)
+	{
+		int best = -1;
+		if (clusterTriangles > 0 && clusterTriangles < kMaxClusterTriangles)
+		{
+			vec3 center = centroidSum / float(clusterTriangles);
+			uint bestNewVertices = 4;
+			float bestDistance = FLT_MAX;
+			for (uint i = 0; i < candidates.size(); )
+			{
+				uint t = candidates[i];
+				if (emitted[t])
+				{
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				i++;
+
+				uint newVertices = 0;
+				for (uint j = 0; j < 3; j++) { newVertices += (vertexCluster[triangles[t * 3 + j]] != cluster); }
+				if (clusterVertices + newVertices > kMaxClusterVertices)
+					continue;
+
+				vec3 offset = centroids[t] - center;
+				float distance = dot(offset, offset);
+				if (newVertices < bestNewVertices || (newVertices == bestNewVertices && distance < bestDistance))
+				{
+					best = t;
+					bestNewVertices = newVertices;
+					bestDistance = distance;
+				}
+			}
+		}
+
+		if (best < 0)
+		{
+			// Full, or no neighbour fits. Start the next one with the next triangle in the input order.
+			if (clusterTriangles > 0)
+			{
+				clusterSizes.push_back(clusterTriangles);
+				cluster++;
+			}
+			clusterVertices = 0;
+			clusterTriangles = 0;
+			centroidSum = vec3(0.0f);
+			candidates.clear();
+
+			while (emitted[nextUnemitted]) { nextUnemitted++; }
+			best = nextUnemitted;
+		}
+
+		const u16* tri = triangles + best * 3;
+		ordered.insert(ordered.end(), tri, tri + 3);
+		emitted[best] = true;
+		clusterTriangles++;
+		centroidSum += centroids[best];
+
+		for (uint i = 0; i < 3; i++)
+		{
+			u16 v = tri[i];
+			if (vertexCluster[v] == cluster)
+				continue;
+
+			vertexCluster[v] = cluster;
+			clusterVertices++;
+			for (uint j = firstAdjacent[v]; j < firstAdjacent[v + 1]; j++)
+			{
+				if (!emitted[adjacent[j]])
+					candidates.push_back(adjacent[j]);
+			}
+		}
+	}
+	if (clusterTriangles > 0) { clusterSizes.push_back(clusterTriangles); }
+
+	memcpy(triangles, ordered.data(), ordered.size() * sizeof(u16));
+}
+
+// Bounds the cluster's triangles with a sphere, grown by padding, and their normals with a cone
+void ComputeClusterBounds(_Cluster& cluster, const u16* triangles, uint nTriangles, const ubyte* vertices, uint vertexSize, float padding)
+{
+	vec3 bbMin(FLT_MAX), bbMax(-FLT_MAX);
+	cluster.matrixMask = 0;
+	for (uint i = 0; i < nTriangles * 3; i++)
+	{
+		const float* pos = GetPosition(vertices, vertexSize, triangles[i]);
+		GrowBounds(bbMin, bbMax, pos);
+
+		uint matrixIndex;
+		memcpy(&matrixIndex, vertices + triangles[i] * vertexSize, sizeof(matrixIndex));
+		cluster.matrixMask |= 1 << matrixIndex;
+	}
+
+	vec3 center = (bbMin + bbMax) * 0.5f;
+	float radiusSq = 0.0f;
+	for (uint i = 0; i < nTriangles * 3; i++)
+	{
+		const float* pos = GetPosition(vertices, vertexSize, triangles[i]);
+		vec3 offset = vec3(pos[0], pos[1], pos[2]) - center;
+		radiusSq = max(radiusSq, dot(offset, offset));
+	}
+	cluster.sphere = vec4(center.x, center.y, center.z, sqrtf(radiusSq) + padding);
+
+	// Triangles without an area are never drawn, the others are wound the way the rasterizer sees them
+	std::vector<vec3> normals;
+	vec3 normalSum(0.0f);
+	for (uint t = 0; t < nTriangles; t++)
+	{
+		const float* a = GetPosition(vertices, vertexSize, triangles[t * 3 + 0]);
+		const float* b = GetPosition(vertices, vertexSize, triangles[t * 3 + 1]);
+		const float* c = GetPosition(vertices, vertexSize, triangles[t * 3 + 2]);
+		vec3 normal = cross(vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]), vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+		float area = length(normal);
+		if (area <= 0.0f)
+			continue;
+
+		normals.push_back(normal / area);
+		normalSum += normals.back();
+	}
+
+	float sumLength = length(normalSum);
+	if (sumLength < 1e-3f)
+	{
+		cluster.cone = vec4(0.0f);
+		return;
+	}
+
+	vec3 axis = normalSum / sumLength;
+	float cosSpread = 1.0f;
+	for (uint i = 0; i < normals.size(); i++) { cosSpread = min(cosSpread, dot(normals[i], axis)); }
+	cluster.cone = vec4(axis.x, axis.y, axis.z, cosSpread);
+}
+
+// Clusters the packets of every batch of a model that was just loaded, rewriting gfxData.vertexIndexBuffers.
+// Runs before CompactVertices(), whose rounding the bounding spheres are padded for.
+void BuildClusters(GDModel::GDModel& model, GDModel::BakeStats& stats)
+{
+	GDModel::TemporaryGFXData& gfxData = model.gfxData;
+	std::vector<ubyte> buffers;
+
+	std::vector<u16> lists, localIndices, globalVertex;
+	std::vector<int> localVertex;
+	std::vector<uint> packetTriangleCounts, clusterSizes;
+
+	ubyte* head = gfxData.vertexIndexBuffers;
+	for (uint i = 0; i < gfxData.nVertexIndexBuffers; i++)
+	{
+		_Batch* batch = (_Batch*)model.batchPtrs[i];
+
+		ubyte* batchStart = head;
+		u16 attributes = READ(u16);
+		u16 vertexCount = READ(u16);
+		uint vertexSize = GC3D::GetVertexSize(attributes);
+		const ubyte* vertices = READ_ARRAY(ubyte, vertexCount * vertexSize);
+		u16 indexCount = READ(u16);
+		const u16* indices = READ_ARRAY(u16, indexCount);
+
+		// The triangles of every packet, as lists
+		lists.clear();
+		packetTriangleCounts.resize(batch->numPackets);
+		uint firstIndex = 0;
+		for (uint j = 0; j < batch->numPackets; j++)
+		{
+			uint listSize = lists.size();
+			if (batch->primitive == PRIM_TRIANGLE_STRIP)
+				StripsToTriangles(indices + firstIndex, batch->packets[j].indexCount, lists);
+			else
+				lists.insert(lists.end(), indices + firstIndex, indices + firstIndex + batch->packets[j].indexCount);
+			firstIndex += batch->packets[j].indexCount;
+			packetTriangleCounts[j] = (lists.size() - listSize) / 3;
+		}
+
+		// The index count of the batch is a u16, batches whose lists don't fit are left as they are
+		if (lists.size() > 0xffff)
+		{
+			LOG("Batch %u: %u triangles are too many for lists, not clustered\n", i, uint(lists.size() / 3));
+			buffers.insert(buffers.end(), batchStart, head);
+			continue;
+		}
+
+		// CompactVertices() rounds each position by up to half a step of its batch's bounds
+		vec3 bbMin(FLT_MAX), bbMax(-FLT_MAX);
+		for (uint v = 0; v < vertexCount; v++)
+		{
+			GrowBounds(bbMin, bbMax, GetPosition(vertices, vertexSize, v));
+		}
+		float padding = vertexCount ? length(bbMax - bbMin) / 65534.0f : 0.0f;
+
+		localVertex.assign(vertexCount, -1);
+		u16* packetTriangles = lists.data();
+		for (uint j = 0; j < batch->numPackets; j++)
+		{
+			_Packet& packet = batch->packets[j];
+			uint nTriangles = packetTriangleCounts[j];
+
+			clusterSizes.clear();
+			SplitClusters(packetTriangles, nTriangles, vertices, vertexSize, vertexCount, clusterSizes);
+
+			packet.indexCount = nTriangles * 3;
+			packet.clusterCount = clusterSizes.size();
+			packet.clusters = (_Cluster*)malloc(sizeof(_Cluster) * clusterSizes.size());
+
+			u16* clusterTriangles = packetTriangles;
+			for (uint k = 0; k < clusterSizes.size(); k++)
+			{
+				// Order each cluster for the vertex cache, with cluster-local vertex ids
+				globalVertex.clear();
+				localIndices.resize(clusterSizes[k] * 3);
+				for (uint l = 0; l < localIndices.size(); l++)
+				{
+					int& local = localVertex[clusterTriangles[l]];
+					if (local < 0)
+					{
+						local = globalVertex.size();
+						globalVertex.push_back(clusterTriangles[l]);
+					}
+					localIndices[l] = local;
+				}
+				for (uint l = 0; l < globalVertex.size(); l++) { localVertex[globalVertex[l]] = -1; }
+
+				OrderTriangles(localIndices.data(), clusterSizes[k], globalVertex.size());
+				for (uint l = 0; l < localIndices.size(); l++) { clusterTriangles[l] = globalVertex[localIndices[l]]; }
+
+				_Cluster& cluster = packet.clusters[k];
+				ComputeClusterBounds(cluster, clusterTriangles, clusterSizes[k], vertices, vertexSize, padding);
+				cluster.firstIndex = clusterTriangles - packetTriangles;
+				cluster.indexCount = clusterSizes[k] * 3;
+				cluster.pad = 0;
+				clusterTriangles += clusterSizes[k] * 3;
+			}
+
+			packetTriangles += nTriangles * 3;
+			stats.nClusters += clusterSizes.size();
+		}
+		batch->primitive = PRIM_TRIANGLES;
+		stats.nClusterTriangles += lists.size() / 3;
+
+		uint offset = buffers.size();
+		u16 newIndexCount = lists.size();
+		buffers.resize(offset + 3 * sizeof(u16) + vertexCount * vertexSize + newIndexCount * sizeof(u16));
+		ubyte* dst = buffers.data() + offset;
+		memcpy(dst, batchStart, 2 * sizeof(u16) + vertexCount * vertexSize);
+		dst += 2 * sizeof(u16) + vertexCount * vertexSize;
+		memcpy(dst, &newIndexCount, sizeof(u16));
+		memcpy(dst + sizeof(u16), lists.data(), newIndexCount * sizeof(u16));
+	}
+
+	gfxData.vertexIndexBuffers = (ubyte*)realloc(gfxData.vertexIndexBuffers, buffers.size());
+	memcpy(gfxData.vertexIndexBuffers, buffers.data(), buffers.size());
+}
+
+RESULT GDModel::Bake(const BModel* bdl, std::vector<ubyte>& blob, const BakeOptions* options, BakeStats* stats)
+{
+	RESULT r = S_OK;
+	BakeStats bakeStats;
+	memset(&bakeStats, 0, sizeof(bakeStats));
+	
+	// Do the conversion as usual, then flatten the result
+	GDModel model;
+	memset(&model, 0, sizeof(model));
+	IFC( Load(&model, bdl) );
+
+	if (options != NULL && options->atlasMaxTextureSize > 0)
+	{
+		AtlasTextures(model, bdl, options->atlasMaxTextureSize);
+	}
+
+	if (options != NULL && options->optimizeVertexCache)
+	{
+		OptimizeVertexCache(model, bakeStats);
+	}
+
+	if (options != NULL && options->buildClusters)
+	{
+		BuildClusters(model, bakeStats);
+	}
+
+	if (options != NULL && options->compactVertices)
+	{
+		CompactVertices(model, bakeStats);
+	}
+	if (stats != NULL) { *stats = bakeStats; }
+
+	{
+		TemporaryGFXData& gfxData = model.gfxData;
+		ModelBlobHeader header;
+		memset(&header, 0, sizeof(header));
+		util::BlobRange* sections = header.sections;
+
+		blob.clear();
+		util::BlobWrite(blob, &header, sizeof(header), 1); // Filled in at the end
+
+		// Scenegraph, including the terminating SG_END node
+		uint nNodes = 1;
+		while (model.scenegraph[nNodes - 1].type != SG_END) { nNodes++; }
+		sections[MB_SCENEGRAPH] = util::BlobWrite(blob, model.scenegraph, sizeof(Scenegraph), nNodes);
+
+		// Batches, with their packet, matrix index and cluster pointers turned into indices
+		std::vector<BlobBatch> batches(model.batchCount);
+		std::vector<BlobPacket> packets;
+		std::vector<u16> matrixIndices;
+		std::vector<_Cluster> clusters;
+		for (uint i = 0; i < model.batchCount; i++)
+		{
+			_Batch* batch = (_Batch*)model.batchPtrs[i];
+			batches[i].numPackets = batch->numPackets;
+			batches[i].primitive = batch->primitive;
+			batches[i].positionScale = batch->positionScale;
+			batches[i].positionOffset = batch->positionOffset;
+			batches[i].firstPacket = packets.size();
+
+			for (uint j = 0; j < batch->numPackets; j++)
+			{
+				const _Packet& packet = batch->packets[j];
+				BlobPacket blobPacket = { packet.indexCount, packet.matrixCount, (u32)matrixIndices.size(), 
+					(u32)clusters.size(), packet.clusterCount, 0 };
+				packets.push_back(blobPacket);
+				matrixIndices.insert(matrixIndices.end(), 
+					packet.matrixIndices, packet.matrixIndices + packet.matrixCount);
+				clusters.insert(clusters.end(), packet.clusters, packet.clusters + packet.clusterCount);
+			}
+		}
+		sections[MB_BATCHES] = util::BlobWrite(blob, batches.data(), sizeof(BlobBatch), batches.size());
+		sections[MB_PACKETS] = util::BlobWrite(blob, packets.data(), sizeof(BlobPacket), packets.size());
+		sections[MB_MATRIX_INDICES] = util::BlobWrite(blob, matrixIndices.data(), sizeof(u16), matrixIndices.size());
+		sections[MB_CLUSTERS] = util::BlobWrite(blob, clusters.data(), sizeof(_Cluster), clusters.size());
+
+		// Materials, draw table, joints
+		sections[MB_MATERIALS] = util::BlobWrite(blob, model.materials, sizeof(MaterialInfo), model.nMaterials);
+		sections[MB_DRW_TABLE] = util::BlobWrite(blob, model.drwTable, sizeof(DrwElement), bdl->drw1.data.size());
+		sections[MB_JOINTS] = util::BlobWrite(blob, model.jointTable, sizeof(JointElement), model.numJoints);
+		sections[MB_DEFAULT_POSE] = util::BlobWrite(blob, model.defaultPose, sizeof(JointElement), model.numJoints);
+
+		// Envelopes
+		u32 weightCount = bdl->evp1.weightedIndices.size();
+		u32 weightedIndexCount = 0;
+		for (uint i = 0; i < weightCount; i++) { weightedIndexCount += model.evpWeightedIndexSizesTable[i]; }
+		sections[MB_EVP_MATRICES] = util::BlobWrite(blob, model.evpMatrixTable, sizeof(mat4), bdl->evp1.matrices.size());
+		sections[MB_EVP_SIZES] = util::BlobWrite(blob, model.evpWeightedIndexSizesTable, sizeof(u8), weightCount);
+		sections[MB_EVP_OFFSETS] = util::BlobWrite(blob, model.evpWeightedIndexOffsetTable, sizeof(u16), weightCount);
+		sections[MB_EVP_WEIGHTED_INDICES] = util::BlobWrite(blob, model.evpWeightedIndexTable, sizeof(WeightedIndex), weightedIndexCount);
+
+		// Textures, all images go into one data array
+		std::vector<BlobTexture> textures(gfxData.nTextures);
+		std::vector<ubyte> textureData;
+		Image img;
+		for (uint i = 0; i < gfxData.nTextures; i++)
+		{
+			const TextureDesc& tex = gfxData.textures[i];
+			BlobTexture& blobTex = textures[i];
+			blobTex.format = tex.format;
+			blobTex.width = tex.width;
+			blobTex.height = tex.height;
+			blobTex.numMips = tex.numMips;
+			blobTex.sizeBytes = tex.sizeBytes;
+			blobTex.texDataOffset = textureData.size();
+
+			if (options != NULL && options->textureQuality >= 0 && tex.format != FORMAT_NONE)
+			{
+				// Works on a copy, the conversion may change the pixels in place
+				img.loadFromMemory(tex.imgData, tex.format, tex.width, tex.height, 1, tex.numMips, false);
+				if (GC3D::CompressTexture(img, options->textureQuality))
+				{
+					blobTex.format = img.getFormat();
+					blobTex.sizeBytes = img.getMipMappedSize(0, tex.numMips);
+					textureData.insert(textureData.end(), img.getPixels(), img.getPixels() + blobTex.sizeBytes);
+					continue;
+				}
+			}
+			textureData.insert(textureData.end(), tex.imgData, tex.imgData + tex.sizeBytes);
+		}
+		sections[MB_TEXTURE_RESOURCES] = util::BlobWrite(blob, gfxData.textureResources, sizeof(TextureResource), gfxData.nTextureResources);
+		sections[MB_TEXTURES] = util::BlobWrite(blob, textures.data(), sizeof(BlobTexture), textures.size());
+		sections[MB_TEXTURE_DATA] = util::BlobWrite(blob, textureData.data(), sizeof(ubyte), textureData.size());
+
+		// Render states
+		sections[MB_BLEND_MODES] = util::BlobWrite(blob, gfxData.blendModes, sizeof(BlendMode), gfxData.nBlendModes);
+		sections[MB_DEPTH_MODES] = util::BlobWrite(blob, gfxData.depthModes, sizeof(DepthMode), gfxData.nDepthModes);
+		sections[MB_CULL_MODES] = util::BlobWrite(blob, gfxData.cullModes, sizeof(u8), gfxData.nCullModes);
+
+		// Shader HLSL
+		uint vsSize = GetShaderTextSize(gfxData.vsShaders, gfxData.vsOffsets, gfxData.nShaders);
+		uint psSize = GetShaderTextSize(gfxData.psShaders, gfxData.psOffsets, gfxData.nShaders);
+		sections[MB_VS_OFFSETS] = util::BlobWrite(blob, gfxData.vsOffsets, sizeof(uint), gfxData.nShaders);
+		sections[MB_PS_OFFSETS] = util::BlobWrite(blob, gfxData.psOffsets, sizeof(uint), gfxData.nShaders);
+		sections[MB_VS_SHADERS] = util::BlobWrite(blob, gfxData.vsShaders, sizeof(char), vsSize);
+		sections[MB_PS_SHADERS] = util::BlobWrite(blob, gfxData.psShaders, sizeof(char), psSize);
+
+		// Vertex and index buffers, already in their final layout
+		uint viSize = GetVertexIndexBuffersSize(gfxData);
+		sections[MB_VERTEX_INDEX_BUFFERS] = util::BlobWrite(blob, gfxData.vertexIndexBuffers, sizeof(ubyte), viSize);
+
+		header.magic = kModelBlobMagic;
+		header.version = kModelBlobVersion;
+		header.size = blob.size();
+		memcpy(blob.data(), &header, sizeof(header));
+	}
+
+	FreeTemporaryGFXData(model.gfxData);
+	FreeTemporaryTextures(model.gfxData);
+	FreeModelTables(&model);
+
+cleanup:
+	return r;
+}
+
+// True if the elements [first, first + count) are inside an array of size elements
+bool InRange(u64 first, u64 count, u64 size)
+{
+	return first + count <= size;
+}
+
+// Returns false if the blob doesn't fit into size bytes, or if anything that Draw() and Update() 
+// follow through it leads outside of its section: the packet, matrix index and cluster ranges, the indices in 
+// the scenegraph, materials, draw table, joints and envelopes, the texture data and shader text, 
+// and the walk through the vertex and index buffers
+bool CheckModelBlob(ubyte* blob, uint size)
+{
+	const ModelBlobHeader* header = (const ModelBlobHeader*)blob;
+	const util::BlobRange* sections = header->sections;
+
+	if (size < sizeof(ModelBlobHeader) || header->size > size)
+		return false;
+
+	for (uint i = 0; i < MB_SECTION_COUNT; i++)
+	{
+		if (!util::BlobCheck(sections[i], kModelBlobElemSizes[i], header->size))
+			return false;
+	}
+
+	uint nBatches = sections[MB_BATCHES].count;
+	uint nPackets = sections[MB_PACKETS].count;
+	uint nMaterials = sections[MB_MATERIALS].count;
+	uint nJoints = sections[MB_JOINTS].count;
+	uint nShaders = sections[MB_VS_OFFSETS].count;
+
+	// Batches and packets, the packets of a batch draw exactly its indices (checked with the buffers below)
+	BlobBatch* batches = util::BlobRead<BlobBatch>(blob, sections[MB_BATCHES]);
+	BlobPacket* packets = util::BlobRead<BlobPacket>(blob, sections[MB_PACKETS]);
+	for (uint i = 0; i < nBatches; i++)
+	{
+		if (!InRange(batches[i].firstPacket, batches[i].numPackets, nPackets) || 
+			(batches[i].primitive != PRIM_TRIANGLES && batches[i].primitive != PRIM_TRIANGLE_STRIP))
+			return false;
+	}
+	_Cluster* clusters = util::BlobRead<_Cluster>(blob, sections[MB_CLUSTERS]);
+	for (uint i = 0; i < nPackets; i++)
+	{
+		if (!InRange(packets[i].firstMatrixIndex, packets[i].matrixCount, sections[MB_MATRIX_INDICES].count) || 
+			packets[i].matrixCount > kMaxPacketMatrices ||
+			!InRange(packets[i].firstCluster, packets[i].clusterCount, sections[MB_CLUSTERS].count))
+			return false;
+
+		// The clusters draw parts of the packet's indices
+		for (uint j = 0; j < packets[i].clusterCount; j++)
+		{
+			const _Cluster& cluster = clusters[packets[i].firstCluster + j];
+			if (!InRange(cluster.firstIndex, cluster.indexCount, packets[i].indexCount))
+				return false;
+		}
+	}
+
+	// Matrix indices into the draw table, 0xffff keeps the matrix of the previous packet
+	u16* matrixIndices = util::BlobRead<u16>(blob, sections[MB_MATRIX_INDICES]);
+	for (uint i = 0; i < sections[MB_MATRIX_INDICES].count; i++)
+	{
+		if (matrixIndices[i] != 0xffff && matrixIndices[i] >= sections[MB_DRW_TABLE].count)
+			return false;
+	}
+
+	// Draw table, envelopes and joints. The root joint is always used, the others follow their parent.
+	DrwElement* drwTable = util::BlobRead<DrwElement>(blob, sections[MB_DRW_TABLE]);
+	u8* evpSizes = util::BlobRead<u8>(blob, sections[MB_EVP_SIZES]);
+	u16* evpOffsets = util::BlobRead<u16>(blob, sections[MB_EVP_OFFSETS]);
+	WeightedIndex* weightedIndices = util::BlobRead<WeightedIndex>(blob, sections[MB_EVP_WEIGHTED_INDICES]);
+	for (uint i = 0; i < sections[MB_DRW_TABLE].count; i++)
+	{
+		const DrwElement& drw = drwTable[i];
+		if (!drw.isWeighted && drw.index >= nJoints)
+			return false;
+		if (drw.isWeighted && (drw.index >= sections[MB_EVP_SIZES].count || drw.index >= sections[MB_EVP_OFFSETS].count ||
+			!InRange(evpOffsets[drw.index], evpSizes[drw.index], sections[MB_EVP_WEIGHTED_INDICES].count)))
+			return false;
+	}
+	for (uint i = 0; i < sections[MB_EVP_WEIGHTED_INDICES].count; i++)
+	{
+		if (weightedIndices[i].index >= sections[MB_EVP_MATRICES].count || weightedIndices[i].index >= nJoints)
+			return false;
+	}
+
+	JointElement* joints = util::BlobRead<JointElement>(blob, sections[MB_JOINTS]);
+	if (nJoints == 0 || sections[MB_DEFAULT_POSE].count != nJoints)
+		return false;
+	for (uint i = 1; i < nJoints; i++)
+	{
+		if (joints[i].parent >= nJoints)
+			return false;
+	}
+
+	// Scenegraph, every batch is drawn with a material that was set before it
+	Scenegraph* scenegraph = util::BlobRead<Scenegraph>(blob, sections[MB_SCENEGRAPH]);
+	bool hasMaterial = false;
+	uint node = 0;
+	for (; node < sections[MB_SCENEGRAPH].count && scenegraph[node].type != SG_END; node++)
+	{
+		if (scenegraph[node].type == SG_MATERIAL && scenegraph[node].index >= nMaterials)
+			return false;
+		if (scenegraph[node].type == SG_PRIM && (scenegraph[node].index >= nBatches || !hasMaterial))
+			return false;
+		hasMaterial |= (scenegraph[node].type == SG_MATERIAL);
+	}
+	if (node == sections[MB_SCENEGRAPH].count)
+		return false;
+
+	// Materials, their samplers index the texture resources up to the first unused one
+	MaterialInfo* materials = util::BlobRead<MaterialInfo>(blob, sections[MB_MATERIALS]);
+	for (uint i = 0; i < nMaterials; i++)
+	{
+		const MaterialInfo& mat = materials[i];
+		if (uint(mat.shader) >= nShaders || uint(mat.blendMode) >= sections[MB_BLEND_MODES].count ||
+			uint(mat.depthMode) >= sections[MB_DEPTH_MODES].count || uint(mat.rasterMode) >= sections[MB_CULL_MODES].count)
+			return false;
+
+		for (uint j = 0; j < 8 && u16(mat.samplers[j]) != 0xffff; j++)
+		{
+			if (u16(mat.samplers[j]) >= sections[MB_TEXTURE_RESOURCES].count)
+				return false;
+		}
+	}
+
+	// Textures, each holds the whole mip chain that its description asks for
+	TextureResource* resources = util::BlobRead<TextureResource>(blob, sections[MB_TEXTURE_RESOURCES]);
+	for (uint i = 0; i < sections[MB_TEXTURE_RESOURCES].count; i++)
+	{
+		if (resources[i].texIndex >= sections[MB_TEXTURES].count)
+			return false;
+	}
+
+	BlobTexture* textures = util::BlobRead<BlobTexture>(blob, sections[MB_TEXTURES]);
+	ubyte* textureData = util::BlobRead<ubyte>(blob, sections[MB_TEXTURE_DATA]);
+	for (uint i = 0; i < sections[MB_TEXTURES].count; i++)
+	{
+		const BlobTexture& tex = textures[i];
+		if (uint(tex.format) > FORMAT_ATI2N || tex.width == 0 || tex.width > 16384 || tex.height == 0 || tex.height > 16384 || 
+			tex.numMips == 0 || tex.numMips > 16 || !InRange(tex.texDataOffset, tex.sizeBytes, sections[MB_TEXTURE_DATA].count))
+			return false;
+
+		Image img;
+		img.loadFromMemory(textureData + tex.texDataOffset, FORMAT(tex.format), tex.width, tex.height, 1, tex.numMips, true);
+		if (uint(img.getMipMappedSize(0, tex.numMips)) > tex.sizeBytes)
+			return false;
+	}
+
+	// Shaders, the text of each one ends within its section. The vertex formats are made with the first one.
+	uint* vsOffsets = util::BlobRead<uint>(blob, sections[MB_VS_OFFSETS]);
+	uint* psOffsets = util::BlobRead<uint>(blob, sections[MB_PS_OFFSETS]);
+	char* vsShaders = util::BlobRead<char>(blob, sections[MB_VS_SHADERS]);
+	char* psShaders = util::BlobRead<char>(blob, sections[MB_PS_SHADERS]);
+	uint vsSize = sections[MB_VS_SHADERS].count;
+	uint psSize = sections[MB_PS_SHADERS].count;
+	if (sections[MB_PS_OFFSETS].count != nShaders || (nBatches > 0 && nShaders == 0))
+		return false;
+	if (nShaders > 0 && (vsSize == 0 || vsShaders[vsSize - 1] != 0 || psSize == 0 || psShaders[psSize - 1] != 0))
+		return false;
+	for (uint i = 0; i < nShaders; i++)
+	{
+		if (vsOffsets[i] >= vsSize || psOffsets[i] >= psSize)
+			return false;
+	}
+
+	// Vertex and index buffers, one per batch in the layout that RegisterGFX() reads. Bake() 
+	// converts either all of them to COMPACT_VERTICES or none.
+	ubyte* head = util::BlobRead<ubyte>(blob, sections[MB_VERTEX_INDEX_BUFFERS]);
+	ubyte* end = head + sections[MB_VERTEX_INDEX_BUFFERS].count;
+	u16 validAttributes = ((HAS_TEXCOORDS7 << 1) - 1) | COMPACT_VERTICES | COMPACT_FLOAT_TEXCOORDS;
+	u16 firstAttributes = 0;
+	for (uint i = 0; i < nBatches; i++)
+	{
+		if (uint(end - head) < 2 * sizeof(u16))
+			return false;
+		u16 attributes = READ(u16);
+		u16 numVertices = READ(u16);
+		firstAttributes = (i == 0) ? attributes : firstAttributes;
+		if ((attributes & ~validAttributes) || (attributes & COMPACT_VERTICES) != (firstAttributes & COMPACT_VERTICES))
+			return false;
+		if ((attributes & COMPACT_FLOAT_TEXCOORDS) && !(attributes & COMPACT_VERTICES))
+			return false;
+
+		uint vertexBytes = numVertices * GC3D::GetVertexSize(attributes);
+		if (uint(end - head) < vertexBytes + sizeof(u16))
+			return false;
+		head += vertexBytes;
+		u16 numIndices = READ(u16);
+		if (uint(end - head) < numIndices * sizeof(u16))
+			return false;
+		u16* indices = READ_ARRAY(u16, numIndices);
+
+		for (uint j = 0; j < numIndices; j++)
+		{
+			if (indices[j] >= numVertices && indices[j] != kStripCutIndex)
+				return false;
+		}
+
+		uint packetIndices = 0;
+		for (uint j = 0; j < batches[i].numPackets; j++)
+		{
+			packetIndices += packets[batches[i].firstPacket + j].indexCount;
+		}
+		if (packetIndices != numIndices)
+			return false;
+	}
+
+	return true;
+}
+
+RESULT GDModel::Reload(GDModel* model, ubyte* blob, uint size)
+{
+	const ModelBlobHeader* header = (const ModelBlobHeader*)blob;
+	const util::BlobRange* sections = header->sections;
+
+	if (size < sizeof(ModelBlobHeader) || header->magic != kModelBlobMagic || header->version != kModelBlobVersion)
+	{
+		WARN("Not a baked model, or baked with a different version\n");
+		return E_FAIL;
+	}
+
+	if (!CheckModelBlob(blob, size))
+	{
+		WARN("Baked model is corrupt\n");
+		return E_FAIL;
+	}
+
+	// Release the old asset, if any
+	if (model->scenegraph)
+	{
+		Unload(model);
+	}
+
+	uint nBatches = sections[MB_BATCHES].count;
+	uint nPackets = sections[MB_PACKETS].count;
+	uint nMaterials = sections[MB_MATERIALS].count;
+	uint nTextures = sections[MB_TEXTURES].count;
+
+	// Everything that holds pointers, or is modified by RegisterGFX(), goes into a 
+	// single allocation. All pointer-sized members come first to keep them aligned.
+	uint runtimeSize = sizeof(ubyte*) * nBatches + sizeof(_Batch) * nBatches + 
+		sizeof(_Packet) * nPackets + sizeof(TextureDesc) * nTextures + sizeof(MaterialInfo) * nMaterials;
+	ubyte* runtime = (ubyte*)malloc(runtimeSize);
+
+	ubyte** batchPtrs = (ubyte**)runtime;
+	_Batch* batches = (_Batch*)(batchPtrs + nBatches);
+	_Packet* packets = (_Packet*)(batches + nBatches);
+	TextureDesc* textures = (TextureDesc*)(packets + nPackets);
+	MaterialInfo* materials = (MaterialInfo*)(textures + nTextures);
+
+	// Batches and packets
+	BlobBatch* blobBatches = util::BlobRead<BlobBatch>(blob, sections[MB_BATCHES]);
+	BlobPacket* blobPackets = util::BlobRead<BlobPacket>(blob, sections[MB_PACKETS]);
+	u16* matrixIndices = util::BlobRead<u16>(blob, sections[MB_MATRIX_INDICES]);
+	_Cluster* clusters = util::BlobRead<_Cluster>(blob, sections[MB_CLUSTERS]);
+	for (uint i = 0; i < nBatches; i++)
+	{
+		_Batch& batch = batches[i];
+		memset(&batch, 0xff, sizeof(_Batch));
+		batch.primitive = blobBatches[i].primitive;
+		batch.positionScale = blobBatches[i].positionScale;
+		batch.positionOffset = blobBatches[i].positionOffset;
+		batch.numPackets = blobBatches[i].numPackets;
+		batch.packets = packets + blobBatches[i].firstPacket;
+		batchPtrs[i] = (ubyte*)&batch;
+	}
+	for (uint i = 0; i < nPackets; i++)
+	{
+		packets[i].indexCount = blobPackets[i].indexCount;
+		packets[i].matrixCount = blobPackets[i].matrixCount;
+		packets[i].matrixIndices = matrixIndices + blobPackets[i].firstMatrixIndex;
+		packets[i].clusterCount = blobPackets[i].clusterCount;
+		packets[i].clusters = clusters + blobPackets[i].firstCluster;
+	}
+
+	model->scenegraph = util::BlobRead<Scenegraph>(blob, sections[MB_SCENEGRAPH]);
+	model->batchCount = nBatches;
+	model->batchPtrs = batchPtrs;
+
+	memcpy(materials, blob + sections[MB_MATERIALS].offset, sizeof(MaterialInfo) * nMaterials);
+	model->nMaterials = nMaterials;
+	model->materials = materials;
+
+	model->numJoints = sections[MB_JOINTS].count;
+	model->jointTable = util::BlobRead<JointElement>(blob, sections[MB_JOINTS]);
+	model->defaultPose = util::BlobRead<JointElement>(blob, sections[MB_DEFAULT_POSE]);
+
+	model->drwTable = util::BlobRead<DrwElement>(blob, sections[MB_DRW_TABLE]);
+	model->evpMatrixTable = util::BlobRead<mat4>(blob, sections[MB_EVP_MATRICES]);
+	model->evpWeightedIndexSizesTable = util::BlobRead<u8>(blob, sections[MB_EVP_SIZES]);
+	model->evpWeightedIndexOffsetTable = util::BlobRead<u16>(blob, sections[MB_EVP_OFFSETS]);
+	model->evpWeightedIndexTable = util::BlobRead<WeightedIndex>(blob, sections[MB_EVP_WEIGHTED_INDICES]);
+
+	// GPU data, uploaded straight from the blob by the next Draw()
+	TemporaryGFXData& gfxData = model->gfxData;
+	gfxData.nVertexIndexBuffers = nBatches;
+	gfxData.vertexIndexBuffers = util::BlobRead<ubyte>(blob, sections[MB_VERTEX_INDEX_BUFFERS]);
+
+	gfxData.nTextureResources = sections[MB_TEXTURE_RESOURCES].count;
+	gfxData.textureResources = util::BlobRead<TextureResource>(blob, sections[MB_TEXTURE_RESOURCES]);
+
+	BlobTexture* blobTextures = util::BlobRead<BlobTexture>(blob, sections[MB_TEXTURES]);
+	gfxData.textureData = util::BlobRead<ubyte>(blob, sections[MB_TEXTURE_DATA]);
+	for (uint i = 0; i < nTextures; i++)
+	{
+		TextureDesc& tex = textures[i];
+		tex.format = FORMAT(blobTextures[i].format);
+		tex.width = blobTextures[i].width;
+		tex.height = blobTextures[i].height;
+		tex.numMips = blobTextures[i].numMips;
+		tex.sizeBytes = blobTextures[i].sizeBytes;
+		tex.texDataOffset = blobTextures[i].texDataOffset;
+		tex.imgData = gfxData.textureData + tex.texDataOffset;
+	}
+	gfxData.nTextures = nTextures;
+	gfxData.textures = textures;
+
+	gfxData.nBlendModes = sections[MB_BLEND_MODES].count;
+	gfxData.blendModes = util::BlobRead<BlendMode>(blob, sections[MB_BLEND_MODES]);
+	gfxData.nDepthModes = sections[MB_DEPTH_MODES].count;
+	gfxData.depthModes = util::BlobRead<DepthMode>(blob, sections[MB_DEPTH_MODES]);
+	gfxData.nCullModes = sections[MB_CULL_MODES].count;
+	gfxData.cullModes = util::BlobRead<u8>(blob, sections[MB_CULL_MODES]);
+
+	gfxData.nShaders = sections[MB_VS_OFFSETS].count;
+	gfxData.vsOffsets = util::BlobRead<uint>(blob, sections[MB_VS_OFFSETS]);
+	gfxData.psOffsets = util::BlobRead<uint>(blob, sections[MB_PS_OFFSETS]);
+	gfxData.vsShaders = util::BlobRead<char>(blob, sections[MB_VS_SHADERS]);
+	gfxData.psShaders = util::BlobRead<char>(blob, sections[MB_PS_SHADERS]);
+
+	model->blob = blob;
+	model->loadGPU = true;
+	model->streamTextures = false;
+	model->screenSize = 0;
+	model->nTextureIDs = 0;
+	model->textureIDs = nullptr;
+	model->nVertexBufferIDs = 0;
+	model->vertexBufferIDs = nullptr;
+	model->vertexFormatIDs = nullptr;
+	model->indexBufferID = IB_NONE;
+
+	return S_OK;
+}
+
+RESULT GDModel::Update(GDModel* model, GDAnim::GDAnim* anim, float time)
+{
+	// Grab the root joint straight from the animation. It's parent is the identity
+	float weights[1] = {1.0f};
+	if (anim) { model->jointTable[0].matrix = GDAnim::GetJoint(&anim, weights, 1, 0, time);	}
+	else { model->jointTable[0].matrix = model->defaultPose[0].matrix; }
+
+	for (uint i = 1; i < model->numJoints; i++)
+	{
+		JointElement& joint = model->jointTable[i];
+
+		// Calculate joint from animation at current time
+		mat4 animMatrix;
+		if (anim ) { animMatrix = GDAnim::GetJoint(&anim, weights, 1, i, time); }
+		else{ animMatrix = model->defaultPose[i].matrix;}	
+
+		// Put in parent's frame
+		joint.matrix = model->jointTable[joint.parent].matrix * animMatrix;
+	}
+
+	return S_OK;
+}
+
+void RequestTextures(GDModel::GDModel* model, const MaterialInfo& mat)
+{
+	for (uint i = 0; i < 8 && mat.samplers[i] != 0xffff; i++)
+	{
+		// An atlased texture only covers its rectangle of the atlas
+		float scale = mat.usesAtlas ? 1.0f / min(mat.texRects[i].z, mat.texRects[i].w) : 1.0f;
+		TextureStreamer::Request(mat.textures[i], model->screenSize * scale);
+	}
+}
+
+void GDModel::SetScreenSize(GDModel* model, float screenSize)
+{
+	model->screenSize = screenSize;
+}
+
+void GDModel::SetView(GDModel* model, const mat4& viewProj, const vec3& viewPos)
+{
+	model->hasView = true;
+	model->viewProj = viewProj;
+	model->viewPos = viewPos;
+}
+
+RESULT GDModel::Draw(Renderer* renderer, GDModel* model)
+{
+	u16 matIndex = -1;
+	memset(&model->drawStats, 0, sizeof(model->drawStats));
+
+	ClusterView view;
+	if (model->hasView)
+	{
+		// The sign of the area that the projection gives a face on screen, for the faces in front of the view
+		const mat4& m = model->viewProj;
+		vec3 x = m.rows[0].xyz(), y = m.rows[1].xyz(), w = m.rows[3].xyz();
+		view.frustum.loadFrustum(m);
+		view.position = model->viewPos;
+		view.handedness = dot(x, cross(y, w)) >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	if (model->loadGPU)
+	{
+		RegisterGFX(renderer, model);
+		model->loadGPU = false;
+	}
+
+	for (Scenegraph* node = model->scenegraph; node->type != SG_END; node++)
+	{
 		switch(node->type)
 		{	
 		case SG_MATERIAL: 
 			matIndex = node->index;
+			if (model->streamTextures)
+			{
+				RequestTextures(model, model->materials[matIndex]);
+			}
 			break;
 
 		case SG_PRIM:
-			DrawBatch(renderer, model, node->index, matIndex);
+			DrawBatch(renderer, model, node->index, matIndex, model->hasView ? &view : NULL);
 			break;	
 		}
 	}
@@ -1,9 +1,10 @@
 #pragma once
 
-#include "Common\common.h"
-#include "Framework3\Renderer.h"
+#include "Common/common.h"
+#include "Framework3/Renderer.h"
 #include "GC3D.h"
 #include "GDAnim.h"
+#include <vector>
 
 struct TextureResource;
 struct TextureDesc;
@@ -55,6 +56,16 @@ namespace GDModel
 		char* psShaders;
 	};
 	
+	struct DrawStats
+	{
+		uint nClusters;         // of the drawn batches
+		uint nCulledClusters;   // outside of the view frustum
+		uint nBackfaceClusters; // only facing away from the view
+		uint nIndices;          // of the drawn batches
+		uint nDrawnIndices;     // of the clusters that weren't culled, and of batches without clusters
+		uint nDrawCalls;
+	};
+
 	struct GDModel
 	{
 		Scenegraph* scenegraph;
@@ -78,6 +89,32 @@ namespace GDModel
 		//		to load/reload all the GPU assets that we own
 		bool loadGPU; 
 		TemporaryGFXData gfxData;
+
+		// Set by Reload(). The tables above point into this baked blob (see Bake()),
+		//		which must stay alive until Unload(). NULL if the model was built by Load().
+		ubyte* blob;
+
+		// Set on the first draw of a baked model while the TextureStreamer runs. The
+		//		materials then hold StreamIDs, requested with screenSize (see SetScreenSize())
+		bool streamTextures;
+		float screenSize;
+
+		// Set on the first draw, what the TextureRegistry returned for each texture
+		uint nTextureIDs;
+		int* textureIDs;
+
+		// Set on the first draw, the buffers and formats that the batches share (see RegisterGFX()),
+		//		one vertex buffer and format per vertex layout and one index buffer for all of them
+		uint nVertexBufferIDs;
+		VertexBufferID* vertexBufferIDs;
+		VertexFormatID* vertexFormatIDs;
+		IndexBufferID indexBufferID;
+
+		// Set by SetView(), the clusters of baked models are culled against it if hasView
+		bool hasView;
+		mat4 viewProj;
+		vec3 viewPos;
+		DrawStats drawStats; // of the last Draw()
 	};
 	
 	
@@ -85,7 +122,17 @@ namespace GDModel
 
 	RESULT Draw(Renderer* renderer, GDModel* model);
 
-	//Save our asset reference and initialize the model in the renderer
+	//How many pixels the model covers on screen, which decides the mip levels its textures
+	//stream in (see TextureStreamer). 0, the default, asks for every level.
+	void SetScreenSize(GDModel* model, float screenSize);
+
+	//The camera of the next draws. The clusters of baked models (see BakeOptions::buildClusters)
+	//that are outside of the viewProj frustum, or whose faces all turn away from viewPos, are skipped.
+	//Everything is drawn until this is called.
+	void SetView(GDModel* model, const mat4& viewProj, const vec3& viewPos);
+
+	//Save our asset reference and initialize the model in the renderer. Fails if a batch has more
+	//than 65534 vertices or 65535 indices, the limits of its u16 counts and indices.
 	RESULT Load(GDModel* model, const BModel* bdl);
 	
 	//Unregister our old asset with the renderer. Delete our asset reference
@@ -93,5 +140,57 @@ namespace GDModel
 
 	//Unregister our old asset with the renderer. Save our new reference.
 	//Initialize our new asset with the renderer. The asset manager will then delete the old asset.
-	RESULT Reload(GDModel* model, ubyte* blob);
+	//Fails if the size bytes at blob are not a complete baked model of this version.
+	RESULT Reload(GDModel* model, ubyte* blob, uint size);
+
+	struct BakeOptions
+	{
+		//Block compress the textures with this Image::compressImage() quality (see
+		//GC3D::CompressTexture()). Negative keeps them uncompressed.
+		int textureQuality;
+
+		//Pack textures without mipmaps up to this size into texture atlases, grouped by
+		//format and sampler state. Materials address them through a per-stage TexRect
+		//constant and share their shaders if that makes them equal. 0 disables it.
+		uint atlasMaxTextureSize;
+
+		//Reorder the triangles of every packet for the post-transform vertex cache, turning the
+		//strips of a batch into triangle lists if that transforms fewer vertices, then reorder
+		//the vertices in the order they are first used.
+		bool optimizeVertexCache;
+
+		//Store the vertices in the compact layout of GC3D.h (COMPACT_VERTICES), positions as s16
+		//within the bounds of their batch, normals as snorm8 and texcoords as halfs. Batches that
+		//tile their textures too far for halfs keep float texcoords (COMPACT_FLOAT_TEXCOORDS).
+		bool compactVertices;
+
+		//Split the triangles of every packet into clusters of up to 64 vertices and 124 triangles,
+		//with a bounding sphere and a cone of their normals, so that Draw() can cull them (see
+		//SetView()). The clustered batches are drawn as triangle lists.
+		bool buildClusters;
+	};
+
+	struct BakeStats
+	{
+		//Filled in with optimizeVertexCache. The cache misses are the vertices a 16 entry FIFO
+		//cache transforms, ACMR is misses per triangle and ATVR misses per vertex.
+		uint nTriangles;
+		uint nVertices;
+		uint nCacheMissesBefore;
+		uint nCacheMissesAfter;
+		uint nListBatches;  // that were converted to triangle lists
+
+		//Filled in with compactVertices, the size of the vertices before and after
+		uint nVertexBytes;
+		uint nCompactVertexBytes;
+		uint nFloatTexcoordBatches;
+
+		//Filled in with buildClusters
+		uint nClusters;
+		uint nClusterTriangles;
+	};
+
+	//Convert a parsed model into a baked blob that Reload() can use directly.
+	//The blob is little-endian and only contains offsets, so it can be written to disk as is.
+	RESULT Bake(const BModel* bdl, std::vector<ubyte>& blob, const BakeOptions* options = NULL, BakeStats* stats = NULL);
 }
\ No newline at end of file
@@ -1,16 +1,16 @@
 #include <stdio.h>
-#include <tchar.h>
 #include <stdarg.h>
 #include <fstream>
 #include <sstream>
 
-#include "json\json.h"
+#include "json/json.h"
 
 #include "common.h"
 #include "gx.h"
-#include "BMDRead\bmdread.h"
-#include "BMDRead\bck.h"
-#include "BMDRead\openfile.h"
+#include "BMDRead/bmdread.h"
+#include "BMDRead/bck.h"
+#include "BMDRead/openfile.h"
+#include "GC3D.h"
 
 const std::string varResultName = "result";
 const std::string varRegisterName[3] = {"r0", "r1", "r2"};
@@ -392,7 +392,19 @@ std::string GetAlphaOpString(uint op, uint bias, uint scale, uint clamp, uint ou
 	return str.str() + "\n";
 }
 
-std::string GeneratePS(const Tex1* texInfo, const Mat3* matInfo, int index)
+// HLSL for a texcoord in the unwrapped [0, 1] range of an atlased texture
+std::string GetAtlasWrapString(const std::string& coord, AddressMode wrap)
+{
+	switch (wrap)
+	{
+	case WRAP: return "frac(" + coord + ")";
+	case MIRROR: return "(1 - abs(frac(" + coord + " * 0.5) * 2 - 1))";
+	default: return "saturate(" + coord + ")";
+	}
+}
+
+// atlasStages is NULL or has an entry for each of the 8 texture stages
+std::string GeneratePS(const Tex1* texInfo, const Mat3* matInfo, int index, const GC3D::AtlasStage* atlasStages)
 {
 	const Material& mat = matInfo->materials[index];
 
@@ -402,6 +414,7 @@ std::string GeneratePS(const Tex1* texInfo, const Mat3* matInfo, int index)
 
 	// Helper macros
 	out << "#define SAMPLE(texIdx, uvIdx) Texture##texIdx.Sample( Sampler##texIdx, In.TexCoord##uvIdx )\n";
+	out << "#define SAMPLE_ATLAS(texIdx, uv) Texture##texIdx.Sample( Sampler##texIdx, TexRect[texIdx].xy + TexRect[texIdx].zw * (uv) )\n";
 	out << "\n";
 
 	// Input structure
@@ -441,9 +454,29 @@ std::string GeneratePS(const Tex1* texInfo, const Mat3* matInfo, int index)
 		//Texture2D Texture0;
 		//SamplerState Sampler0;
 		out << "SamplerState Sampler" << i << ";\n";
-		out << "Texture2D Texture" << i << "; //"
-			<< mat.texStages[i] << " -> "
-			<< texHdrIndex << ", " << texInfo->imageHeaders[texHdrIndex].name << "\n";
+		if (atlasStages != NULL && atlasStages[i].inAtlas)
+		{
+			// Leave out the texture name so that the materials sharing an atlas can share the shader
+			out << "Texture2D Texture" << i << "; //atlas\n";
+		}
+		else
+		{
+			out << "Texture2D Texture" << i << "; //"
+				<< mat.texStages[i] << " -> "
+				<< texHdrIndex << ", " << texInfo->imageHeaders[texHdrIndex].name << "\n";
+		}
+		out << "\n";
+	}
+
+	bool usesAtlas = false;
+	for (uint i = 0; atlasStages != NULL && i < 8; i++)
+	{
+		usesAtlas = usesAtlas || (mat.texStages[i] != 0xffff && atlasStages[i].inAtlas);
+	}
+	if (usesAtlas)
+	{
+		// Offset (xy) and size (zw) of each atlased texture in its atlas
+		out << "float4 TexRect[8];\n";
 		out << "\n";
 	}
 
@@ -490,6 +523,8 @@ std::string GeneratePS(const Tex1* texInfo, const Mat3* matInfo, int index)
 			{
 			case I8: swizzle = ".rrrr"; break;
 			case I8_A8: swizzle = ".rrrg"; break;
+			case RGB565: swizzle = ""; break;
+			case RGBA4: swizzle = ""; break;
 			case RGBA8: swizzle = ""; break;
 			case DXT1: swizzle = ""; break;
 			default:
@@ -498,8 +533,19 @@ std::string GeneratePS(const Tex1* texInfo, const Mat3* matInfo, int index)
 				swizzle = "";
 			}
 
-			out << "float4 tex" << tex << coord << " = SAMPLE(" 
-				<< tex << ", " << coord << ")" << swizzle << ";\n";
+			if (atlasStages != NULL && atlasStages[tex].inAtlas)
+			{
+				std::ostringstream uv;
+				uv << "In.TexCoord" << coord;
+				out << "float4 tex" << tex << coord << " = SAMPLE_ATLAS(" << tex << ", float2("
+					<< GetAtlasWrapString(uv.str() + ".x", atlasStages[tex].wrapS) << ", "
+					<< GetAtlasWrapString(uv.str() + ".y", atlasStages[tex].wrapT) << "))" << swizzle << ";\n";
+			}
+			else
+			{
+				out << "float4 tex" << tex << coord << " = SAMPLE(" 
+					<< tex << ", " << coord << ")" << swizzle << ";\n";
+			}
 		}
 	}
 	out << "\n";
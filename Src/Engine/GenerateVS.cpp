@@ -1,16 +1,15 @@
 #include <stdio.h>
-#include <tchar.h>
 #include <stdarg.h>
 #include <fstream>
 #include <sstream>
 
-#include "json\json.h"
+#include "json/json.h"
 
 #include "common.h"
 #include "gx.h"
-#include "BMDRead\bmdread.h"
-#include "BMDRead\bck.h"
-#include "BMDRead\openfile.h"
+#include "BMDRead/bmdread.h"
+#include "BMDRead/bck.h"
+#include "BMDRead/openfile.h"
 
 #define PI 3.14159265358979323846f
 
@@ -131,14 +130,21 @@ std::string GenerateVS(const Mat3* matInfo, int index)
 	out << "cbuffer PerPacket" << "\n";
 	out << "{" << "\n";
 	out << "  float4x4 ModelMat[10];" << "\n";
+	out << "  float4 PositionScale;" << "\n";
+	out << "  float4 PositionOffset;" << "\n";
 	out << "}" << "\n";
 	out << "\n";
 
-	// In/Out structures
+	// In/Out structures. COMPACT_VERTICES is defined by the renderer for models in the compact vertex
+	// layout (see GC3D.h), whose positions are quantized within their batch's bounds.
 	out << "struct VsIn" << "\n";
 	out << "{" << "\n";
+	out << "#ifdef COMPACT_VERTICES" << "\n";
+	out << "int4   Position : Position;" << "\n";
+	out << "#else" << "\n";
 	out << "uint   MatIndex : Generic;" << "\n";
 	out << "float3 Position : Position;" << "\n";
+	out << "#endif" << "\n";
 	out << "float4 VtxColor0: Color0;" << "\n";
 	out << "float4 VtxColor1: Color1;" << "\n";
 	out << "float2 TexCoord0: Texcoord0;" << "\n";
@@ -184,7 +190,14 @@ std::string GenerateVS(const Mat3* matInfo, int index)
 	out << "float4 matColor1 = " << getColorString(matInfo->matColor[mat.matColor[1]]) << ";\n";
 
 	// Transformation
-	out << "Out.Position = mul(ModelMat[In.MatIndex], float4(In.Position, 1.0));" << "\n";
+	out << "#ifdef COMPACT_VERTICES" << "\n";
+	out << "float3 Position = In.Position.xyz * PositionScale.xyz + PositionOffset.xyz;" << "\n";
+	out << "uint MatIndex = In.Position.w;" << "\n";
+	out << "#else" << "\n";
+	out << "float3 Position = In.Position;" << "\n";
+	out << "uint MatIndex = In.MatIndex;" << "\n";
+	out << "#endif" << "\n";
+	out << "Out.Position = mul(ModelMat[MatIndex], float4(Position, 1.0));" << "\n";
 	out << "Out.Position = mul(WorldViewProj, Out.Position);" << "\n";
 	out << "\n";
 	
@@ -0,0 +1,186 @@
+#include "TextureRegistry.h"
+#include "TextureStreamer.h"
+#include "util.h"
+#include "Framework3/Imaging/Image.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace
+{
+	struct RegisteredTexture
+	{
+		u64 key;
+		u64 desc; // see MakeDesc()
+		bool streamed;
+		int id; // TextureID, or StreamID if streamed
+		uint refs;
+		uint sizeBytes;
+
+		// The data of every reference, which stays valid until it is released. Equal keys are
+		// checked against the first, and the streamer reads it.
+		std::vector<const ubyte*> sources;
+	};
+
+	// Both by key and by id, the TextureIDs and StreamIDs are separate. Images whose keys
+	// collide get an entry each.
+	typedef std::multimap<u64, RegisteredTexture> TextureMap;
+	TextureMap s_textures;
+	std::map<int, u64> s_keys[2];
+	TextureRegistry::Stats s_stats;
+
+	u64 MakeDesc(FORMAT format, uint width, uint height, uint numMips, bool streamed)
+	{
+		return (u64(format) << 56) ^ (u64(numMips) << 48) ^ (u64(width) << 24) ^ u64(height) ^ (streamed ? 1ull << 63 : 0);
+	}
+
+	u64 MakeKey(const ubyte* data, uint sizeBytes, u64 desc)
+	{
+		// The description goes into the seed, so equal bytes in other formats or sizes don't match
+		return util::hash64(data, sizeBytes, desc);
+	}
+
+	// The texture of an identical image. The key only picks the candidates, a hash can collide.
+	RegisteredTexture* Find(u64 key, u64 desc, const ubyte* data, uint sizeBytes)
+	{
+		std::pair<TextureMap::iterator, TextureMap::iterator> range = s_textures.equal_range(key);
+		for (TextureMap::iterator it = range.first; it != range.second; ++it)
+		{
+			RegisteredTexture& tex = it->second;
+			if (tex.desc == desc && tex.sizeBytes == sizeBytes && memcmp(tex.sources.front(), data, sizeBytes) == 0)
+				return &tex;
+		}
+		return NULL;
+	}
+
+	// The entry of a texture by its id
+	TextureMap::iterator FindByID(bool streamed, int id)
+	{
+		std::map<int, u64>::iterator key = s_keys[streamed].find(id);
+		ASSERT(key != s_keys[streamed].end());
+
+		std::pair<TextureMap::iterator, TextureMap::iterator> range = s_textures.equal_range(key->second);
+		TextureMap::iterator it = range.first;
+		while (it != range.second && it->second.id != id) { ++it; }
+		ASSERT(it != range.second);
+		return it;
+	}
+
+	RegisteredTexture& Insert(u64 key, u64 desc, bool streamed, int id, const ubyte* data, uint sizeBytes)
+	{
+		RegisteredTexture& tex = s_textures.insert(std::make_pair(key, RegisteredTexture()))->second;
+		tex.key = key;
+		tex.desc = desc;
+		tex.streamed = streamed;
+		tex.id = id;
+		tex.refs = 1;
+		tex.sizeBytes = sizeBytes;
+		tex.sources.push_back(data);
+		s_keys[streamed][id] = key;
+
+		s_stats.nTextures++;
+		s_stats.nReferences++;
+		s_stats.uniqueBytes += sizeBytes;
+		return tex;
+	}
+
+	void AddReference(RegisteredTexture& tex, const ubyte* data)
+	{
+		tex.refs++;
+		tex.sources.push_back(data);
+		s_stats.nReferences++;
+		s_stats.sharedBytes += tex.sizeBytes;
+	}
+
+	// True if that was the last reference, the caller removes the texture
+	bool RemoveReference(RegisteredTexture& tex, const ubyte* data, bool* wasFirstSource)
+	{
+		std::vector<const ubyte*>& sources = tex.sources;
+		std::vector<const ubyte*>::iterator source = std::find(sources.begin(), sources.end(), data);
+		ASSERT(source != sources.end());
+		*wasFirstSource = (source == sources.begin());
+		sources.erase(source);
+
+		s_stats.nReferences--;
+		if (--tex.refs > 0)
+		{
+			s_stats.sharedBytes -= tex.sizeBytes;
+			return false;
+		}
+
+		s_stats.nTextures--;
+		s_stats.uniqueBytes -= tex.sizeBytes;
+		s_keys[tex.streamed].erase(tex.id);
+		return true;
+	}
+}
+
+TextureID TextureRegistry::Acquire(Renderer* renderer, const ubyte* data, uint sizeBytes, FORMAT format, uint width, uint height, uint numMips)
+{
+	u64 desc = MakeDesc(format, width, height, numMips, false);
+	u64 key = MakeKey(data, sizeBytes, desc);
+	RegisteredTexture* tex = Find(key, desc, data, sizeBytes);
+	if (tex != NULL)
+	{
+		AddReference(*tex, data);
+		return tex->id;
+	}
+
+	Image img;
+	img.loadFromMemory((void*)data, format, width, height, 1, numMips, true);
+	TextureID texture = renderer->addTexture(img);
+
+	Insert(key, desc, false, texture, data, sizeBytes);
+	return texture;
+}
+
+void TextureRegistry::Release(Renderer* renderer, TextureID texture, const ubyte* data)
+{
+	TextureMap::iterator it = FindByID(false, texture);
+	bool wasFirstSource;
+	if (RemoveReference(it->second, data, &wasFirstSource))
+	{
+		renderer->removeTexture(texture);
+		s_textures.erase(it);
+	}
+}
+
+int TextureRegistry::AcquireStreamed(Renderer* renderer, const ubyte* data, uint sizeBytes, FORMAT format, uint width, uint height, uint numMips)
+{
+	u64 desc = MakeDesc(format, width, height, numMips, true);
+	u64 key = MakeKey(data, sizeBytes, desc);
+	RegisteredTexture* tex = Find(key, desc, data, sizeBytes);
+	if (tex != NULL)
+	{
+		AddReference(*tex, data);
+		return tex->id;
+	}
+
+	TextureStreamer::StreamID id = TextureStreamer::Add(renderer, data, format, width, height, numMips);
+	Insert(key, desc, true, id, data, sizeBytes);
+	return id;
+}
+
+void TextureRegistry::ReleaseStreamed(Renderer* renderer, int streamID, const ubyte* data)
+{
+	TextureMap::iterator it = FindByID(true, streamID);
+	RegisteredTexture& tex = it->second;
+
+	bool wasStreamedFrom;
+	if (RemoveReference(tex, data, &wasStreamedFrom))
+	{
+		TextureStreamer::Remove(renderer, streamID);
+		s_textures.erase(it);
+	}
+	else if (wasStreamedFrom)
+	{
+		// The data of this reference is about to go away with its model
+		TextureStreamer::SetSource(streamID, tex.sources.front());
+	}
+}
+
+void TextureRegistry::GetStats(Stats* stats)
+{
+	*stats = s_stats;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "Common/common.h"
+#include "Framework3/Renderer.h"
+
+// Shares the textures of all loaded models. Images are keyed by the util::hash64 of their
+// data, with their format, size and mip count, so identical images that several models embed
+// (foliage, water, glyphs) are uploaded once. Equal keys are compared byte for byte, images
+// that only collide get a texture each. Every Acquire() takes a reference, and the
+// texture is removed when the last one is released.
+namespace TextureRegistry
+{
+	struct Stats
+	{
+		uint nTextures;    // unique textures
+		uint nReferences;  // held by the models
+		uint uniqueBytes;  // of the unique textures, full mip chains
+		uint sharedBytes;  // that references to an existing texture didn't have to upload
+	};
+
+	//Returns the texture of an identical image, or uploads it. data is the full mip chain of sizeBytes.
+	//Later images are compared against it, so it must stay valid until the same data is released.
+	//The registry keeps no copy, every reference passes its own.
+	TextureID Acquire(Renderer* renderer, const ubyte* data, uint sizeBytes, FORMAT format, uint width, uint height, uint numMips);
+	void Release(Renderer* renderer, TextureID texture, const ubyte* data);
+
+	//The same for textures streamed by the TextureStreamer, returns a StreamID
+	int AcquireStreamed(Renderer* renderer, const ubyte* data, uint sizeBytes, FORMAT format, uint width, uint height, uint numMips);
+	void ReleaseStreamed(Renderer* renderer, int streamID, const ubyte* data);
+
+	void GetStats(Stats* stats);
+}
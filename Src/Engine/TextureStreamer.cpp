@@ -0,0 +1,430 @@
+#include "TextureStreamer.h"
+#include "Framework3/Imaging/Image.h"
+
+#include <condition_variable>
+#include <deque>
+#include <math.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const uint kTailSize = 64;      // mip levels up to this size are always resident
+	const uint kEvictFrames = 120;  // textures that aren't requested for this long drop to their tail
+	const uint kMaxMips = 16;
+
+	struct StreamedTexture
+	{
+		const ubyte* data;
+		FORMAT format;
+		uint width;
+		uint height;
+		uint numMips;
+		uint mipOffsets[kMaxMips + 1]; // mipOffsets[numMips] is the size of the whole chain
+
+		TextureID texture;
+		uint residentMip; // first level on the GPU
+		uint tailMip;
+		uint wantedMip;
+
+		float requestedSize;
+		uint requestFrame;
+
+		// A fetch of the levels from pendingMip on is queued, staging is set once the worker is done
+		bool pending;
+		uint pendingMip;
+		ubyte* staging;
+
+		bool used;
+	};
+
+	struct FetchJob
+	{
+		TextureStreamer::StreamID id;
+		const ubyte* src;
+		uint size;
+	};
+
+	struct FetchResult
+	{
+		TextureStreamer::StreamID id;
+		ubyte* staging;
+	};
+
+	std::vector<StreamedTexture> s_textures; // indexed by StreamID
+	std::vector<TextureStreamer::StreamID> s_freeIDs;
+	uint s_frame;
+	TextureStreamer::Stats s_stats;
+	uint s_uploadBytesPerFrame;
+	bool s_running = false;
+
+	// Shared with the worker thread
+	std::thread s_worker;
+	std::mutex s_mutex;
+	std::condition_variable s_wakeWorker;
+	std::condition_variable s_fetchDone;
+	std::deque<FetchJob> s_jobs;
+	TextureStreamer::StreamID s_fetchingID = -1; // the texture the worker is copying
+	std::vector<FetchResult> s_results;
+	bool s_quit;
+
+	// Copies the requested levels out of the blob. With the blob in a memory mapped or
+	// streamed file this is where the reads happen, off the render thread.
+	void FetchWorker()
+	{
+		std::unique_lock<std::mutex> lock(s_mutex);
+		while (true)
+		{
+			s_wakeWorker.wait(lock, [] { return s_quit || !s_jobs.empty(); });
+			if (s_quit)
+				return;
+
+			FetchJob job = s_jobs.front();
+			s_jobs.pop_front();
+			s_fetchingID = job.id;
+
+			lock.unlock();
+			ubyte* staging = (ubyte*)malloc(job.size);
+			memcpy(staging, job.src, job.size);
+			lock.lock();
+
+			FetchResult result = { job.id, staging };
+			s_results.push_back(result);
+			s_fetchingID = -1;
+			s_fetchDone.notify_all();
+		}
+	}
+
+	uint LevelsSize(const StreamedTexture& tex, uint firstMip)
+	{
+		return tex.mipOffsets[tex.numMips] - tex.mipOffsets[firstMip];
+	}
+
+	// Replaces the texture with one that has the levels from firstMip on, stored at data
+	void SwapLevels(Renderer* renderer, StreamedTexture& tex, const ubyte* data, uint firstMip)
+	{
+		Image img;
+		img.loadFromMemory((void*)data, tex.format, max(tex.width >> firstMip, 1u), max(tex.height >> firstMip, 1u), 1,
+			tex.numMips - firstMip, true);
+
+		TextureID texture = renderer->addTexture(img);
+		if (tex.texture != TEXTURE_NONE)
+		{
+			renderer->removeTexture(tex.texture);
+		}
+
+		s_stats.residentBytes += LevelsSize(tex, firstMip);
+		s_stats.residentBytes -= (tex.texture != TEXTURE_NONE) ? LevelsSize(tex, tex.residentMip) : 0;
+		tex.texture = texture;
+		tex.residentMip = firstMip;
+	}
+
+	void FinishFetch(StreamedTexture& tex)
+	{
+		free(tex.staging);
+		tex.staging = NULL;
+		tex.pending = false;
+	}
+
+	void ReleaseID(TextureStreamer::StreamID id)
+	{
+		s_textures[id].used = false;
+		s_freeIDs.push_back(id);
+	}
+
+	// The first level that covers screenSize pixels
+	uint MipForSize(const StreamedTexture& tex, float screenSize)
+	{
+		if (screenSize <= 0)
+			return 0;
+
+		float levels = log2f(float(max(tex.width, tex.height)) / screenSize);
+		return levels <= 0 ? 0 : min(uint(levels), tex.tailMip);
+	}
+
+	// Drops levels of the textures that need the most memory until the wanted levels fit into the budget
+	void FitBudget(uint wantedBytes)
+	{
+		while (wantedBytes > s_stats.budgetBytes)
+		{
+			StreamedTexture* largest = NULL;
+			for (uint i = 0; i < s_textures.size(); i++)
+			{
+				StreamedTexture& tex = s_textures[i];
+				if (tex.used && tex.wantedMip < tex.tailMip &&
+					(largest == NULL || LevelsSize(tex, tex.wantedMip) > LevelsSize(*largest, largest->wantedMip)))
+				{
+					largest = &tex;
+				}
+			}
+			if (largest == NULL)
+				return;
+
+			wantedBytes -= LevelsSize(*largest, largest->wantedMip) - LevelsSize(*largest, largest->wantedMip + 1);
+			largest->wantedMip++;
+		}
+	}
+}
+
+RESULT TextureStreamer::Init(uint budgetBytes, uint uploadBytesPerFrame)
+{
+	if (s_running)
+		return S_OK;
+
+	memset(&s_stats, 0, sizeof(s_stats));
+	s_stats.budgetBytes = budgetBytes;
+	s_uploadBytesPerFrame = uploadBytesPerFrame;
+	s_frame = 0;
+	s_quit = false;
+	s_worker = std::thread(FetchWorker);
+	s_running = true;
+
+	return S_OK;
+}
+
+void TextureStreamer::Shutdown(Renderer* renderer)
+{
+	if (!s_running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_quit = true;
+	}
+	s_wakeWorker.notify_one();
+	s_worker.join();
+
+	for (uint i = 0; i < s_results.size(); i++)
+	{
+		free(s_results[i].staging);
+	}
+	for (uint i = 0; i < s_textures.size(); i++)
+	{
+		StreamedTexture& tex = s_textures[i];
+		free(tex.staging);
+		if (tex.used)
+		{
+			renderer->removeTexture(tex.texture);
+		}
+	}
+
+	s_jobs.clear();
+	s_results.clear();
+	s_textures.clear();
+	s_freeIDs.clear();
+	s_running = false;
+}
+
+bool TextureStreamer::IsRunning()
+{
+	return s_running;
+}
+
+TextureStreamer::StreamID TextureStreamer::Add(Renderer* renderer, const ubyte* data, FORMAT format, uint width, uint height, uint numMips)
+{
+	StreamID id;
+	if (s_freeIDs.empty())
+	{
+		id = s_textures.size();
+		s_textures.resize(id + 1);
+	}
+	else
+	{
+		id = s_freeIDs.back();
+		s_freeIDs.pop_back();
+	}
+
+	StreamedTexture& tex = s_textures[id];
+	memset(&tex, 0, sizeof(tex));
+	tex.data = data;
+	tex.format = format;
+	tex.width = width;
+	tex.height = height;
+	tex.numMips = min(numMips, kMaxMips);
+	tex.texture = TEXTURE_NONE;
+	tex.requestFrame = s_frame - kEvictFrames - 1; // not requested yet
+	tex.used = true;
+
+	Image img;
+	img.loadFromMemory((void*)data, format, width, height, 1, tex.numMips, true);
+	for (uint i = 0; i <= tex.numMips; i++)
+	{
+		tex.mipOffsets[i] = img.getMipMappedSize(0, i);
+	}
+
+	tex.tailMip = 0;
+	while (tex.tailMip + 1 < tex.numMips && max(width >> tex.tailMip, height >> tex.tailMip) > kTailSize)
+	{
+		tex.tailMip++;
+	}
+	tex.wantedMip = tex.tailMip;
+	SwapLevels(renderer, tex, data + tex.mipOffsets[tex.tailMip], tex.tailMip);
+
+	s_stats.nTextures++;
+	s_stats.fullBytes += LevelsSize(tex, 0);
+
+	return id;
+}
+
+void TextureStreamer::Remove(Renderer* renderer, StreamID id)
+{
+	StreamedTexture& tex = s_textures[id];
+	renderer->removeTexture(tex.texture);
+
+	s_stats.nTextures--;
+	s_stats.fullBytes -= LevelsSize(tex, 0);
+	s_stats.residentBytes -= LevelsSize(tex, tex.residentMip);
+
+	// The data can be freed right after this, so queued fetches are dropped and one that is under way
+	// has to finish first, the same as in SetSource()
+	{
+		std::unique_lock<std::mutex> lock(s_mutex);
+		for (uint i = 0; i < s_jobs.size(); )
+		{
+			if (s_jobs[i].id == id)
+				s_jobs.erase(s_jobs.begin() + i);
+			else
+				i++;
+		}
+		s_fetchDone.wait(lock, [id] { return s_fetchingID != id; });
+
+		for (uint i = 0; i < s_results.size(); )
+		{
+			if (s_results[i].id == id)
+			{
+				free(s_results[i].staging);
+				s_results.erase(s_results.begin() + i);
+			}
+			else
+				i++;
+		}
+	}
+
+	FinishFetch(tex);
+	ReleaseID(id);
+}
+
+void TextureStreamer::SetSource(StreamID id, const ubyte* data)
+{
+	StreamedTexture& tex = s_textures[id];
+
+	// Queued fetches read from the new data, one that is under way has to finish first
+	std::unique_lock<std::mutex> lock(s_mutex);
+	for (uint i = 0; i < s_jobs.size(); i++)
+	{
+		if (s_jobs[i].id == id)
+			s_jobs[i].src = data + (s_jobs[i].src - tex.data);
+	}
+	s_fetchDone.wait(lock, [id] { return s_fetchingID != id; });
+
+	tex.data = data;
+}
+
+TextureID TextureStreamer::GetTexture(StreamID id)
+{
+	return s_textures[id].texture;
+}
+
+void TextureStreamer::Request(StreamID id, float screenSize)
+{
+	StreamedTexture& tex = s_textures[id];
+
+	// Full detail (screenSize <= 0) wins over any size
+	if (tex.requestFrame != s_frame)
+		tex.requestedSize = screenSize;
+	else if (tex.requestedSize > 0)
+		tex.requestedSize = (screenSize <= 0) ? screenSize : max(tex.requestedSize, screenSize);
+
+	tex.requestFrame = s_frame;
+}
+
+void TextureStreamer::Update(Renderer* renderer)
+{
+	// Hand the finished fetches to their textures
+	std::vector<FetchResult> results;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		results.swap(s_results);
+	}
+	for (uint i = 0; i < results.size(); i++)
+	{
+		StreamedTexture& tex = s_textures[results[i].id];
+		tex.staging = results[i].staging;
+	}
+
+	// Pick the levels from the requests of the last frame
+	s_stats.requestedBytes = 0;
+	for (uint i = 0; i < s_textures.size(); i++)
+	{
+		StreamedTexture& tex = s_textures[i];
+		if (!tex.used)
+			continue;
+
+		bool requested = s_frame - tex.requestFrame <= kEvictFrames;
+		tex.wantedMip = requested ? MipForSize(tex, tex.requestedSize) : tex.tailMip;
+		s_stats.requestedBytes += LevelsSize(tex, tex.wantedMip);
+	}
+	FitBudget(s_stats.requestedBytes);
+
+	// Drop levels right away, they come straight from the blob. Fetch the missing ones.
+	uint uploadedBytes = 0;
+	s_stats.nPending = 0;
+	s_stats.nFullyResident = 0;
+	for (uint i = 0; i < s_textures.size(); i++)
+	{
+		StreamedTexture& tex = s_textures[i];
+		if (!tex.used)
+			continue;
+
+		if (tex.wantedMip > tex.residentMip)
+		{
+			s_stats.evictedBytes += LevelsSize(tex, tex.residentMip) - LevelsSize(tex, tex.wantedMip);
+			SwapLevels(renderer, tex, tex.data + tex.mipOffsets[tex.wantedMip], tex.wantedMip);
+		}
+
+		// A finished fetch is uploaded if its levels are still wanted, budget permitting.
+		// The first one each frame always goes, so that large textures can't stall.
+		if (tex.staging != NULL)
+		{
+			bool stillWanted = tex.wantedMip < tex.residentMip;
+			uint firstMip = max(tex.wantedMip, tex.pendingMip);
+			uint size = LevelsSize(tex, firstMip);
+			if (stillWanted && uploadedBytes > 0 && uploadedBytes + size > s_uploadBytesPerFrame)
+			{
+				s_stats.nPending++;
+				continue;
+			}
+
+			if (stillWanted)
+			{
+				SwapLevels(renderer, tex, tex.staging + tex.mipOffsets[firstMip] - tex.mipOffsets[tex.pendingMip], firstMip);
+				uploadedBytes += size;
+			}
+			FinishFetch(tex);
+		}
+
+		if (tex.wantedMip < tex.residentMip && !tex.pending)
+		{
+			FetchJob job = { StreamID(i), tex.data + tex.mipOffsets[tex.wantedMip], LevelsSize(tex, tex.wantedMip) };
+			{
+				std::lock_guard<std::mutex> lock(s_mutex);
+				s_jobs.push_back(job);
+			}
+			s_wakeWorker.notify_one();
+			tex.pending = true;
+			tex.pendingMip = tex.wantedMip;
+		}
+
+		s_stats.nPending += tex.pending ? 1 : 0;
+		s_stats.nFullyResident += (tex.residentMip == 0) ? 1 : 0;
+	}
+
+	s_stats.uploadedBytes += uploadedBytes;
+	s_frame++;
+}
+
+void TextureStreamer::GetStats(Stats* stats)
+{
+	*stats = s_stats;
+}
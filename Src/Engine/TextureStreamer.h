@@ -0,0 +1,58 @@
+#pragma once
+#include "Common/common.h"
+#include "Framework3/Renderer.h"
+
+// Streams the mip levels of textures whose full mip chain stays in memory, e.g. in a baked
+// model blob. Add() only uploads the mip tail (the levels up to kTailSize), so a model is
+// drawable right away. Update() then picks the levels every texture should have from the
+// sizes requested that frame, keeping them within the memory budget. Higher levels are
+// fetched into staging memory by a worker thread, and swapped in on the render thread,
+// with a limit on the bytes uploaded per frame to avoid hitches.
+namespace TextureStreamer
+{
+	typedef int StreamID;
+
+	struct Stats
+	{
+		uint nTextures;
+		uint nFullyResident;  // with all their mip levels on the GPU
+		uint nPending;        // waiting for the worker thread or for their upload
+
+		uint residentBytes;   // GPU memory of the streamed textures
+		uint requestedBytes;  // what the requests of the last frame need, without the budget
+		uint fullBytes;       // with every mip level of every texture
+		uint budgetBytes;
+
+		uint uploadedBytes;   // since Init()
+		uint evictedBytes;    // since Init()
+	};
+
+	//Start the worker thread. budgetBytes is the GPU memory the streamed textures may use
+	//(mip tails are always resident, even above it), uploadBytesPerFrame limits the swaps per Update()
+	RESULT Init(uint budgetBytes, uint uploadBytesPerFrame);
+
+	//Stop the worker thread and remove every texture that is left
+	void Shutdown(Renderer* renderer);
+
+	bool IsRunning();
+
+	//Upload the mip tail of a texture. data is the full mip chain, largest level first,
+	//and must stay valid until Remove()
+	StreamID Add(Renderer* renderer, const ubyte* data, FORMAT format, uint width, uint height, uint numMips);
+	void Remove(Renderer* renderer, StreamID id);
+
+	//Read the levels from an identical copy of the mip chain from now on, so that the old one can go away
+	void SetSource(StreamID id, const ubyte* data);
+
+	//The texture to bind this frame. Changes when levels are swapped in or out.
+	TextureID GetTexture(StreamID id);
+
+	//Ask for enough levels for the texture to cover screenSize pixels (along its larger side)
+	//this frame. Textures that aren't requested for a while drop back to their mip tail.
+	void Request(StreamID id, float screenSize);
+
+	//Once per frame, before drawing
+	void Update(Renderer* renderer);
+
+	void GetStats(Stats* stats);
+}
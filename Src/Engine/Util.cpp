@@ -1,4 +1,5 @@
-#include "Util.h"
+#include "util.h"
+#include <string.h>
 
 namespace util
 {
@@ -64,4 +65,26 @@ namespace util
 
 		return h;
 	}
+	BlobRange BlobWrite(std::vector<ubyte>& blob, const void* data, uint elemSize, uint count)
+	{
+		blob.resize((blob.size() + 15) & ~15, 0);
+
+		BlobRange range;
+		range.offset = blob.size();
+		range.count = count;
+
+		uint size = elemSize * count;
+		if (size)
+		{
+			blob.resize(blob.size() + size);
+			memcpy(&blob[range.offset], data, size);
+		}
+		return range;
+	}
+
+	bool BlobCheck(const BlobRange& range, uint elemSize, uint blobSize)
+	{
+		return range.offset <= blobSize && 
+			u64(range.count) * elemSize <= blobSize - range.offset;
+	}
 }
\ No newline at end of file
@@ -1,12 +1,29 @@
 #pragma once
 
 #include "Types.h"
+#include <vector>
 
-#define STL_FOR_EACH(ELEM, CONTAINER) for (auto ELEM = CONTAINER##.begin(); ELEM != CONTAINER##.end(); ELEM++) 
+#define STL_FOR_EACH(ELEM, CONTAINER) for (auto ELEM = (CONTAINER).begin(); ELEM != (CONTAINER).end(); ELEM++) 
 
 namespace util
 {
 	uint bitcount (uint n);
 
 	uint64_t hash64(const void * key, uint32_t len, uint64_t seed);
+
+	// An array inside a baked blob. The offset is relative to the start of the blob.
+	struct BlobRange
+	{
+		u32 offset;
+		u32 count;
+	};
+
+	// Appends count elements of elemSize bytes to the blob, aligned to 16 bytes
+	BlobRange BlobWrite(std::vector<ubyte>& blob, const void* data, uint elemSize, uint count);
+
+	// Returns false if the range does not fit into a blob of blobSize bytes
+	bool BlobCheck(const BlobRange& range, uint elemSize, uint blobSize);
+
+	template <class T>
+	T* BlobRead(ubyte* blob, const BlobRange& range) { return (T*)(blob + range.offset); }
 }
\ No newline at end of file